@@ -1,14 +1,13 @@
 #include <algorithm>
-#include <bits/stdint-uintn.h>
+#include <chrono>
+#include <climits>
 #include <cstdint>
-#include <cstdlib>
-#include <cstring>
-#include <fstream>
+#include <exception>
 #include <iostream>
-#include <optional>
-#include <set>
-#include <stdexcept>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #define GLFW_INCLUDE_VULKAN
@@ -16,960 +15,405 @@
 
 #include "app.hpp"
 #include "constants.hpp"
-#include "utils/io.hpp"
+#include "utils/env.hpp"
 #include "utils/vk.hpp"
 
 App::App()
 #ifdef NDEBUG
   : m_areValidationLayersEnabled(false)
+  , m_sessionCount(static_cast<uint32_t>(getEnvUint("VK_APP_SESSIONS")))
+  , m_isShaderHotReloadEnabled(false)
 #else
   : m_areValidationLayersEnabled(true)
+  , m_sessionCount(static_cast<uint32_t>(getEnvUint("VK_APP_SESSIONS")))
+  // Shaders are as on disk when the replay starts, and headless sessions
+  // are served as they started.
+  , m_isShaderHotReloadEnabled(!hasEnv("VK_APP_REPLAY")
+                               && m_sessionCount == 0)
 #endif
-  , m_validationLayers({ "VK_LAYER_KHRONOS_validation" })
-  , m_deviceExtensions({ VK_KHR_SWAPCHAIN_EXTENSION_NAME }) {}
+  , m_isNormalViewEnabled(hasEnv("VK_APP_NORMAL_VIEW"))
+  , m_captureFileName(getEnv("VK_APP_CAPTURE"))
+  , m_traceFileName(getEnv("VK_APP_TRACE"))
+  , m_replayFileName(getEnv("VK_APP_REPLAY"))
+  , m_frameLimit(getEnvUint("VK_APP_FRAME_LIMIT"))
+  , m_statsFileName(getEnv("VK_APP_STATS"))
+  , m_particleCapacity(
+      static_cast<uint32_t>(getEnvUint("VK_APP_PARTICLES")))
+  // Each render thread is a worker too.
+  , m_workerThreadCount(static_cast<uint32_t>(getEnvUint(
+      "VK_APP_WORKERS",
+      std::max(std::thread::hardware_concurrency(), 1u) - 1)))
+  , m_meshFileName(getEnv("VK_APP_MESH"))
+  , m_extraObjectCount(static_cast<uint32_t>(getEnvUint("VK_APP_OBJECTS")))
+  , m_isCpuCullingEnabled(hasEnv("VK_APP_CPU_CULLING"))
+  , m_windowCount(static_cast<uint32_t>(
+      std::max<uint64_t>(getEnvUint("VK_APP_WINDOWS", 1), 1)))
+  , m_lightCount(static_cast<uint32_t>(getEnvUint("VK_APP_LIGHTS")))
+  , m_targetFrameRate(static_cast<uint32_t>(
+      getEnvUint("VK_APP_TARGET_FPS")))
+  , m_textureFileNames(getEnvList("VK_APP_TEXTURES"))
+  , m_textureBudget(getEnvUint("VK_APP_TEXTURE_BUDGET",
+                               DEFAULT_TEXTURE_BUDGET_MB) << 20)
+  , m_metricsSocketPath(getEnv("VK_APP_METRICS_SOCKET"))
+  , m_metricsJsonFileName(getEnv("VK_APP_METRICS_JSON"))
+{}
 
 void App::run() {
 #ifndef NDEBUG
     std::cout << "Running debug build.\n";
 #endif
 
-    initWindow();
-    initVulkan();
-    mainLoop();
+    m_frameStats.resize(std::max(m_sessionCount, 1u));
+    for (FrameStats& frameStats : m_frameStats) {
+      frameStats.start();
+    }
+    // Whatever was created is cleaned up before an error is reported, so
+    // that no thread is left running.
+    try {
+      if (m_sessionCount == 0) {
+        initWindow();
+        initVulkan();
+        mainLoop();
+      } else {
+        initVulkan();
+        serveSessions();
+      }
+    } catch (...) {
+      performCleanup();
+      throw;
+    }
     performCleanup();
 }
 
 void App::initWindow()
 {
-  glfwInit();
+  m_glfw.init();
 
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
   glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-  m_window = glfwCreateWindow(WINDOW_HEIGHT, WINDOW_WIDTH, "Vulkan!",
-                              nullptr, nullptr);
-}
-
-void App::initVulkan()
-{
-  createVkInstance();
-  setupDebugMessenger();
-  createSurface();
-  selectPhysicalDevice();
-  createLogicalDevice();
-  createSwapChain();
-  createImageViews();
-  createRenderPass();
-  createGraphicsPipeline();
-  createFramebuffers();
-  createCommandPool();
-  createCommandBuffers();
-  createSyncObjects();
-}
-
-void App::mainLoop()
-{
-  while (!glfwWindowShouldClose(m_window)) {
-    glfwPollEvents();
-    drawFrame();
-  }
-
-  vkDeviceWaitIdle(m_device);
-}
-
-void App::drawFrame()
-{
-  vkWaitForFences(m_device, 1, &m_inFlightFences[m_currentFrameIndex],
-                  VK_TRUE, UINT64_MAX);
-  vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrameIndex]);
-
-  uint32_t imgIndex;
-  vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX,
-                        m_imageAvailableSemaphores[m_currentFrameIndex],
-                        VK_NULL_HANDLE, &imgIndex);
-
-  // Check if a previous frame is using this image (i.e. there is its fence
-  // to wait on).
-  if (m_imagesInFlight[imgIndex] != VK_NULL_HANDLE) {
-    vkWaitForFences(m_device, 1, &m_imagesInFlight[imgIndex],
-                    VK_TRUE, UINT64_MAX);
-  }
-
-  // Mark the image as now being in use by this frame.
-  m_imagesInFlight[imgIndex] = m_inFlightFences[m_currentFrameIndex];
-
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-  VkSemaphore waitSemaphores[] = {
-    m_imageAvailableSemaphores[m_currentFrameIndex]
-  };
-  VkPipelineStageFlags waitStages[] = {
-    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-  };
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &m_commandBuffers[imgIndex];
-
-  VkSemaphore signalSemaphores[] = {
-    m_renderFinishedSemaphores[m_currentFrameIndex]
-  };
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
-
-  vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrameIndex]);
-
-  if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo,
-                    m_inFlightFences[m_currentFrameIndex]) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to submit draw command buffer!");
-  }
-
-  VkPresentInfoKHR presentInfo{};
-  presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-  presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = signalSemaphores;
-
-  VkSwapchainKHR swapChains[] = { m_swapChain };
-  presentInfo.swapchainCount = 1;
-  presentInfo.pSwapchains = swapChains;
-  presentInfo.pImageIndices = &imgIndex;
-  presentInfo.pResults = nullptr;
-  
-  vkQueuePresentKHR(m_presentQueue, &presentInfo);
-
-  m_currentFrameIndex = (m_currentFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
-}
-
-void App::performCleanup()
-{
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    vkDestroySemaphore(m_device, m_imageAvailableSemaphores[i], nullptr);
-    vkDestroySemaphore(m_device, m_renderFinishedSemaphores[i], nullptr);
-    vkDestroyFence(m_device, m_inFlightFences[i], nullptr);
-  }
-
-  vkDestroyCommandPool(m_device, m_commandPool, nullptr);
-
-  for (auto framebuffer : m_swapChainFramebuffers) {
-    vkDestroyFramebuffer(m_device, framebuffer, nullptr);
-  }
-
-  vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
-  vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
-  vkDestroyRenderPass(m_device, m_renderPass, nullptr);
-
-  for (auto imageView : m_swapChainImageViews) {
-    vkDestroyImageView(m_device, imageView, nullptr);
-  }
-
-  vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
-
-  vkDestroyDevice(m_device, nullptr);
-
-  vkDestroySurfaceKHR(m_vkInstance, m_surface, nullptr);
-
-  if (m_areValidationLayersEnabled) {
-    DestroyDebugUtilsMessengerEXT(m_vkInstance, m_debugMessenger, nullptr);
-  }
-
-  vkDestroyInstance(m_vkInstance, nullptr);
-
-  glfwDestroyWindow(m_window);
-
-  glfwTerminate();
-}
-
-void App::createVkInstance()
-{
-  if (m_areValidationLayersEnabled && !checkValidationLayerSupport()) {
-    throw std::runtime_error("Validation layers requested, but unavailable!");
-  }
-
-  VkApplicationInfo appInfo{};
-  appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-  appInfo.pApplicationName = "Hello Triangle";
-  appInfo.applicationVersion = VK_MAKE_VERSION(1, 0 , 0);
-  appInfo.pEngineName = "No Engine";
-  appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
-
-  VkInstanceCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-  createInfo.pApplicationInfo = &appInfo;
-
-  uint32_t vkExtensionCount = 0;
-  vkEnumerateInstanceExtensionProperties(nullptr, &vkExtensionCount, nullptr);
-
-  std::vector<VkExtensionProperties> vkExtensions(vkExtensionCount);
-  vkEnumerateInstanceExtensionProperties(nullptr,
-                                          &vkExtensionCount,
-                                          vkExtensions.data());
-
-  std::cout << "Available Vulkan Extensions: \n";
-
-  for (const auto& extension : vkExtensions) {
-    std::cout << "\t" << extension.extensionName << "\n";
-  }
-
-  auto extensions = getRequiredExtensions();    
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-  createInfo.ppEnabledExtensionNames = extensions.data();
-
-  VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo;
-  if (m_areValidationLayersEnabled) {
-    createInfo.enabledLayerCount = static_cast<uint32_t>(
-      m_validationLayers.size());
-    createInfo.ppEnabledLayerNames = m_validationLayers.data();
-
-    populateDebugMessengerCreateInfo(debugCreateInfo);
-    createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*) &debugCreateInfo;
-  } else {
-    createInfo.enabledLayerCount = 0;
-  }
-
-  if (vkCreateInstance(&createInfo, nullptr, &m_vkInstance) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create instance!");
+  for (uint32_t i = 0; i < m_windowCount; i++) {
+    std::string title = i == 0 ? "Vulkan!"
+                               : "Vulkan! (" + std::to_string(i + 1) + ")";
+    m_windows.push_back(UniqueWindow(glfwCreateWindow(
+      WINDOW_HEIGHT, WINDOW_WIDTH, title.c_str(), nullptr, nullptr)));
   }
 }
 
-void App::setupDebugMessenger()
+void App::initVulkan()
 {
-  if (!m_areValidationLayersEnabled) {
-    return;
-  }
-
-  VkDebugUtilsMessengerCreateInfoEXT createInfo{};
-  populateDebugMessengerCreateInfo(createInfo);
+  // Headless sessions have no windows to present to, and are created by
+  // their own threads.
+  m_deviceContext.init(m_sessionCount == 0, m_areValidationLayersEnabled);
+
+  if (m_sessionCount == 0) {
+    std::vector<GLFWwindow*> windows;
+    for (const UniqueWindow& window : m_windows) {
+      windows.push_back(window.get());
+    }
 
-  if (CreateDebugUtilsMessengerEXT(m_vkInstance,
-                                   &createInfo,
-                                   nullptr,
-                                   &m_debugMessenger) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to setup debug messenger.");
+    auto session = std::make_unique<RenderSession>();
+    session->init(m_deviceContext, createSessionOptions(0), windows,
+                  m_metrics, {});
+    m_session = std::move(session);
   }
-}
 
-void App::createSurface()
-{
-  if (glfwCreateWindowSurface(m_vkInstance, m_window, nullptr, &m_surface)
-      != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create window surface!");
+  createMetrics();
+  if (!m_metricsSocketPath.empty() || !m_metricsJsonFileName.empty()) {
+    m_metricsExporter.init(
+      m_metrics, m_metricsSocketPath, m_metricsJsonFileName,
+      std::chrono::milliseconds(METRICS_JSON_INTERVAL_MS));
   }
 }
 
-void App::selectPhysicalDevice()
+void App::mainLoop()
 {
-  uint32_t numDevices = 0;
-  vkEnumeratePhysicalDevices(m_vkInstance, &numDevices, nullptr);
-
-  if (numDevices == 0) {
-    throw std::runtime_error("Failed to find GPUs with Vulkan support!");
-  }
-
-  std::vector<VkPhysicalDevice> devices(numDevices);
-  vkEnumeratePhysicalDevices(m_vkInstance, &numDevices, devices.data());
-
-  for (const auto& device : devices) {
-    if (isPhysicalDeviceSuitable(device)) {
-      m_physicalDevice = device;
-      break;
+  // GLFW events must be handled on the main thread, and rendering runs on
+  // its own, so that neither a slow fence wait or present delays input nor
+  // a burst of window events delays rendering.
+  m_startTime = std::chrono::steady_clock::now();
+  publishInput();
+  m_renderThread = std::thread([this]() {
+    try {
+      m_session->run(m_isStopRequested, &m_inputMailbox, m_frameStats[0]);
+    } catch (...) {
+      m_renderException = std::current_exception();
     }
-  }
-
-  if (m_physicalDevice == VK_NULL_HANDLE) {
-    throw std::runtime_error("Failed to find a suitable GPU!");
-  }
-}
 
-void App::createLogicalDevice()
-{
-  QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
-
-  std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {
-    indices.m_graphicsFamily.value(),
-    indices.m_presentFamily.value()
-  };
-
-  float queuePriority = 1.0f;
-  for (uint32_t queueFamily : uniqueQueueFamilies) {
-    VkDeviceQueueCreateInfo queueCreateInfo{};
-    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueCreateInfo.queueFamilyIndex = indices.m_graphicsFamily.value();
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
-
-    queueCreateInfos.push_back(queueCreateInfo);
-  }    
-
-  VkPhysicalDeviceFeatures deviceFeatures{};
-
-  VkDeviceCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  createInfo.pQueueCreateInfos = queueCreateInfos.data();
-  createInfo.queueCreateInfoCount = 
-    static_cast<uint32_t>(queueCreateInfos.size());
-  createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(
-    m_deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = m_deviceExtensions.data();
-
-  if (m_areValidationLayersEnabled) {
-    createInfo.enabledLayerCount = static_cast<uint32_t>(
-      m_validationLayers.size());
-    createInfo.ppEnabledLayerNames = m_validationLayers.data();
-  } else {
-    createInfo.enabledLayerCount = 0;
-  }
+    // Wakes the main thread if it is waiting for events.
+    m_isRenderLoopFinished.store(true, std::memory_order_release);
+    glfwPostEmptyEvent();
+  });
 
-  if (vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &m_device)
-      != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create logical device!");
-  }
-
-  vkGetDeviceQueue(m_device, indices.m_graphicsFamily.value(), 0,
-                    &m_graphicsQueue);
-  vkGetDeviceQueue(m_device, indices.m_presentFamily.value(), 0,
-                    &m_presentQueue);
-}
-
-void App::createSwapChain()
-{
-  SwapChainSupportDetails swapChainSupport = querySwapChainSupport(
-    m_physicalDevice);
-  VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(
-    swapChainSupport.formats);
-  VkPresentModeKHR presentMode = chooseSwapPresentMode(
-    swapChainSupport.presentModes);
-  VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
-
-  uint32_t imgCount = swapChainSupport.capabilities.minImageCount + 1;
-
-  if (swapChainSupport.capabilities.maxImageCount > 0
-      && imgCount > swapChainSupport.capabilities.maxImageCount) {
-    imgCount = swapChainSupport.capabilities.maxImageCount;
-  }
+  auto isAnyWindowClosed = [this]() {
+    for (const UniqueWindow& window : m_windows) {
+      if (glfwWindowShouldClose(window.get())) {
+        return true;
+      }
+    }
 
-  VkSwapchainCreateInfoKHR createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-  createInfo.surface = m_surface;
-  createInfo.minImageCount = imgCount;
-  createInfo.imageFormat = surfaceFormat.format;
-  createInfo.imageColorSpace = surfaceFormat.colorSpace;
-  createInfo.imageExtent = extent;
-  createInfo.imageArrayLayers = 1;
-  createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-  QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
-  uint32_t queueFamilyIndices[] = {
-    indices.m_graphicsFamily.value(),
-    indices.m_presentFamily.value()
+    return false;
   };
-  if (indices.m_graphicsFamily != indices.m_presentFamily) {
-    createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-    createInfo.queueFamilyIndexCount = 2;
-    createInfo.pQueueFamilyIndices = queueFamilyIndices;
-  } else {
-    createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    createInfo.queueFamilyIndexCount = 0;
-    createInfo.pQueueFamilyIndices = nullptr;
-  }
 
-  createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
-  createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-  createInfo.presentMode = presentMode;
-  createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
-
-  if (vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapChain)
-      != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create swap chain!");
+  auto lastMetricsUpdateTime = m_startTime;
+  while (!isAnyWindowClosed()
+         && !m_isRenderLoopFinished.load(std::memory_order_acquire)) {
+    glfwWaitEventsTimeout(INPUT_POLL_INTERVAL);
+    publishInput();
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastMetricsUpdateTime
+        >= std::chrono::milliseconds(DEVICE_METRICS_INTERVAL_MS)) {
+      updateMetrics();
+      lastMetricsUpdateTime = now;
+    }
   }
 
-  vkGetSwapchainImagesKHR(m_device, m_swapChain, &imgCount, nullptr);
-  m_swapChainImages.resize(imgCount);
-  vkGetSwapchainImagesKHR(m_device, m_swapChain, &imgCount,
-                          m_swapChainImages.data());
-
-  m_swapChainImageFormat = surfaceFormat.format;
-  m_swapChainExtent = extent;
-}
-
-void App::createImageViews()
-{
-  m_swapChainImageViews.resize(m_swapChainImages.size());
-
-  for (size_t i = 0; i < m_swapChainImages.size(); i++) {
-    VkImageViewCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    createInfo.image = m_swapChainImages[i];
-    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    createInfo.format = m_swapChainImageFormat;
-    createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    createInfo.subresourceRange.baseMipLevel = 0;
-    createInfo.subresourceRange.levelCount = 1;
-    createInfo.subresourceRange.baseArrayLayer = 0;
-    createInfo.subresourceRange.layerCount = 1;
-
-    if (vkCreateImageView(m_device, &createInfo, nullptr,
-                          &m_swapChainImageViews[i])
-        != VK_SUCCESS) {
-      throw std::runtime_error("Failed to create image views.");
-    }
+  m_isStopRequested.store(true, std::memory_order_release);
+  m_renderThread.join();
+  if (m_renderException) {
+    std::rethrow_exception(m_renderException);
   }
-}
 
-void App::createRenderPass()
-{
-  VkAttachmentDescription colourAttachment{};
-  colourAttachment.format = m_swapChainImageFormat;
-  colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-  VkAttachmentReference colourAttachmentRef{};
-  colourAttachmentRef.attachment = 0;
-  colourAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  VkSubpassDescription subpass{};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colourAttachmentRef;
-
-  VkRenderPassCreateInfo renderPassCreateInfo{};
-  renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassCreateInfo.attachmentCount = 1;
-  renderPassCreateInfo.pAttachments = &colourAttachment;
-  renderPassCreateInfo.subpassCount = 1;
-  renderPassCreateInfo.pSubpasses = &subpass;
-
-  VkSubpassDependency subpassDependency{};
-  subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  subpassDependency.dstSubpass = 0;
-  subpassDependency.srcStageMask =
-    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  subpassDependency.srcAccessMask = 0;
-  subpassDependency.dstStageMask =
-    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-  renderPassCreateInfo.dependencyCount = 1;
-  renderPassCreateInfo.pDependencies = &subpassDependency;
-
-  if (vkCreateRenderPass(m_device, &renderPassCreateInfo, nullptr,
-                          &m_renderPass) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create render pass!");
+  updateMetrics();
+  if (!m_statsFileName.empty()) {
+    m_frameStats[0].write(m_statsFileName);
   }
 }
 
-void App::createGraphicsPipeline()
+void App::serveSessions()
 {
-  auto vertShaderCode = readFile("shaders/vertex.spv");
-  auto fragShaderCode = readFile("shaders/fragment.spv");
-
-  VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-  VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-  vertShaderStageInfo.sType = 
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-  fragShaderStageInfo.sType = 
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo shaderStages[] = {
-    vertShaderStageInfo, fragShaderStageInfo
-  };
-
-  VkPipelineVertexInputStateCreateInfo vertInputCreateInfo{};
-  vertInputCreateInfo.sType = 
-    VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertInputCreateInfo.vertexBindingDescriptionCount = 0;
-  vertInputCreateInfo.pVertexBindingDescriptions = nullptr;
-  vertInputCreateInfo.vertexAttributeDescriptionCount = 0;
-  vertInputCreateInfo.pVertexAttributeDescriptions = nullptr;
-
-  VkPipelineInputAssemblyStateCreateInfo inputAsmCreateInfo{};
-  inputAsmCreateInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAsmCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAsmCreateInfo.primitiveRestartEnable = VK_FALSE;
-
-  VkViewport viewport{};
-  viewport.x = 0.f;
-  viewport.y = 0.f;
-  viewport.width = (float) m_swapChainExtent.width;
-  viewport.height = (float) m_swapChainExtent.height;
-  viewport.minDepth = 0.f;
-  viewport.maxDepth = 1.f;
-
-  VkRect2D scissor{};
-  scissor.offset = { 0, 0 };
-  scissor.extent = m_swapChainExtent;
-
-  VkPipelineViewportStateCreateInfo viewportStateCreateInfo{};
-  viewportStateCreateInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportStateCreateInfo.viewportCount = 1;
-  viewportStateCreateInfo.pViewports = &viewport;
-  viewportStateCreateInfo.scissorCount = 1;
-  viewportStateCreateInfo.pScissors = &scissor;
-
-  VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo{};
-  rasterizerCreateInfo.sType = 
-    VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizerCreateInfo.depthClampEnable = VK_FALSE;
-  rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-  rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizerCreateInfo.lineWidth = 1.f;
-  rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizerCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-  rasterizerCreateInfo.depthBiasEnable = VK_FALSE;
-  rasterizerCreateInfo.depthBiasConstantFactor = 0.f;
-  rasterizerCreateInfo.depthBiasClamp = 0.f;
-  rasterizerCreateInfo.depthBiasSlopeFactor = 0.f;
-
-  VkPipelineMultisampleStateCreateInfo msCreateInfo{};
-  msCreateInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  msCreateInfo.sampleShadingEnable = VK_FALSE;
-  msCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-  msCreateInfo.minSampleShading = 1.f;
-  msCreateInfo.pSampleMask = nullptr;
-  msCreateInfo.alphaToCoverageEnable = VK_FALSE;
-  msCreateInfo.alphaToOneEnable = VK_FALSE;
-
-  VkPipelineColorBlendAttachmentState colourBlendAttachment{};
-  colourBlendAttachment.colorWriteMask =
-    VK_COLOR_COMPONENT_R_BIT
-    | VK_COLOR_COMPONENT_G_BIT
-    | VK_COLOR_COMPONENT_B_BIT
-    | VK_COLOR_COMPONENT_A_BIT;
-  colourBlendAttachment.blendEnable = VK_FALSE;
-  colourBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-  colourBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-  colourBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-  colourBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-  colourBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-  colourBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-  
-  VkPipelineColorBlendStateCreateInfo colourBlendCreateInfo{};
-  colourBlendCreateInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colourBlendCreateInfo.logicOpEnable = VK_FALSE;
-  colourBlendCreateInfo.logicOp = VK_LOGIC_OP_COPY;
-  colourBlendCreateInfo.attachmentCount = 1;
-  colourBlendCreateInfo.pAttachments = &colourBlendAttachment;
-  colourBlendCreateInfo.blendConstants[0] = 0.f;
-  colourBlendCreateInfo.blendConstants[1] = 0.f;
-  colourBlendCreateInfo.blendConstants[2] = 0.f;
-  colourBlendCreateInfo.blendConstants[3] = 0.f;
-
-  VkDynamicState dynamicStates[] = {
-    VK_DYNAMIC_STATE_VIEWPORT,
-    VK_DYNAMIC_STATE_LINE_WIDTH
-  };
-  VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
-  dynamicStateCreateInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicStateCreateInfo.dynamicStateCount = 2;
-  dynamicStateCreateInfo.pDynamicStates = dynamicStates;
-
-  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
-  pipelineLayoutCreateInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutCreateInfo.setLayoutCount = 0;
-  pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-  pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-  pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
-  if (vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr,
-                              &m_pipelineLayout) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create pipeline layout!");
-  }
+  // Each session is created, drawn and destroyed by its own thread, which
+  // only shares the device, its queues and caches with the others.
+  for (uint32_t i = 0; i < m_sessionCount; i++) {
+    m_sessionThreads.emplace_back([this, i]() {
+      try {
+        RenderSession session;
+        session.init(m_deviceContext, createSessionOptions(i), {},
+                     m_metrics, { { "session", std::to_string(i) } });
+        try {
+          session.run(m_isStopRequested, nullptr, m_frameStats[i]);
+        } catch (...) {
+          session.destroy();
+          throw;
+        }
+        session.destroy();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(m_sessionMutex);
+        if (!m_renderException) {
+          m_renderException = std::current_exception();
+        }
+        m_isStopRequested.store(true, std::memory_order_release);
+      }
 
-  VkGraphicsPipelineCreateInfo pipelineCreateInfo{};
-  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineCreateInfo.stageCount = 2;
-  pipelineCreateInfo.pStages = shaderStages;
-  pipelineCreateInfo.pVertexInputState = &vertInputCreateInfo;
-  pipelineCreateInfo.pInputAssemblyState = &inputAsmCreateInfo;
-  pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-  pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
-  pipelineCreateInfo.pMultisampleState = &msCreateInfo;
-  pipelineCreateInfo.pDepthStencilState = nullptr;
-  pipelineCreateInfo.pColorBlendState = &colourBlendCreateInfo;
-  pipelineCreateInfo.pDynamicState = nullptr;
-  pipelineCreateInfo.layout = m_pipelineLayout;
-  pipelineCreateInfo.renderPass = m_renderPass;
-  pipelineCreateInfo.subpass = 0;
-  pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
-  pipelineCreateInfo.basePipelineIndex = -1;
-  if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1,
-                                &pipelineCreateInfo, nullptr,
-                                &m_graphicsPipeline) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create graphics pipeline!");
+      std::lock_guard<std::mutex> lock(m_sessionMutex);
+      m_finishedSessionCount++;
+      m_sessionFinished.notify_one();
+    });
   }
 
-  vkDestroyShaderModule(m_device, fragShaderModule, nullptr);
-  vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
-}
-
-void App::createFramebuffers()
-{
-  m_swapChainFramebuffers.resize(m_swapChainImageViews.size());
-  for (size_t i = 0; i < m_swapChainImageViews.size(); i++) {
-    VkImageView attachments[] = {
-      m_swapChainImageViews[i]
-    };
-
-    VkFramebufferCreateInfo framebufferCreateInfo{};
-    framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferCreateInfo.renderPass = m_renderPass;
-    framebufferCreateInfo.attachmentCount = 1;
-    framebufferCreateInfo.pAttachments = attachments;
-    framebufferCreateInfo.width = m_swapChainExtent.width;
-    framebufferCreateInfo.height = m_swapChainExtent.height;
-    framebufferCreateInfo.layers = 1;
-    if (vkCreateFramebuffer(m_device, &framebufferCreateInfo, nullptr,
-                            &m_swapChainFramebuffers[i]) != VK_SUCCESS) {
-      throw std::runtime_error("Failed to create framebuffer!");
+  {
+    std::unique_lock<std::mutex> lock(m_sessionMutex);
+    while (m_finishedSessionCount < m_sessionCount) {
+      m_sessionFinished.wait_for(
+        lock, std::chrono::milliseconds(DEVICE_METRICS_INTERVAL_MS));
+      updateMetrics();
     }
   }
-}
 
-void App::createCommandPool()
-{
-  QueueFamilyIndices queueFamilyIndices = findQueueFamilies(m_physicalDevice);
-
-  VkCommandPoolCreateInfo poolCreateInfo{};
-  poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  poolCreateInfo.queueFamilyIndex = queueFamilyIndices.m_graphicsFamily
-                                                      .value();
-  poolCreateInfo.flags = 0;
-  if (vkCreateCommandPool(m_device, &poolCreateInfo, nullptr, &m_commandPool)
-      != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create command pool!");
+  for (std::thread& thread : m_sessionThreads) {
+    thread.join();
   }
-}
-
-void App::createCommandBuffers()
-{
-  m_commandBuffers.resize(m_swapChainFramebuffers.size());
-
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = m_commandPool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = (uint32_t) m_commandBuffers.size();
-  if (vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data())
-      != VK_SUCCESS) {
-    throw std::runtime_error("Failed to allocate command buffers!");
+  if (m_renderException) {
+    std::rethrow_exception(m_renderException);
   }
 
-  for (size_t i = 0; i < m_commandBuffers.size(); i++) {
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0;
-    beginInfo.pInheritanceInfo = nullptr;
-    if (vkBeginCommandBuffer(m_commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-      throw std::runtime_error("Failed to begin recording command buffer!");
+  updateMetrics();
+  if (!m_statsFileName.empty()) {
+    for (uint32_t i = 0; i < m_sessionCount; i++) {
+      m_frameStats[i].write(getSessionFileName(m_statsFileName, i));
     }
-
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_renderPass;
-    renderPassInfo.framebuffer = m_swapChainFramebuffers[i];
-    renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = m_swapChainExtent;
-
-    VkClearValue clearColour = { 0.f, 0.f, 0.f, 1.f };
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColour;
-
-    vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassInfo,
-                          VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(m_commandBuffers[i],
-                      VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      m_graphicsPipeline);
-    vkCmdDraw(m_commandBuffers[i], 3, 1, 0, 0);
-    vkCmdEndRenderPass(m_commandBuffers[i]);
-
-    if (vkEndCommandBuffer(m_commandBuffers[i]) != VK_SUCCESS) {
-      throw std::runtime_error("Failed to record command buffer!");
-    }  
   }
 }
 
-void App::createSyncObjects()
+void App::publishInput()
 {
-  m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  m_imagesInFlight.resize(m_swapChainImages.size(), VK_NULL_HANDLE);
-
-  VkSemaphoreCreateInfo semaphoreCreateInfo{};
-  semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-  VkFenceCreateInfo fenceCreateInfo{};
-  fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    if (vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr,
-                          &m_imageAvailableSemaphores[i]) != VK_SUCCESS
-        || vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr,
-                              &m_renderFinishedSemaphores[i]) != VK_SUCCESS
-        || vkCreateFence(m_device, &fenceCreateInfo, nullptr,
-                          &m_inFlightFences[i]) != VK_SUCCESS) {
-      throw std::runtime_error(
-        "Failed to create sychronization objects for a frame!");
-    }
-  }
+  FrameInput input;
+  input.time = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - m_startTime).count();
+  input.framebufferWidth = INT_MAX;
+  input.framebufferHeight = INT_MAX;
+  for (const UniqueWindow& window : m_windows) {
+    int width;
+    int height;
+    glfwGetFramebufferSize(window.get(), &width, &height);
+    input.framebufferWidth = std::min(input.framebufferWidth, width);
+    input.framebufferHeight = std::min(input.framebufferHeight, height);
+  }
+
+  m_inputMailbox.write(input);
 }
-  
-bool App::checkValidationLayerSupport()
-{
-  uint32_t numLayers;
-  vkEnumerateInstanceLayerProperties(&numLayers, nullptr);
-
-  std::vector<VkLayerProperties> availableLayers(numLayers);
-  vkEnumerateInstanceLayerProperties(&numLayers, availableLayers.data());
-
-  for (const char* layerName : m_validationLayers) {
-    bool isLayerFound = false;
 
-    for (const auto& layerProperties : availableLayers) {
-      if (strcmp(layerName, layerProperties.layerName) == 0) {
-        isLayerFound = true;
-        break;
-      }
-    }
-
-    if (!isLayerFound) {
-      return false;
-    }
-  }
-
-  return true;
-}
-
-std::vector<const char*> App::getRequiredExtensions()
+void App::performCleanup()
 {
-  uint32_t glfwExtensionCount = 0;
-  const char** glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char*> extensions(glfwExtensions,
-                                      glfwExtensions + glfwExtensionCount);
-
-  if (m_areValidationLayersEnabled) {
-    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  // Only still running if an error stopped the main thread first.
+  m_isStopRequested.store(true, std::memory_order_release);
+  if (m_renderThread.joinable()) {
+    m_renderThread.join();
+  }
+  for (std::thread& thread : m_sessionThreads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
   }
 
-  return extensions;
-}
-
-bool App::isPhysicalDeviceSuitable(VkPhysicalDevice device)
-{
-  QueueFamilyIndices indices = findQueueFamilies(device);
-
-  bool areExtensionsSupported = checkDeviceExtensionSupport(device);
-
-  bool isSwapChainAdequate = false;
-  if (areExtensionsSupported) {
-    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-    isSwapChainAdequate = !swapChainSupport.formats.empty()
-                          && !swapChainSupport.presentModes.empty();
+  if (!m_metricsSocketPath.empty() || !m_metricsJsonFileName.empty()) {
+    m_metricsExporter.destroy();
   }
 
-  return indices.isComplete()
-          && areExtensionsSupported
-          && isSwapChainAdequate;
-}
-
-QueueFamilyIndices App::findQueueFamilies(VkPhysicalDevice device)
-{
-  QueueFamilyIndices indices;
-
-  uint32_t queueFamilyCount = 0;
-  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
-                                            nullptr);
-
-  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
-                                            queueFamilies.data());
-
-  int i = 0;
-  for (const auto& queueFamily : queueFamilies) {
-    if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-      indices.m_graphicsFamily = i;
-    }
-
-    VkBool32 isPresentSupportAvailable = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface,
-                                          &isPresentSupportAvailable);
-
-    if (isPresentSupportAvailable) {
-      indices.m_presentFamily = i;
-    }
-
-    i++;
-
-    if (indices.isComplete()) {
-      break;
-    }
+  // Headless sessions were destroyed by their threads.
+  if (m_session) {
+    m_session->destroy();
+    m_session.reset();
   }
+  m_deviceContext.destroy();
 
-  return indices;
+  // Everything else is owned by RAII members, which are destroyed in
+  // reverse order of declaration.
 }
 
-bool App::checkDeviceExtensionSupport(VkPhysicalDevice device)
+SessionOptions App::createSessionOptions(uint32_t sessionIndex)
 {
-  uint32_t extensionCount;
-  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
-                                        nullptr);
-
-  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
-                                        availableExtensions.data());
-
-  std::set<std::string> requiredExtensions(m_deviceExtensions.begin(),
-                                            m_deviceExtensions.end());
-  for (const auto& extension : availableExtensions) {
-    requiredExtensions.erase(extension.extensionName);
-  }
-
-  return requiredExtensions.empty();
+  SessionOptions options;
+  options.isNormalViewEnabled = m_isNormalViewEnabled;
+  options.isShaderHotReloadEnabled = m_isShaderHotReloadEnabled;
+  options.captureFileName = getSessionFileName(m_captureFileName,
+                                               sessionIndex);
+  options.traceFileName = getSessionFileName(m_traceFileName, sessionIndex);
+  options.tracedSettings = getTracedSettings();
+  // Every session replays the same trace.
+  options.replayFileName = m_replayFileName;
+  options.frameLimit = m_frameLimit;
+  options.particleCapacity = m_particleCapacity;
+  options.workerThreadCount = m_workerThreadCount;
+  options.meshFileName = m_meshFileName;
+  options.extraObjectCount = m_extraObjectCount;
+  options.isCpuCullingEnabled = m_isCpuCullingEnabled;
+  options.lightCount = m_lightCount;
+  options.targetFrameRate = m_targetFrameRate;
+  options.textureFileNames = m_textureFileNames;
+  options.textureBudget = m_textureBudget;
+
+  return options;
 }
 
-SwapChainSupportDetails App::querySwapChainSupport(VkPhysicalDevice device)
+std::string App::getSessionFileName(const std::string& fileName,
+                                    uint32_t sessionIndex)
 {
-  SwapChainSupportDetails details;
-  
-  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, m_surface,
-                                            &details.capabilities);
-
-  uint32_t formatCount;
-  vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_surface, &formatCount,
-                                        nullptr);
-  if (formatCount != 0) {
-    details.formats.resize(formatCount);
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_surface, &formatCount,
-                                          details.formats.data());
+  // A single session writes the files as named.
+  if (m_sessionCount <= 1 || fileName.empty()) {
+    return fileName;
   }
 
-  uint32_t presentModeCount;
-  vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_surface,
-                                            &presentModeCount,
-                                            nullptr);
-  if (presentModeCount != 0) {
-    details.presentModes.resize(presentModeCount);
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_surface,
-                                              &presentModeCount,
-                                              details.presentModes.data());
+  std::string suffix = "_" + std::to_string(sessionIndex);
+  size_t directoryEnd = fileName.rfind('/');
+  size_t extensionStart = fileName.rfind('.');
+  if (extensionStart == std::string::npos
+      || (directoryEnd != std::string::npos
+          && extensionStart < directoryEnd)) {
+    return fileName + suffix;
   }
 
-  return details;
+  return fileName.substr(0, extensionStart) + suffix
+         + fileName.substr(extensionStart);
 }
 
-VkSurfaceFormatKHR App::chooseSwapSurfaceFormat(
-  const std::vector<VkSurfaceFormatKHR>& availableFormats)
+std::vector<std::string> App::getTracedSettings()
 {
-  for (const auto& availableFormat : availableFormats) {
-    if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB
-        && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-      return availableFormat;
+  std::vector<std::string> settings;
+  for (const char* name : TRACED_SETTINGS) {
+    if (hasEnv(name)) {
+      settings.push_back(std::string(name) + "=" + getEnv(name));
     }
   }
 
-  return availableFormats[0];
+  return settings;
 }
 
-VkPresentModeKHR App::chooseSwapPresentMode(
-  const std::vector<VkPresentModeKHR>& availablePresentModes)
+void App::createMetrics()
 {
-  for (const auto& availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return availablePresentMode;
+  MetricHandles& handles = m_metricHandles;
+  handles.memoryAllocations = &m_metrics.addCounter(
+    "vk_app_memory_allocations_total", "Calls to vkAllocateMemory().");
+  handles.memoryFrees = &m_metrics.addCounter(
+    "vk_app_memory_frees_total", "Calls to vkFreeMemory().");
+  handles.pipelineCacheHits = &m_metrics.addCounter(
+    "vk_app_pipeline_cache_hits_total",
+    "Pipeline lookups served by an existing pipeline.");
+  handles.pipelineCacheMisses = &m_metrics.addCounter(
+    "vk_app_pipeline_cache_misses_total",
+    "Pipeline lookups that created a pipeline.");
+  handles.pipelineCacheHitRatio = &m_metrics.addGauge(
+    "vk_app_pipeline_cache_hit_ratio",
+    "Fraction of pipeline lookups that were hits.");
+
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(m_deviceContext.getPhysicalDevice(),
+                                      &memoryProperties);
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    MetricLabels labels = { { "heap", std::to_string(i) } };
+    handles.heapSizes.push_back(&m_metrics.addGauge(
+      "vk_app_memory_heap_size_bytes", "Size of a device memory heap.",
+      labels));
+    handles.heapSizes.back()->set(
+      static_cast<double>(memoryProperties.memoryHeaps[i].size));
+
+    // Only known with VK_EXT_memory_budget.
+    if (m_deviceContext.isMemoryBudgetSupported()) {
+      handles.heapUsages.push_back(&m_metrics.addGauge(
+        "vk_app_memory_heap_usage_bytes",
+        "Device memory used by this process in a heap.", labels));
+      handles.heapBudgets.push_back(&m_metrics.addGauge(
+        "vk_app_memory_heap_budget_bytes",
+        "Device memory this process can use in a heap without "
+        "oversubscribing it.", labels));
     }
   }
-
-  return VK_PRESENT_MODE_FIFO_KHR;
-}
-
-VkExtent2D App::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
-{
-  if (capabilities.currentExtent.width != UINT32_MAX) {
-    return capabilities.currentExtent;
-  } else {
-    VkExtent2D actualExtent = { WINDOW_WIDTH, WINDOW_HEIGHT };
-    actualExtent.width = std::max(
-      capabilities.minImageExtent.width,
-      std::min(capabilities.maxImageExtent.width, actualExtent.width));
-    actualExtent.height = std::max(
-      capabilities.minImageExtent.height,
-      std::min(capabilities.maxImageExtent.height, actualExtent.height));
-
-    return actualExtent;
-  }
 }
 
-VkShaderModule App::createShaderModule(const std::vector<char>& code)
+void App::updateMetrics()
 {
-  VkShaderModuleCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-  VkShaderModule shaderModule;
-  if (vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule)
-      != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create shader module!");
+  MetricHandles& handles = m_metricHandles;
+  handles.memoryAllocations->update(getMemoryAllocationCount());
+  handles.memoryFrees->update(getMemoryFreeCount());
+
+  const PipelineCache& pipelineCache = m_deviceContext.getPipelineCache();
+  uint64_t hitCount = pipelineCache.getHitCount();
+  uint64_t missCount = pipelineCache.getMissCount();
+  handles.pipelineCacheHits->update(hitCount);
+  handles.pipelineCacheMisses->update(missCount);
+  if (hitCount + missCount > 0) {
+    handles.pipelineCacheHitRatio->set(
+      static_cast<double>(hitCount) / (hitCount + missCount));
+  }
+
+  if (m_deviceContext.isMemoryBudgetSupported()) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 memoryProperties{};
+    memoryProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(m_deviceContext.getPhysicalDevice(),
+                                         &memoryProperties);
+
+    for (size_t i = 0; i < handles.heapUsages.size(); i++) {
+      handles.heapUsages[i]->set(
+        static_cast<double>(budgetProperties.heapUsage[i]));
+      handles.heapBudgets[i]->set(
+        static_cast<double>(budgetProperties.heapBudget[i]));
+    }
   }
-
-  return shaderModule;
-}
-
-void App::populateDebugMessengerCreateInfo(
-  VkDebugUtilsMessengerCreateInfoEXT& createInfo)
-{
-  createInfo = {};
-  createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-  createInfo.messageSeverity =
-    VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT
-    | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT
-    | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-  createInfo.messageType =
-    VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT
-    | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT
-    | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-  createInfo.pfnUserCallback = debugCallback;
-}
-
-VKAPI_ATTR VkBool32 VKAPI_CALL App::debugCallback(
-  VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-  VkDebugUtilsMessageTypeFlagsEXT messageType,
-  const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
-  void* pUserData)
-{
-  std::cerr << "Validation Layer: " << pCallbackData->pMessage << std::endl;
-
-  return VK_FALSE;
 }
@@ -1,15 +1,33 @@
 #ifndef APP_HPP
 #define APP_HPP
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-#include "ds/QueueFamilyIndices.hpp"
-#include "ds/SwapChainSupportDetails.hpp"
+#include "ds/FrameInput.hpp"
+#include "ds/SessionOptions.hpp"
+#include "gfx/device_context.hpp"
+#include "gfx/frame_stats.hpp"
+#include "gfx/render_session.hpp"
+#include "utils/glfw.hpp"
+#include "utils/mailbox.hpp"
+#include "utils/metrics.hpp"
+#include "utils/metrics_exporter.hpp"
 
+// Renders one session to the windows, or with VK_APP_SESSIONS serves that
+// many headless sessions, each on its own thread, from one device.
 class App
 {
 public:
@@ -20,71 +38,80 @@ private:
   void initWindow();
   void initVulkan();
   void mainLoop();
-  void drawFrame();
+  void serveSessions();
+  void publishInput();
   void performCleanup();
 
-  void createVkInstance();
-  void setupDebugMessenger();
-  void createSurface();
-  void selectPhysicalDevice();
-  void createLogicalDevice();
-  void createSwapChain();
-  void createImageViews();
-  void createRenderPass();
-  void createGraphicsPipeline();
-  void createFramebuffers();
-  void createCommandPool();
-  void createCommandBuffers();
-  void createSyncObjects();
-
-  bool checkValidationLayerSupport();
-  std::vector<const char*> getRequiredExtensions();
-  bool isPhysicalDeviceSuitable(VkPhysicalDevice device);
-  QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
-  bool checkDeviceExtensionSupport(VkPhysicalDevice device);
-  SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
-  VkSurfaceFormatKHR chooseSwapSurfaceFormat(
-    const std::vector<VkSurfaceFormatKHR>& availableFormats);
-  VkPresentModeKHR chooseSwapPresentMode(
-    const std::vector<VkPresentModeKHR>& availablePresentModes);
-  VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-  VkShaderModule createShaderModule(const std::vector<char>& code);
-
-  void populateDebugMessengerCreateInfo(
-    VkDebugUtilsMessengerCreateInfoEXT& createInfo);
-  static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
-    VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-    VkDebugUtilsMessageTypeFlagsEXT messageType,
-    const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
-    void* pUserData);
+  SessionOptions createSessionOptions(uint32_t sessionIndex);
+  // Each headless session writes its own files, named after the setting
+  // with the session index before the extension.
+  std::string getSessionFileName(const std::string& fileName,
+                                 uint32_t sessionIndex);
+  std::vector<std::string> getTracedSettings();
+  void createMetrics();
+  void updateMetrics();
 
   const bool m_areValidationLayersEnabled;
-  const std::vector<const char*> m_validationLayers;
-  const std::vector<const char*> m_deviceExtensions;
-  GLFWwindow* m_window;
-  VkInstance m_vkInstance;
-  VkDebugUtilsMessengerEXT m_debugMessenger;
-  VkSurfaceKHR m_surface;
-  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
-  VkDevice m_device;
-  VkQueue m_graphicsQueue;
-  VkQueue m_presentQueue;
-  VkSwapchainKHR m_swapChain;
-  std::vector<VkImage> m_swapChainImages;
-  VkFormat m_swapChainImageFormat;
-  VkExtent2D m_swapChainExtent;
-  std::vector<VkImageView> m_swapChainImageViews;
-  VkRenderPass m_renderPass;
-  VkPipelineLayout m_pipelineLayout;
-  VkPipeline m_graphicsPipeline;
-  std::vector<VkFramebuffer> m_swapChainFramebuffers;
-  VkCommandPool m_commandPool;
-  std::vector<VkCommandBuffer> m_commandBuffers;
-  std::vector<VkSemaphore> m_imageAvailableSemaphores;
-  std::vector<VkSemaphore> m_renderFinishedSemaphores;
-  std::vector<VkFence> m_inFlightFences;
-  std::vector<VkFence> m_imagesInFlight;
-  size_t m_currentFrameIndex = 0;
+  // Zero renders one session to the windows.
+  const uint32_t m_sessionCount;
+  const bool m_isShaderHotReloadEnabled;
+  const bool m_isNormalViewEnabled;
+  const std::string m_captureFileName;
+  const std::string m_traceFileName;
+  const std::string m_replayFileName;
+  const uint64_t m_frameLimit;
+  const std::string m_statsFileName;
+  const uint32_t m_particleCapacity;
+  const uint32_t m_workerThreadCount;
+  const std::string m_meshFileName;
+  const uint32_t m_extraObjectCount;
+  const bool m_isCpuCullingEnabled;
+  const uint32_t m_windowCount;
+  const uint32_t m_lightCount;
+  const uint32_t m_targetFrameRate;
+  const std::vector<std::string> m_textureFileNames;
+  const uint64_t m_textureBudget;
+  const std::string m_metricsSocketPath;
+  const std::string m_metricsJsonFileName;
+  std::chrono::steady_clock::time_point m_startTime;
+  Mailbox<FrameInput> m_inputMailbox;
+  std::thread m_renderThread;
+  std::atomic<bool> m_isStopRequested{ false };
+  std::atomic<bool> m_isRenderLoopFinished{ false };
+  // Thrown by the render thread, rethrown on the main thread.
+  std::exception_ptr m_renderException;
+  // Headless sessions, each on its own thread. The first exception thrown
+  // by one stops the others, and is rethrown on the main thread.
+  std::vector<std::thread> m_sessionThreads;
+  std::mutex m_sessionMutex;
+  std::condition_variable m_sessionFinished;
+  uint32_t m_finishedSessionCount = 0;
+  // One per session.
+  std::vector<FrameStats> m_frameStats;
+  MetricsRegistry m_metrics;
+  MetricsExporter m_metricsExporter;
+  // Metrics of the device, shared by the sessions. Registered by
+  // createMetrics() and owned by m_metrics.
+  struct MetricHandles
+  {
+    Counter* memoryAllocations;
+    Counter* memoryFrees;
+    Counter* pipelineCacheHits;
+    Counter* pipelineCacheMisses;
+    Gauge* pipelineCacheHitRatio;
+    // One per device memory heap.
+    std::vector<Gauge*> heapSizes;
+    std::vector<Gauge*> heapUsages;
+    std::vector<Gauge*> heapBudgets;
+  } m_metricHandles;
+  // Owning members are destroyed in reverse order of declaration, so each
+  // one must be declared after the objects it depends on.
+  GlfwLibrary m_glfw;
+  std::vector<UniqueWindow> m_windows;
+  DeviceContext m_deviceContext;
+  // The session rendering to the windows, once it is initialized.
+  // Headless sessions are owned by their threads.
+  std::unique_ptr<RenderSession> m_session;
 };
 
 #endif
@@ -1,6 +1,14 @@
 #!/bin/sh
+# Compiles each shader source to SPIR-V next to it, named after the whole
+# source name, so that stages of the same name don't collide. A source gives
+# extra glslc flags on lines starting with "// glslc: ", which the shader
+# watcher reads too. Stops at the first shader that fails to compile.
 
-echo -n "Compiling vertex and fragment shaders... "
-glslc shaders/vertex.vert -o shaders/vertex.spv
-glslc shaders/fragment.frag -o shaders/fragment.spv
-echo "Done!"
\ No newline at end of file
+set -e
+
+echo -n "Compiling shaders... "
+for source in shaders/*.vert shaders/*.frag shaders/*.comp; do
+  flags=$(sed -n 's|^// glslc: ||p' "$source")
+  glslc $flags "$source" -o "$source.spv"
+done
+echo "Done!"
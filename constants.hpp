@@ -3,8 +3,77 @@
 
 #include <cstdint>
 
+#include "utils/specialization.hpp"
+
 static constexpr uint32_t WINDOW_HEIGHT = 800;
 static constexpr uint32_t WINDOW_WIDTH = 600;
+// Size of a headless render session's target, the same as a window's.
+static constexpr uint32_t HEADLESS_WIDTH = 800;
+static constexpr uint32_t HEADLESS_HEIGHT = 600;
 static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+// Longest time, in seconds, between input snapshots while there are no
+// window events.
+static constexpr double INPUT_POLL_INTERVAL = 0.001;
+// Readback buffers for frame capture. Frames in flight each hold one until
+// they finish, and the rest give the writer thread room to fall behind.
+static constexpr uint32_t CAPTURE_BUFFER_COUNT = MAX_FRAMES_IN_FLIGHT + 2;
+// Lowest scale of the render resolution with dynamic resolution.
+static constexpr float MIN_RESOLUTION_SCALE = 0.5f;
+// Texel data kept resident by the texture streaming, in MiB, unless set
+// by VK_APP_TEXTURE_BUDGET.
+static constexpr uint64_t DEFAULT_TEXTURE_BUDGET_MB = 256;
+// Time between rewrites of the metrics JSON file.
+static constexpr uint32_t METRICS_JSON_INTERVAL_MS = 10000;
+// Time between updates of the metrics of the device, which the main thread
+// takes while the sessions render on their own threads.
+static constexpr uint32_t DEVICE_METRICS_INTERVAL_MS = 100;
+// Environment variables that change the work of a frame, recorded in frame
+// traces and restored from them on replay.
+static constexpr const char* TRACED_SETTINGS[] = {
+  "VK_APP_NORMAL_VIEW", "VK_APP_PARTICLES", "VK_APP_WORKERS",
+  "VK_APP_MESH", "VK_APP_OBJECTS", "VK_APP_CPU_CULLING", "VK_APP_WINDOWS",
+  "VK_APP_LIGHTS", "VK_APP_TARGET_FPS", "VK_APP_TEXTURES",
+  "VK_APP_TEXTURE_BUDGET"
+};
+static constexpr const char* PIPELINE_CACHE_FILE_NAME = "pipeline_cache.bin";
+static constexpr const char* SHADER_DIR = "shaders";
+static constexpr const char* VERTEX_SHADER_FILE_NAME =
+  "shaders/vertex.vert.spv";
+static constexpr const char* FRAGMENT_SHADER_FILE_NAME =
+  "shaders/fragment.frag.spv";
+static constexpr const char* PARTICLE_PREPARE_SHADER_FILE_NAME =
+  "shaders/particle_prepare.comp.spv";
+static constexpr const char* PARTICLE_SIMULATE_SHADER_FILE_NAME =
+  "shaders/particle_simulate.comp.spv";
+static constexpr const char* PARTICLE_EMIT_SHADER_FILE_NAME =
+  "shaders/particle_emit.comp.spv";
+static constexpr const char* PARTICLE_VERTEX_SHADER_FILE_NAME =
+  "shaders/particle_vertex.vert.spv";
+static constexpr const char* PARTICLE_FRAGMENT_SHADER_FILE_NAME =
+  "shaders/particle_fragment.frag.spv";
+static constexpr const char* LIGHT_BINNING_SHADER_FILE_NAME =
+  "shaders/light_binning.comp.spv";
+static constexpr const char* UPSCALE_VERTEX_SHADER_FILE_NAME =
+  "shaders/upscale_vertex.vert.spv";
+static constexpr const char* UPSCALE_FRAGMENT_SHADER_FILE_NAME =
+  "shaders/upscale_fragment.frag.spv";
+static constexpr const char* HIZ_BUILD_SHADER_FILE_NAME =
+  "shaders/hiz_build.comp.spv";
+static constexpr const char* HIZ_BUILD_SHARED_SHADER_FILE_NAME =
+  "shaders/hiz_build_shared.comp.spv";
+static constexpr const char* HIZ_CULL_SHADER_FILE_NAME =
+  "shaders/hiz_cull.comp.spv";
+static constexpr const char* TEXTURE_FEEDBACK_SHADER_FILE_NAME =
+  "shaders/texture_feedback.comp.spv";
+static constexpr const char* MIP_GENERATE_SHADER_FILE_NAME =
+  "shaders/mip_generate.comp.spv";
+
+// Specialization constants of shaders/fragment.frag.
+static constexpr SpecConstant<bool> IS_NORMAL_VIEW_ENABLED{ 0 };
+static constexpr SpecConstant<bool> IS_LIGHTING_ENABLED{ 1 };
+static constexpr SpecConstant<uint32_t> TEXTURE_COUNT{ 2 };
+
+// Specialization constants of shaders/mip_generate.comp.
+static constexpr SpecConstant<bool> IS_SRGB{ 0 };
 
 #endif
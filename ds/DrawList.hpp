@@ -0,0 +1,16 @@
+#ifndef DRAW_LIST_HPP
+#define DRAW_LIST_HPP
+
+#include <cstdint>
+#include <vector>
+
+static constexpr uint32_t MAX_LOD_COUNT = 4;
+
+// Visible objects grouped by LOD, in ascending object order, so that each
+// LOD can be recorded as one instanced draw.
+struct DrawList
+{
+  std::vector<uint32_t> objects[MAX_LOD_COUNT];
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef FRAME_INPUT_HPP
+#define FRAME_INPUT_HPP
+
+#include <cstdint>
+
+// Snapshot of the window and input state, taken by the main thread after
+// handling events and read by the render thread at the start of a frame.
+struct FrameInput
+{
+  // Seconds since the app started, as of the snapshot.
+  double time;
+  // The smallest over all windows, i.e. zero while any is minimised.
+  int framebufferWidth;
+  int framebufferHeight;
+};
+
+#endif
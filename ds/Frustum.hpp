@@ -0,0 +1,12 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+// Planes (a, b, c, d) of a view frustum, with normals pointing inwards and
+// normalised, so that a * x + b * y + c * z + d is the signed distance of a
+// point from the plane.
+struct Frustum
+{
+  float planes[6][4];
+};
+
+#endif
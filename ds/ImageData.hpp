@@ -0,0 +1,15 @@
+#ifndef IMAGE_DATA_HPP
+#define IMAGE_DATA_HPP
+
+#include <cstdint>
+#include <vector>
+
+// Tightly packed 8-bit RGB pixels, top row first.
+struct ImageData
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+#endif
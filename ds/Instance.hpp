@@ -0,0 +1,33 @@
+#ifndef INSTANCE_HPP
+#define INSTANCE_HPP
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "../utils/vertex_layout.hpp"
+#include "Mat4.hpp"
+
+// Per-instance vertex data, written by Scene::resolveWorldMatrices().
+struct Instance
+{
+  Mat4 model;
+};
+
+// Follows the locations of VertexLayout.
+using InstanceLayout = VertexBindingLayout<
+  Instance, 1, VK_VERTEX_INPUT_RATE_INSTANCE, 4,
+  VERTEX_ATTRIBUTE(Instance, model)>;
+
+// Per-instance index of the object drawn, written by the occlusion culling
+// next to the visible instances.
+struct InstanceObject
+{
+  uint32_t objectIndex;
+};
+
+using InstanceObjectLayout = VertexBindingLayout<
+  InstanceObject, 2, VK_VERTEX_INPUT_RATE_INSTANCE, 8,
+  VERTEX_ATTRIBUTE(InstanceObject, objectIndex)>;
+
+#endif
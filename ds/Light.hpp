@@ -0,0 +1,15 @@
+#ifndef LIGHT_HPP
+#define LIGHT_HPP
+
+// A point light, laid out as the Light struct of
+// shaders/lighting_common.glsl.
+struct Light
+{
+  float position[3];
+  // Distance at which the light's contribution reaches zero.
+  float radius;
+  float colour[3];
+  float intensity;
+};
+
+#endif
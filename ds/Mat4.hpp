@@ -0,0 +1,11 @@
+#ifndef MAT4_HPP
+#define MAT4_HPP
+
+// Column-major 4x4 matrix, as read by GLSL. Aligned so that each column
+// can be loaded into one SSE register.
+struct alignas(16) Mat4
+{
+  float m[16];
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef MESH_DATA_HPP
+#define MESH_DATA_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "MeshVertex.hpp"
+#include "Meshlet.hpp"
+
+struct MeshData
+{
+  std::vector<MeshVertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<Meshlet> meshlets;
+  std::vector<uint32_t> meshletVertices;
+  std::vector<uint8_t> meshletTriangles;
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef MESH_VERTEX_HPP
+#define MESH_VERTEX_HPP
+
+struct MeshVertex
+{
+  float position[3];
+  float normal[3];
+  float uv[2];
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef MESHLET_HPP
+#define MESHLET_HPP
+
+#include <cstdint>
+
+// A small cluster of triangles that can be culled as a unit. Vertices are
+// indices into MeshData::meshletVertices, starting at vertexOffset, and
+// triangles are triplets of local (8-bit) vertex indices into
+// MeshData::meshletTriangles, starting at triangleOffset.
+//
+// The cluster is culled if the camera lies inside the backface cone, i.e.
+//   dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff
+struct Meshlet
+{
+  uint32_t vertexOffset;
+  uint32_t triangleOffset;
+  uint32_t vertexCount;
+  uint32_t triangleCount;
+
+  float center[3];
+  float radius;
+  float coneApex[3];
+  float coneAxis[3];
+  float coneCutoff;
+};
+
+#endif
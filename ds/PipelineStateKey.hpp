@@ -0,0 +1,49 @@
+#ifndef PIPELINE_STATE_KEY_HPP
+#define PIPELINE_STATE_KEY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../utils/specialization.hpp"
+
+struct ShaderStageKey
+{
+  VkShaderStageFlagBits stage;
+  VkShaderModule module;
+  std::string entryPoint = "main";
+  SpecializationConstants specialization;
+};
+
+// Everything that determines a graphics pipeline. Viewport and scissor are
+// dynamic, so pipelines do not depend on the swap chain extent.
+struct PipelineStateKey
+{
+  std::vector<ShaderStageKey> stages;
+
+  std::vector<VkVertexInputBindingDescription> vertexBindings;
+  std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+  VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+  bool isDepthBiasEnabled = false;
+  float depthBiasConstantFactor = 0.f;
+  float depthBiasSlopeFactor = 0.f;
+
+  // One entry per colour attachment of the subpass.
+  std::vector<VkPipelineColorBlendAttachmentState> colourBlendAttachments;
+
+  bool isDepthTestEnabled = false;
+  bool isDepthWriteEnabled = false;
+  VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  uint32_t subpass = 0;
+};
+
+#endif
@@ -8,11 +8,22 @@ struct QueueFamilyIndices
 {
   std::optional<uint32_t> m_graphicsFamily;
   std::optional<uint32_t> m_presentFamily;
+  // A family with compute but no graphics support if there is one, so that
+  // compute work can run alongside rendering. Otherwise the graphics family.
+  std::optional<uint32_t> m_computeFamily;
 
-  bool isComplete()
+  // The present family is only needed to present to windows.
+  bool isComplete(bool isPresentationEnabled) const
   {
-    return m_graphicsFamily.has_value() && m_presentFamily.has_value();
+    return m_graphicsFamily.has_value()
+           && (m_presentFamily.has_value() || !isPresentationEnabled)
+           && m_computeFamily.has_value();
+  }
+
+  bool hasDedicatedComputeFamily() const
+  {
+    return m_computeFamily != m_graphicsFamily;
   }
 };
 
-#endif
\ No newline at end of file
+#endif
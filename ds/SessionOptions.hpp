@@ -0,0 +1,42 @@
+#ifndef SESSION_OPTIONS_HPP
+#define SESSION_OPTIONS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a render session draws and records, read from the environment by
+// the app (see README.md).
+struct SessionOptions
+{
+  bool isNormalViewEnabled = false;
+  bool isShaderHotReloadEnabled = false;
+  std::string captureFileName;
+  // Frames are recorded to the trace, with the settings, or replayed from
+  // the replay trace instead of following the input and GPU times (see
+  // tools/replay).
+  std::string traceFileName;
+  std::vector<std::string> tracedSettings;
+  std::string replayFileName;
+  // Stops after this many frames if non-zero.
+  uint64_t frameLimit = 0;
+  // Particles are disabled if zero.
+  uint32_t particleCapacity = 0;
+  uint32_t workerThreadCount = 0;
+  // A .mesh file (see tools/meshopt) drawn instead of the triangle if set.
+  std::string meshFileName;
+  // Objects drawn around the root object, which is drawn on its own.
+  uint32_t extraObjectCount = 0;
+  // Culls the objects against the view on the CPU rather than against the
+  // view and the previous frame's depth on the GPU.
+  bool isCpuCullingEnabled = false;
+  // Lighting is disabled if zero, and the scene is drawn unlit.
+  uint32_t lightCount = 0;
+  // Dynamic resolution is disabled if zero.
+  uint32_t targetFrameRate = 0;
+  // Objects are untextured if empty.
+  std::vector<std::string> textureFileNames;
+  uint64_t textureBudget = 0;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef VERTEX_HPP
+#define VERTEX_HPP
+
+#include <vulkan/vulkan.h>
+
+#include "../utils/quantize.hpp"
+#include "../utils/vertex_layout.hpp"
+
+// 20-byte vertex, down from 48 bytes with 32-bit floats throughout.
+struct Vertex
+{
+  Half4 position;
+  OctNormal normal;
+  Unorm16x2 uv;
+  Unorm8x4 colour;
+};
+
+using VertexLayout = VertexBindingLayout<
+  Vertex, 0, VK_VERTEX_INPUT_RATE_VERTEX, 0,
+  VERTEX_ATTRIBUTE(Vertex, position),
+  VERTEX_ATTRIBUTE(Vertex, normal),
+  VERTEX_ATTRIBUTE(Vertex, uv),
+  VERTEX_ATTRIBUTE(Vertex, colour)>;
+
+#endif
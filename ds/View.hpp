@@ -0,0 +1,42 @@
+#ifndef VIEW_HPP
+#define VIEW_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../gfx/handles.hpp"
+#include "../utils/glfw.hpp"
+
+// A window and everything needed to present to it, or an offscreen target
+// in its place. All views of a session share the device, the render pass
+// and the per-frame command buffers and fences, so each frame renders and
+// presents every view with one submission.
+struct View
+{
+  // Owned by the app. Null for an offscreen view, which has no surface or
+  // swap chain.
+  GLFWwindow* window = nullptr;
+  UniqueSurface surface;
+  UniqueSwapchain swapChain;
+  // The swap chain's images, or the offscreen ones.
+  std::vector<VkImage> swapChainImages;
+  VkExtent2D swapChainExtent;
+  // Offscreen images, one per frame in flight, so that frames in flight
+  // never share one, as a swap chain ensures by acquiring.
+  std::vector<UniqueDeviceMemory> offscreenImageMemories;
+  std::vector<UniqueImage> offscreenImages;
+  std::vector<UniqueImageView> swapChainImageViews;
+  std::vector<UniqueFramebuffer> swapChainFramebuffers;
+
+  // One per frame in flight. Offscreen views have none.
+  std::vector<UniqueSemaphore> imageAvailableSemaphores;
+  std::vector<UniqueSemaphore> renderFinishedSemaphores;
+  // The fence of the frame that last rendered to each swap chain image.
+  std::vector<VkFence> imagesInFlight;
+  // Acquired for the frame being recorded. Offscreen, the frame slot.
+  uint32_t imageIndex = 0;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "async_compute.hpp"
+
+void AsyncCompute::init(VkDevice device,
+                        const QueueFamilyIndices& queueFamilies,
+                        SubmitQueue& computeQueue,
+                        uint32_t frameCount)
+{
+  m_device = device;
+  m_queue = &computeQueue;
+  m_computeFamily = queueFamilies.m_computeFamily.value();
+  m_graphicsFamily = queueFamilies.m_graphicsFamily.value();
+
+  VkCommandPoolCreateInfo poolCreateInfo{};
+  poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolCreateInfo.queueFamilyIndex = m_computeFamily;
+  poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  VkCommandPool commandPool;
+  if (vkCreateCommandPool(m_device, &poolCreateInfo, nullptr, &commandPool)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create compute command pool!");
+  }
+  m_commandPool = UniqueCommandPool(m_device, commandPool);
+
+  std::vector<VkCommandBuffer> commandBuffers(frameCount);
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = m_commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = frameCount;
+  if (vkAllocateCommandBuffers(m_device, &allocInfo, commandBuffers.data())
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate compute command buffers!");
+  }
+
+  VkSemaphoreCreateInfo semaphoreCreateInfo{};
+  semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  VkFenceCreateInfo fenceCreateInfo{};
+  fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  m_frames.resize(frameCount);
+  for (uint32_t i = 0; i < frameCount; i++) {
+    Frame& frame = m_frames[i];
+    frame.commandBuffer = commandBuffers[i];
+
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr,
+                          &semaphore) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create compute semaphore!");
+    }
+    frame.finishedSemaphore = UniqueSemaphore(m_device, semaphore);
+
+    VkFence fence;
+    if (vkCreateFence(m_device, &fenceCreateInfo, nullptr, &fence)
+        != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create compute fence!");
+    }
+    frame.fence = UniqueFence(m_device, fence);
+  }
+}
+
+void AsyncCompute::destroy()
+{
+  // Command buffers are freed with the pool.
+  m_frames.clear();
+  m_commandPool.reset();
+}
+
+bool AsyncCompute::isDedicated() const
+{
+  return m_computeFamily != m_graphicsFamily;
+}
+
+std::vector<uint32_t> AsyncCompute::getConcurrentQueueFamilies() const
+{
+  if (!isDedicated()) {
+    return {};
+  }
+
+  return { m_computeFamily, m_graphicsFamily };
+}
+
+VkCommandBuffer AsyncCompute::begin(size_t frameIndex)
+{
+  Frame& frame = m_frames[frameIndex];
+  vkWaitForFences(m_device, 1, frame.fence.getAddress(), VK_TRUE,
+                  UINT64_MAX);
+
+  vkResetCommandBuffer(frame.commandBuffer, 0);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin compute command buffer!");
+  }
+
+  return frame.commandBuffer;
+}
+
+void AsyncCompute::submit(size_t frameIndex,
+                          VkPipelineStageFlags graphicsWaitStage)
+{
+  Frame& frame = m_frames[frameIndex];
+  if (vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record compute command buffer!");
+  }
+
+  VkSemaphore signalSemaphores[] = { frame.finishedSemaphore };
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &frame.commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = signalSemaphores;
+
+  vkResetFences(m_device, 1, frame.fence.getAddress());
+  if (m_queue->submit(1, &submitInfo, frame.fence) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to submit compute command buffer!");
+  }
+
+  frame.graphicsWaitStage = graphicsWaitStage;
+  frame.isWaitPending = true;
+}
+
+bool AsyncCompute::getGraphicsWait(size_t frameIndex,
+                                   VkSemaphore& semaphore,
+                                   VkPipelineStageFlags& waitStage)
+{
+  Frame& frame = m_frames[frameIndex];
+  if (!frame.isWaitPending) {
+    return false;
+  }
+
+  semaphore = frame.finishedSemaphore;
+  waitStage = frame.graphicsWaitStage;
+  frame.isWaitPending = false;
+
+  return true;
+}
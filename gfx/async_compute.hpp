@@ -0,0 +1,74 @@
+#ifndef ASYNC_COMPUTE_HPP
+#define ASYNC_COMPUTE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../ds/QueueFamilyIndices.hpp"
+#include "../utils/submit_queue.hpp"
+#include "handles.hpp"
+
+// Submits per-frame compute work, e.g. simulation or culling, to the
+// compute queue so that it overlaps with rendering. The graphics submission
+// of the same frame waits on a semaphore signalled by the compute one.
+//
+// Buffers used by both queues are shared concurrently by the two queue
+// families (see getConcurrentQueueFamilies()) rather than transferred
+// between them. The compute work of the next frame overlaps with the
+// graphics work of the current one, so the graphics queue could not hand
+// such a buffer back in time without a wait that undoes the overlap. The
+// semaphore alone orders the work.
+class AsyncCompute
+{
+public:
+  void init(VkDevice device,
+            const QueueFamilyIndices& queueFamilies,
+            SubmitQueue& computeQueue,
+            uint32_t frameCount);
+  void destroy();
+
+  bool isDedicated() const;
+
+  // For buffers that both queues read and write every frame, where an
+  // ownership transfer each way would cost more than concurrent sharing.
+  // Pass to createBuffer().
+  std::vector<uint32_t> getConcurrentQueueFamilies() const;
+
+  // Waits for the previous compute submission of this frame slot, and
+  // returns its command buffer ready for recording.
+  VkCommandBuffer begin(size_t frameIndex);
+
+  // Submits the command buffer of the frame slot. The graphics submission
+  // of the frame must wait on the semaphore from getGraphicsWait(), at
+  // graphicsWaitStage, which must cover the stages reading compute output.
+  void submit(size_t frameIndex, VkPipelineStageFlags graphicsWaitStage);
+
+  // Returns false if no compute work was submitted for this frame. Each
+  // wait is handed out once, since a semaphore signal can only be waited on
+  // once.
+  bool getGraphicsWait(size_t frameIndex,
+                       VkSemaphore& semaphore,
+                       VkPipelineStageFlags& waitStage);
+
+private:
+  struct Frame
+  {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    UniqueSemaphore finishedSemaphore;
+    UniqueFence fence;
+    VkPipelineStageFlags graphicsWaitStage = 0;
+    bool isWaitPending = false;
+  };
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  SubmitQueue* m_queue = nullptr;
+  uint32_t m_computeFamily = 0;
+  uint32_t m_graphicsFamily = 0;
+  UniqueCommandPool m_commandPool;
+  std::vector<Frame> m_frames;
+};
+
+#endif
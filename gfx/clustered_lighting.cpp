@@ -0,0 +1,221 @@
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../constants.hpp"
+#include "../utils/vk.hpp"
+#include "clustered_lighting.hpp"
+
+namespace
+{
+// Matches the local size of shaders/light_binning.comp.
+constexpr uint32_t GROUP_SIZE = 64;
+
+// Matches the push constant block of shaders/light_binning.comp.
+struct BinningPushConstants
+{
+  uint32_t lightCount;
+};
+}
+
+void ClusteredLighting::init(VkDevice device,
+                             VkPhysicalDevice physicalDevice,
+                             LayoutCache& layoutCache,
+                             PipelineCache& pipelineCache,
+                             uint32_t capacity,
+                             uint32_t frameCount)
+{
+  m_device = device;
+  m_physicalDevice = physicalDevice;
+  m_layoutCache = &layoutCache;
+  m_pipelineCache = &pipelineCache;
+  m_capacity = capacity;
+  m_frames.resize(frameCount);
+
+  // Declared the same way as the reflected set of the fragment shader, so
+  // that the layout cache returns the same layout for both.
+  std::vector<VkDescriptorSetLayoutBinding> bindings(BINDING_COUNT);
+  for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[i].pImmutableSamplers = nullptr;
+  }
+  m_shadingSetLayout = m_layoutCache->getDescriptorSetLayout(bindings);
+
+  createBuffers();
+  createDescriptorPool();
+  createBinningPipeline();
+}
+
+void ClusteredLighting::destroy()
+{
+  // The layouts belong to the layout cache. Descriptor sets are freed with
+  // the pool.
+  m_binningPipeline.reset();
+  m_descriptorPool.reset();
+  m_clusterLightIndexBuffer.reset();
+  m_clusterLightIndexMemory.reset();
+  m_clusterLightCountBuffer.reset();
+  m_clusterLightCountMemory.reset();
+  m_frames.clear();
+}
+
+VkDescriptorSetLayout ClusteredLighting::getShadingSetLayout() const
+{
+  return m_shadingSetLayout;
+}
+
+Light* ClusteredLighting::getLights(size_t frameIndex) const
+{
+  return m_frames[frameIndex].lights;
+}
+
+void ClusteredLighting::recordBinning(VkCommandBuffer commandBuffer,
+                                      size_t frameIndex,
+                                      uint32_t lightCount) const
+{
+  // The cluster lists are shared by all frames, so the previous frame's
+  // shading must have read them before they are rewritten.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  BinningPushConstants pushConstants{};
+  pushConstants.lightCount = lightCount;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_binningPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_binningPipelineLayout, 0, 1,
+                          &m_frames[frameIndex].binningSet, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, m_binningPipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants),
+                     &pushConstants);
+  vkCmdDispatch(commandBuffer, (CLUSTER_COUNT + GROUP_SIZE - 1) / GROUP_SIZE,
+                1, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+}
+
+void ClusteredLighting::bind(VkCommandBuffer commandBuffer,
+                             VkPipelineLayout pipelineLayout,
+                             size_t frameIndex) const
+{
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout, 0, 1,
+                          &m_frames[frameIndex].shadingSet, 0, nullptr);
+}
+
+void ClusteredLighting::createBuffers()
+{
+  VkDeviceSize lightsSize = m_capacity * sizeof(Light);
+  for (Frame& frame : m_frames) {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    createBuffer(m_device, m_physicalDevice, lightsSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                 | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffer, memory);
+    frame.lightMemory = UniqueDeviceMemory(m_device, memory);
+    frame.lightBuffer = UniqueBuffer(m_device, buffer);
+
+    // Stays mapped until the memory is freed.
+    void* data;
+    vkMapMemory(m_device, memory, 0, lightsSize, 0, &data);
+    frame.lights = static_cast<Light*>(data);
+  }
+
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  createBuffer(m_device, m_physicalDevice,
+               CLUSTER_COUNT * sizeof(uint32_t),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+  m_clusterLightCountMemory = UniqueDeviceMemory(m_device, memory);
+  m_clusterLightCountBuffer = UniqueBuffer(m_device, buffer);
+
+  createBuffer(m_device, m_physicalDevice,
+               CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+  m_clusterLightIndexMemory = UniqueDeviceMemory(m_device, memory);
+  m_clusterLightIndexBuffer = UniqueBuffer(m_device, buffer);
+}
+
+void ClusteredLighting::createDescriptorPool()
+{
+  // A binning set and a shading set per frame.
+  uint32_t setCount = 2 * static_cast<uint32_t>(m_frames.size());
+
+  VkDescriptorPoolSize poolSize{};
+  poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSize.descriptorCount = setCount * BINDING_COUNT;
+
+  VkDescriptorPoolCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  createInfo.maxSets = setCount;
+  createInfo.poolSizeCount = 1;
+  createInfo.pPoolSizes = &poolSize;
+
+  VkDescriptorPool descriptorPool;
+  if (vkCreateDescriptorPool(m_device, &createInfo, nullptr, &descriptorPool)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create lighting descriptor pool!");
+  }
+  m_descriptorPool = UniqueDescriptorPool(m_device, descriptorPool);
+}
+
+void ClusteredLighting::createBinningPipeline()
+{
+  ComputePipelineInfo info = m_pipelineCache->createComputePipeline(
+    *m_layoutCache, LIGHT_BINNING_SHADER_FILE_NAME);
+  m_binningPipeline = UniquePipeline(m_device, info.pipeline);
+  m_binningPipelineLayout = info.layoutInfo->layout;
+
+  for (Frame& frame : m_frames) {
+    frame.binningSet = allocateDescriptorSet(m_device, m_descriptorPool,
+                                             info.layoutInfo->setLayouts[0]);
+    writeDescriptorSet(frame.binningSet, frame);
+    frame.shadingSet = allocateDescriptorSet(m_device, m_descriptorPool,
+                                             m_shadingSetLayout);
+    writeDescriptorSet(frame.shadingSet, frame);
+  }
+}
+
+void ClusteredLighting::writeDescriptorSet(VkDescriptorSet descriptorSet,
+                                           const Frame& frame)
+{
+  VkDescriptorBufferInfo bufferInfos[BINDING_COUNT];
+  bufferInfos[LIGHTS_BINDING] = { frame.lightBuffer, 0, VK_WHOLE_SIZE };
+  bufferInfos[CLUSTER_LIGHT_COUNTS_BINDING] = {
+    m_clusterLightCountBuffer, 0, VK_WHOLE_SIZE
+  };
+  bufferInfos[CLUSTER_LIGHT_INDICES_BINDING] = {
+    m_clusterLightIndexBuffer, 0, VK_WHOLE_SIZE
+  };
+
+  VkWriteDescriptorSet writes[BINDING_COUNT] = {};
+  for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = descriptorSet;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = &bufferInfos[i];
+  }
+
+  vkUpdateDescriptorSets(m_device, BINDING_COUNT, writes, 0, nullptr);
+}
@@ -0,0 +1,100 @@
+#ifndef CLUSTERED_LIGHTING_HPP
+#define CLUSTERED_LIGHTING_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../ds/Light.hpp"
+#include "handles.hpp"
+#include "layout_cache.hpp"
+#include "pipeline_cache.hpp"
+
+// Point lights for clustered forward shading. The view volume is split
+// into a 3D grid of clusters, and a compute pass lists the lights touching
+// each one, so that a fragment only loops over the lights of its cluster
+// instead of all of them (see shaders/lighting_common.glsl).
+//
+// Lights are written by the CPU into a mapped buffer per frame in flight.
+// The cluster lists are rebuilt on the graphics queue before the scene is
+// drawn.
+class ClusteredLighting
+{
+public:
+  // Matches shaders/lighting_common.glsl.
+  static constexpr uint32_t CLUSTER_COUNT = 16 * 16 * 16;
+  static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+
+  void init(VkDevice device,
+            VkPhysicalDevice physicalDevice,
+            LayoutCache& layoutCache,
+            PipelineCache& pipelineCache,
+            uint32_t capacity,
+            uint32_t frameCount);
+  void destroy();
+
+  // Layout of set 0 of the scene's fragment shader, which the sets bound
+  // by bind() are allocated with.
+  VkDescriptorSetLayout getShadingSetLayout() const;
+
+  // The capacity's worth of lights used by the frame slot. They may be
+  // written once the slot's previous frame has finished.
+  Light* getLights(size_t frameIndex) const;
+
+  // Bins the first lightCount lights of the slot. Must be outside of a
+  // render pass, before the draws that are shaded with them.
+  void recordBinning(VkCommandBuffer commandBuffer,
+                     size_t frameIndex,
+                     uint32_t lightCount) const;
+
+  // Binds the slot's lights and cluster lists as set 0 of a pipeline with
+  // the shading set layout.
+  void bind(VkCommandBuffer commandBuffer,
+            VkPipelineLayout pipelineLayout,
+            size_t frameIndex) const;
+
+private:
+  enum Binding : uint32_t
+  {
+    LIGHTS_BINDING,
+    CLUSTER_LIGHT_COUNTS_BINDING,
+    CLUSTER_LIGHT_INDICES_BINDING,
+    BINDING_COUNT
+  };
+
+  struct Frame
+  {
+    UniqueDeviceMemory lightMemory;
+    UniqueBuffer lightBuffer;
+    Light* lights = nullptr;
+    VkDescriptorSet binningSet = VK_NULL_HANDLE;
+    VkDescriptorSet shadingSet = VK_NULL_HANDLE;
+  };
+
+  void createBuffers();
+  void createDescriptorPool();
+  void createBinningPipeline();
+  void writeDescriptorSet(VkDescriptorSet descriptorSet,
+                          const Frame& frame);
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  LayoutCache* m_layoutCache = nullptr;
+  PipelineCache* m_pipelineCache = nullptr;
+  uint32_t m_capacity = 0;
+
+  std::vector<Frame> m_frames;
+  UniqueDeviceMemory m_clusterLightCountMemory;
+  UniqueBuffer m_clusterLightCountBuffer;
+  UniqueDeviceMemory m_clusterLightIndexMemory;
+  UniqueBuffer m_clusterLightIndexBuffer;
+  UniqueDescriptorPool m_descriptorPool;
+
+  // The layouts are owned by the layout cache.
+  VkDescriptorSetLayout m_shadingSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout m_binningPipelineLayout = VK_NULL_HANDLE;
+  UniquePipeline m_binningPipeline;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "deletion_queue.hpp"
+
+void DeletionQueue::retire(std::function<void()> destroy,
+                           uint64_t retireFrame)
+{
+  push(std::make_unique<Callback>(std::move(destroy)), retireFrame);
+}
+
+void DeletionQueue::collect(uint64_t completedFrameCount)
+{
+  // Objects are destroyed outside of the lock, since destroying one may
+  // retire others.
+  std::vector<Entry> expired;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.begin();
+    while (it != m_entries.end()) {
+      if (it->retireFrame <= completedFrameCount) {
+        expired.push_back(std::move(*it));
+        it = m_entries.erase(it);
+      } else {
+        it++;
+      }
+    }
+  }
+}
+
+void DeletionQueue::flush()
+{
+  std::vector<Entry> expired;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    expired.swap(m_entries);
+  }
+}
+
+void DeletionQueue::push(std::unique_ptr<Retired> object,
+                         uint64_t retireFrame)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.push_back({ retireFrame, std::move(object) });
+}
@@ -0,0 +1,70 @@
+#ifndef DELETION_QUEUE_HPP
+#define DELETION_QUEUE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Defers destroying objects until the GPU is done with them, without
+// waiting for the device to go idle. Each object is tagged with the first
+// frame (or timeline semaphore value) that no longer uses it, and is
+// destroyed once all work before that has completed.
+class DeletionQueue
+{
+public:
+  // Takes ownership of a RAII object such as a UniqueBuffer.
+  template<typename T>
+  void retire(T&& object, uint64_t retireFrame)
+  {
+    push(std::make_unique<Holder<std::decay_t<T>>>(std::forward<T>(object)),
+         retireFrame);
+  }
+
+  // For objects that are not owned by a RAII wrapper.
+  void retire(std::function<void()> destroy, uint64_t retireFrame);
+
+  // Destroys the objects retired at or before completedFrameCount, i.e.
+  // those whose last use was in a completed frame.
+  void collect(uint64_t completedFrameCount);
+
+  // Destroys everything. The device must be idle.
+  void flush();
+
+private:
+  struct Retired
+  {
+    virtual ~Retired() = default;
+  };
+
+  template<typename T>
+  struct Holder : Retired
+  {
+    explicit Holder(T&& object) : object(std::move(object)) {}
+    T object;
+  };
+
+  struct Callback : Retired
+  {
+    explicit Callback(std::function<void()> destroy)
+      : destroy(std::move(destroy)) {}
+    ~Callback() override { destroy(); }
+    std::function<void()> destroy;
+  };
+
+  struct Entry
+  {
+    uint64_t retireFrame;
+    std::unique_ptr<Retired> object;
+  };
+
+  void push(std::unique_ptr<Retired> object, uint64_t retireFrame);
+
+  // Objects may be retired from other threads, e.g. by streaming.
+  std::mutex m_mutex;
+  std::vector<Entry> m_entries;
+};
+
+#endif
@@ -0,0 +1,456 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../constants.hpp"
+#include "../utils/glfw.hpp"
+#include "../utils/vk.hpp"
+#include "device_context.hpp"
+
+void DeviceContext::init(bool isPresentationEnabled,
+                         bool areValidationLayersEnabled)
+{
+  m_isPresentationEnabled = isPresentationEnabled;
+  m_areValidationLayersEnabled = areValidationLayersEnabled;
+  m_validationLayers = { "VK_LAYER_KHRONOS_validation" };
+  if (m_isPresentationEnabled) {
+    m_deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+  }
+
+  createVkInstance();
+  setupDebugMessenger();
+  selectPhysicalDevice();
+  createLogicalDevice();
+}
+
+void DeviceContext::destroy()
+{
+  // The cache destroys the pipelines still in it, and saves the driver's
+  // cache for the next run.
+  m_pipelineCache.destroy();
+  m_layoutCache.destroy();
+  m_queues.clear();
+  m_device.reset();
+  m_debugMessenger.reset();
+  m_vkInstance.reset();
+}
+
+bool DeviceContext::isPresentationEnabled() const
+{
+  return m_isPresentationEnabled;
+}
+
+VkInstance DeviceContext::getInstance() const
+{
+  return m_vkInstance;
+}
+
+VkPhysicalDevice DeviceContext::getPhysicalDevice() const
+{
+  return m_physicalDevice;
+}
+
+VkDevice DeviceContext::getDevice() const
+{
+  return m_device;
+}
+
+const QueueFamilyIndices& DeviceContext::getQueueFamilies() const
+{
+  return m_queueFamilies;
+}
+
+bool DeviceContext::isMemoryBudgetSupported() const
+{
+  return m_isMemoryBudgetSupported;
+}
+
+SubmitQueue& DeviceContext::getGraphicsQueue()
+{
+  return m_queues.at(m_queueFamilies.m_graphicsFamily.value());
+}
+
+SubmitQueue& DeviceContext::getPresentQueue()
+{
+  return m_queues.at(m_queueFamilies.m_presentFamily.value());
+}
+
+SubmitQueue& DeviceContext::getComputeQueue()
+{
+  return m_queues.at(m_queueFamilies.m_computeFamily.value());
+}
+
+LayoutCache& DeviceContext::getLayoutCache()
+{
+  return m_layoutCache;
+}
+
+PipelineCache& DeviceContext::getPipelineCache()
+{
+  return m_pipelineCache;
+}
+
+void DeviceContext::createVkInstance()
+{
+  if (m_areValidationLayersEnabled && !checkValidationLayerSupport()) {
+    throw std::runtime_error("Validation layers requested, but unavailable!");
+  }
+
+  VkApplicationInfo appInfo{};
+  appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  appInfo.pApplicationName = "Hello Triangle";
+  appInfo.applicationVersion = VK_MAKE_VERSION(1, 0 , 0);
+  appInfo.pEngineName = "No Engine";
+  appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+  // 1.1 for vkGetPhysicalDeviceMemoryProperties2(), used with the memory
+  // budget extension.
+  appInfo.apiVersion = VK_API_VERSION_1_1;
+
+  VkInstanceCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  createInfo.pApplicationInfo = &appInfo;
+
+  uint32_t vkExtensionCount = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &vkExtensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> vkExtensions(vkExtensionCount);
+  vkEnumerateInstanceExtensionProperties(nullptr,
+                                          &vkExtensionCount,
+                                          vkExtensions.data());
+
+  std::cout << "Available Vulkan Extensions: \n";
+
+  for (const auto& extension : vkExtensions) {
+    std::cout << "\t" << extension.extensionName << "\n";
+  }
+
+  auto extensions = getRequiredExtensions();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
+
+  VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo;
+  if (m_areValidationLayersEnabled) {
+    createInfo.enabledLayerCount = static_cast<uint32_t>(
+      m_validationLayers.size());
+    createInfo.ppEnabledLayerNames = m_validationLayers.data();
+
+    populateDebugMessengerCreateInfo(debugCreateInfo);
+    createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*) &debugCreateInfo;
+  } else {
+    createInfo.enabledLayerCount = 0;
+  }
+
+  VkInstance instance;
+  if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create instance!");
+  }
+  m_vkInstance = UniqueInstance(instance);
+}
+
+void DeviceContext::setupDebugMessenger()
+{
+  if (!m_areValidationLayersEnabled) {
+    return;
+  }
+
+  VkDebugUtilsMessengerCreateInfoEXT createInfo{};
+  populateDebugMessengerCreateInfo(createInfo);
+
+  VkDebugUtilsMessengerEXT debugMessenger;
+  if (CreateDebugUtilsMessengerEXT(m_vkInstance,
+                                   &createInfo,
+                                   nullptr,
+                                   &debugMessenger) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to setup debug messenger.");
+  }
+  m_debugMessenger = UniqueDebugMessenger(m_vkInstance, debugMessenger);
+}
+
+void DeviceContext::selectPhysicalDevice()
+{
+  uint32_t numDevices = 0;
+  vkEnumeratePhysicalDevices(m_vkInstance, &numDevices, nullptr);
+
+  if (numDevices == 0) {
+    throw std::runtime_error("Failed to find GPUs with Vulkan support!");
+  }
+
+  std::vector<VkPhysicalDevice> devices(numDevices);
+  vkEnumeratePhysicalDevices(m_vkInstance, &numDevices, devices.data());
+
+  for (const auto& device : devices) {
+    if (isPhysicalDeviceSuitable(device)) {
+      m_physicalDevice = device;
+      break;
+    }
+  }
+
+  if (m_physicalDevice == VK_NULL_HANDLE) {
+    throw std::runtime_error("Failed to find a suitable GPU!");
+  }
+
+  m_queueFamilies = findQueueFamilies(m_physicalDevice);
+}
+
+void DeviceContext::createLogicalDevice()
+{
+  const QueueFamilyIndices& indices = m_queueFamilies;
+
+  std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+  std::set<uint32_t> uniqueQueueFamilies = {
+    indices.m_graphicsFamily.value(),
+    indices.m_computeFamily.value()
+  };
+  if (m_isPresentationEnabled) {
+    uniqueQueueFamilies.insert(indices.m_presentFamily.value());
+  }
+
+  float queuePriority = 1.0f;
+  for (uint32_t queueFamily : uniqueQueueFamilies) {
+    VkDeviceQueueCreateInfo queueCreateInfo{};
+    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = queueFamily;
+    queueCreateInfo.queueCount = 1;
+    queueCreateInfo.pQueuePriorities = &queuePriority;
+
+    queueCreateInfos.push_back(queueCreateInfo);
+  }
+
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
+  // The fragment shader selects textures from an array in a loop. Block
+  // compressed textures are loaded only where supported.
+  VkPhysicalDeviceFeatures deviceFeatures{};
+  deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+  deviceFeatures.textureCompressionBC =
+    supportedFeatures.textureCompressionBC;
+
+  VkDeviceCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pQueueCreateInfos = queueCreateInfos.data();
+  createInfo.queueCreateInfoCount =
+    static_cast<uint32_t>(queueCreateInfos.size());
+  createInfo.pEnabledFeatures = &deviceFeatures;
+  // The memory budget is only reported, so it is optional.
+  std::vector<const char*> extensions = m_deviceExtensions;
+  m_isMemoryBudgetSupported = isDeviceExtensionSupported(
+    m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (m_isMemoryBudgetSupported) {
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(
+    extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
+
+  if (m_areValidationLayersEnabled) {
+    createInfo.enabledLayerCount = static_cast<uint32_t>(
+      m_validationLayers.size());
+    createInfo.ppEnabledLayerNames = m_validationLayers.data();
+  } else {
+    createInfo.enabledLayerCount = 0;
+  }
+
+  VkDevice device;
+  if (vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &device)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create logical device!");
+  }
+  m_device = UniqueDevice(device);
+
+  for (uint32_t queueFamily : uniqueQueueFamilies) {
+    m_queues[queueFamily].init(m_device, queueFamily);
+  }
+
+  m_layoutCache.init(m_device);
+  m_pipelineCache.init(m_device, PIPELINE_CACHE_FILE_NAME);
+}
+
+bool DeviceContext::checkValidationLayerSupport()
+{
+  uint32_t numLayers;
+  vkEnumerateInstanceLayerProperties(&numLayers, nullptr);
+
+  std::vector<VkLayerProperties> availableLayers(numLayers);
+  vkEnumerateInstanceLayerProperties(&numLayers, availableLayers.data());
+
+  for (const char* layerName : m_validationLayers) {
+    bool isLayerFound = false;
+
+    for (const auto& layerProperties : availableLayers) {
+      if (strcmp(layerName, layerProperties.layerName) == 0) {
+        isLayerFound = true;
+        break;
+      }
+    }
+
+    if (!isLayerFound) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::vector<const char*> DeviceContext::getRequiredExtensions()
+{
+  // Surface extensions are only needed to present.
+  std::vector<const char*> extensions;
+  if (m_isPresentationEnabled) {
+    uint32_t glfwExtensionCount = 0;
+    const char** glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
+
+  if (m_areValidationLayersEnabled) {
+    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  }
+
+  return extensions;
+}
+
+bool DeviceContext::isPhysicalDeviceSuitable(VkPhysicalDevice device)
+{
+  // Swap chain support depends on the windows' surfaces, and is checked by
+  // the sessions that present to them.
+  QueueFamilyIndices indices = findQueueFamilies(device);
+
+  bool areExtensionsSupported = checkDeviceExtensionSupport(device);
+
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+
+  return indices.isComplete(m_isPresentationEnabled)
+          && areExtensionsSupported
+          && supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+}
+
+QueueFamilyIndices DeviceContext::findQueueFamilies(VkPhysicalDevice device)
+{
+  QueueFamilyIndices indices;
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                            nullptr);
+
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                            queueFamilies.data());
+
+  // All families are visited, since a dedicated compute family usually
+  // comes after the graphics one.
+  std::optional<uint32_t> dedicatedComputeFamily;
+  for (uint32_t i = 0; i < queueFamilyCount; i++) {
+    VkQueueFlags flags = queueFamilies[i].queueFlags;
+    bool isGraphics = flags & VK_QUEUE_GRAPHICS_BIT;
+    if (isGraphics && !indices.m_graphicsFamily.has_value()) {
+      indices.m_graphicsFamily = i;
+    }
+
+    if (!isGraphics && (flags & VK_QUEUE_COMPUTE_BIT)
+        && !dedicatedComputeFamily.has_value()) {
+      dedicatedComputeFamily = i;
+    }
+
+    // One queue presents to every window. The windows are created later,
+    // by the sessions, so this asks GLFW whether the family can present at
+    // all, and sessions check their surfaces.
+    if (!m_isPresentationEnabled) {
+      continue;
+    }
+    bool isPresentSupportAvailable =
+      glfwGetPhysicalDevicePresentationSupport(m_vkInstance, device, i)
+      == GLFW_TRUE;
+
+    // Presenting from the graphics queue avoids sharing swap chain images.
+    if (isPresentSupportAvailable
+        && (!indices.m_presentFamily.has_value()
+            || indices.m_graphicsFamily == i)) {
+      indices.m_presentFamily = i;
+    }
+  }
+
+  if (dedicatedComputeFamily.has_value()) {
+    indices.m_computeFamily = dedicatedComputeFamily;
+  } else if (indices.m_graphicsFamily.has_value()
+             && (queueFamilies[indices.m_graphicsFamily.value()].queueFlags
+                 & VK_QUEUE_COMPUTE_BIT)) {
+    indices.m_computeFamily = indices.m_graphicsFamily;
+  }
+
+  return indices;
+}
+
+bool DeviceContext::isDeviceExtensionSupported(VkPhysicalDevice device,
+                                               const char* extensionName)
+{
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                        nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                        availableExtensions.data());
+
+  for (const auto& extension : availableExtensions) {
+    if (std::strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool DeviceContext::checkDeviceExtensionSupport(VkPhysicalDevice device)
+{
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                        nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                        availableExtensions.data());
+
+  std::set<std::string> requiredExtensions(m_deviceExtensions.begin(),
+                                            m_deviceExtensions.end());
+  for (const auto& extension : availableExtensions) {
+    requiredExtensions.erase(extension.extensionName);
+  }
+
+  return requiredExtensions.empty();
+}
+
+void DeviceContext::populateDebugMessengerCreateInfo(
+  VkDebugUtilsMessengerCreateInfoEXT& createInfo)
+{
+  createInfo = {};
+  createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+  createInfo.messageSeverity =
+    VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT
+    | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT
+    | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+  createInfo.messageType =
+    VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT
+    | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT
+    | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+  createInfo.pfnUserCallback = debugCallback;
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL DeviceContext::debugCallback(
+  VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+  VkDebugUtilsMessageTypeFlagsEXT messageType,
+  const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+  void* pUserData)
+{
+  std::cerr << "Validation Layer: " << pCallbackData->pMessage << std::endl;
+
+  return VK_FALSE;
+}
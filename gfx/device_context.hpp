@@ -0,0 +1,86 @@
+#ifndef DEVICE_CONTEXT_HPP
+#define DEVICE_CONTEXT_HPP
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../ds/QueueFamilyIndices.hpp"
+#include "../utils/submit_queue.hpp"
+#include "handles.hpp"
+#include "layout_cache.hpp"
+#include "pipeline_cache.hpp"
+
+// The instance, the device and its queues, and the caches built on them.
+// One per process, shared by every render session (see render_session.hpp)
+// so that sessions do not each pay for device creation and their own copy
+// of pipelines and layouts. Sessions may run on their own threads: the
+// caches are thread-safe, and the queues are shared through SubmitQueue.
+class DeviceContext
+{
+public:
+  // With presentation enabled, GLFW must be initialised, and the device
+  // must be able to present to windows. Without it, only offscreen
+  // sessions can be created, and GLFW is not needed.
+  void init(bool isPresentationEnabled, bool areValidationLayersEnabled);
+  // Every session must have been destroyed.
+  void destroy();
+
+  bool isPresentationEnabled() const;
+  VkInstance getInstance() const;
+  VkPhysicalDevice getPhysicalDevice() const;
+  VkDevice getDevice() const;
+  const QueueFamilyIndices& getQueueFamilies() const;
+  bool isMemoryBudgetSupported() const;
+
+  // Queues of families that are the same are the same object. The present
+  // queue only exists with presentation enabled.
+  SubmitQueue& getGraphicsQueue();
+  SubmitQueue& getPresentQueue();
+  SubmitQueue& getComputeQueue();
+
+  LayoutCache& getLayoutCache();
+  PipelineCache& getPipelineCache();
+
+private:
+  void createVkInstance();
+  void setupDebugMessenger();
+  void selectPhysicalDevice();
+  void createLogicalDevice();
+
+  bool checkValidationLayerSupport();
+  std::vector<const char*> getRequiredExtensions();
+  bool isPhysicalDeviceSuitable(VkPhysicalDevice device);
+  QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
+  bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isDeviceExtensionSupported(VkPhysicalDevice device,
+                                  const char* extensionName);
+
+  void populateDebugMessengerCreateInfo(
+    VkDebugUtilsMessengerCreateInfoEXT& createInfo);
+  static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+    VkDebugUtilsMessageTypeFlagsEXT messageType,
+    const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+    void* pUserData);
+
+  bool m_isPresentationEnabled = false;
+  bool m_areValidationLayersEnabled = false;
+  std::vector<const char*> m_validationLayers;
+  std::vector<const char*> m_deviceExtensions;
+  // Owning members are destroyed in reverse order of declaration.
+  UniqueInstance m_vkInstance;
+  UniqueDebugMessenger m_debugMessenger;
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  QueueFamilyIndices m_queueFamilies;
+  UniqueDevice m_device;
+  bool m_isMemoryBudgetSupported = false;
+  // One per queue family used, by family index.
+  std::map<uint32_t, SubmitQueue> m_queues;
+  LayoutCache m_layoutCache;
+  PipelineCache m_pipelineCache;
+};
+
+#endif
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../utils/png.hpp"
+#include "../utils/vk.hpp"
+#include "frame_capture.hpp"
+
+static bool hasSuffix(const std::string& str, const std::string& suffix)
+{
+  return str.size() >= suffix.size()
+         && str.compare(str.size() - suffix.size(), suffix.size(), suffix)
+            == 0;
+}
+
+void FrameCapture::init(VkDevice device,
+                        VkPhysicalDevice physicalDevice,
+                        VkExtent2D extent,
+                        VkFormat format,
+                        uint32_t bufferCount,
+                        const std::string& outputFileName)
+{
+  m_device = device;
+  m_physicalDevice = physicalDevice;
+  m_extent = extent;
+  m_outputFileName = outputFileName;
+
+  switch (format) {
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      m_isBgra = true;
+      break;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      m_isBgra = false;
+      break;
+    default:
+      throw std::runtime_error("Unsupported format for frame capture!");
+  }
+  m_frameSize = VkDeviceSize(extent.width) * extent.height * 4;
+
+  if (hasSuffix(outputFileName, ".png")) {
+    m_format = CaptureFormat::Png;
+  } else if (hasSuffix(outputFileName, ".y4m")) {
+    m_format = CaptureFormat::Y4m;
+  } else {
+    m_format = CaptureFormat::Raw;
+  }
+
+  if (m_format != CaptureFormat::Png) {
+    m_outputFile.open(outputFileName, std::ios::binary | std::ios::trunc);
+    if (!m_outputFile.is_open()) {
+      throw std::runtime_error("Failed to open " + outputFileName + "!");
+    }
+  }
+
+  if (m_format == CaptureFormat::Y4m) {
+    // The frame rate is nominal, since frames are captured as rendered.
+    m_outputFile << "YUV4MPEG2 W" << extent.width << " H" << extent.height
+                 << " F60:1 Ip A1:1 C444\n";
+  }
+
+  m_slots.resize(bufferCount);
+  for (Slot& slot : m_slots) {
+    createSlot(slot);
+  }
+
+  m_isShuttingDown = false;
+  m_writerThread = std::thread(&FrameCapture::runWriterThread, this);
+}
+
+void FrameCapture::destroy()
+{
+  releaseCompletedFrames(UINT64_MAX);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isShuttingDown = true;
+  }
+  m_writerCondition.notify_all();
+  if (m_writerThread.joinable()) {
+    m_writerThread.join();
+  }
+
+  for (Slot& slot : m_slots) {
+    vkUnmapMemory(m_device, slot.memory);
+    vkDestroyBuffer(m_device, slot.buffer, nullptr);
+    freeMemory(m_device, slot.memory, nullptr);
+  }
+  m_slots.clear();
+
+  m_outputFile.close();
+
+  if (m_droppedFrameCount > 0) {
+    std::cerr << "Frame capture dropped " << m_droppedFrameCount
+              << " frames.\n";
+  }
+}
+
+bool FrameCapture::recordCopy(VkCommandBuffer commandBuffer,
+                              VkImage image,
+                              VkImageLayout layout,
+                              uint64_t frameNumber)
+{
+  Slot* slot = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Slot& candidate : m_slots) {
+      if (candidate.state == SlotState::Free) {
+        slot = &candidate;
+        break;
+      }
+    }
+
+    if (slot == nullptr) {
+      m_droppedFrameCount++;
+      return false;
+    }
+
+    slot->state = SlotState::Recorded;
+    slot->frameNumber = frameNumber;
+  }
+
+  // The render pass makes its colour writes available to transfers (see
+  // RenderSession::createRenderPass()).
+  VkImageMemoryBarrier toTransferBarrier{};
+  toTransferBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  toTransferBarrier.srcAccessMask = 0;
+  toTransferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  toTransferBarrier.oldLayout = layout;
+  toTransferBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  toTransferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransferBarrier.image = image;
+  toTransferBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  toTransferBarrier.subresourceRange.baseMipLevel = 0;
+  toTransferBarrier.subresourceRange.levelCount = 1;
+  toTransferBarrier.subresourceRange.baseArrayLayer = 0;
+  toTransferBarrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 0, nullptr, 0, nullptr, 1, &toTransferBarrier);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = { 0, 0, 0 };
+  region.imageExtent = { m_extent.width, m_extent.height, 1 };
+  vkCmdCopyImageToBuffer(commandBuffer, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         slot->buffer, 1, &region);
+
+  VkImageMemoryBarrier toOriginalBarrier = toTransferBarrier;
+  toOriginalBarrier.srcAccessMask = 0;
+  toOriginalBarrier.dstAccessMask = 0;
+  toOriginalBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  toOriginalBarrier.newLayout = layout;
+
+  VkBufferMemoryBarrier toHostBarrier{};
+  toHostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  toHostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toHostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  toHostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHostBarrier.buffer = slot->buffer;
+  toHostBarrier.offset = 0;
+  toHostBarrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+                       | VK_PIPELINE_STAGE_HOST_BIT,
+                       0, 0, nullptr, 1, &toHostBarrier,
+                       1, &toOriginalBarrier);
+
+  return true;
+}
+
+void FrameCapture::releaseCompletedFrames(uint64_t completedFrameCount)
+{
+  bool hasReleasedFrames = false;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_slots.size(); i++) {
+      Slot& slot = m_slots[i];
+      if (slot.state == SlotState::Recorded
+          && slot.frameNumber < completedFrameCount) {
+        slot.state = SlotState::Writing;
+        m_writeQueue.push_back(i);
+        hasReleasedFrames = true;
+      }
+    }
+
+    // Slots complete in frame order, but may be picked in any order, so
+    // the queue is kept sorted to write frames in sequence.
+    std::sort(m_writeQueue.begin(), m_writeQueue.end(),
+              [this](size_t a, size_t b) {
+                return m_slots[a].frameNumber < m_slots[b].frameNumber;
+              });
+  }
+
+  if (hasReleasedFrames) {
+    m_writerCondition.notify_one();
+  }
+}
+
+uint64_t FrameCapture::getDroppedFrameCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_droppedFrameCount;
+}
+
+void FrameCapture::createSlot(Slot& slot)
+{
+  VkBufferCreateInfo bufferCreateInfo{};
+  bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferCreateInfo.size = m_frameSize;
+  bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(m_device, &bufferCreateInfo, nullptr, &slot.buffer)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create capture buffer!");
+  }
+
+  VkMemoryRequirements memoryRequirements;
+  vkGetBufferMemoryRequirements(m_device, slot.buffer, &memoryRequirements);
+
+  // Cached memory makes CPU reads much faster, but is not always available
+  // together with coherent memory.
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                     | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  uint32_t memoryType;
+  try {
+    memoryType = findMemoryType(m_physicalDevice,
+                                memoryRequirements.memoryTypeBits,
+                                properties
+                                | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  } catch (const std::runtime_error&) {
+    memoryType = findMemoryType(m_physicalDevice,
+                                memoryRequirements.memoryTypeBits,
+                                properties);
+  }
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memoryRequirements.size;
+  allocInfo.memoryTypeIndex = memoryType;
+  if (allocateMemory(m_device, &allocInfo, nullptr, &slot.memory)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate capture buffer memory!");
+  }
+
+  vkBindBufferMemory(m_device, slot.buffer, slot.memory, 0);
+
+  void* data;
+  vkMapMemory(m_device, slot.memory, 0, m_frameSize, 0, &data);
+  slot.data = static_cast<const uint8_t*>(data);
+}
+
+void FrameCapture::runWriterThread()
+{
+  while (true) {
+    size_t slotIndex;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_writerCondition.wait(lock, [this]() {
+        return m_isShuttingDown || !m_writeQueue.empty();
+      });
+
+      // Frames still queued are written before shutting down.
+      if (m_writeQueue.empty()) {
+        return;
+      }
+
+      slotIndex = m_writeQueue.front();
+      m_writeQueue.pop_front();
+    }
+
+    try {
+      writeFrame(m_slots[slotIndex]);
+    } catch (const std::exception& e) {
+      std::cerr << "Failed to write captured frame: " << e.what() << "\n";
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots[slotIndex].state = SlotState::Free;
+  }
+}
+
+void FrameCapture::writeFrame(const Slot& slot)
+{
+  if (m_format == CaptureFormat::Raw) {
+    m_outputFile.write(reinterpret_cast<const char*>(slot.data),
+                       m_frameSize);
+    return;
+  }
+
+  ImageData image;
+  convertToRgb(slot.data, image);
+
+  if (m_format == CaptureFormat::Png) {
+    char frameSuffix[32];
+    std::snprintf(frameSuffix, sizeof(frameSuffix), "_%06llu.png",
+                  static_cast<unsigned long long>(slot.frameNumber));
+    std::string fileName = m_outputFileName.substr(
+                             0, m_outputFileName.size() - 4)
+                           + frameSuffix;
+    writePng(fileName, image);
+    return;
+  }
+
+  // BT.601 limited range, as expected by most Y4M consumers.
+  size_t pixelCount = size_t(image.width) * image.height;
+  std::vector<uint8_t> planes(pixelCount * 3);
+  for (size_t i = 0; i < pixelCount; i++) {
+    int r = image.pixels[i * 3];
+    int g = image.pixels[i * 3 + 1];
+    int b = image.pixels[i * 3 + 2];
+    planes[i] = static_cast<uint8_t>(
+      ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    planes[pixelCount + i] = static_cast<uint8_t>(
+      ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    planes[pixelCount * 2 + i] = static_cast<uint8_t>(
+      ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+  }
+
+  m_outputFile << "FRAME\n";
+  m_outputFile.write(reinterpret_cast<const char*>(planes.data()),
+                     planes.size());
+}
+
+void FrameCapture::convertToRgb(const uint8_t* data, ImageData& image) const
+{
+  image.width = m_extent.width;
+  image.height = m_extent.height;
+
+  size_t pixelCount = size_t(image.width) * image.height;
+  image.pixels.resize(pixelCount * 3);
+
+  int red = m_isBgra ? 2 : 0;
+  int blue = m_isBgra ? 0 : 2;
+  for (size_t i = 0; i < pixelCount; i++) {
+    image.pixels[i * 3] = data[i * 4 + red];
+    image.pixels[i * 3 + 1] = data[i * 4 + 1];
+    image.pixels[i * 3 + 2] = data[i * 4 + blue];
+  }
+}
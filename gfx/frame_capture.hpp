@@ -0,0 +1,99 @@
+#ifndef FRAME_CAPTURE_HPP
+#define FRAME_CAPTURE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../ds/ImageData.hpp"
+
+enum class CaptureFormat
+{
+  Raw, // Frames as copied from the image, appended to one file
+  Png, // One file per frame
+  Y4m  // YUV 4:4:4 video stream
+};
+
+// Reads rendered frames back into a ring of persistently mapped buffers and
+// writes them to disk on a background thread. Copies are recorded into the
+// frame's own command buffer and picked up once the frame has finished, so
+// capturing never waits on the GPU. If the writer falls behind and no
+// buffer is free, frames are dropped rather than stalling rendering.
+class FrameCapture
+{
+public:
+  // The format is chosen by the extension of the output file name. For PNG
+  // output the frame number is inserted before the extension.
+  void init(VkDevice device,
+            VkPhysicalDevice physicalDevice,
+            VkExtent2D extent,
+            VkFormat format,
+            uint32_t bufferCount,
+            const std::string& outputFileName);
+
+  // The device must be idle, so that all recorded copies are complete.
+  void destroy();
+
+  // Records a copy of the image after the render pass. The image is in the
+  // given layout, e.g. the present one, and is returned to it. Returns
+  // false if the frame is dropped.
+  bool recordCopy(VkCommandBuffer commandBuffer,
+                  VkImage image,
+                  VkImageLayout layout,
+                  uint64_t frameNumber);
+
+  // Hands the copies of frames before completedFrameCount, which have
+  // finished on the GPU, to the writer thread.
+  void releaseCompletedFrames(uint64_t completedFrameCount);
+
+  uint64_t getDroppedFrameCount() const;
+
+private:
+  enum class SlotState
+  {
+    Free,
+    Recorded,
+    Writing
+  };
+
+  struct Slot
+  {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    const uint8_t* data = nullptr;
+    SlotState state = SlotState::Free;
+    uint64_t frameNumber = 0;
+  };
+
+  void createSlot(Slot& slot);
+  void runWriterThread();
+  void writeFrame(const Slot& slot);
+  void convertToRgb(const uint8_t* data, ImageData& image) const;
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  VkExtent2D m_extent{};
+  bool m_isBgra = false;
+  VkDeviceSize m_frameSize = 0;
+  CaptureFormat m_format = CaptureFormat::Raw;
+  std::string m_outputFileName;
+  std::ofstream m_outputFile;
+
+  std::vector<Slot> m_slots;
+  uint64_t m_droppedFrameCount = 0;
+
+  std::thread m_writerThread;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_writerCondition;
+  std::deque<size_t> m_writeQueue;
+  bool m_isShuttingDown = false;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "frame_stats.hpp"
+
+// Frames rendered before timing starts, so that pipeline creation and
+// driver warm-up do not skew the frame times.
+static constexpr size_t WARM_UP_FRAME_COUNT = 10;
+
+static double toMs(std::chrono::steady_clock::duration duration)
+{
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+static double getPercentile(const std::vector<double>& sorted,
+                            double percentile)
+{
+  size_t index = static_cast<size_t>(percentile * (sorted.size() - 1) + 0.5);
+
+  return sorted[index];
+}
+
+void FrameStats::start()
+{
+  m_startTime = Clock::now();
+  m_lastFrameTime = m_startTime;
+  m_hasFirstFrame = false;
+  m_startupMs = 0.0;
+  m_frameMs.clear();
+}
+
+void FrameStats::recordFrame()
+{
+  Clock::time_point now = Clock::now();
+  if (!m_hasFirstFrame) {
+    m_startupMs = toMs(now - m_startTime);
+    m_hasFirstFrame = true;
+  } else {
+    m_frameMs.push_back(toMs(now - m_lastFrameTime));
+  }
+  m_lastFrameTime = now;
+}
+
+void FrameStats::write(const std::string& fileName) const
+{
+  std::ofstream file(fileName, std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open " + fileName + "!");
+  }
+
+  file << "startup_ms " << m_startupMs << "\n";
+
+  if (m_frameMs.size() <= WARM_UP_FRAME_COUNT) {
+    return;
+  }
+
+  std::vector<double> sorted(m_frameMs.begin() + WARM_UP_FRAME_COUNT,
+                             m_frameMs.end());
+  std::sort(sorted.begin(), sorted.end());
+
+  double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0)
+                / sorted.size();
+  file << "frame_ms_mean " << mean << "\n";
+  file << "frame_ms_p50 " << getPercentile(sorted, 0.5) << "\n";
+  file << "frame_ms_p95 " << getPercentile(sorted, 0.95) << "\n";
+  file << "frame_ms_p99 " << getPercentile(sorted, 0.99) << "\n";
+}
@@ -0,0 +1,33 @@
+#ifndef FRAME_STATS_HPP
+#define FRAME_STATS_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Records startup and frame times on the CPU side, for the performance
+// regression tests (see tests/run.sh).
+class FrameStats
+{
+public:
+  void start();
+
+  // Called once per frame, after it has been submitted. The time until the
+  // first call is the startup time.
+  void recordFrame();
+
+  // Writes "name value" lines, in milliseconds, which tools/regress
+  // compares against a baseline.
+  void write(const std::string& fileName) const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  Clock::time_point m_startTime;
+  Clock::time_point m_lastFrameTime;
+  bool m_hasFirstFrame = false;
+  double m_startupMs = 0.0;
+  std::vector<double> m_frameMs;
+};
+
+#endif
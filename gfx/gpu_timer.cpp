@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_timer.hpp"
+
+void GpuTimer::init(VkDevice device,
+                    VkPhysicalDevice physicalDevice,
+                    uint32_t queueFamilyIndex,
+                    uint32_t frameCount)
+{
+  m_device = device;
+  m_isPending.assign(frameCount, false);
+
+  uint32_t queueFamilyCount;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                           &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                           &queueFamilyCount,
+                                           queueFamilies.data());
+
+  uint32_t validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+  if (validBits == 0) {
+    return;
+  }
+  m_timestampMask = validBits >= 64 ? UINT64_MAX
+                                    : (uint64_t(1) << validBits) - 1;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  m_timestampPeriod = properties.limits.timestampPeriod;
+
+  VkQueryPoolCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  createInfo.queryCount = 2 * frameCount;
+
+  VkQueryPool queryPool;
+  if (vkCreateQueryPool(m_device, &createInfo, nullptr, &queryPool)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create timestamp query pool!");
+  }
+  m_queryPool = UniqueQueryPool(m_device, queryPool);
+}
+
+void GpuTimer::destroy()
+{
+  m_queryPool.reset();
+}
+
+bool GpuTimer::isSupported() const
+{
+  return m_queryPool != VK_NULL_HANDLE;
+}
+
+void GpuTimer::recordStart(VkCommandBuffer commandBuffer, size_t frameIndex)
+{
+  if (!isSupported()) {
+    return;
+  }
+
+  uint32_t firstQuery = static_cast<uint32_t>(2 * frameIndex);
+  vkCmdResetQueryPool(commandBuffer, m_queryPool, firstQuery, 2);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      m_queryPool, firstQuery);
+}
+
+void GpuTimer::recordEnd(VkCommandBuffer commandBuffer, size_t frameIndex)
+{
+  if (!isSupported()) {
+    return;
+  }
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      m_queryPool, static_cast<uint32_t>(2 * frameIndex + 1));
+  m_isPending[frameIndex] = true;
+}
+
+bool GpuTimer::getElapsedTime(size_t frameIndex, double& seconds)
+{
+  if (!m_isPending[frameIndex]) {
+    return false;
+  }
+  m_isPending[frameIndex] = false;
+
+  // Does not wait: the frame's fence was, so the results should be there.
+  uint64_t timestamps[2];
+  if (vkGetQueryPoolResults(m_device, m_queryPool,
+                            static_cast<uint32_t>(2 * frameIndex), 2,
+                            sizeof(timestamps), timestamps,
+                            sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT)
+      != VK_SUCCESS) {
+    return false;
+  }
+
+  uint64_t ticks = (timestamps[1] - timestamps[0]) & m_timestampMask;
+  seconds = ticks * m_timestampPeriod * 1e-9;
+
+  return true;
+}
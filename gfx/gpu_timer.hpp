@@ -0,0 +1,47 @@
+#ifndef GPU_TIMER_HPP
+#define GPU_TIMER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "handles.hpp"
+
+// Measures the GPU time of each frame with a pair of timestamp queries per
+// frame in flight. A frame's time can be read once its fence has been
+// waited on, so it arrives as many frames late as there are in flight.
+class GpuTimer
+{
+public:
+  // The queue family is the one the timed command buffers are submitted
+  // to. Some families have no timestamps, see isSupported().
+  void init(VkDevice device,
+            VkPhysicalDevice physicalDevice,
+            uint32_t queueFamilyIndex,
+            uint32_t frameCount);
+  void destroy();
+
+  bool isSupported() const;
+
+  // Record at the start and end of the frame's command buffer, outside of
+  // any render pass.
+  void recordStart(VkCommandBuffer commandBuffer, size_t frameIndex);
+  void recordEnd(VkCommandBuffer commandBuffer, size_t frameIndex);
+
+  // Reads the time of the last frame recorded in the slot, in seconds,
+  // once its fence has been waited on. Returns false if there is no such
+  // frame, or its timestamps are not available.
+  bool getElapsedTime(size_t frameIndex, double& seconds);
+
+private:
+  VkDevice m_device = VK_NULL_HANDLE;
+  UniqueQueryPool m_queryPool;
+  // Nanoseconds per timestamp tick.
+  double m_timestampPeriod = 0.0;
+  uint64_t m_timestampMask = 0;
+  // Whether the slot's queries were written and not read yet.
+  std::vector<bool> m_isPending;
+};
+
+#endif
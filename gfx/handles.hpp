@@ -0,0 +1,149 @@
+#ifndef HANDLES_HPP
+#define HANDLES_HPP
+
+#include <vulkan/vulkan.h>
+
+#include "../utils/vk.hpp"
+
+// Move-only owner of a Vulkan handle that is destroyed on its own, i.e.
+// VkInstance and VkDevice. Converts implicitly to the raw handle, so it can
+// be passed straight to Vulkan calls.
+template<typename Handle, auto Destroy>
+class UniqueRootHandle
+{
+public:
+  UniqueRootHandle() = default;
+  explicit UniqueRootHandle(Handle handle) : m_handle(handle) {}
+  ~UniqueRootHandle() { reset(); }
+
+  UniqueRootHandle(const UniqueRootHandle&) = delete;
+  UniqueRootHandle& operator=(const UniqueRootHandle&) = delete;
+
+  UniqueRootHandle(UniqueRootHandle&& other) noexcept
+    : m_handle(other.release()) {}
+
+  UniqueRootHandle& operator=(UniqueRootHandle&& other) noexcept
+  {
+    if (this != &other) {
+      reset();
+      m_handle = other.release();
+    }
+
+    return *this;
+  }
+
+  operator Handle() const { return m_handle; }
+  Handle get() const { return m_handle; }
+
+  Handle release()
+  {
+    Handle handle = m_handle;
+    m_handle = VK_NULL_HANDLE;
+
+    return handle;
+  }
+
+  void reset()
+  {
+    if (m_handle != VK_NULL_HANDLE) {
+      Destroy(m_handle, nullptr);
+      m_handle = VK_NULL_HANDLE;
+    }
+  }
+
+private:
+  Handle m_handle = VK_NULL_HANDLE;
+};
+
+// Move-only owner of a Vulkan handle that is destroyed through its parent
+// instance or device.
+template<typename Parent, typename Handle, auto Destroy>
+class UniqueHandle
+{
+public:
+  UniqueHandle() = default;
+  UniqueHandle(Parent parent, Handle handle)
+    : m_parent(parent), m_handle(handle) {}
+  ~UniqueHandle() { reset(); }
+
+  UniqueHandle(const UniqueHandle&) = delete;
+  UniqueHandle& operator=(const UniqueHandle&) = delete;
+
+  UniqueHandle(UniqueHandle&& other) noexcept
+    : m_parent(other.m_parent), m_handle(other.release()) {}
+
+  UniqueHandle& operator=(UniqueHandle&& other) noexcept
+  {
+    if (this != &other) {
+      reset();
+      m_parent = other.m_parent;
+      m_handle = other.release();
+    }
+
+    return *this;
+  }
+
+  operator Handle() const { return m_handle; }
+  Handle get() const { return m_handle; }
+
+  // For Vulkan calls that take arrays of handles, e.g. vkWaitForFences().
+  const Handle* getAddress() const { return &m_handle; }
+
+  Handle release()
+  {
+    Handle handle = m_handle;
+    m_handle = VK_NULL_HANDLE;
+
+    return handle;
+  }
+
+  void reset()
+  {
+    if (m_handle != VK_NULL_HANDLE) {
+      Destroy(m_parent, m_handle, nullptr);
+      m_handle = VK_NULL_HANDLE;
+    }
+  }
+
+private:
+  Parent m_parent = VK_NULL_HANDLE;
+  Handle m_handle = VK_NULL_HANDLE;
+};
+
+template<typename Handle, auto Destroy>
+using UniqueInstanceHandle = UniqueHandle<VkInstance, Handle, Destroy>;
+
+template<typename Handle, auto Destroy>
+using UniqueDeviceHandle = UniqueHandle<VkDevice, Handle, Destroy>;
+
+using UniqueInstance = UniqueRootHandle<VkInstance, vkDestroyInstance>;
+using UniqueDevice = UniqueRootHandle<VkDevice, vkDestroyDevice>;
+
+using UniqueDebugMessenger =
+  UniqueInstanceHandle<VkDebugUtilsMessengerEXT,
+                       DestroyDebugUtilsMessengerEXT>;
+using UniqueSurface = UniqueInstanceHandle<VkSurfaceKHR, vkDestroySurfaceKHR>;
+
+using UniqueSwapchain =
+  UniqueDeviceHandle<VkSwapchainKHR, vkDestroySwapchainKHR>;
+using UniqueImage = UniqueDeviceHandle<VkImage, vkDestroyImage>;
+using UniqueImageView = UniqueDeviceHandle<VkImageView, vkDestroyImageView>;
+using UniqueSampler = UniqueDeviceHandle<VkSampler, vkDestroySampler>;
+using UniqueBuffer = UniqueDeviceHandle<VkBuffer, vkDestroyBuffer>;
+using UniqueDeviceMemory = UniqueDeviceHandle<VkDeviceMemory, freeMemory>;
+using UniqueRenderPass =
+  UniqueDeviceHandle<VkRenderPass, vkDestroyRenderPass>;
+using UniqueFramebuffer =
+  UniqueDeviceHandle<VkFramebuffer, vkDestroyFramebuffer>;
+using UniqueShaderModule =
+  UniqueDeviceHandle<VkShaderModule, vkDestroyShaderModule>;
+using UniquePipeline = UniqueDeviceHandle<VkPipeline, vkDestroyPipeline>;
+using UniqueDescriptorPool =
+  UniqueDeviceHandle<VkDescriptorPool, vkDestroyDescriptorPool>;
+using UniqueCommandPool =
+  UniqueDeviceHandle<VkCommandPool, vkDestroyCommandPool>;
+using UniqueSemaphore = UniqueDeviceHandle<VkSemaphore, vkDestroySemaphore>;
+using UniqueFence = UniqueDeviceHandle<VkFence, vkDestroyFence>;
+using UniqueQueryPool = UniqueDeviceHandle<VkQueryPool, vkDestroyQueryPool>;
+
+#endif
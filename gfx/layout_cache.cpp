@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../utils/hash.hpp"
+#include "../utils/spirv.hpp"
+#include "layout_cache.hpp"
+
+void LayoutCache::init(VkDevice device)
+{
+  m_device = device;
+}
+
+void LayoutCache::destroy()
+{
+  for (auto& entry : m_pipelineLayouts) {
+    vkDestroyPipelineLayout(m_device, entry.second.layout, nullptr);
+  }
+  m_pipelineLayouts.clear();
+
+  for (auto& entry : m_setLayouts) {
+    vkDestroyDescriptorSetLayout(m_device, entry.second, nullptr);
+  }
+  m_setLayouts.clear();
+}
+
+VkDescriptorSetLayout LayoutCache::getDescriptorSetLayout(
+  std::vector<VkDescriptorSetLayoutBinding> bindings)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  return findDescriptorSetLayout(std::move(bindings));
+}
+
+VkDescriptorSetLayout LayoutCache::findDescriptorSetLayout(
+  std::vector<VkDescriptorSetLayoutBinding> bindings)
+{
+  // Bindings are sorted so that the same set declared in a different order
+  // maps to the same layout.
+  std::sort(bindings.begin(), bindings.end(),
+            [](const VkDescriptorSetLayoutBinding& a,
+               const VkDescriptorSetLayoutBinding& b) {
+              return a.binding < b.binding;
+            });
+
+  DescriptorSetLayoutKey key{ bindings };
+  auto it = m_setLayouts.find(key);
+  if (it != m_setLayouts.end()) {
+    return it->second;
+  }
+
+  VkDescriptorSetLayoutCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  createInfo.pBindings = bindings.data();
+
+  VkDescriptorSetLayout setLayout;
+  if (vkCreateDescriptorSetLayout(m_device, &createInfo, nullptr, &setLayout)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor set layout!");
+  }
+
+  m_setLayouts.emplace(std::move(key), setLayout);
+
+  return setLayout;
+}
+
+const PipelineLayoutInfo& LayoutCache::getPipelineLayout(
+  const std::vector<ShaderReflection>& stages)
+{
+  // Merge the bindings of all stages, by set and binding number.
+  std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+  std::vector<VkPushConstantRange> pushConstantRanges;
+
+  for (const ShaderReflection& stage : stages) {
+    for (const ReflectedDescriptorBinding& reflected
+         : stage.descriptorBindings) {
+      auto& set = sets[reflected.set];
+      auto it = set.find(reflected.binding);
+      if (it != set.end()) {
+        if (it->second.descriptorType != reflected.descriptorType
+            || it->second.descriptorCount != reflected.descriptorCount) {
+          throw std::runtime_error(
+            "Shader stages disagree on a descriptor binding!");
+        }
+
+        it->second.stageFlags |= reflected.stageFlags;
+        continue;
+      }
+
+      VkDescriptorSetLayoutBinding binding{};
+      binding.binding = reflected.binding;
+      binding.descriptorType = reflected.descriptorType;
+      binding.descriptorCount = reflected.descriptorCount;
+      binding.stageFlags = reflected.stageFlags;
+      binding.pImmutableSamplers = nullptr;
+      set.emplace(reflected.binding, binding);
+    }
+
+    for (const ReflectedPushConstantRange& reflected
+         : stage.pushConstantRanges) {
+      // Stages sharing the same block share one range.
+      auto it = std::find_if(pushConstantRanges.begin(),
+                             pushConstantRanges.end(),
+                             [&](const VkPushConstantRange& range) {
+                               return range.offset == reflected.offset
+                                      && range.size == reflected.size;
+                             });
+      if (it != pushConstantRanges.end()) {
+        it->stageFlags |= reflected.stageFlags;
+      } else {
+        pushConstantRanges.push_back({ reflected.stageFlags,
+                                       reflected.offset,
+                                       reflected.size });
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  PipelineLayoutKey key;
+  if (!sets.empty()) {
+    key.setLayouts.resize(sets.rbegin()->first + 1);
+  }
+  for (uint32_t i = 0; i < key.setLayouts.size(); i++) {
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    auto set = sets.find(i);
+    if (set != sets.end()) {
+      for (const auto& binding : set->second) {
+        bindings.push_back(binding.second);
+      }
+    }
+
+    key.setLayouts[i] = findDescriptorSetLayout(bindings);
+  }
+  key.pushConstantRanges = pushConstantRanges;
+
+  auto it = m_pipelineLayouts.find(key);
+  if (it != m_pipelineLayouts.end()) {
+    return it->second;
+  }
+
+  VkPipelineLayoutCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  createInfo.setLayoutCount = static_cast<uint32_t>(key.setLayouts.size());
+  createInfo.pSetLayouts = key.setLayouts.data();
+  createInfo.pushConstantRangeCount = static_cast<uint32_t>(
+    key.pushConstantRanges.size());
+  createInfo.pPushConstantRanges = key.pushConstantRanges.data();
+
+  PipelineLayoutInfo info;
+  if (vkCreatePipelineLayout(m_device, &createInfo, nullptr, &info.layout)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create pipeline layout!");
+  }
+  info.setLayouts = key.setLayouts;
+  info.pushConstantRanges = key.pushConstantRanges;
+
+  return m_pipelineLayouts.emplace(std::move(key), std::move(info))
+                          .first->second;
+}
+
+bool LayoutCache::DescriptorSetLayoutKey::operator==(
+  const DescriptorSetLayoutKey& other) const
+{
+  return std::equal(bindings.begin(), bindings.end(),
+                    other.bindings.begin(), other.bindings.end(),
+                    [](const VkDescriptorSetLayoutBinding& a,
+                       const VkDescriptorSetLayoutBinding& b) {
+                      return a.binding == b.binding
+                             && a.descriptorType == b.descriptorType
+                             && a.descriptorCount == b.descriptorCount
+                             && a.stageFlags == b.stageFlags;
+                    });
+}
+
+bool LayoutCache::PipelineLayoutKey::operator==(
+  const PipelineLayoutKey& other) const
+{
+  return setLayouts == other.setLayouts
+         && std::equal(pushConstantRanges.begin(), pushConstantRanges.end(),
+                       other.pushConstantRanges.begin(),
+                       other.pushConstantRanges.end(),
+                       [](const VkPushConstantRange& a,
+                          const VkPushConstantRange& b) {
+                         return a.stageFlags == b.stageFlags
+                                && a.offset == b.offset
+                                && a.size == b.size;
+                       });
+}
+
+size_t LayoutCache::KeyHash::operator()(
+  const DescriptorSetLayoutKey& key) const
+{
+  size_t seed = 0;
+  for (const VkDescriptorSetLayoutBinding& binding : key.bindings) {
+    hashCombine(seed, binding.binding);
+    hashCombine(seed, static_cast<uint32_t>(binding.descriptorType));
+    hashCombine(seed, binding.descriptorCount);
+    hashCombine(seed, binding.stageFlags);
+  }
+
+  return seed;
+}
+
+size_t LayoutCache::KeyHash::operator()(const PipelineLayoutKey& key) const
+{
+  size_t seed = 0;
+  for (VkDescriptorSetLayout setLayout : key.setLayouts) {
+    hashCombine(seed, setLayout);
+  }
+  for (const VkPushConstantRange& range : key.pushConstantRanges) {
+    hashCombine(seed, range.stageFlags);
+    hashCombine(seed, range.offset);
+    hashCombine(seed, range.size);
+  }
+
+  return seed;
+}
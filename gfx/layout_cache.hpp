@@ -0,0 +1,73 @@
+#ifndef LAYOUT_CACHE_HPP
+#define LAYOUT_CACHE_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../utils/spirv.hpp"
+
+struct PipelineLayoutInfo
+{
+  VkPipelineLayout layout;
+  // Indexed by set number. Sets a pipeline does not use get an empty layout.
+  std::vector<VkDescriptorSetLayout> setLayouts;
+  std::vector<VkPushConstantRange> pushConstantRanges;
+};
+
+// Creates descriptor set and pipeline layouts from shader reflection data
+// and deduplicates them, so that pipelines with the same interface share
+// layouts and stay compatible for descriptor set binding. Thread-safe, so
+// render sessions on several threads can share one cache. Returned
+// references stay valid until destroy().
+class LayoutCache
+{
+public:
+  void init(VkDevice device);
+  void destroy();
+
+  VkDescriptorSetLayout getDescriptorSetLayout(
+    std::vector<VkDescriptorSetLayoutBinding> bindings);
+  const PipelineLayoutInfo& getPipelineLayout(
+    const std::vector<ShaderReflection>& stages);
+
+private:
+  struct DescriptorSetLayoutKey
+  {
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+    bool operator==(const DescriptorSetLayoutKey& other) const;
+  };
+
+  struct PipelineLayoutKey
+  {
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    std::vector<VkPushConstantRange> pushConstantRanges;
+
+    bool operator==(const PipelineLayoutKey& other) const;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const DescriptorSetLayoutKey& key) const;
+    size_t operator()(const PipelineLayoutKey& key) const;
+  };
+
+  // With m_mutex held.
+  VkDescriptorSetLayout findDescriptorSetLayout(
+    std::vector<VkDescriptorSetLayoutBinding> bindings);
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  std::mutex m_mutex;
+  std::unordered_map<DescriptorSetLayoutKey,
+                     VkDescriptorSetLayout,
+                     KeyHash> m_setLayouts;
+  std::unordered_map<PipelineLayoutKey,
+                     PipelineLayoutInfo,
+                     KeyHash> m_pipelineLayouts;
+};
+
+#endif
@@ -0,0 +1,477 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../constants.hpp"
+#include "../ds/Instance.hpp"
+#include "../utils/vk.hpp"
+#include "occlusion_culling.hpp"
+
+namespace
+{
+// Matches the local sizes of shaders/hiz_build.glsl and
+// shaders/hiz_cull.comp.
+constexpr uint32_t BUILD_GROUP_SIZE = 256;
+constexpr uint32_t BUILD_TILE_SIZE = 64;
+constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+// Matches the push constant block of shaders/hiz_build.glsl.
+struct BuildPushConstants
+{
+  uint32_t depthSize[2];
+  uint32_t capacity[2];
+};
+
+// Matches the push constant block of shaders/hiz_cull.comp.
+struct CullPushConstants
+{
+  float bounds[4];
+  uint32_t depthSize[2];
+  uint32_t capacity[2];
+  uint32_t objectCount;
+};
+
+// Matches getLevelSize() of shaders/hiz_common.glsl.
+uint32_t getLevelSize(uint32_t depthSize, uint32_t level)
+{
+  uint32_t divisor = 2u << level;
+  return (depthSize + divisor - 1) / divisor;
+}
+}
+
+void OcclusionCulling::init(VkDevice device,
+                            VkPhysicalDevice physicalDevice,
+                            LayoutCache& layoutCache,
+                            PipelineCache& pipelineCache,
+                            VkImageView depthView,
+                            VkExtent2D capacity,
+                            const std::vector<VkBuffer>& instanceBuffers,
+                            uint32_t instanceCapacity,
+                            uint32_t indexCount,
+                            const float bounds[4],
+                            bool isCpuCulled)
+{
+  if (!isCpuCulled
+      && (capacity.width > MAX_DEPTH_SIZE
+          || capacity.height > MAX_DEPTH_SIZE)) {
+    throw std::runtime_error("Depth is too large for the depth pyramid!");
+  }
+
+  m_device = device;
+  m_physicalDevice = physicalDevice;
+  m_layoutCache = &layoutCache;
+  m_pipelineCache = &pipelineCache;
+  m_capacity = capacity;
+  m_indexCount = indexCount;
+  std::copy(bounds, bounds + 4, m_bounds);
+  m_isCpuCulled = isCpuCulled;
+  m_pyramidDepthSize = { 0, 0 };
+  m_frames.resize(instanceBuffers.size());
+
+  createBuffers(instanceCapacity);
+  if (m_isCpuCulled) {
+    return;
+  }
+
+  createDescriptorPool();
+
+  // The shared memory variant gives the same pyramid, with more barriers.
+  createPass(isSubgroupQuadSupported() ? HIZ_BUILD_SHADER_FILE_NAME
+                                       : HIZ_BUILD_SHARED_SHADER_FILE_NAME,
+             m_buildPass);
+  createPass(HIZ_CULL_SHADER_FILE_NAME, m_cullPass);
+
+  writeBuildSet(depthView);
+  for (size_t i = 0; i < m_frames.size(); i++) {
+    writeCullSet(m_frames[i], instanceBuffers[i]);
+  }
+}
+
+void OcclusionCulling::destroy()
+{
+  // The layouts belong to the layout cache. Descriptor sets are freed with
+  // the pool.
+  m_cullPass.pipeline.reset();
+  m_buildPass.pipeline.reset();
+  m_descriptorPool.reset();
+  m_depthSampler.reset();
+  m_counterBuffer.reset();
+  m_counterMemory.reset();
+  m_pyramidBuffer.reset();
+  m_pyramidMemory.reset();
+  m_frames.clear();
+}
+
+VkBuffer OcclusionCulling::getVisibleInstanceBuffer(size_t frameIndex) const
+{
+  return m_frames[frameIndex].visibleInstanceBuffer;
+}
+
+VkBuffer OcclusionCulling::getVisibleObjectBuffer(size_t frameIndex) const
+{
+  return m_frames[frameIndex].visibleObjectBuffer;
+}
+
+VkBuffer OcclusionCulling::getDrawCommandBuffer(size_t frameIndex) const
+{
+  return m_frames[frameIndex].drawCommandBuffer;
+}
+
+void OcclusionCulling::recordCull(VkCommandBuffer commandBuffer,
+                                  size_t frameIndex,
+                                  uint32_t instanceCount) const
+{
+  const Frame& frame = m_frames[frameIndex];
+
+  VkDrawIndexedIndirectCommand drawCommand{};
+  drawCommand.indexCount = m_indexCount;
+  vkCmdUpdateBuffer(commandBuffer, frame.drawCommandBuffer, 0,
+                    sizeof(drawCommand), &drawCommand);
+
+  // The draw command was just reset, and the pyramid was written by the
+  // previous frame's build.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT
+                          | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+                          | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT
+                       | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  CullPushConstants pushConstants{};
+  std::copy(m_bounds, m_bounds + 4, pushConstants.bounds);
+  pushConstants.depthSize[0] = m_pyramidDepthSize.width;
+  pushConstants.depthSize[1] = m_pyramidDepthSize.height;
+  pushConstants.capacity[0] = m_capacity.width;
+  pushConstants.capacity[1] = m_capacity.height;
+  pushConstants.objectCount = instanceCount;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_cullPass.pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_cullPass.layout, 0, 1, &frame.cullSet, 0,
+                          nullptr);
+  vkCmdPushConstants(commandBuffer, m_cullPass.layout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants),
+                     &pushConstants);
+  vkCmdDispatch(commandBuffer,
+                (instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1,
+                1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+                          | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+                       | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+}
+
+void OcclusionCulling::writeVisible(size_t frameIndex,
+                                    const std::vector<uint32_t>& objects,
+                                    const Mat4* worldMatrices)
+{
+  Frame& frame = m_frames[frameIndex];
+  for (size_t i = 0; i < objects.size(); i++) {
+    frame.visibleInstanceData[i] = worldMatrices[objects[i]];
+  }
+  std::memcpy(frame.visibleObjectData, objects.data(),
+              objects.size() * sizeof(uint32_t));
+
+  VkDrawIndexedIndirectCommand drawCommand{};
+  drawCommand.indexCount = m_indexCount;
+  drawCommand.instanceCount = static_cast<uint32_t>(objects.size());
+  *frame.drawCommandData = drawCommand;
+}
+
+void OcclusionCulling::recordDraw(VkCommandBuffer commandBuffer,
+                                  size_t frameIndex) const
+{
+  vkCmdDrawIndexedIndirect(commandBuffer,
+                           m_frames[frameIndex].drawCommandBuffer, 0, 1,
+                           sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void OcclusionCulling::recordPyramidBuild(VkCommandBuffer commandBuffer,
+                                          VkExtent2D depthSize)
+{
+  vkCmdFillBuffer(commandBuffer, m_counterBuffer, 0, VK_WHOLE_SIZE, 0);
+
+  // The counter was just zeroed, and the frame's cull must have read the
+  // pyramid before it is rewritten.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+                          | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT
+                       | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  BuildPushConstants pushConstants{};
+  pushConstants.depthSize[0] = depthSize.width;
+  pushConstants.depthSize[1] = depthSize.height;
+  pushConstants.capacity[0] = m_capacity.width;
+  pushConstants.capacity[1] = m_capacity.height;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_buildPass.pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_buildPass.layout, 0, 1, &m_buildSet, 0,
+                          nullptr);
+  vkCmdPushConstants(commandBuffer, m_buildPass.layout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants),
+                     &pushConstants);
+  vkCmdDispatch(commandBuffer,
+                (depthSize.width + BUILD_TILE_SIZE - 1) / BUILD_TILE_SIZE,
+                (depthSize.height + BUILD_TILE_SIZE - 1) / BUILD_TILE_SIZE,
+                1);
+
+  m_pyramidDepthSize = depthSize;
+}
+
+bool OcclusionCulling::isSubgroupQuadSupported() const
+{
+  VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+  subgroupProperties.sType =
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &subgroupProperties;
+  vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties);
+
+  // Quads must not straddle subgroups, which fill the group exactly.
+  uint32_t subgroupSize = subgroupProperties.subgroupSize;
+  return (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT)
+         && (subgroupProperties.supportedOperations
+             & VK_SUBGROUP_FEATURE_QUAD_BIT)
+         && subgroupSize >= 4 && subgroupSize <= BUILD_GROUP_SIZE
+         && BUILD_GROUP_SIZE % subgroupSize == 0;
+}
+
+void OcclusionCulling::createBuffers(uint32_t instanceCapacity)
+{
+  if (m_isCpuCulled) {
+    createMappedFrameBuffers(instanceCapacity);
+    return;
+  }
+
+  VkDeviceSize texelCount = 0;
+  for (uint32_t i = 0; i < PYRAMID_LEVEL_COUNT; i++) {
+    texelCount += VkDeviceSize(getLevelSize(m_capacity.width, i))
+                  * getLevelSize(m_capacity.height, i);
+  }
+
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  createBuffer(m_device, m_physicalDevice, texelCount * 2 * sizeof(float),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+  m_pyramidMemory = UniqueDeviceMemory(m_device, memory);
+  m_pyramidBuffer = UniqueBuffer(m_device, buffer);
+
+  createBuffer(m_device, m_physicalDevice, sizeof(uint32_t),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+               | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+  m_counterMemory = UniqueDeviceMemory(m_device, memory);
+  m_counterBuffer = UniqueBuffer(m_device, buffer);
+
+  for (Frame& frame : m_frames) {
+    createBuffer(m_device, m_physicalDevice,
+                 std::max(instanceCapacity, 1u) * sizeof(Instance),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                 | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+    frame.visibleInstanceMemory = UniqueDeviceMemory(m_device, memory);
+    frame.visibleInstanceBuffer = UniqueBuffer(m_device, buffer);
+
+    createBuffer(m_device, m_physicalDevice,
+                 std::max(instanceCapacity, 1u) * sizeof(InstanceObject),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                 | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+    frame.visibleObjectMemory = UniqueDeviceMemory(m_device, memory);
+    frame.visibleObjectBuffer = UniqueBuffer(m_device, buffer);
+
+    createBuffer(m_device, m_physicalDevice,
+                 sizeof(VkDrawIndexedIndirectCommand),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                 | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                 | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+    frame.drawCommandMemory = UniqueDeviceMemory(m_device, memory);
+    frame.drawCommandBuffer = UniqueBuffer(m_device, buffer);
+  }
+
+  // Texels are read individually, at the exact level.
+  VkSamplerCreateInfo samplerCreateInfo{};
+  samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+  samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+  VkSampler sampler;
+  if (vkCreateSampler(m_device, &samplerCreateInfo, nullptr, &sampler)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth sampler!");
+  }
+  m_depthSampler = UniqueSampler(m_device, sampler);
+}
+
+void OcclusionCulling::createMappedFrameBuffers(uint32_t instanceCapacity)
+{
+  // Written by the CPU each frame, and read once by the GPU.
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                     | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  VkDeviceSize instanceSize = std::max(instanceCapacity, 1u)
+                              * sizeof(Instance);
+  VkDeviceSize objectSize = std::max(instanceCapacity, 1u)
+                            * sizeof(InstanceObject);
+
+  for (Frame& frame : m_frames) {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    void* data;
+
+    createBuffer(m_device, m_physicalDevice, instanceSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                 | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 properties, buffer, memory);
+    frame.visibleInstanceMemory = UniqueDeviceMemory(m_device, memory);
+    frame.visibleInstanceBuffer = UniqueBuffer(m_device, buffer);
+    vkMapMemory(m_device, memory, 0, instanceSize, 0, &data);
+    frame.visibleInstanceData = static_cast<Mat4*>(data);
+
+    createBuffer(m_device, m_physicalDevice, objectSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                 | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 properties, buffer, memory);
+    frame.visibleObjectMemory = UniqueDeviceMemory(m_device, memory);
+    frame.visibleObjectBuffer = UniqueBuffer(m_device, buffer);
+    vkMapMemory(m_device, memory, 0, objectSize, 0, &data);
+    frame.visibleObjectData = static_cast<uint32_t*>(data);
+
+    createBuffer(m_device, m_physicalDevice,
+                 sizeof(VkDrawIndexedIndirectCommand),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                 | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 properties, buffer, memory);
+    frame.drawCommandMemory = UniqueDeviceMemory(m_device, memory);
+    frame.drawCommandBuffer = UniqueBuffer(m_device, buffer);
+    vkMapMemory(m_device, memory, 0, sizeof(VkDrawIndexedIndirectCommand),
+                0, &data);
+    frame.drawCommandData = static_cast<VkDrawIndexedIndirectCommand*>(data);
+
+    // Nothing is drawn until the first write.
+    *frame.drawCommandData = VkDrawIndexedIndirectCommand{};
+  }
+}
+
+void OcclusionCulling::createDescriptorPool()
+{
+  // A build set, with the pyramid, the counter and the depth, and a cull
+  // set per frame, with the pyramid, the instances, the visible instances,
+  // the draw command and the visible objects.
+  uint32_t frameCount = static_cast<uint32_t>(m_frames.size());
+
+  VkDescriptorPoolSize poolSizes[2] = {};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[0].descriptorCount = 2 + 5 * frameCount;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[1].descriptorCount = 1;
+
+  VkDescriptorPoolCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  createInfo.maxSets = 1 + frameCount;
+  createInfo.poolSizeCount = 2;
+  createInfo.pPoolSizes = poolSizes;
+
+  VkDescriptorPool descriptorPool;
+  if (vkCreateDescriptorPool(m_device, &createInfo, nullptr, &descriptorPool)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create culling descriptor pool!");
+  }
+  m_descriptorPool = UniqueDescriptorPool(m_device, descriptorPool);
+}
+
+void OcclusionCulling::createPass(const char* shaderFileName, Pass& pass)
+{
+  ComputePipelineInfo info =
+    m_pipelineCache->createComputePipeline(*m_layoutCache, shaderFileName);
+  pass.pipeline = UniquePipeline(m_device, info.pipeline);
+  pass.layout = info.layoutInfo->layout;
+  pass.setLayout = info.layoutInfo->setLayouts[0];
+}
+
+void OcclusionCulling::writeBuildSet(VkImageView depthView)
+{
+  m_buildSet = allocateDescriptorSet(m_device, m_descriptorPool,
+                                     m_buildPass.setLayout);
+
+  VkDescriptorBufferInfo bufferInfos[2] = {
+    { m_pyramidBuffer, 0, VK_WHOLE_SIZE },
+    { m_counterBuffer, 0, VK_WHOLE_SIZE }
+  };
+
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = m_depthSampler;
+  imageInfo.imageView = depthView;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkWriteDescriptorSet writes[3] = {};
+  for (uint32_t i = 0; i < 3; i++) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = m_buildSet;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+  }
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  writes[0].pBufferInfo = &bufferInfos[0];
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  writes[1].pBufferInfo = &bufferInfos[1];
+  writes[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[2].pImageInfo = &imageInfo;
+
+  vkUpdateDescriptorSets(m_device, 3, writes, 0, nullptr);
+}
+
+void OcclusionCulling::writeCullSet(Frame& frame, VkBuffer instanceBuffer)
+{
+  frame.cullSet = allocateDescriptorSet(m_device, m_descriptorPool,
+                                        m_cullPass.setLayout);
+
+  VkDescriptorBufferInfo bufferInfos[5] = {
+    { m_pyramidBuffer, 0, VK_WHOLE_SIZE },
+    { instanceBuffer, 0, VK_WHOLE_SIZE },
+    { frame.visibleInstanceBuffer, 0, VK_WHOLE_SIZE },
+    { frame.drawCommandBuffer, 0, VK_WHOLE_SIZE },
+    { frame.visibleObjectBuffer, 0, VK_WHOLE_SIZE }
+  };
+
+  VkWriteDescriptorSet writes[5] = {};
+  for (uint32_t i = 0; i < 5; i++) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = frame.cullSet;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = &bufferInfos[i];
+  }
+
+  vkUpdateDescriptorSets(m_device, 5, writes, 0, nullptr);
+}
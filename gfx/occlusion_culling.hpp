@@ -0,0 +1,143 @@
+#ifndef OCCLUSION_CULLING_HPP
+#define OCCLUSION_CULLING_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../ds/Mat4.hpp"
+#include "handles.hpp"
+#include "layout_cache.hpp"
+#include "pipeline_cache.hpp"
+
+// GPU culling of the scene's instances against the view and against a
+// hierarchical min/max depth pyramid (see shaders/hiz_common.glsl). The
+// pyramid is built from the scene depth after it is drawn, and the next
+// frame tests each instance's bounding sphere against it before the draws,
+// which only draw the instances that pass.
+//
+// Using the previous frame's depth, an instance that comes out from behind
+// others shows a frame late.
+//
+// With CPU culling, the caller culls the instances against the view
+// instead (see scene/culling.hpp) and writes the visible ones with
+// writeVisible(), and no pyramid is built.
+class OcclusionCulling
+{
+public:
+  // Matches shaders/hiz_common.glsl.
+  static constexpr uint32_t PYRAMID_LEVEL_COUNT = 12;
+  static constexpr uint32_t MAX_DEPTH_SIZE = 4096;
+
+  // The depth view is sampled in SHADER_READ_ONLY_OPTIMAL layout, and is
+  // at most capacity in size. The instance buffers, one per frame in
+  // flight, hold up to instanceCapacity instances of a mesh of indexCount
+  // indices, whose object space bounding sphere is centre (x, y, z) and
+  // radius w. The depth is unused with CPU culling.
+  void init(VkDevice device,
+            VkPhysicalDevice physicalDevice,
+            LayoutCache& layoutCache,
+            PipelineCache& pipelineCache,
+            VkImageView depthView,
+            VkExtent2D capacity,
+            const std::vector<VkBuffer>& instanceBuffers,
+            uint32_t instanceCapacity,
+            uint32_t indexCount,
+            const float bounds[4],
+            bool isCpuCulled);
+  void destroy();
+
+  // Instances of the slot that passed the last cull, to bind as instance
+  // vertex buffer for recordDraw().
+  VkBuffer getVisibleInstanceBuffer(size_t frameIndex) const;
+  // Index of the object of each visible instance, to bind as vertex buffer
+  // next to them.
+  VkBuffer getVisibleObjectBuffer(size_t frameIndex) const;
+  // The VkDrawIndexedIndirectCommand of recordDraw(), whose instance count
+  // is the number of visible instances.
+  VkBuffer getDrawCommandBuffer(size_t frameIndex) const;
+
+  // Culls the first instanceCount instances of the slot against the last
+  // built pyramid. Must be outside of a render pass, before the draws.
+  // Not used with CPU culling.
+  void recordCull(VkCommandBuffer commandBuffer,
+                  size_t frameIndex,
+                  uint32_t instanceCount) const;
+
+  // With CPU culling, makes the given objects the instances of the slot
+  // drawn by recordDraw(), with their world matrices. The slot's previous
+  // submission must have finished.
+  void writeVisible(size_t frameIndex,
+                    const std::vector<uint32_t>& objects,
+                    const Mat4* worldMatrices);
+
+  // Draws the instances of the slot that passed the cull. Must be inside a
+  // render pass, with the mesh's index buffer and the visible instance
+  // buffer bound.
+  void recordDraw(VkCommandBuffer commandBuffer, size_t frameIndex) const;
+
+  // Builds the pyramid from the top left depthSize of the depth. Must be
+  // after the render pass that drew it, which must make it available to
+  // compute shaders. Not used with CPU culling.
+  void recordPyramidBuild(VkCommandBuffer commandBuffer,
+                          VkExtent2D depthSize);
+
+private:
+  struct Pass
+  {
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    UniquePipeline pipeline;
+  };
+
+  struct Frame
+  {
+    UniqueDeviceMemory visibleInstanceMemory;
+    UniqueBuffer visibleInstanceBuffer;
+    UniqueDeviceMemory visibleObjectMemory;
+    UniqueBuffer visibleObjectBuffer;
+    UniqueDeviceMemory drawCommandMemory;
+    UniqueBuffer drawCommandBuffer;
+    VkDescriptorSet cullSet = VK_NULL_HANDLE;
+    // Persistently mapped with CPU culling, and null otherwise.
+    Mat4* visibleInstanceData = nullptr;
+    uint32_t* visibleObjectData = nullptr;
+    VkDrawIndexedIndirectCommand* drawCommandData = nullptr;
+  };
+
+  bool isSubgroupQuadSupported() const;
+  void createBuffers(uint32_t instanceCapacity);
+  void createMappedFrameBuffers(uint32_t instanceCapacity);
+  void createDescriptorPool();
+  void createPass(const char* shaderFileName, Pass& pass);
+  void writeBuildSet(VkImageView depthView);
+  void writeCullSet(Frame& frame, VkBuffer instanceBuffer);
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  LayoutCache* m_layoutCache = nullptr;
+  PipelineCache* m_pipelineCache = nullptr;
+  VkExtent2D m_capacity = { 0, 0 };
+  uint32_t m_indexCount = 0;
+  float m_bounds[4] = {};
+  bool m_isCpuCulled = false;
+  // Size of the depth the pyramid was last built from, zero before the
+  // first build.
+  VkExtent2D m_pyramidDepthSize = { 0, 0 };
+
+  std::vector<Frame> m_frames;
+  UniqueDeviceMemory m_pyramidMemory;
+  UniqueBuffer m_pyramidBuffer;
+  UniqueDeviceMemory m_counterMemory;
+  UniqueBuffer m_counterBuffer;
+  UniqueSampler m_depthSampler;
+  UniqueDescriptorPool m_descriptorPool;
+  VkDescriptorSet m_buildSet = VK_NULL_HANDLE;
+
+  // The layouts are owned by the layout cache.
+  Pass m_buildPass;
+  Pass m_cullPass;
+};
+
+#endif
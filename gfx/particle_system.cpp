@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../constants.hpp"
+#include "../utils/io.hpp"
+#include "../utils/vk.hpp"
+#include "particle_system.hpp"
+
+namespace
+{
+// Matches the Counters block of shaders/particle_common.glsl.
+struct Counters
+{
+  int32_t freeCount;
+  uint32_t padding[3];
+  VkDispatchIndirectCommand simulateDispatch;
+  uint32_t dispatchPadding;
+  VkDrawIndirectCommand draws[2];
+};
+
+constexpr uint32_t GROUP_SIZE = 64;
+// Particles live between 1 and 4 seconds (see particle_emit.comp). Spawning
+// at capacity / mean lifetime keeps the system close to full.
+constexpr float MEAN_LIFETIME = 2.5f;
+// Keeps a long stall, e.g. at startup, from emitting a burst.
+constexpr float MAX_DELTA_TIME = 0.1f;
+constexpr uint32_t VERTICES_PER_PARTICLE = 6;
+constexpr uint32_t PASS_COUNT = 4;
+
+void upload(VkDevice device,
+            VkPhysicalDevice physicalDevice,
+            VkCommandPool commandPool,
+            SubmitQueue& queue,
+            VkBuffer buffer,
+            const void* data,
+            VkDeviceSize size)
+{
+  VkBuffer rawBuffer;
+  VkDeviceMemory rawMemory;
+  createBuffer(device, physicalDevice, size,
+               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+               | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               rawBuffer, rawMemory);
+  UniqueDeviceMemory stagingBufferMemory(device, rawMemory);
+  UniqueBuffer stagingBuffer(device, rawBuffer);
+
+  void* mapped;
+  vkMapMemory(device, stagingBufferMemory, 0, size, 0, &mapped);
+  memcpy(mapped, data, (size_t) size);
+  vkUnmapMemory(device, stagingBufferMemory);
+
+  copyBuffer(device, commandPool, queue, stagingBuffer, buffer, size);
+}
+}
+
+void ParticleSystem::init(VkDevice device,
+                          VkPhysicalDevice physicalDevice,
+                          LayoutCache& layoutCache,
+                          PipelineCache& pipelineCache,
+                          const AsyncCompute& asyncCompute,
+                          VkCommandPool commandPool,
+                          SubmitQueue& graphicsQueue,
+                          VkRenderPass renderPass,
+                          uint32_t subpass,
+                          uint32_t capacity)
+{
+  m_device = device;
+  m_physicalDevice = physicalDevice;
+  m_layoutCache = &layoutCache;
+  m_pipelineCache = &pipelineCache;
+  m_capacity = capacity;
+  m_emitRate = capacity / MEAN_LIFETIME;
+
+  createBuffers(asyncCompute, commandPool, graphicsQueue);
+  createDescriptorPool();
+  createComputePass(PARTICLE_PREPARE_SHADER_FILE_NAME, m_preparePass);
+  createComputePass(PARTICLE_SIMULATE_SHADER_FILE_NAME, m_simulatePass);
+  createComputePass(PARTICLE_EMIT_SHADER_FILE_NAME, m_emitPass);
+  createDrawPass(renderPass, subpass);
+}
+
+void ParticleSystem::destroy()
+{
+  // The layouts belong to their cache. The draw pipeline's key holds this
+  // class's modules, so no one else uses it, and it is taken out of its
+  // cache, which may be shared and outlive this class. Descriptor sets are
+  // freed with the pool.
+  vkDestroyPipeline(m_device, m_pipelineCache->evict(m_drawPipelineKey),
+                    nullptr);
+  m_vertexShaderModule.reset();
+  m_fragmentShaderModule.reset();
+  m_emitPass.pipeline.reset();
+  m_simulatePass.pipeline.reset();
+  m_preparePass.pipeline.reset();
+  m_descriptorPool.reset();
+  for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+    m_buffers[i].reset();
+    m_memories[i].reset();
+  }
+}
+
+void ParticleSystem::update(float deltaTime)
+{
+  m_readHalf = 1 - m_readHalf;
+  m_seed++;
+  m_deltaTime = std::min(deltaTime, MAX_DELTA_TIME);
+
+  m_emitAccumulator += m_emitRate * m_deltaTime;
+  float emitCount = std::floor(m_emitAccumulator);
+  m_emitAccumulator -= emitCount;
+  m_emitCount = std::min(static_cast<uint32_t>(emitCount), m_capacity);
+}
+
+void ParticleSystem::recordCompute(VkCommandBuffer commandBuffer) const
+{
+  PushConstants pushConstants = getPushConstants();
+  pushConstants.emitCount = m_emitCount;
+
+  // Orders this frame after the previous one on the compute queue. The
+  // graphics frame that drew the half written here has already finished.
+  recordComputeBarrier(commandBuffer,
+                       VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+  bindComputePass(commandBuffer, m_preparePass, pushConstants);
+  vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+  // The simulation is sized by the dispatch arguments written above.
+  recordComputeBarrier(commandBuffer,
+                       VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+                       | VK_ACCESS_SHADER_READ_BIT
+                       | VK_ACCESS_SHADER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+                       | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+  bindComputePass(commandBuffer, m_simulatePass, pushConstants);
+  vkCmdDispatchIndirect(commandBuffer, m_buffers[COUNTERS_BINDING],
+                        offsetof(Counters, simulateDispatch));
+
+  if (pushConstants.emitCount == 0) {
+    return;
+  }
+
+  // Emission reuses the ids freed by the simulation, and appends to the
+  // same list of live particles.
+  recordComputeBarrier(commandBuffer,
+                       VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+  bindComputePass(commandBuffer, m_emitPass, pushConstants);
+  vkCmdDispatch(commandBuffer,
+                (pushConstants.emitCount + GROUP_SIZE - 1) / GROUP_SIZE,
+                1, 1);
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer) const
+{
+  PushConstants pushConstants = getPushConstants();
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    m_drawPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          m_drawPass.layout, 0, 1, &m_drawPass.descriptorSet,
+                          0, nullptr);
+  vkCmdPushConstants(commandBuffer, m_drawPass.layout,
+                     m_drawPass.pushConstantStages, 0, sizeof(pushConstants),
+                     &pushConstants);
+
+  // The instance count is the number of particles the compute pass left
+  // alive in the written half.
+  VkDeviceSize drawOffset = offsetof(Counters, draws)
+                            + (1 - m_readHalf)
+                              * sizeof(VkDrawIndirectCommand);
+  vkCmdDrawIndirect(commandBuffer, m_buffers[COUNTERS_BINDING], drawOffset,
+                    1, sizeof(VkDrawIndirectCommand));
+}
+
+void ParticleSystem::createBuffers(const AsyncCompute& asyncCompute,
+                                   VkCommandPool commandPool,
+                                   SubmitQueue& graphicsQueue)
+{
+  VkDeviceSize sizes[BINDING_COUNT];
+  sizes[COUNTERS_BINDING] = sizeof(Counters);
+  sizes[POSITIONS_BINDING] = 2 * m_capacity * 4 * sizeof(float);
+  sizes[VELOCITIES_BINDING] = 2 * m_capacity * 4 * sizeof(float);
+  sizes[ALIVE_IDS_BINDING] = 2 * m_capacity * sizeof(uint32_t);
+  sizes[FREE_IDS_BINDING] = m_capacity * sizeof(uint32_t);
+
+  // Both queues use the buffers every frame, so ownership transfers would
+  // be needed in both directions. Sharing them concurrently is cheaper.
+  std::vector<uint32_t> queueFamilies =
+    asyncCompute.getConcurrentQueueFamilies();
+
+  for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                               | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (i == COUNTERS_BINDING) {
+      usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    }
+
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    createBuffer(m_device, m_physicalDevice, sizes[i], usage,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory,
+                 queueFamilies);
+    m_memories[i] = UniqueDeviceMemory(m_device, memory);
+    m_buffers[i] = UniqueBuffer(m_device, buffer);
+  }
+
+  // Every particle starts out dead, with its id on the free list.
+  Counters counters{};
+  counters.freeCount = static_cast<int32_t>(m_capacity);
+  counters.simulateDispatch = { 0, 1, 1 };
+  for (VkDrawIndirectCommand& draw : counters.draws) {
+    draw.vertexCount = VERTICES_PER_PARTICLE;
+  }
+  upload(m_device, m_physicalDevice, commandPool, graphicsQueue,
+         m_buffers[COUNTERS_BINDING], &counters, sizeof(counters));
+
+  std::vector<uint32_t> freeIds(m_capacity);
+  std::iota(freeIds.begin(), freeIds.end(), 0);
+  upload(m_device, m_physicalDevice, commandPool, graphicsQueue,
+         m_buffers[FREE_IDS_BINDING], freeIds.data(),
+         sizes[FREE_IDS_BINDING]);
+}
+
+void ParticleSystem::createDescriptorPool()
+{
+  VkDescriptorPoolSize poolSize{};
+  poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSize.descriptorCount = PASS_COUNT * BINDING_COUNT;
+
+  VkDescriptorPoolCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  createInfo.maxSets = PASS_COUNT;
+  createInfo.poolSizeCount = 1;
+  createInfo.pPoolSizes = &poolSize;
+
+  VkDescriptorPool descriptorPool;
+  if (vkCreateDescriptorPool(m_device, &createInfo, nullptr, &descriptorPool)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create particle descriptor pool!");
+  }
+  m_descriptorPool = UniqueDescriptorPool(m_device, descriptorPool);
+}
+
+void ParticleSystem::createComputePass(const char* fileName,
+                                       ComputePass& pass)
+{
+  ComputePipelineInfo info =
+    m_pipelineCache->createComputePipeline(*m_layoutCache, fileName);
+  pass.pipeline = UniquePipeline(m_device, info.pipeline);
+  initPass({ info.reflection }, pass);
+}
+
+void ParticleSystem::createDrawPass(VkRenderPass renderPass,
+                                    uint32_t subpass)
+{
+  std::vector<char> vertShaderCode =
+    readFile(PARTICLE_VERTEX_SHADER_FILE_NAME);
+  std::vector<char> fragShaderCode =
+    readFile(PARTICLE_FRAGMENT_SHADER_FILE_NAME);
+  initPass({ reflectShader(vertShaderCode), reflectShader(fragShaderCode) },
+           m_drawPass);
+
+  // Additive, so that particles need no sorting.
+  VkPipelineColorBlendAttachmentState colourBlendAttachment{};
+  colourBlendAttachment.colorWriteMask =
+    VK_COLOR_COMPONENT_R_BIT
+    | VK_COLOR_COMPONENT_G_BIT
+    | VK_COLOR_COMPONENT_B_BIT
+    | VK_COLOR_COMPONENT_A_BIT;
+  colourBlendAttachment.blendEnable = VK_TRUE;
+  colourBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  colourBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  colourBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colourBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  colourBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  colourBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  m_vertexShaderModule = UniqueShaderModule(
+    m_device, createShaderModule(m_device, vertShaderCode));
+  m_fragmentShaderModule = UniqueShaderModule(
+    m_device, createShaderModule(m_device, fragShaderCode));
+
+  // No vertex input, the vertex shader reads the particle buffers.
+  PipelineStateKey& key = m_drawPipelineKey;
+  key.cullMode = VK_CULL_MODE_NONE;
+  key.colourBlendAttachments = { colourBlendAttachment };
+  key.renderPass = renderPass;
+  key.subpass = subpass;
+  key.layout = m_drawPass.layout;
+  key.stages = {
+    { VK_SHADER_STAGE_VERTEX_BIT, m_vertexShaderModule, "main", {} },
+    { VK_SHADER_STAGE_FRAGMENT_BIT, m_fragmentShaderModule, "main", {} }
+  };
+
+  // Owned by the pipeline cache.
+  m_drawPipeline = m_pipelineCache->get(key);
+}
+
+void ParticleSystem::initPass(const std::vector<ShaderReflection>& stages,
+                              Pass& pass)
+{
+  const PipelineLayoutInfo& layoutInfo =
+    m_layoutCache->getPipelineLayout(stages);
+  if (layoutInfo.setLayouts.size() != 1) {
+    throw std::runtime_error("Particle shaders must only use set 0!");
+  }
+
+  pass.layout = layoutInfo.layout;
+  for (const VkPushConstantRange& range : layoutInfo.pushConstantRanges) {
+    pass.pushConstantStages |= range.stageFlags;
+  }
+
+  pass.descriptorSet = allocateDescriptorSet(m_device, m_descriptorPool,
+                                             layoutInfo.setLayouts[0]);
+
+  // The set is written from reflection, since the compiler may strip
+  // buffers that a shader does not use.
+  std::set<uint32_t> bindings;
+  for (const ShaderReflection& stage : stages) {
+    for (const ReflectedDescriptorBinding& binding
+         : stage.descriptorBindings) {
+      if (binding.binding >= BINDING_COUNT) {
+        throw std::runtime_error("Unknown particle buffer binding!");
+      }
+      bindings.insert(binding.binding);
+    }
+  }
+
+  std::vector<VkDescriptorBufferInfo> bufferInfos;
+  bufferInfos.reserve(bindings.size());
+  std::vector<VkWriteDescriptorSet> writes;
+  for (uint32_t binding : bindings) {
+    bufferInfos.push_back({ m_buffers[binding], 0, VK_WHOLE_SIZE });
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = pass.descriptorSet;
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfos.back();
+    writes.push_back(write);
+  }
+
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+}
+
+void ParticleSystem::bindComputePass(
+  VkCommandBuffer commandBuffer,
+  const ComputePass& pass,
+  const PushConstants& pushConstants) const
+{
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    pass.pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pass.layout, 0, 1, &pass.descriptorSet, 0,
+                          nullptr);
+  vkCmdPushConstants(commandBuffer, pass.layout, pass.pushConstantStages, 0,
+                     sizeof(pushConstants), &pushConstants);
+}
+
+void ParticleSystem::recordComputeBarrier(
+  VkCommandBuffer commandBuffer,
+  VkAccessFlags dstAccessMask,
+  VkPipelineStageFlags dstStageMask) const
+{
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = dstAccessMask;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       dstStageMask, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+ParticleSystem::PushConstants ParticleSystem::getPushConstants() const
+{
+  PushConstants pushConstants{};
+  pushConstants.capacity = m_capacity;
+  pushConstants.readHalf = m_readHalf;
+  pushConstants.seed = m_seed;
+  pushConstants.deltaTime = m_deltaTime;
+
+  return pushConstants;
+}
@@ -0,0 +1,140 @@
+#ifndef PARTICLE_SYSTEM_HPP
+#define PARTICLE_SYSTEM_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../utils/spirv.hpp"
+#include "../utils/submit_queue.hpp"
+#include "async_compute.hpp"
+#include "handles.hpp"
+#include "layout_cache.hpp"
+#include "pipeline_cache.hpp"
+
+// Simulates particles entirely on the GPU. Each frame a compute pass
+// integrates the live particles, compacts the survivors and recycles dead
+// ones through a free list, then spawns new ones. The same buffers feed an
+// indirect instanced draw, so particle data never goes through the CPU.
+//
+// State is stored as structure-of-arrays, twice: a frame reads one half and
+// writes the other, which is then drawn. Since the next frame writes the
+// half drawn two frames earlier, its compute work can overlap with the
+// rendering of the current frame (see shaders/particle_common.glsl).
+class ParticleSystem
+{
+public:
+  // Stages of the graphics submission that read particle data, and must
+  // wait for the compute submission of the frame.
+  static constexpr VkPipelineStageFlags GRAPHICS_WAIT_STAGE =
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+
+  // The command pool and queue are only used for the initial upload. The
+  // particles are drawn in the given subpass of the render pass.
+  void init(VkDevice device,
+            VkPhysicalDevice physicalDevice,
+            LayoutCache& layoutCache,
+            PipelineCache& pipelineCache,
+            const AsyncCompute& asyncCompute,
+            VkCommandPool commandPool,
+            SubmitQueue& graphicsQueue,
+            VkRenderPass renderPass,
+            uint32_t subpass,
+            uint32_t capacity);
+  void destroy();
+
+  // Switches to the frame's halves and accumulates the particles it emits.
+  // Called once per frame, before its commands are recorded, which may
+  // then happen on other threads.
+  void update(float deltaTime);
+
+  // Records the frame's simulation and emission into a compute command
+  // buffer.
+  void recordCompute(VkCommandBuffer commandBuffer) const;
+
+  // Records the draw of the particles written by the frame's compute work.
+  // Must be inside the render pass, with the viewport and scissor set.
+  void recordDraw(VkCommandBuffer commandBuffer) const;
+
+private:
+  enum Binding : uint32_t
+  {
+    COUNTERS_BINDING,
+    POSITIONS_BINDING,
+    VELOCITIES_BINDING,
+    ALIVE_IDS_BINDING,
+    FREE_IDS_BINDING,
+    BINDING_COUNT
+  };
+
+  // Matches the push constant block of shaders/particle_common.glsl.
+  struct PushConstants
+  {
+    uint32_t capacity;
+    uint32_t readHalf;
+    uint32_t emitCount;
+    uint32_t seed;
+    float deltaTime;
+  };
+
+  struct Pass
+  {
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkShaderStageFlags pushConstantStages = 0;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  };
+
+  struct ComputePass : Pass
+  {
+    UniquePipeline pipeline;
+  };
+
+  void createBuffers(const AsyncCompute& asyncCompute,
+                     VkCommandPool commandPool,
+                     SubmitQueue& graphicsQueue);
+  void createDescriptorPool();
+  void createComputePass(const char* fileName, ComputePass& pass);
+  void createDrawPass(VkRenderPass renderPass, uint32_t subpass);
+  void initPass(const std::vector<ShaderReflection>& stages, Pass& pass);
+  void bindComputePass(VkCommandBuffer commandBuffer,
+                       const ComputePass& pass,
+                       const PushConstants& pushConstants) const;
+  void recordComputeBarrier(VkCommandBuffer commandBuffer,
+                            VkAccessFlags dstAccessMask,
+                            VkPipelineStageFlags dstStageMask) const;
+  PushConstants getPushConstants() const;
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  LayoutCache* m_layoutCache = nullptr;
+  PipelineCache* m_pipelineCache = nullptr;
+  uint32_t m_capacity = 0;
+
+  std::array<UniqueDeviceMemory, BINDING_COUNT> m_memories;
+  std::array<UniqueBuffer, BINDING_COUNT> m_buffers;
+  UniqueDescriptorPool m_descriptorPool;
+
+  ComputePass m_preparePass;
+  ComputePass m_simulatePass;
+  ComputePass m_emitPass;
+
+  // The draw pipeline is owned by the pipeline cache, and the modules
+  // referenced by its key by this class.
+  Pass m_drawPass;
+  UniqueShaderModule m_vertexShaderModule;
+  UniqueShaderModule m_fragmentShaderModule;
+  PipelineStateKey m_drawPipelineKey;
+  VkPipeline m_drawPipeline = VK_NULL_HANDLE;
+
+  // Starts at 1, so that the first frame reads half 0. Both are empty then.
+  uint32_t m_readHalf = 1;
+  uint32_t m_seed = 0;
+  float m_emitRate = 0.f;
+  float m_emitAccumulator = 0.f;
+  float m_deltaTime = 0.f;
+  uint32_t m_emitCount = 0;
+};
+
+#endif
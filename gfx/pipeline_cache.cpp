@@ -0,0 +1,512 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../ds/PipelineStateKey.hpp"
+#include "../utils/hash.hpp"
+#include "../utils/io.hpp"
+#include "../utils/vk.hpp"
+#include "handles.hpp"
+#include "pipeline_cache.hpp"
+
+void PipelineCache::init(VkDevice device, const std::string& cacheFileName)
+{
+  m_device = device;
+  m_cacheFileName = cacheFileName;
+
+  // Data from another driver or device is rejected by the driver, so a
+  // stale file only costs a recompile.
+  std::vector<char> initialData;
+  std::ifstream file(cacheFileName, std::ios::ate | std::ios::binary);
+  if (file.is_open()) {
+    initialData.resize((size_t) file.tellg());
+    file.seekg(0);
+    file.read(initialData.data(), initialData.size());
+  }
+
+  VkPipelineCacheCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = initialData.size();
+  createInfo.pInitialData = initialData.data();
+  if (vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_driverCache)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create pipeline cache!");
+  }
+
+  m_isShuttingDown = false;
+  m_compileThread = std::thread(&PipelineCache::runCompileThread, this);
+}
+
+void PipelineCache::destroy()
+{
+  // Nothing was created if init() failed or was never called.
+  if (m_driverCache == VK_NULL_HANDLE) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_compileMutex);
+    m_isShuttingDown = true;
+  }
+  m_compileCondition.notify_all();
+  if (m_compileThread.joinable()) {
+    m_compileThread.join();
+  }
+
+  for (Shard& shard : m_shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto& entry : shard.entries) {
+      if (!entry.second->pipeline.valid()) {
+        continue;
+      }
+
+      try {
+        vkDestroyPipeline(m_device, entry.second->pipeline.get(), nullptr);
+      } catch (const std::exception&) {
+        // The pipeline failed to compile, so there is nothing to destroy.
+      }
+    }
+    shard.entries.clear();
+  }
+
+  size_t dataSize = 0;
+  vkGetPipelineCacheData(m_device, m_driverCache, &dataSize, nullptr);
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(m_device, m_driverCache, &dataSize, data.data())
+      == VK_SUCCESS) {
+    std::ofstream file(m_cacheFileName, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), dataSize);
+  }
+
+  vkDestroyPipelineCache(m_device, m_driverCache, nullptr);
+  m_driverCache = VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineCache::get(const PipelineStateKey& key)
+{
+  Shard& shard = getShard(key);
+
+  std::promise<VkPipeline> promise;
+  std::shared_future<VkPipeline> pipeline;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+      pipeline = it->second->pipeline;
+      m_hitCount.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      m_missCount.fetch_add(1, std::memory_order_relaxed);
+      auto entry = std::make_shared<Entry>();
+      entry->pipeline = promise.get_future().share();
+      shard.entries.emplace(key, entry);
+    }
+  }
+
+  if (pipeline.valid()) {
+    // Blocks if another thread is still creating the pipeline.
+    return pipeline.get();
+  }
+
+  // Created outside of the lock, so other lookups are not held up.
+  try {
+    VkPipeline newPipeline = createPipeline(key);
+    promise.set_value(newPipeline);
+    return newPipeline;
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+}
+
+VkPipeline PipelineCache::getAsync(const PipelineStateKey& key,
+                                   VkPipeline fallback)
+{
+  Shard& shard = getShard(key);
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.entries.find(key);
+  if (it != shard.entries.end()) {
+    const auto& pipeline = it->second->pipeline;
+    if (pipeline.wait_for(std::chrono::seconds(0))
+        == std::future_status::ready) {
+      m_hitCount.fetch_add(1, std::memory_order_relaxed);
+      return pipeline.get();
+    }
+
+    return fallback;
+  }
+
+  m_missCount.fetch_add(1, std::memory_order_relaxed);
+  CompileJob job;
+  job.key = key;
+
+  auto entry = std::make_shared<Entry>();
+  entry->pipeline = job.promise.get_future().share();
+  shard.entries.emplace(key, entry);
+
+  {
+    std::lock_guard<std::mutex> compileLock(m_compileMutex);
+    m_compileJobs.push_back(std::move(job));
+  }
+  m_compileCondition.notify_one();
+
+  return fallback;
+}
+
+ComputePipelineInfo PipelineCache::createComputePipeline(
+  LayoutCache& layoutCache,
+  const std::string& fileName,
+  const SpecializationConstants& specialization)
+{
+  ComputePipelineInfo info{};
+  std::vector<char> code = readFile(fileName);
+  info.reflection = reflectShader(code);
+  if (info.reflection.stage != VK_SHADER_STAGE_COMPUTE_BIT) {
+    throw std::runtime_error(fileName + " is not a compute shader!");
+  }
+
+  info.layoutInfo = &layoutCache.getPipelineLayout({ info.reflection });
+  if (info.layoutInfo->setLayouts.size() != 1) {
+    throw std::runtime_error(fileName + " must only use set 0!");
+  }
+
+  specialization.validate(info.reflection);
+  std::vector<VkSpecializationMapEntry> mapEntries =
+    specialization.getMapEntries();
+  std::vector<uint32_t> specializationData = specialization.getData();
+  VkSpecializationInfo specializationInfo{};
+  specializationInfo.mapEntryCount = static_cast<uint32_t>(
+    mapEntries.size());
+  specializationInfo.pMapEntries = mapEntries.data();
+  specializationInfo.dataSize = specializationData.size()
+                                * sizeof(uint32_t);
+  specializationInfo.pData = specializationData.data();
+
+  // The module is only needed while the pipeline is created.
+  UniqueShaderModule shaderModule(m_device,
+                                  createShaderModule(m_device, code));
+
+  VkComputePipelineCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  createInfo.stage.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  createInfo.stage.module = shaderModule;
+  createInfo.stage.pName = info.reflection.entryPoint.c_str();
+  if (!specialization.isEmpty()) {
+    createInfo.stage.pSpecializationInfo = &specializationInfo;
+  }
+  createInfo.layout = info.layoutInfo->layout;
+
+  if (vkCreateComputePipelines(m_device, m_driverCache, 1, &createInfo,
+                               nullptr, &info.pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create compute pipeline for "
+                             + fileName + "!");
+  }
+
+  return info;
+}
+
+VkPipeline PipelineCache::evict(const PipelineStateKey& key)
+{
+  Shard& shard = getShard(key);
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.entries.find(key);
+  if (it == shard.entries.end()) {
+    return VK_NULL_HANDLE;
+  }
+
+  const auto& pipeline = it->second->pipeline;
+  if (pipeline.wait_for(std::chrono::seconds(0))
+      != std::future_status::ready) {
+    return VK_NULL_HANDLE;
+  }
+
+  VkPipeline evictedPipeline = VK_NULL_HANDLE;
+  try {
+    evictedPipeline = pipeline.get();
+  } catch (const std::exception&) {
+    // Failed compilations are evicted too, so that they can be retried.
+  }
+  shard.entries.erase(it);
+
+  return evictedPipeline;
+}
+
+uint64_t PipelineCache::getHitCount() const
+{
+  return m_hitCount.load(std::memory_order_relaxed);
+}
+
+uint64_t PipelineCache::getMissCount() const
+{
+  return m_missCount.load(std::memory_order_relaxed);
+}
+
+PipelineCache::Shard& PipelineCache::getShard(const PipelineStateKey& key)
+{
+  return m_shards[KeyHash{}(key) % NUM_SHARDS];
+}
+
+void PipelineCache::runCompileThread()
+{
+  while (true) {
+    CompileJob job;
+    {
+      std::unique_lock<std::mutex> lock(m_compileMutex);
+      m_compileCondition.wait(lock, [this]() {
+        return m_isShuttingDown || !m_compileJobs.empty();
+      });
+
+      if (m_isShuttingDown) {
+        // Pending pipelines are abandoned; their futures report a broken
+        // promise to anyone still waiting on them.
+        m_compileJobs.clear();
+        return;
+      }
+
+      job = std::move(m_compileJobs.front());
+      m_compileJobs.pop_front();
+    }
+
+    try {
+      job.promise.set_value(createPipeline(job.key));
+    } catch (...) {
+      job.promise.set_exception(std::current_exception());
+    }
+  }
+}
+
+VkPipeline PipelineCache::createPipeline(const PipelineStateKey& key)
+{
+  // Sized up front, since the create infos point into these.
+  std::vector<std::vector<VkSpecializationMapEntry>> specMapEntries(
+    key.stages.size());
+  std::vector<std::vector<uint32_t>> specData(key.stages.size());
+  std::vector<VkSpecializationInfo> specInfos(key.stages.size());
+
+  std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+  for (size_t i = 0; i < key.stages.size(); i++) {
+    const ShaderStageKey& stage = key.stages[i];
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo{};
+    shaderStageInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.stage = stage.stage;
+    shaderStageInfo.module = stage.module;
+    shaderStageInfo.pName = stage.entryPoint.c_str();
+
+    if (!stage.specialization.isEmpty()) {
+      specMapEntries[i] = stage.specialization.getMapEntries();
+      specData[i] = stage.specialization.getData();
+
+      specInfos[i].mapEntryCount =
+        static_cast<uint32_t>(specMapEntries[i].size());
+      specInfos[i].pMapEntries = specMapEntries[i].data();
+      specInfos[i].dataSize = specData[i].size() * sizeof(uint32_t);
+      specInfos[i].pData = specData[i].data();
+      shaderStageInfo.pSpecializationInfo = &specInfos[i];
+    }
+
+    shaderStages.push_back(shaderStageInfo);
+  }
+
+  VkPipelineVertexInputStateCreateInfo vertInputCreateInfo{};
+  vertInputCreateInfo.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertInputCreateInfo.vertexBindingDescriptionCount =
+    static_cast<uint32_t>(key.vertexBindings.size());
+  vertInputCreateInfo.pVertexBindingDescriptions = key.vertexBindings.data();
+  vertInputCreateInfo.vertexAttributeDescriptionCount =
+    static_cast<uint32_t>(key.vertexAttributes.size());
+  vertInputCreateInfo.pVertexAttributeDescriptions =
+    key.vertexAttributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAsmCreateInfo{};
+  inputAsmCreateInfo.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAsmCreateInfo.topology = key.topology;
+  inputAsmCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+  VkPipelineViewportStateCreateInfo viewportStateCreateInfo{};
+  viewportStateCreateInfo.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportStateCreateInfo.viewportCount = 1;
+  viewportStateCreateInfo.pViewports = nullptr;
+  viewportStateCreateInfo.scissorCount = 1;
+  viewportStateCreateInfo.pScissors = nullptr;
+
+  VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo{};
+  rasterizerCreateInfo.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizerCreateInfo.depthClampEnable = VK_FALSE;
+  rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+  rasterizerCreateInfo.polygonMode = key.polygonMode;
+  rasterizerCreateInfo.lineWidth = 1.f;
+  rasterizerCreateInfo.cullMode = key.cullMode;
+  rasterizerCreateInfo.frontFace = key.frontFace;
+  rasterizerCreateInfo.depthBiasEnable = key.isDepthBiasEnabled;
+  rasterizerCreateInfo.depthBiasConstantFactor = key.depthBiasConstantFactor;
+  rasterizerCreateInfo.depthBiasClamp = 0.f;
+  rasterizerCreateInfo.depthBiasSlopeFactor = key.depthBiasSlopeFactor;
+
+  VkPipelineMultisampleStateCreateInfo msCreateInfo{};
+  msCreateInfo.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  msCreateInfo.sampleShadingEnable = VK_FALSE;
+  msCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  msCreateInfo.minSampleShading = 1.f;
+  msCreateInfo.pSampleMask = nullptr;
+  msCreateInfo.alphaToCoverageEnable = VK_FALSE;
+  msCreateInfo.alphaToOneEnable = VK_FALSE;
+
+  VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo{};
+  depthStencilCreateInfo.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencilCreateInfo.depthTestEnable = key.isDepthTestEnabled;
+  depthStencilCreateInfo.depthWriteEnable = key.isDepthWriteEnabled;
+  depthStencilCreateInfo.depthCompareOp = key.depthCompareOp;
+  depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+  depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+
+  VkPipelineColorBlendStateCreateInfo colourBlendCreateInfo{};
+  colourBlendCreateInfo.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colourBlendCreateInfo.logicOpEnable = VK_FALSE;
+  colourBlendCreateInfo.logicOp = VK_LOGIC_OP_COPY;
+  colourBlendCreateInfo.attachmentCount =
+    static_cast<uint32_t>(key.colourBlendAttachments.size());
+  colourBlendCreateInfo.pAttachments = key.colourBlendAttachments.data();
+  colourBlendCreateInfo.blendConstants[0] = 0.f;
+  colourBlendCreateInfo.blendConstants[1] = 0.f;
+  colourBlendCreateInfo.blendConstants[2] = 0.f;
+  colourBlendCreateInfo.blendConstants[3] = 0.f;
+
+  VkDynamicState dynamicStates[] = {
+    VK_DYNAMIC_STATE_VIEWPORT,
+    VK_DYNAMIC_STATE_SCISSOR
+  };
+  VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
+  dynamicStateCreateInfo.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicStateCreateInfo.dynamicStateCount = 2;
+  dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+
+  VkGraphicsPipelineCreateInfo pipelineCreateInfo{};
+  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+  pipelineCreateInfo.pStages = shaderStages.data();
+  pipelineCreateInfo.pVertexInputState = &vertInputCreateInfo;
+  pipelineCreateInfo.pInputAssemblyState = &inputAsmCreateInfo;
+  pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+  pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+  pipelineCreateInfo.pMultisampleState = &msCreateInfo;
+  pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+  pipelineCreateInfo.pColorBlendState = &colourBlendCreateInfo;
+  pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+  pipelineCreateInfo.layout = key.layout;
+  pipelineCreateInfo.renderPass = key.renderPass;
+  pipelineCreateInfo.subpass = key.subpass;
+  pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineCreateInfo.basePipelineIndex = -1;
+
+  VkPipeline pipeline;
+  if (vkCreateGraphicsPipelines(m_device, m_driverCache, 1,
+                                &pipelineCreateInfo, nullptr,
+                                &pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create graphics pipeline!");
+  }
+
+  return pipeline;
+}
+
+size_t PipelineCache::KeyHash::operator()(const PipelineStateKey& key) const
+{
+  size_t seed = 0;
+  for (const ShaderStageKey& stage : key.stages) {
+    hashCombine(seed, static_cast<uint32_t>(stage.stage));
+    hashCombine(seed, stage.module);
+    hashCombine(seed, stage.entryPoint);
+    hashCombine(seed, stage.specialization.hash());
+  }
+  for (const auto& binding : key.vertexBindings) {
+    hashCombine(seed, hashBytes(&binding, sizeof(binding)));
+  }
+  for (const auto& attribute : key.vertexAttributes) {
+    hashCombine(seed, hashBytes(&attribute, sizeof(attribute)));
+  }
+  hashCombine(seed, static_cast<uint32_t>(key.topology));
+  hashCombine(seed, static_cast<uint32_t>(key.polygonMode));
+  hashCombine(seed, key.cullMode);
+  hashCombine(seed, static_cast<uint32_t>(key.frontFace));
+  hashCombine(seed, key.isDepthBiasEnabled);
+  hashCombine(seed, key.depthBiasConstantFactor);
+  hashCombine(seed, key.depthBiasSlopeFactor);
+  for (const auto& attachment : key.colourBlendAttachments) {
+    hashCombine(seed, hashBytes(&attachment, sizeof(attachment)));
+  }
+  hashCombine(seed, key.isDepthTestEnabled);
+  hashCombine(seed, key.isDepthWriteEnabled);
+  hashCombine(seed, static_cast<uint32_t>(key.depthCompareOp));
+  hashCombine(seed, key.layout);
+  hashCombine(seed, key.renderPass);
+  hashCombine(seed, key.subpass);
+
+  return seed;
+}
+
+// Vulkan state structs are compared bytewise. Keys are value-initialized
+// field by field, so there is no uninitialized padding to trip over.
+template<typename T>
+static bool areBytewiseEqual(const std::vector<T>& a, const std::vector<T>& b)
+{
+  return a.size() == b.size()
+         && (a.empty()
+             || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+bool PipelineCache::KeyEqual::operator()(const PipelineStateKey& a,
+                                         const PipelineStateKey& b) const
+{
+  if (a.stages.size() != b.stages.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.stages.size(); i++) {
+    if (a.stages[i].stage != b.stages[i].stage
+        || a.stages[i].module != b.stages[i].module
+        || a.stages[i].entryPoint != b.stages[i].entryPoint
+        || a.stages[i].specialization != b.stages[i].specialization) {
+      return false;
+    }
+  }
+
+  return areBytewiseEqual(a.vertexBindings, b.vertexBindings)
+         && areBytewiseEqual(a.vertexAttributes, b.vertexAttributes)
+         && a.topology == b.topology
+         && a.polygonMode == b.polygonMode
+         && a.cullMode == b.cullMode
+         && a.frontFace == b.frontFace
+         && a.isDepthBiasEnabled == b.isDepthBiasEnabled
+         && a.depthBiasConstantFactor == b.depthBiasConstantFactor
+         && a.depthBiasSlopeFactor == b.depthBiasSlopeFactor
+         && areBytewiseEqual(a.colourBlendAttachments,
+                             b.colourBlendAttachments)
+         && a.isDepthTestEnabled == b.isDepthTestEnabled
+         && a.isDepthWriteEnabled == b.isDepthWriteEnabled
+         && a.depthCompareOp == b.depthCompareOp
+         && a.layout == b.layout
+         && a.renderPass == b.renderPass
+         && a.subpass == b.subpass;
+}
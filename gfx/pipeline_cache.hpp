@@ -0,0 +1,128 @@
+#ifndef PIPELINE_CACHE_HPP
+#define PIPELINE_CACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../ds/PipelineStateKey.hpp"
+#include "../utils/specialization.hpp"
+#include "../utils/spirv.hpp"
+#include "layout_cache.hpp"
+
+// Compute pipeline created by PipelineCache::createComputePipeline().
+struct ComputePipelineInfo
+{
+  VkPipeline pipeline;
+  // Owned by the layout cache.
+  const PipelineLayoutInfo* layoutInfo;
+  ShaderReflection reflection;
+};
+
+// Creates graphics pipelines on first use and deduplicates them by their
+// state key. Safe to use from several threads. Pipelines can also be
+// compiled on a background thread, in which case a fallback pipeline is
+// used until they are ready. The shader modules and layouts referenced by a
+// key must outlive any pending compilation.
+class PipelineCache
+{
+public:
+  // The driver's pipeline cache is loaded from, and saved to, the given
+  // file, so that later runs skip most of the compilation work.
+  void init(VkDevice device, const std::string& cacheFileName);
+  void destroy();
+
+  // Returns the pipeline for the key, creating it on this thread if needed.
+  VkPipeline get(const PipelineStateKey& key);
+
+  // Returns the pipeline for the key if it has been created, or queues it
+  // for background compilation and returns the fallback.
+  VkPipeline getAsync(const PipelineStateKey& key, VkPipeline fallback);
+
+  // Creates a compute pipeline from a SPIR-V file, with its layout from the
+  // layout cache, through the driver's cache like graphics pipelines. The
+  // shader must only use set 0. Compute pipelines each have one owner, so
+  // they are not deduplicated, and the caller destroys them.
+  ComputePipelineInfo createComputePipeline(
+    LayoutCache& layoutCache,
+    const std::string& fileName,
+    const SpecializationConstants& specialization = {});
+
+  // Removes the pipeline from the cache without destroying it, e.g. after
+  // its shaders are reloaded. Returns VK_NULL_HANDLE if it is not cached or
+  // still being compiled.
+  VkPipeline evict(const PipelineStateKey& key);
+
+  // Lookups that found the pipeline, and ones that had to create it.
+  // Lookups of pipelines still being compiled count as neither.
+  uint64_t getHitCount() const;
+  uint64_t getMissCount() const;
+
+private:
+  struct KeyHash
+  {
+    size_t operator()(const PipelineStateKey& key) const;
+  };
+
+  struct KeyEqual
+  {
+    bool operator()(const PipelineStateKey& a,
+                    const PipelineStateKey& b) const;
+  };
+
+  struct Entry
+  {
+    std::shared_future<VkPipeline> pipeline;
+  };
+
+  // The map is split into shards with a lock each, so that threads looking
+  // up different pipelines rarely contend.
+  static constexpr size_t NUM_SHARDS = 16;
+
+  struct Shard
+  {
+    std::mutex mutex;
+    std::unordered_map<PipelineStateKey,
+                       std::shared_ptr<Entry>,
+                       KeyHash,
+                       KeyEqual> entries;
+  };
+
+  struct CompileJob
+  {
+    PipelineStateKey key;
+    std::promise<VkPipeline> promise;
+  };
+
+  Shard& getShard(const PipelineStateKey& key);
+  VkPipeline createPipeline(const PipelineStateKey& key);
+  void runCompileThread();
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkPipelineCache m_driverCache = VK_NULL_HANDLE;
+  std::string m_cacheFileName;
+  std::array<Shard, NUM_SHARDS> m_shards;
+
+  std::thread m_compileThread;
+  std::mutex m_compileMutex;
+  std::condition_variable m_compileCondition;
+  std::deque<CompileJob> m_compileJobs;
+  bool m_isShuttingDown = false;
+
+  std::atomic<uint64_t> m_hitCount{ 0 };
+  std::atomic<uint64_t> m_missCount{ 0 };
+};
+
+#endif
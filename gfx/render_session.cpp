@@ -0,0 +1,1814 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../constants.hpp"
+#include "../ds/Instance.hpp"
+#include "../ds/Vertex.hpp"
+#include "../utils/io.hpp"
+#include "../utils/mesh.hpp"
+#include "../utils/quantize.hpp"
+#include "../utils/spirv.hpp"
+#include "../utils/vk.hpp"
+#include "render_session.hpp"
+
+// Offscreen views render to this, which every device supports as a colour
+// attachment, and the frame capture can read back.
+static constexpr VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+// Objects per job of the scene update and the CPU culling.
+static constexpr size_t SCENE_BATCH_SIZE = 1024;
+static_assert(SCENE_BATCH_SIZE % Scene::OBJECT_BATCH_ALIGNMENT == 0,
+              "Scene batches must stay aligned.");
+
+// Bounding sphere of the mesh, centred on the middle of its bounding box,
+// for the culling.
+static void computeMeshBounds(const MeshData& mesh, float bounds[4])
+{
+  float minPosition[3];
+  float maxPosition[3];
+  std::copy(mesh.vertices[0].position, mesh.vertices[0].position + 3,
+            minPosition);
+  std::copy(minPosition, minPosition + 3, maxPosition);
+  for (const MeshVertex& vertex : mesh.vertices) {
+    for (int i = 0; i < 3; i++) {
+      minPosition[i] = std::min(minPosition[i], vertex.position[i]);
+      maxPosition[i] = std::max(maxPosition[i], vertex.position[i]);
+    }
+  }
+
+  for (int i = 0; i < 3; i++) {
+    bounds[i] = 0.5f * (minPosition[i] + maxPosition[i]);
+  }
+  bounds[3] = 0.f;
+  for (const MeshVertex& vertex : mesh.vertices) {
+    float x = vertex.position[0] - bounds[0];
+    float y = vertex.position[1] - bounds[1];
+    float z = vertex.position[2] - bounds[2];
+    bounds[3] = std::max(bounds[3], std::sqrt(x * x + y * y + z * z));
+  }
+}
+
+// Meshes are y up and face +z with counter-clockwise triangles, like the
+// OBJ files meshopt reads. They are turned to face the view, which is y
+// down and looks along +z, and scaled into the triangle's place: a sphere
+// of radius 0.5 around the middle of the depth range, so that the whole
+// mesh is in front of the near plane.
+static void normaliseMesh(MeshData& mesh)
+{
+  float bounds[4];
+  computeMeshBounds(mesh, bounds);
+  float scale = bounds[3] > 0.f ? 0.5f / bounds[3] : 1.f;
+
+  // Half a turn around x, which keeps the winding as seen from the view.
+  for (MeshVertex& vertex : mesh.vertices) {
+    vertex.position[0] = (vertex.position[0] - bounds[0]) * scale;
+    vertex.position[1] = -(vertex.position[1] - bounds[1]) * scale;
+    vertex.position[2] = 0.5f - (vertex.position[2] - bounds[2]) * scale;
+    vertex.normal[1] = -vertex.normal[1];
+    vertex.normal[2] = -vertex.normal[2];
+    // Vertices without a normal face the view, like the triangle's.
+    if (vertex.normal[0] == 0.f && vertex.normal[1] == 0.f
+        && vertex.normal[2] == 0.f) {
+      vertex.normal[2] = -1.f;
+    }
+  }
+  // The scene pipeline's front faces are clockwise on screen, like the
+  // triangle's.
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+  }
+}
+
+void RenderSession::init(DeviceContext& context,
+                         const SessionOptions& options,
+                         const std::vector<GLFWwindow*>& windows,
+                         MetricsRegistry& metrics,
+                         const MetricLabels& labels)
+{
+  m_options = options;
+  m_vkInstance = context.getInstance();
+  m_physicalDevice = context.getPhysicalDevice();
+  m_device = context.getDevice();
+  m_queueFamilies = context.getQueueFamilies();
+  m_graphicsQueue = &context.getGraphicsQueue();
+  m_computeQueue = &context.getComputeQueue();
+  m_layoutCache = &context.getLayoutCache();
+  m_pipelineCache = &context.getPipelineCache();
+
+  m_isOffscreen = windows.empty();
+  if (!m_isOffscreen) {
+    m_presentQueue = &context.getPresentQueue();
+  }
+  // Offscreen images are left ready to be read back.
+  m_viewLayout = m_isOffscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                               : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  if (!m_options.replayFileName.empty()) {
+    m_replayFrames = readFrameTrace(m_options.replayFileName).frames;
+  }
+
+  createSurfaces(windows);
+  createSwapChains();
+  createSceneRenderPass();
+  createRenderPass();
+  createFramebuffers();
+  createUpscaler();
+  createCommandPool();
+  createVertexBuffer();
+  createScene();
+  createInstanceBuffers();
+  createOcclusionCulling();
+  // Before the graphics pipeline, whose fragment shader uses their sets.
+  m_lighting.init(m_device, m_physicalDevice, *m_layoutCache,
+                  *m_pipelineCache, std::max(m_options.lightCount, 1u),
+                  MAX_FRAMES_IN_FLIGHT);
+  createTextures();
+  createGraphicsPipeline();
+  createCommandBuffers();
+  createSyncObjects();
+  m_asyncCompute.init(m_device, m_queueFamilies, *m_computeQueue,
+                      MAX_FRAMES_IN_FLIGHT);
+
+  if (m_options.particleCapacity > 0) {
+    m_particleSystem.init(m_device, m_physicalDevice, *m_layoutCache,
+                          *m_pipelineCache, m_asyncCompute, m_commandPool,
+                          *m_graphicsQueue, m_sceneRenderPass, 1,
+                          m_options.particleCapacity);
+  }
+
+  if (m_options.isShaderHotReloadEnabled) {
+    m_shaderWatcher.init(SHADER_DIR);
+  }
+
+  if (!m_options.captureFileName.empty()) {
+    m_frameCapture.init(m_device, m_physicalDevice,
+                        m_views[0].swapChainExtent,
+                        m_swapChainImageFormat, CAPTURE_BUFFER_COUNT,
+                        m_options.captureFileName);
+  }
+
+  if (!m_options.traceFileName.empty()) {
+    m_traceWriter.init(m_options.traceFileName, m_options.tracedSettings);
+  }
+
+  createMetrics(metrics, labels);
+}
+
+void RenderSession::destroy()
+{
+  if (m_options.isShaderHotReloadEnabled) {
+    m_shaderWatcher.destroy();
+  }
+
+  if (!m_options.captureFileName.empty()) {
+    m_frameCapture.destroy();
+  }
+
+  if (!m_options.traceFileName.empty()) {
+    m_traceWriter.destroy();
+  }
+
+  // The pipeline cache is shared and outlives the session, so the
+  // session's pipelines are taken out of it. Their keys hold the session's
+  // render pass and modules, so no other session uses them. A pending
+  // pipeline is waited for, since it is compiled from the modules.
+  if (m_isPipelinePending) {
+    try {
+      m_pipelineCache->get(m_pendingPipelineKey);
+    } catch (const std::exception&) {
+      // Reported when it was picked up, or not needed any more.
+    }
+    vkDestroyPipeline(m_device, m_pipelineCache->evict(m_pendingPipelineKey),
+                      nullptr);
+    vkDestroyPipeline(
+      m_device,
+      m_pipelineCache->evict(createDepthPipelineKey(m_pendingPipelineKey)),
+      nullptr);
+    retireShaderModules(m_pendingPipelineKey);
+  }
+  m_pipelineCache->evict(m_graphicsPipelineKey);
+  m_pipelineCache->evict(createDepthPipelineKey(m_graphicsPipelineKey));
+  vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_depthPipeline, nullptr);
+  retireShaderModules(m_graphicsPipelineKey);
+
+  m_upscaler.destroy();
+  m_gpuTimer.destroy();
+  if (m_options.particleCapacity > 0) {
+    m_particleSystem.destroy();
+  }
+  m_asyncCompute.destroy();
+  m_lighting.destroy();
+  m_occlusionCulling.destroy();
+  m_textureStreamer.destroy();
+  m_deletionQueue.flush();
+
+  // Everything else is owned by RAII members, which are destroyed with
+  // the session, in reverse order of declaration.
+}
+
+void RenderSession::run(const std::atomic<bool>& isStopRequested,
+                        Mailbox<FrameInput>* inputMailbox,
+                        FrameStats& frameStats)
+{
+  // Jobs are waited on by this thread, so it must be the job system's
+  // worker 0.
+  m_jobSystem.init(m_options.workerThreadCount);
+
+  try {
+    auto startTime = std::chrono::steady_clock::now();
+    while (!isStopRequested.load(std::memory_order_acquire)
+           && (m_options.frameLimit == 0
+               || m_frameNumber < m_options.frameLimit)
+           && (m_options.replayFileName.empty()
+               || m_frameNumber < m_replayFrames.size())) {
+      // Replayed frames follow each other as fast as they are drawn, and so
+      // do offscreen ones, whose size never changes.
+      FrameInput input;
+      if (!m_options.replayFileName.empty()) {
+        input = m_replayFrames[m_frameNumber].input;
+      } else if (m_isOffscreen) {
+        input.time = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - startTime).count();
+        input.framebufferWidth = static_cast<int>(
+          m_views[0].swapChainExtent.width);
+        input.framebufferHeight = static_cast<int>(
+          m_views[0].swapChainExtent.height);
+      } else {
+        input = inputMailbox->read();
+      }
+      if (input.framebufferWidth == 0 || input.framebufferHeight == 0) {
+        std::this_thread::sleep_for(
+          std::chrono::duration<double>(INPUT_POLL_INTERVAL));
+        continue;
+      }
+
+      auto frameStartTime = std::chrono::steady_clock::now();
+      if (m_frameNumber > 0) {
+        m_metricHandles.frameIntervals->observe(
+          std::chrono::duration<double>(
+            frameStartTime - m_lastFrameStartTime).count());
+      }
+      m_lastFrameStartTime = frameStartTime;
+
+      drawFrame(input);
+      frameStats.recordFrame();
+
+      m_metricHandles.frameCpuTimes->observe(
+        std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - frameStartTime).count());
+      updateMetrics();
+    }
+  } catch (...) {
+    // The session is destroyed next, so its jobs and GPU work must finish
+    // first. A failed submission leaves its fence unsignalled, so the
+    // queues are drained instead.
+    m_jobSystem.wait(m_frameJobs);
+    m_jobSystem.wait(m_sceneJobs);
+    m_jobSystem.wait(m_cullJobs);
+    m_jobSystem.destroy();
+    m_graphicsQueue->waitIdle();
+    m_computeQueue->waitIdle();
+    if (!m_isOffscreen) {
+      m_presentQueue->waitIdle();
+    }
+    throw;
+  }
+
+  waitForSubmittedFrames();
+  m_jobSystem.destroy();
+}
+
+void RenderSession::waitForSubmittedFrames()
+{
+  // Every frame's work ends with its in-flight fence being signalled. The
+  // compute submissions are covered too, since each graphics submission
+  // waits on its frame's compute work. Presentation has no fence, so the
+  // present queue is drained separately before its semaphores are freed.
+  std::vector<VkFence> fences;
+  for (const UniqueFence& fence : m_inFlightFences) {
+    fences.push_back(fence);
+  }
+  vkWaitForFences(m_device, static_cast<uint32_t>(fences.size()),
+                  fences.data(), VK_TRUE, UINT64_MAX);
+  if (!m_isOffscreen) {
+    m_presentQueue->waitIdle();
+  }
+}
+
+void RenderSession::drawFrame(const FrameInput& input)
+{
+  vkWaitForFences(m_device, 1, m_inFlightFences[m_currentFrameIndex]
+                                .getAddress(),
+                  VK_TRUE, UINT64_MAX);
+
+  // Frame boundary: nothing of this frame is recorded yet, and the frame
+  // that last used this frame slot has finished on the GPU, so all frames
+  // before completedFrameCount have.
+  uint64_t completedFrameCount = m_frameNumber + 1 >= MAX_FRAMES_IN_FLIGHT
+                                 ? m_frameNumber + 1 - MAX_FRAMES_IN_FLIGHT
+                                 : 0;
+  m_deletionQueue.collect(completedFrameCount);
+  reloadShaders();
+
+  // The frame that last used this slot has finished, so its GPU time is
+  // known. It picks the resolution of this frame, unless replaying, which
+  // uses the resolution the frame was recorded at.
+  double gpuTime;
+  if (m_gpuTimer.getElapsedTime(m_currentFrameIndex, gpuTime)) {
+    m_metricHandles.frameGpuTimes->observe(gpuTime);
+    if (m_options.targetFrameRate > 0
+        && m_options.replayFileName.empty()) {
+      m_resolutionController.update(gpuTime);
+    }
+  }
+  float scale = m_options.replayFileName.empty()
+                ? m_resolutionController.getScale()
+                : m_replayFrames[m_frameNumber].resolutionScale;
+  VkExtent2D sceneExtent = m_upscaler.getSceneExtent();
+  m_renderExtent.width = std::max<uint32_t>(
+    static_cast<uint32_t>(std::lround(sceneExtent.width * scale)), 1);
+  m_renderExtent.height = std::max<uint32_t>(
+    static_cast<uint32_t>(std::lround(sceneExtent.height * scale)), 1);
+  m_metricHandles.resolutionScale->set(scale);
+
+  if (!m_options.traceFileName.empty()) {
+    m_traceWriter.write({ input, scale });
+  }
+
+  if (!m_options.captureFileName.empty()) {
+    m_frameCapture.releaseCompletedFrames(completedFrameCount);
+  }
+
+  // Recorded by a job, while this thread acquires the swap chain image and
+  // records the graphics work. The compute command pool is separate, so
+  // both can record at the same time. Particles are simulated up to the
+  // time of the input snapshot. Their state is advanced here, before the
+  // job starts, since the draw recorded by this thread depends on it too.
+  if (m_options.particleCapacity > 0) {
+    float deltaTime = m_frameNumber > 0
+                      ? static_cast<float>(input.time - m_lastFrameTime)
+                      : 0.f;
+    m_lastFrameTime = input.time;
+    m_particleSystem.update(deltaTime);
+
+    m_jobSystem.run([this]() {
+      VkCommandBuffer computeCommandBuffer =
+        m_asyncCompute.begin(m_currentFrameIndex);
+      m_particleSystem.recordCompute(computeCommandBuffer);
+    }, &m_frameJobs);
+  }
+
+  // The objects are animated and their local matrices computed in
+  // batches, then their world matrices are resolved in order into the
+  // slot's instance buffer, which is no longer read, since its fence was
+  // waited on.
+  m_jobSystem.parallelFor(
+    m_scene.getObjectCount(), SCENE_BATCH_SIZE,
+    [this](size_t begin, size_t end) {
+      updateScene(begin, end);
+      m_scene.updateLocalMatrices(begin, end);
+    }, m_sceneJobs);
+  m_jobSystem.runAfter(m_sceneJobs, [this]() {
+    m_scene.resolveWorldMatrices(m_instanceData[m_currentFrameIndex]);
+    if (m_isCpuCulled) {
+      cullScene();
+    }
+  }, &m_frameJobs);
+
+  // Likewise for the slot's lights.
+  if (m_options.lightCount > 0) {
+    m_jobSystem.run([this]() { updateLights(); }, &m_frameJobs);
+  }
+
+  for (View& view : m_views) {
+    // The slot's fence was waited on, so its offscreen image is free.
+    if (m_isOffscreen) {
+      view.imageIndex = static_cast<uint32_t>(m_currentFrameIndex);
+      continue;
+    }
+
+    vkAcquireNextImageKHR(
+      m_device, view.swapChain, UINT64_MAX,
+      view.imageAvailableSemaphores[m_currentFrameIndex], VK_NULL_HANDLE,
+      &view.imageIndex);
+
+    // Check if a previous frame is using this image (i.e. there is its
+    // fence to wait on).
+    VkFence& imageFence = view.imagesInFlight[view.imageIndex];
+    if (imageFence != VK_NULL_HANDLE) {
+      vkWaitForFences(m_device, 1, &imageFence, VK_TRUE, UINT64_MAX);
+    }
+
+    // Mark the image as now being in use by this frame.
+    imageFence = m_inFlightFences[m_currentFrameIndex];
+  }
+
+  VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrameIndex];
+  vkResetCommandBuffer(commandBuffer, 0);
+  recordCommandBuffer(commandBuffer);
+
+  m_jobSystem.wait(m_frameJobs);
+  // Reached zero before the frame jobs that followed them started, and
+  // are reused next frame.
+  m_jobSystem.wait(m_sceneJobs);
+  m_jobSystem.wait(m_cullJobs);
+
+  // Submitted first, since the graphics submission waits on it.
+  if (m_options.particleCapacity > 0) {
+    m_asyncCompute.submit(m_currentFrameIndex,
+                          ParticleSystem::GRAPHICS_WAIT_STAGE);
+    m_metricHandles.computeSubmissions->add();
+  }
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+  // One submission renders every view, and one present shows them all.
+  // Offscreen views are neither acquired nor presented.
+  std::vector<VkSemaphore> waitSemaphores;
+  std::vector<VkPipelineStageFlags> waitStages;
+  std::vector<VkSemaphore> signalSemaphores;
+  std::vector<VkSwapchainKHR> swapChains;
+  std::vector<uint32_t> imageIndices;
+  for (const View& view : m_views) {
+    if (m_isOffscreen) {
+      break;
+    }
+
+    waitSemaphores.push_back(
+      view.imageAvailableSemaphores[m_currentFrameIndex]);
+    waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    signalSemaphores.push_back(
+      view.renderFinishedSemaphores[m_currentFrameIndex]);
+    swapChains.push_back(view.swapChain);
+    imageIndices.push_back(view.imageIndex);
+  }
+
+  VkSemaphore computeSemaphore;
+  VkPipelineStageFlags computeWaitStage;
+  if (m_asyncCompute.getGraphicsWait(m_currentFrameIndex, computeSemaphore,
+                                     computeWaitStage)) {
+    waitSemaphores.push_back(computeSemaphore);
+    waitStages.push_back(computeWaitStage);
+  }
+
+  submitInfo.waitSemaphoreCount = static_cast<uint32_t>(
+    waitSemaphores.size());
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+
+  submitInfo.signalSemaphoreCount = static_cast<uint32_t>(
+    signalSemaphores.size());
+  submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+  vkResetFences(m_device, 1,
+                m_inFlightFences[m_currentFrameIndex].getAddress());
+
+  if (m_graphicsQueue->submit(1, &submitInfo,
+                              m_inFlightFences[m_currentFrameIndex])
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to submit draw command buffer!");
+  }
+  m_metricHandles.graphicsSubmissions->add();
+
+  if (!m_isOffscreen) {
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = static_cast<uint32_t>(
+      signalSemaphores.size());
+    presentInfo.pWaitSemaphores = signalSemaphores.data();
+    presentInfo.swapchainCount = static_cast<uint32_t>(swapChains.size());
+    presentInfo.pSwapchains = swapChains.data();
+    presentInfo.pImageIndices = imageIndices.data();
+    presentInfo.pResults = nullptr;
+
+    m_presentQueue->present(presentInfo);
+    m_metricHandles.presents->add();
+  }
+
+  m_currentFrameIndex = (m_currentFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+  m_frameNumber++;
+}
+
+void RenderSession::createSurfaces(const std::vector<GLFWwindow*>& windows)
+{
+  // An offscreen session has one view, without a window.
+  m_views.resize(std::max<size_t>(windows.size(), 1));
+  for (size_t i = 0; i < windows.size(); i++) {
+    View& view = m_views[i];
+    view.window = windows[i];
+
+    VkSurfaceKHR surface;
+    if (glfwCreateWindowSurface(m_vkInstance, view.window, nullptr,
+                                &surface) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create window surface!");
+    }
+    view.surface = UniqueSurface(m_vkInstance, surface);
+
+    // The present family was picked before the window existed.
+    VkBool32 isSurfaceSupported = false;
+    vkGetPhysicalDeviceSurfaceSupportKHR(
+      m_physicalDevice, m_queueFamilies.m_presentFamily.value(),
+      view.surface, &isSurfaceSupported);
+    if (!isSurfaceSupported) {
+      throw std::runtime_error(
+        "Window surface is not supported by the present queue!");
+    }
+  }
+}
+
+void RenderSession::createSwapChains()
+{
+  for (View& view : m_views) {
+    if (m_isOffscreen) {
+      createOffscreenImages(view);
+    } else {
+      createSwapChain(view);
+    }
+    createImageViews(view);
+  }
+}
+
+void RenderSession::createSwapChain(View& view)
+{
+  SwapChainSupportDetails swapChainSupport = querySwapChainSupport(
+    m_physicalDevice, view.surface);
+  if (swapChainSupport.formats.empty()
+      || swapChainSupport.presentModes.empty()) {
+    throw std::runtime_error("Window surface has no swap chain support!");
+  }
+  VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(
+    swapChainSupport.formats);
+
+  // The first view picks the format of the render pass.
+  if (&view == &m_views[0]) {
+    m_swapChainImageFormat = surfaceFormat.format;
+  } else if (surfaceFormat.format != m_swapChainImageFormat) {
+    throw std::runtime_error("Windows need different swap chain formats!");
+  }
+  VkPresentModeKHR presentMode = chooseSwapPresentMode(
+    swapChainSupport.presentModes);
+  VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
+
+  uint32_t imgCount = swapChainSupport.capabilities.minImageCount + 1;
+
+  if (swapChainSupport.capabilities.maxImageCount > 0
+      && imgCount > swapChainSupport.capabilities.maxImageCount) {
+    imgCount = swapChainSupport.capabilities.maxImageCount;
+  }
+
+  VkSwapchainCreateInfoKHR createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+  createInfo.surface = view.surface;
+  createInfo.minImageCount = imgCount;
+  createInfo.imageFormat = surfaceFormat.format;
+  createInfo.imageColorSpace = surfaceFormat.colorSpace;
+  createInfo.imageExtent = extent;
+  createInfo.imageArrayLayers = 1;
+  createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+  // Needed to read frames back for capture.
+  if (swapChainSupport.capabilities.supportedUsageFlags
+      & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+    createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  } else if (!m_options.captureFileName.empty()) {
+    throw std::runtime_error("Swap chain images cannot be captured!");
+  }
+
+  const QueueFamilyIndices& indices = m_queueFamilies;
+  uint32_t queueFamilyIndices[] = {
+    indices.m_graphicsFamily.value(),
+    indices.m_presentFamily.value()
+  };
+  if (indices.m_graphicsFamily != indices.m_presentFamily) {
+    createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+    createInfo.queueFamilyIndexCount = 2;
+    createInfo.pQueueFamilyIndices = queueFamilyIndices;
+  } else {
+    createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    createInfo.queueFamilyIndexCount = 0;
+    createInfo.pQueueFamilyIndices = nullptr;
+  }
+
+  createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+  createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+  createInfo.presentMode = presentMode;
+  createInfo.clipped = VK_TRUE;
+  createInfo.oldSwapchain = VK_NULL_HANDLE;
+
+  VkSwapchainKHR swapChain;
+  if (vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &swapChain)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create swap chain!");
+  }
+  view.swapChain = UniqueSwapchain(m_device, swapChain);
+
+  vkGetSwapchainImagesKHR(m_device, view.swapChain, &imgCount, nullptr);
+  view.swapChainImages.resize(imgCount);
+  vkGetSwapchainImagesKHR(m_device, view.swapChain, &imgCount,
+                          view.swapChainImages.data());
+
+  view.swapChainExtent = extent;
+}
+
+void RenderSession::createOffscreenImages(View& view)
+{
+  m_swapChainImageFormat = OFFSCREEN_FORMAT;
+  view.swapChainExtent = { HEADLESS_WIDTH, HEADLESS_HEIGHT };
+
+  // Read back by the frame capture.
+  view.offscreenImageMemories.resize(MAX_FRAMES_IN_FLIGHT);
+  view.offscreenImages.resize(MAX_FRAMES_IN_FLIGHT);
+  view.swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    VkImage image;
+    VkDeviceMemory memory;
+    createImage(m_device, m_physicalDevice, view.swapChainExtent,
+                m_swapChainImageFormat,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+                | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+    view.offscreenImageMemories[i] = UniqueDeviceMemory(m_device, memory);
+    view.offscreenImages[i] = UniqueImage(m_device, image);
+    view.swapChainImages[i] = image;
+  }
+}
+
+void RenderSession::createImageViews(View& view)
+{
+  view.swapChainImageViews.resize(view.swapChainImages.size());
+
+  for (size_t i = 0; i < view.swapChainImages.size(); i++) {
+    VkImageViewCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    createInfo.image = view.swapChainImages[i];
+    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    createInfo.format = m_swapChainImageFormat;
+    createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    createInfo.subresourceRange.baseMipLevel = 0;
+    createInfo.subresourceRange.levelCount = 1;
+    createInfo.subresourceRange.baseArrayLayer = 0;
+    createInfo.subresourceRange.layerCount = 1;
+
+    VkImageView imageView;
+    if (vkCreateImageView(m_device, &createInfo, nullptr, &imageView)
+        != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create image views.");
+    }
+    view.swapChainImageViews[i] = UniqueImageView(m_device, imageView);
+  }
+}
+
+void RenderSession::createSceneRenderPass()
+{
+  // Same format as the swap chain, so that upscaling at full resolution
+  // gives the same image as rendering to the swap chain directly.
+  VkAttachmentDescription attachments[2] = {};
+  VkAttachmentDescription& colourAttachment = attachments[0];
+  colourAttachment.format = m_swapChainImageFormat;
+  colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colourAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  // Kept for the depth pyramid, which is built from it.
+  m_depthFormat = findDepthFormat();
+  VkAttachmentDescription& depthAttachment = attachments[1];
+  depthAttachment.format = m_depthFormat;
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkAttachmentReference colourAttachmentRef{};
+  colourAttachmentRef.attachment = 0;
+  colourAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depthAttachmentRef{};
+  depthAttachmentRef.attachment = 1;
+  depthAttachmentRef.layout =
+    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depthReadAttachmentRef{};
+  depthReadAttachmentRef.attachment = 1;
+  depthReadAttachmentRef.layout =
+    VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  // The depth prepass lays down the nearest depth, so that the colour
+  // subpass shades each pixel once, where the depth is equal.
+  VkSubpassDescription subpasses[2] = {};
+  subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
+  subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[1].colorAttachmentCount = 1;
+  subpasses[1].pColorAttachments = &colourAttachmentRef;
+  subpasses[1].pDepthStencilAttachment = &depthReadAttachmentRef;
+
+  VkRenderPassCreateInfo renderPassCreateInfo{};
+  renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassCreateInfo.attachmentCount = 2;
+  renderPassCreateInfo.pAttachments = attachments;
+  renderPassCreateInfo.subpassCount = 2;
+  renderPassCreateInfo.pSubpasses = subpasses;
+
+  // There is one scene image, so the previous frame's upscale must have
+  // read it before it is overwritten. Likewise for the depth and the
+  // previous frame's pyramid build.
+  VkSubpassDependency subpassDependencies[4] = {};
+  subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[0].dstSubpass = 0;
+  subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  subpassDependencies[0].srcAccessMask = 0;
+  subpassDependencies[0].dstStageMask =
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+    | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  subpassDependencies[0].dstAccessMask =
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  subpassDependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[1].dstSubpass = 1;
+  subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  subpassDependencies[1].srcAccessMask = 0;
+  subpassDependencies[1].dstStageMask =
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  subpassDependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+  subpassDependencies[2].srcSubpass = 0;
+  subpassDependencies[2].dstSubpass = 1;
+  subpassDependencies[2].srcStageMask =
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+    | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  subpassDependencies[2].srcAccessMask =
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  subpassDependencies[2].dstStageMask =
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+    | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  subpassDependencies[2].dstAccessMask =
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+  // Makes the rendered image available to the upscale pass, and the depth
+  // to the pyramid build.
+  subpassDependencies[3].srcSubpass = 1;
+  subpassDependencies[3].dstSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[3].srcStageMask =
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+    | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  subpassDependencies[3].srcAccessMask =
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+    | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  subpassDependencies[3].dstStageMask =
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+    | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  subpassDependencies[3].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  renderPassCreateInfo.dependencyCount = 4;
+  renderPassCreateInfo.pDependencies = subpassDependencies;
+
+  VkRenderPass renderPass;
+  if (vkCreateRenderPass(m_device, &renderPassCreateInfo, nullptr,
+                         &renderPass) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create scene render pass!");
+  }
+  m_sceneRenderPass = UniqueRenderPass(m_device, renderPass);
+}
+
+void RenderSession::createRenderPass()
+{
+  // Every pixel is written by the upscale, so nothing needs loading.
+  VkAttachmentDescription colourAttachment{};
+  colourAttachment.format = m_swapChainImageFormat;
+  colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colourAttachment.finalLayout = m_viewLayout;
+
+  VkAttachmentReference colourAttachmentRef{};
+  colourAttachmentRef.attachment = 0;
+  colourAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colourAttachmentRef;
+
+  VkRenderPassCreateInfo renderPassCreateInfo{};
+  renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassCreateInfo.attachmentCount = 1;
+  renderPassCreateInfo.pAttachments = &colourAttachment;
+  renderPassCreateInfo.subpassCount = 1;
+  renderPassCreateInfo.pSubpasses = &subpass;
+
+  VkSubpassDependency subpassDependencies[2] = {};
+  subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[0].dstSubpass = 0;
+  subpassDependencies[0].srcStageMask =
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  subpassDependencies[0].srcAccessMask = 0;
+  subpassDependencies[0].dstStageMask =
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+  // Makes the rendered image available to the frame capture copy.
+  subpassDependencies[1].srcSubpass = 0;
+  subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[1].srcStageMask =
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  subpassDependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  renderPassCreateInfo.dependencyCount = 2;
+  renderPassCreateInfo.pDependencies = subpassDependencies;
+
+  VkRenderPass renderPass;
+  if (vkCreateRenderPass(m_device, &renderPassCreateInfo, nullptr,
+                         &renderPass) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create render pass!");
+  }
+  m_renderPass = UniqueRenderPass(m_device, renderPass);
+}
+
+void RenderSession::createGraphicsPipeline()
+{
+  m_graphicsPipelineKey = createGraphicsPipelineKey();
+  m_pipelineLayout = m_graphicsPipelineKey.layout;
+
+  // Owned by the pipeline cache.
+  m_graphicsPipeline = m_pipelineCache->get(m_graphicsPipelineKey);
+  m_depthPipeline = m_pipelineCache->get(
+    createDepthPipelineKey(m_graphicsPipelineKey));
+}
+
+PipelineStateKey RenderSession::createGraphicsPipelineKey()
+{
+  auto vertShaderCode = readFile(VERTEX_SHADER_FILE_NAME);
+  auto fragShaderCode = readFile(FRAGMENT_SHADER_FILE_NAME);
+
+  ShaderReflection vertShaderReflection = reflectShader(vertShaderCode);
+  ShaderReflection fragShaderReflection = reflectShader(fragShaderCode);
+
+  VkPipelineVertexInputStateCreateInfo vertInputCreateInfo =
+    VertexInputLayout<VertexLayout, InstanceLayout,
+                      InstanceObjectLayout>::createInfo();
+  checkVertexInputLayout(vertShaderReflection, vertInputCreateInfo);
+
+  VkPipelineColorBlendAttachmentState colourBlendAttachment{};
+  colourBlendAttachment.colorWriteMask =
+    VK_COLOR_COMPONENT_R_BIT
+    | VK_COLOR_COMPONENT_G_BIT
+    | VK_COLOR_COMPONENT_B_BIT
+    | VK_COLOR_COMPONENT_A_BIT;
+  colourBlendAttachment.blendEnable = VK_FALSE;
+  colourBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  colourBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+  colourBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colourBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  colourBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  colourBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  // Each set of values yields a separate pipeline, in which the driver
+  // folds away the branches on these constants.
+  SpecializationConstants fragSpecialization;
+  fragSpecialization.set(IS_NORMAL_VIEW_ENABLED, m_options.isNormalViewEnabled);
+  fragSpecialization.set(IS_LIGHTING_ENABLED, m_options.lightCount > 0);
+  fragSpecialization.set(TEXTURE_COUNT,
+                         m_textureStreamer.getTextureCount());
+  fragSpecialization.validate(fragShaderReflection);
+
+  PipelineStateKey key;
+  key.vertexBindings.assign(
+    vertInputCreateInfo.pVertexBindingDescriptions,
+    vertInputCreateInfo.pVertexBindingDescriptions
+      + vertInputCreateInfo.vertexBindingDescriptionCount);
+  key.vertexAttributes.assign(
+    vertInputCreateInfo.pVertexAttributeDescriptions,
+    vertInputCreateInfo.pVertexAttributeDescriptions
+      + vertInputCreateInfo.vertexAttributeDescriptionCount);
+  key.colourBlendAttachments = { colourBlendAttachment };
+  key.renderPass = m_sceneRenderPass;
+  // Shades what the depth prepass found nearest, without writing depth.
+  key.subpass = 1;
+  key.isDepthTestEnabled = true;
+  key.isDepthWriteEnabled = false;
+  key.depthCompareOp = VK_COMPARE_OP_EQUAL;
+
+  // The layout is derived from the shaders and owned by the layout cache.
+  // Set 0 is bound by the lighting, even while it is disabled, and set 1
+  // by the texture streaming, even without textures.
+  const PipelineLayoutInfo& layoutInfo = m_layoutCache->getPipelineLayout(
+    { vertShaderReflection, fragShaderReflection });
+  if (layoutInfo.setLayouts.size() != 2
+      || layoutInfo.setLayouts[0] != m_lighting.getShadingSetLayout()
+      || layoutInfo.setLayouts[1] != m_textureStreamer.getSetLayout()) {
+    throw std::runtime_error(
+      "Scene shaders do not match the lighting and texture descriptor "
+      "sets!");
+  }
+  key.layout = layoutInfo.layout;
+
+  // The modules are part of the key and live as long as pipelines built
+  // from it. They are created last, after the checks that may throw.
+  key.stages = {
+    { VK_SHADER_STAGE_VERTEX_BIT, createShaderModule(vertShaderCode),
+      "main", {} },
+    { VK_SHADER_STAGE_FRAGMENT_BIT, createShaderModule(fragShaderCode),
+      "main", fragSpecialization }
+  };
+
+  return key;
+}
+
+PipelineStateKey RenderSession::createDepthPipelineKey(
+  const PipelineStateKey& graphicsPipelineKey)
+{
+  // The same vertex shader and module, so that positions and thus depths
+  // match those of the colour subpass exactly. The layout is kept, since
+  // it is compatible with the vertex stage alone.
+  PipelineStateKey key = graphicsPipelineKey;
+  key.stages = { graphicsPipelineKey.stages[0] };
+  key.colourBlendAttachments.clear();
+  key.subpass = 0;
+  key.isDepthTestEnabled = true;
+  key.isDepthWriteEnabled = true;
+  key.depthCompareOp = VK_COMPARE_OP_LESS;
+
+  return key;
+}
+
+void RenderSession::createFramebuffers()
+{
+  for (View& view : m_views) {
+    view.swapChainFramebuffers.resize(view.swapChainImageViews.size());
+    for (size_t i = 0; i < view.swapChainImageViews.size(); i++) {
+      VkImageView attachments[] = {
+        view.swapChainImageViews[i]
+      };
+
+      VkFramebufferCreateInfo framebufferCreateInfo{};
+      framebufferCreateInfo.sType =
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+      framebufferCreateInfo.renderPass = m_renderPass;
+      framebufferCreateInfo.attachmentCount = 1;
+      framebufferCreateInfo.pAttachments = attachments;
+      framebufferCreateInfo.width = view.swapChainExtent.width;
+      framebufferCreateInfo.height = view.swapChainExtent.height;
+      framebufferCreateInfo.layers = 1;
+      VkFramebuffer framebuffer;
+      if (vkCreateFramebuffer(m_device, &framebufferCreateInfo, nullptr,
+                              &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create framebuffer!");
+      }
+      view.swapChainFramebuffers[i] = UniqueFramebuffer(m_device,
+                                                        framebuffer);
+    }
+  }
+}
+
+void RenderSession::createUpscaler()
+{
+  // Sized for the largest window. Smaller ones get the same image scaled
+  // down, as they did when each drew the scene at its own size.
+  VkExtent2D extent = { 0, 0 };
+  for (const View& view : m_views) {
+    extent.width = std::max(extent.width, view.swapChainExtent.width);
+    extent.height = std::max(extent.height, view.swapChainExtent.height);
+  }
+  m_upscaler.init(m_device, m_physicalDevice, *m_layoutCache,
+                  *m_pipelineCache, m_sceneRenderPass, m_renderPass,
+                  m_swapChainImageFormat, m_depthFormat, extent);
+  m_renderExtent = extent;
+
+  m_gpuTimer.init(m_device, m_physicalDevice,
+                  m_queueFamilies.m_graphicsFamily.value(),
+                  MAX_FRAMES_IN_FLIGHT);
+  if (m_options.targetFrameRate > 0) {
+    if (!m_gpuTimer.isSupported()) {
+      std::cerr << "No GPU timestamps, rendering at full resolution.\n";
+    }
+    m_resolutionController.init(1.0 / m_options.targetFrameRate,
+                                MIN_RESOLUTION_SCALE);
+  }
+}
+
+void RenderSession::createCommandPool()
+{
+  const QueueFamilyIndices& queueFamilyIndices = m_queueFamilies;
+
+  VkCommandPoolCreateInfo poolCreateInfo{};
+  poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolCreateInfo.queueFamilyIndex = queueFamilyIndices.m_graphicsFamily
+                                                      .value();
+  // Command buffers are re-recorded every frame.
+  poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  VkCommandPool commandPool;
+  if (vkCreateCommandPool(m_device, &poolCreateInfo, nullptr, &commandPool)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create command pool!");
+  }
+  m_commandPool = UniqueCommandPool(m_device, commandPool);
+}
+
+void RenderSession::createVertexBuffer()
+{
+  MeshData mesh;
+  std::vector<Unorm8x4> colours;
+  if (!m_options.meshFileName.empty()) {
+    mesh = readMesh(m_options.meshFileName);
+    if (mesh.vertices.empty() || mesh.indices.empty()) {
+      throw std::runtime_error("Mesh " + m_options.meshFileName
+                               + " is empty!");
+    }
+    normaliseMesh(mesh);
+    colours.assign(mesh.vertices.size(), packUnorm8x4(1.f, 1.f, 1.f, 1.f));
+  } else {
+    const float positions[3][2] = {
+      {  0.f, -0.5f },
+      { 0.5f,  0.5f },
+      { -0.5f, 0.5f }
+    };
+    const float triangleColours[3][3] = {
+      { 1.f, 0.f, 0.f },
+      { 0.f, 1.f, 0.f },
+      { 0.f, 0.f, 1.f }
+    };
+    const float uvs[3][2] = {
+      { 0.5f, 0.f },
+      { 1.f, 1.f },
+      { 0.f, 1.f }
+    };
+
+    mesh.vertices.resize(3);
+    for (uint32_t i = 0; i < 3; i++) {
+      mesh.vertices[i] = MeshVertex{
+        { positions[i][0], positions[i][1], 0.f },
+        { 0.f, 0.f, -1.f },
+        { uvs[i][0], uvs[i][1] }
+      };
+      mesh.indices.push_back(i);
+      colours.push_back(packUnorm8x4(triangleColours[i][0],
+                                     triangleColours[i][1],
+                                     triangleColours[i][2], 1.f));
+    }
+  }
+
+  std::vector<Vertex> vertices(mesh.vertices.size());
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const MeshVertex& vertex = mesh.vertices[i];
+    vertices[i].position = packHalf4(vertex.position[0], vertex.position[1],
+                                     vertex.position[2]);
+    vertices[i].normal = encodeOctahedral(vertex.normal[0], vertex.normal[1],
+                                          vertex.normal[2]);
+    vertices[i].uv = packUnorm16x2(vertex.uv[0], vertex.uv[1]);
+    vertices[i].colour = colours[i];
+  }
+  m_indexCount = static_cast<uint32_t>(mesh.indices.size());
+  computeMeshBounds(mesh, m_meshBounds);
+
+  uploadDeviceBuffer(vertices.data(), sizeof(vertices[0]) * vertices.size(),
+                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, m_vertexBuffer,
+                     m_vertexBufferMemory);
+  uploadDeviceBuffer(mesh.indices.data(),
+                     sizeof(mesh.indices[0]) * mesh.indices.size(),
+                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT, m_indexBuffer,
+                     m_indexBufferMemory);
+}
+
+void RenderSession::uploadDeviceBuffer(const void* contents,
+                                       VkDeviceSize bufferSize,
+                                       VkBufferUsageFlags usage,
+                                       UniqueBuffer& deviceBuffer,
+                                       UniqueDeviceMemory& deviceMemory)
+{
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  createBuffer(m_device, m_physicalDevice, bufferSize,
+               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+               | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               buffer, memory);
+  // Freed when going out of scope, buffer first.
+  UniqueDeviceMemory stagingBufferMemory(m_device, memory);
+  UniqueBuffer stagingBuffer(m_device, buffer);
+
+  void* data;
+  vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
+  memcpy(data, contents, (size_t) bufferSize);
+  vkUnmapMemory(m_device, stagingBufferMemory);
+
+  createBuffer(m_device, m_physicalDevice, bufferSize,
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+               buffer, memory);
+  deviceMemory = UniqueDeviceMemory(m_device, memory);
+  deviceBuffer = UniqueBuffer(m_device, buffer);
+
+  copyBuffer(m_device, m_commandPool, *m_graphicsQueue, stagingBuffer,
+             deviceBuffer, bufferSize);
+}
+
+void RenderSession::createScene()
+{
+  // The root keeps the identity transform, so that it draws the triangle
+  // as before, and the extra objects are smaller copies circling it.
+  m_scene.reserve(size_t(1) + m_options.extraObjectCount);
+  uint32_t root = m_scene.createObject();
+  for (uint32_t i = 0; i < m_options.extraObjectCount; i++) {
+    uint32_t object = m_scene.createObject(root);
+    m_scene.setScale(object, 0.1f, 0.1f, 0.1f);
+  }
+
+  // Beyond the size of the depth pyramid, the GPU culling is unavailable.
+  VkExtent2D sceneExtent = m_upscaler.getSceneExtent();
+  m_isCpuCulled = m_options.isCpuCullingEnabled
+                  || sceneExtent.width > OcclusionCulling::MAX_DEPTH_SIZE
+                  || sceneExtent.height > OcclusionCulling::MAX_DEPTH_SIZE;
+  if (m_isCpuCulled) {
+    m_cullBounds.resize(m_scene.getObjectCount());
+    m_batchDrawLists.resize(
+      (m_scene.getObjectCount() + SCENE_BATCH_SIZE - 1) / SCENE_BATCH_SIZE);
+    // The scene has no camera, so the view is the clip volume.
+    Mat4 identity{};
+    identity.m[0] = identity.m[5] = identity.m[10] = identity.m[15] = 1.f;
+    m_clipFrustum = extractFrustum(identity);
+  }
+}
+
+void RenderSession::createInstanceBuffers()
+{
+  VkDeviceSize bufferSize = sizeof(Instance) * m_scene.getObjectCount();
+
+  m_instanceBufferMemories.resize(MAX_FRAMES_IN_FLIGHT);
+  m_instanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+  m_instanceData.resize(MAX_FRAMES_IN_FLIGHT);
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    // Read by the occlusion culling, which copies the visible instances
+    // to the buffer that is drawn.
+    createBuffer(m_device, m_physicalDevice, bufferSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                 | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffer, memory);
+    m_instanceBufferMemories[i] = UniqueDeviceMemory(m_device, memory);
+    m_instanceBuffers[i] = UniqueBuffer(m_device, buffer);
+
+    // Stays mapped until the memory is freed. Mapped memory is aligned to
+    // at least 64 bytes, as streaming stores of matrices require.
+    void* data;
+    vkMapMemory(m_device, memory, 0, bufferSize, 0, &data);
+    m_instanceData[i] = static_cast<Mat4*>(data);
+  }
+}
+
+void RenderSession::createOcclusionCulling()
+{
+  std::vector<VkBuffer> instanceBuffers(m_instanceBuffers.begin(),
+                                        m_instanceBuffers.end());
+  m_occlusionCulling.init(m_device, m_physicalDevice, *m_layoutCache,
+                          *m_pipelineCache, m_upscaler.getSceneDepthView(),
+                          m_upscaler.getSceneExtent(), instanceBuffers,
+                          static_cast<uint32_t>(m_scene.getObjectCount()),
+                          m_indexCount, m_meshBounds,
+                          m_isCpuCulled);
+}
+
+void RenderSession::createTextures()
+{
+  // Objects cycle through the textures by index, and the feedback comes
+  // from the instances that pass the culling.
+  m_textureStreamer.init(m_device, m_physicalDevice, *m_layoutCache,
+                         *m_pipelineCache, m_deletionQueue, m_commandPool,
+                         *m_graphicsQueue, m_options.textureFileNames,
+                         m_options.textureBudget,
+                         MAX_FRAMES_IN_FLIGHT, m_occlusionCulling,
+                         static_cast<uint32_t>(m_scene.getObjectCount()),
+                         m_meshBounds[3]);
+}
+
+void RenderSession::updateScene(size_t begin, size_t end)
+{
+  // Animated by frame number rather than time, so that captured frames
+  // are reproducible. Each object is at its own depth behind the root, so
+  // that overlaps do not depend on the order of the culled draws, and
+  // every other one circles close enough to be hidden by it. The root,
+  // object 0, stays still.
+  float time = static_cast<float>(m_frameNumber) * 0.01f;
+  for (size_t index = std::max<size_t>(begin, 1); index < end; index++) {
+    uint32_t object = static_cast<uint32_t>(index);
+    uint32_t i = object - 1;
+    float radius = i % 2 == 0 ? 0.75f : 0.15f;
+    float angle = time + 6.2831853f * i / m_options.extraObjectCount;
+    float depth = 0.5f + 0.4f * (i + 1) / m_options.extraObjectCount;
+    m_scene.setPosition(object, radius * std::cos(angle),
+                        radius * std::sin(angle), depth);
+    m_scene.setRotation(object, 0.f, 0.f, std::sin(angle),
+                        std::cos(angle));
+  }
+}
+
+void RenderSession::cullScene()
+{
+  // Each batch bounds and culls its objects into its own draw list, and
+  // the lists are joined in batch order, so that the objects stay sorted.
+  m_jobSystem.parallelFor(
+    m_cullBounds.count, SCENE_BATCH_SIZE,
+    [this](size_t begin, size_t end) {
+      cullObjects(begin, end, m_batchDrawLists[begin / SCENE_BATCH_SIZE]);
+    }, m_cullJobs);
+  m_jobSystem.runAfter(m_cullJobs, [this]() {
+    std::vector<uint32_t>& visibleObjects = m_drawList.objects[0];
+    visibleObjects.clear();
+    for (const DrawList& drawList : m_batchDrawLists) {
+      visibleObjects.insert(visibleObjects.end(),
+                            drawList.objects[0].begin(),
+                            drawList.objects[0].end());
+    }
+
+    m_occlusionCulling.writeVisible(m_currentFrameIndex, visibleObjects,
+                                    &m_scene.getWorldMatrix(0));
+  }, &m_frameJobs);
+}
+
+void RenderSession::cullObjects(size_t begin, size_t end, DrawList& drawList)
+{
+  // Each object's bounding sphere is the mesh's, moved by its world matrix
+  // and scaled by its largest axis scale, as in the GPU culling.
+  const float* bounds = m_meshBounds;
+  for (size_t i = begin; i < end; i++) {
+    const float* m = m_scene.getWorldMatrix(static_cast<uint32_t>(i)).m;
+    m_cullBounds.x[i] = m[0] * bounds[0] + m[4] * bounds[1]
+                        + m[8] * bounds[2] + m[12];
+    m_cullBounds.y[i] = m[1] * bounds[0] + m[5] * bounds[1]
+                        + m[9] * bounds[2] + m[13];
+    m_cullBounds.z[i] = m[2] * bounds[0] + m[6] * bounds[1]
+                        + m[10] * bounds[2] + m[14];
+    float scaleSquared = std::max(
+      std::max(m[0] * m[0] + m[1] * m[1] + m[2] * m[2],
+               m[4] * m[4] + m[5] * m[5] + m[6] * m[6]),
+      m[8] * m[8] + m[9] * m[9] + m[10] * m[10]);
+    m_cullBounds.radius[i] = bounds[3] * std::sqrt(scaleSquared);
+  }
+
+  // The mesh has a single LOD.
+  LodSelection lodSelection{};
+  lodSelection.lodCount = 1;
+  cullSpheres(m_cullBounds, begin, end, m_clipFrustum, lodSelection,
+              drawList);
+}
+
+void RenderSession::updateLights()
+{
+  // Spread over the scene on a golden angle spiral, circling it just in
+  // front, with colours around the hue circle. The radius shrinks as the
+  // count grows, so that clusters hold a similar number of lights.
+  const float twoPi = 6.2831853f;
+  float lightRadius = std::min(
+    4.f / std::sqrt(float(m_options.lightCount)), 0.5f);
+  float time = static_cast<float>(m_frameNumber) * 0.01f;
+  Light* lights = m_lighting.getLights(m_currentFrameIndex);
+  for (uint32_t i = 0; i < m_options.lightCount; i++) {
+    float t = (i + 0.5f) / m_options.lightCount;
+    float distance = 0.95f * std::sqrt(t);
+    float angle = 2.3999632f * i + time * (0.5f + 0.1f * (i % 7));
+
+    Light& light = lights[i];
+    light.position[0] = distance * std::cos(angle);
+    light.position[1] = distance * std::sin(angle);
+    light.position[2] = -0.05f;
+    light.radius = lightRadius;
+    light.colour[0] = 0.5f + 0.5f * std::cos(twoPi * t);
+    light.colour[1] = 0.5f + 0.5f * std::cos(twoPi * (t - 1.f / 3.f));
+    light.colour[2] = 0.5f + 0.5f * std::cos(twoPi * (t - 2.f / 3.f));
+    light.intensity = 1.f;
+  }
+}
+
+void RenderSession::createCommandBuffers()
+{
+  // One per frame in flight, recorded each frame, so that they always bind
+  // the current pipelines.
+  m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = m_commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = (uint32_t) m_commandBuffers.size();
+  if (vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data())
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate command buffers!");
+  }
+}
+
+void RenderSession::recordCommandBuffer(VkCommandBuffer commandBuffer)
+{
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = nullptr;
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin recording command buffer!");
+  }
+  m_gpuTimer.recordStart(commandBuffer, m_currentFrameIndex);
+
+  m_textureStreamer.recordUpdates(commandBuffer, m_currentFrameIndex,
+                                  m_frameNumber);
+  if (m_options.lightCount > 0) {
+    m_lighting.recordBinning(commandBuffer, m_currentFrameIndex,
+                             m_options.lightCount);
+  }
+  if (!m_isCpuCulled) {
+    m_occlusionCulling.recordCull(
+      commandBuffer, m_currentFrameIndex,
+      static_cast<uint32_t>(m_scene.getObjectCount()));
+  }
+  m_textureStreamer.recordFeedback(commandBuffer, m_currentFrameIndex,
+                                   m_renderExtent);
+
+  // The scene is rendered once, and upscaled into every view. Its depth is
+  // reduced for the next frame's culling on the GPU.
+  recordScene(commandBuffer);
+  if (!m_isCpuCulled) {
+    m_occlusionCulling.recordPyramidBuild(commandBuffer, m_renderExtent);
+  }
+  for (const View& view : m_views) {
+    recordView(commandBuffer, view);
+  }
+
+  if (!m_options.captureFileName.empty()) {
+    const View& view = m_views[0];
+    m_frameCapture.recordCopy(commandBuffer,
+                              view.swapChainImages[view.imageIndex],
+                              m_viewLayout, m_frameNumber);
+  }
+
+  m_gpuTimer.recordEnd(commandBuffer, m_currentFrameIndex);
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record command buffer!");
+  }
+}
+
+void RenderSession::recordScene(VkCommandBuffer commandBuffer)
+{
+  // Only the part of the scene image at the current resolution is drawn.
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = m_sceneRenderPass;
+  renderPassInfo.framebuffer = m_upscaler.getSceneFramebuffer();
+  renderPassInfo.renderArea.offset = { 0, 0 };
+  renderPassInfo.renderArea.extent = m_renderExtent;
+
+  VkClearValue clearValues[2] = {};
+  clearValues[0].color = { { 0.f, 0.f, 0.f, 1.f } };
+  clearValues[1].depthStencil = { 1.f, 0 };
+  renderPassInfo.clearValueCount = 2;
+  renderPassInfo.pClearValues = clearValues;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                       VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport{};
+  viewport.x = 0.f;
+  viewport.y = 0.f;
+  viewport.width = (float) m_renderExtent.width;
+  viewport.height = (float) m_renderExtent.height;
+  viewport.minDepth = 0.f;
+  viewport.maxDepth = 1.f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = { 0, 0 };
+  scissor.extent = m_renderExtent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  // Both subpasses draw the instances that passed the culling.
+  VkBuffer vertexBuffers[] = {
+    m_vertexBuffer,
+    m_occlusionCulling.getVisibleInstanceBuffer(m_currentFrameIndex),
+    m_occlusionCulling.getVisibleObjectBuffer(m_currentFrameIndex)
+  };
+  VkDeviceSize offsets[] = { 0, 0, 0 };
+  vkCmdBindVertexBuffers(commandBuffer, 0, 3, vertexBuffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0,
+                       VK_INDEX_TYPE_UINT32);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    m_depthPipeline);
+  m_occlusionCulling.recordDraw(commandBuffer, m_currentFrameIndex);
+
+  vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    m_graphicsPipeline);
+  m_lighting.bind(commandBuffer, m_pipelineLayout, m_currentFrameIndex);
+  m_textureStreamer.bind(commandBuffer, m_pipelineLayout,
+                         m_currentFrameIndex);
+  m_occlusionCulling.recordDraw(commandBuffer, m_currentFrameIndex);
+
+  if (m_options.particleCapacity > 0) {
+    m_particleSystem.recordDraw(commandBuffer);
+  }
+
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+void RenderSession::recordView(VkCommandBuffer commandBuffer,
+                               const View& view)
+{
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = m_renderPass;
+  renderPassInfo.framebuffer = view.swapChainFramebuffers[view.imageIndex];
+  renderPassInfo.renderArea.offset = { 0, 0 };
+  renderPassInfo.renderArea.extent = view.swapChainExtent;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                       VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport{};
+  viewport.x = 0.f;
+  viewport.y = 0.f;
+  viewport.width = (float) view.swapChainExtent.width;
+  viewport.height = (float) view.swapChainExtent.height;
+  viewport.minDepth = 0.f;
+  viewport.maxDepth = 1.f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = { 0, 0 };
+  scissor.extent = view.swapChainExtent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  m_upscaler.recordDraw(commandBuffer, m_renderExtent);
+
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+void RenderSession::reloadShaders()
+{
+  if (!m_options.isShaderHotReloadEnabled) {
+    return;
+  }
+
+  if (m_isPipelinePending) {
+    // The depth prepass pipeline uses the same modules, and is compiled
+    // once the graphics one is, so that neither is still compiling when
+    // the other fails.
+    PipelineStateKey pendingDepthKey =
+      createDepthPipelineKey(m_pendingPipelineKey);
+    VkPipeline pipeline;
+    VkPipeline depthPipeline = VK_NULL_HANDLE;
+    try {
+      pipeline = m_pipelineCache->getAsync(m_pendingPipelineKey,
+                                          VK_NULL_HANDLE);
+      if (pipeline != VK_NULL_HANDLE) {
+        depthPipeline = m_pipelineCache->getAsync(pendingDepthKey,
+                                                 VK_NULL_HANDLE);
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Failed to rebuild graphics pipeline: " << e.what()
+                << "\n";
+      m_deletionQueue.retire(
+        UniquePipeline(m_device, m_pipelineCache->evict(m_pendingPipelineKey)),
+        m_frameNumber);
+      m_pipelineCache->evict(pendingDepthKey);
+      retireShaderModules(m_pendingPipelineKey);
+      m_isPipelinePending = false;
+      return;
+    }
+
+    if (depthPipeline == VK_NULL_HANDLE) {
+      return;
+    }
+
+    // Frames in flight may still use the old pipelines, so they are only
+    // retired here.
+    m_pipelineCache->evict(m_graphicsPipelineKey);
+    m_pipelineCache->evict(createDepthPipelineKey(m_graphicsPipelineKey));
+    m_deletionQueue.retire(UniquePipeline(m_device, m_graphicsPipeline),
+                           m_frameNumber);
+    m_deletionQueue.retire(UniquePipeline(m_device, m_depthPipeline),
+                           m_frameNumber);
+    retireShaderModules(m_graphicsPipelineKey);
+
+    m_graphicsPipelineKey = m_pendingPipelineKey;
+    m_graphicsPipeline = pipeline;
+    m_depthPipeline = depthPipeline;
+    m_pipelineLayout = m_graphicsPipelineKey.layout;
+    m_isPipelinePending = false;
+
+    return;
+  }
+
+  // Shaders recompiled while a rebuild is pending are picked up after it.
+  std::vector<std::string> compiledShaders =
+    m_shaderWatcher.takeCompiledShaders();
+  bool isPipelineAffected = std::any_of(
+    compiledShaders.begin(), compiledShaders.end(),
+    [](const std::string& path) {
+      return path == VERTEX_SHADER_FILE_NAME
+             || path == FRAGMENT_SHADER_FILE_NAME;
+    });
+  if (!isPipelineAffected) {
+    return;
+  }
+
+  try {
+    m_pendingPipelineKey = createGraphicsPipelineKey();
+  } catch (const std::exception& e) {
+    std::cerr << "Failed to reload shaders: " << e.what() << "\n";
+    return;
+  }
+
+  // Compiled on the pipeline cache's thread; the old pipelines keep being
+  // used until then.
+  m_pipelineCache->getAsync(m_pendingPipelineKey, m_graphicsPipeline);
+  m_isPipelinePending = true;
+}
+
+void RenderSession::retireShaderModules(const PipelineStateKey& key)
+{
+  for (const ShaderStageKey& stage : key.stages) {
+    m_deletionQueue.retire(UniqueShaderModule(m_device, stage.module),
+                           m_frameNumber);
+  }
+}
+
+void RenderSession::createSyncObjects()
+{
+  m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+
+  VkSemaphoreCreateInfo semaphoreCreateInfo{};
+  semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  VkFenceCreateInfo fenceCreateInfo{};
+  fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  // Offscreen views are neither acquired nor presented, so they need no
+  // semaphores, and their images are used by one frame slot each.
+  for (View& view : m_views) {
+    if (m_isOffscreen) {
+      break;
+    }
+
+    view.imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    view.renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    view.imagesInFlight.resize(view.swapChainImages.size(), VK_NULL_HANDLE);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+      VkSemaphore imageAvailableSemaphore;
+      VkSemaphore renderFinishedSemaphore;
+      if (vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr,
+                            &imageAvailableSemaphore) != VK_SUCCESS) {
+        throw std::runtime_error(
+          "Failed to create sychronization objects for a frame!");
+      }
+      view.imageAvailableSemaphores[i] = UniqueSemaphore(
+        m_device, imageAvailableSemaphore);
+
+      if (vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr,
+                            &renderFinishedSemaphore) != VK_SUCCESS) {
+        throw std::runtime_error(
+          "Failed to create sychronization objects for a frame!");
+      }
+      view.renderFinishedSemaphores[i] = UniqueSemaphore(
+        m_device, renderFinishedSemaphore);
+    }
+  }
+
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    VkFence inFlightFence;
+    if (vkCreateFence(m_device, &fenceCreateInfo, nullptr, &inFlightFence)
+        != VK_SUCCESS) {
+      throw std::runtime_error(
+        "Failed to create sychronization objects for a frame!");
+    }
+    m_inFlightFences[i] = UniqueFence(m_device, inFlightFence);
+  }
+}
+
+void RenderSession::createMetrics(MetricsRegistry& metrics,
+                                  const MetricLabels& labels)
+{
+  // Seconds, from well above 1000 FPS to a one second stall.
+  const std::vector<double> frameTimeBounds = {
+    0.001, 0.002, 0.004, 0.008, 0.0167, 0.0333, 0.05, 0.1, 0.25, 0.5, 1.0
+  };
+  MetricLabels graphicsLabels = labels;
+  graphicsLabels["queue"] = "graphics";
+  MetricLabels computeLabels = labels;
+  computeLabels["queue"] = "compute";
+
+  MetricHandles& handles = m_metricHandles;
+  handles.frames = &metrics.addCounter(
+    "vk_app_frames_total", "Frames submitted.", labels);
+  handles.frameIntervals = &metrics.addHistogram(
+    "vk_app_frame_interval_seconds",
+    "Time between the starts of consecutive frames.", frameTimeBounds,
+    labels);
+  handles.frameCpuTimes = &metrics.addHistogram(
+    "vk_app_frame_cpu_seconds",
+    "CPU time spent in drawFrame(), including waits on fences.",
+    frameTimeBounds, labels);
+  handles.graphicsSubmissions = &metrics.addCounter(
+    "vk_app_queue_submissions_total", "Calls to vkQueueSubmit().",
+    graphicsLabels);
+  handles.computeSubmissions = &metrics.addCounter(
+    "vk_app_queue_submissions_total", "Calls to vkQueueSubmit().",
+    computeLabels);
+  handles.presents = &metrics.addCounter(
+    "vk_app_queue_presents_total", "Calls to vkQueuePresentKHR().",
+    labels);
+  handles.droppedCaptureFrames = &metrics.addCounter(
+    "vk_app_capture_dropped_frames_total",
+    "Captured frames dropped because the writer fell behind.", labels);
+  handles.frameGpuTimes = &metrics.addHistogram(
+    "vk_app_frame_gpu_seconds",
+    "GPU time of the frame's graphics command buffer.", frameTimeBounds,
+    labels);
+  handles.resolutionScale = &metrics.addGauge(
+    "vk_app_resolution_scale",
+    "Scale of the scene's render resolution, set by dynamic resolution.",
+    labels);
+  handles.textureResidentSize = &metrics.addGauge(
+    "vk_app_texture_resident_bytes",
+    "Texel data of the streamed textures resident on the GPU.", labels);
+}
+
+void RenderSession::updateMetrics()
+{
+  MetricHandles& handles = m_metricHandles;
+  handles.frames->update(m_frameNumber);
+  handles.textureResidentSize->set(
+    static_cast<double>(m_textureStreamer.getResidentSize()));
+
+  if (!m_options.captureFileName.empty()) {
+    handles.droppedCaptureFrames->update(
+      m_frameCapture.getDroppedFrameCount());
+  }
+}
+
+SwapChainSupportDetails RenderSession::querySwapChainSupport(
+  VkPhysicalDevice device,
+  VkSurfaceKHR surface)
+{
+  SwapChainSupportDetails details;
+  
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface,
+                                            &details.capabilities);
+
+  uint32_t formatCount;
+  vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount,
+                                        nullptr);
+  if (formatCount != 0) {
+    details.formats.resize(formatCount);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount,
+                                          details.formats.data());
+  }
+
+  uint32_t presentModeCount;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface,
+                                            &presentModeCount,
+                                            nullptr);
+  if (presentModeCount != 0) {
+    details.presentModes.resize(presentModeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface,
+                                              &presentModeCount,
+                                              details.presentModes.data());
+  }
+
+  return details;
+}
+
+VkSurfaceFormatKHR RenderSession::chooseSwapSurfaceFormat(
+  const std::vector<VkSurfaceFormatKHR>& availableFormats)
+{
+  for (const auto& availableFormat : availableFormats) {
+    if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB
+        && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+      return availableFormat;
+    }
+  }
+
+  return availableFormats[0];
+}
+
+VkPresentModeKHR RenderSession::chooseSwapPresentMode(
+  const std::vector<VkPresentModeKHR>& availablePresentModes)
+{
+  // Replays run as fast as they are drawn, so they do not wait for
+  // vertical blanks where tearing is allowed.
+  if (!m_options.replayFileName.empty()) {
+    for (const auto& availablePresentMode : availablePresentModes) {
+      if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+        return availablePresentMode;
+      }
+    }
+  }
+
+  for (const auto& availablePresentMode : availablePresentModes) {
+    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+      return availablePresentMode;
+    }
+  }
+
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+VkExtent2D RenderSession::chooseSwapExtent(
+  const VkSurfaceCapabilitiesKHR& capabilities)
+{
+  if (capabilities.currentExtent.width != UINT32_MAX) {
+    return capabilities.currentExtent;
+  } else {
+    VkExtent2D actualExtent = { WINDOW_WIDTH, WINDOW_HEIGHT };
+    actualExtent.width = std::max(
+      capabilities.minImageExtent.width,
+      std::min(capabilities.maxImageExtent.width, actualExtent.width));
+    actualExtent.height = std::max(
+      capabilities.minImageExtent.height,
+      std::min(capabilities.maxImageExtent.height, actualExtent.height));
+
+    return actualExtent;
+  }
+}
+
+VkFormat RenderSession::findDepthFormat()
+{
+  // Sampled as well, by the depth pyramid build.
+  const VkFormat candidates[] = {
+    VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM
+  };
+  const VkFormatFeatureFlags features =
+    VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+    | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+  for (VkFormat format : candidates) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format,
+                                        &properties);
+    if ((properties.optimalTilingFeatures & features) == features) {
+      return format;
+    }
+  }
+
+  throw std::runtime_error("Failed to find a sampled depth format!");
+}
+
+VkShaderModule RenderSession::createShaderModule(
+  const std::vector<char>& code)
+{
+  return ::createShaderModule(m_device, code);
+}
+
+void RenderSession::checkVertexInputLayout(
+  const ShaderReflection& vertShaderReflection,
+  const VkPipelineVertexInputStateCreateInfo& vertInputCreateInfo)
+{
+  for (const auto& input : vertShaderReflection.vertexInputs) {
+    bool isAttributeFound = false;
+    for (uint32_t i = 0;
+         i < vertInputCreateInfo.vertexAttributeDescriptionCount;
+         i++) {
+      if (vertInputCreateInfo.pVertexAttributeDescriptions[i].location
+          == input.location) {
+        isAttributeFound = true;
+        break;
+      }
+    }
+
+    if (!isAttributeFound) {
+      throw std::runtime_error("Vertex shader input \"" + input.name
+                               + "\" has no matching vertex attribute!");
+    }
+  }
+}
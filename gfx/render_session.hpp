@@ -0,0 +1,237 @@
+#ifndef RENDER_SESSION_HPP
+#define RENDER_SESSION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../ds/DrawList.hpp"
+#include "../ds/FrameInput.hpp"
+#include "../ds/Frustum.hpp"
+#include "../ds/PipelineStateKey.hpp"
+#include "../ds/SessionOptions.hpp"
+#include "../ds/SwapChainSupportDetails.hpp"
+#include "../ds/View.hpp"
+#include "../scene/culling.hpp"
+#include "../scene/scene.hpp"
+#include "../utils/frame_trace.hpp"
+#include "../utils/glfw.hpp"
+#include "../utils/job_system.hpp"
+#include "../utils/mailbox.hpp"
+#include "../utils/metrics.hpp"
+#include "../utils/spirv.hpp"
+#include "../utils/submit_queue.hpp"
+#include "async_compute.hpp"
+#include "clustered_lighting.hpp"
+#include "deletion_queue.hpp"
+#include "device_context.hpp"
+#include "frame_capture.hpp"
+#include "frame_stats.hpp"
+#include "gpu_timer.hpp"
+#include "handles.hpp"
+#include "layout_cache.hpp"
+#include "occlusion_culling.hpp"
+#include "particle_system.hpp"
+#include "pipeline_cache.hpp"
+#include "resolution_controller.hpp"
+#include "shader_watcher.hpp"
+#include "texture_streamer.hpp"
+#include "upscaler.hpp"
+
+// Everything one stream of frames needs on top of the shared device: its
+// targets, render passes, command buffers and sync objects, scene and
+// subsystems, and the pipelines it looks up in the shared cache. Sessions
+// on the same device are independent, so each can draw on its own thread.
+class RenderSession
+{
+public:
+  // Presents to the windows, or renders offscreen at HEADLESS_WIDTH by
+  // HEADLESS_HEIGHT if there are none. Metrics are registered with the
+  // labels, which tell the series of sessions sharing a registry apart.
+  void init(DeviceContext& context,
+            const SessionOptions& options,
+            const std::vector<GLFWwindow*>& windows,
+            MetricsRegistry& metrics,
+            const MetricLabels& labels);
+  // The session's frames must have finished, i.e. run() has returned.
+  void destroy();
+
+  // Draws frames until stop is requested, the frame limit is reached or
+  // the replayed frames run out, and waits for them to finish. Windowed
+  // sessions take their input from the mailbox, and offscreen ones from
+  // their own clock. The calling thread becomes worker 0 of the session's
+  // jobs. If it throws, the session's work has still finished, so it can
+  // be destroyed.
+  void run(const std::atomic<bool>& isStopRequested,
+           Mailbox<FrameInput>* inputMailbox,
+           FrameStats& frameStats);
+
+private:
+  void waitForSubmittedFrames();
+  void drawFrame(const FrameInput& input);
+
+  void createSurfaces(const std::vector<GLFWwindow*>& windows);
+  void createSwapChains();
+  void createSwapChain(View& view);
+  void createOffscreenImages(View& view);
+  void createImageViews(View& view);
+  void createSceneRenderPass();
+  void createRenderPass();
+  void createGraphicsPipeline();
+  void createFramebuffers();
+  void createUpscaler();
+  void createCommandPool();
+  void createVertexBuffer();
+  // Creates a device local buffer of the given usage holding the contents.
+  void uploadDeviceBuffer(const void* contents,
+                          VkDeviceSize bufferSize,
+                          VkBufferUsageFlags usage,
+                          UniqueBuffer& deviceBuffer,
+                          UniqueDeviceMemory& deviceMemory);
+  void createScene();
+  void createInstanceBuffers();
+  void createOcclusionCulling();
+  void createTextures();
+  void createCommandBuffers();
+  void createSyncObjects();
+  void createMetrics(MetricsRegistry& metrics, const MetricLabels& labels);
+  void updateMetrics();
+
+  PipelineStateKey createGraphicsPipelineKey();
+  PipelineStateKey createDepthPipelineKey(
+    const PipelineStateKey& graphicsPipelineKey);
+  // Animates the objects in [begin, end).
+  void updateScene(size_t begin, size_t end);
+  void cullScene();
+  void cullObjects(size_t begin, size_t end, DrawList& drawList);
+  void updateLights();
+  void recordCommandBuffer(VkCommandBuffer commandBuffer);
+  void recordScene(VkCommandBuffer commandBuffer);
+  void recordView(VkCommandBuffer commandBuffer, const View& view);
+  void reloadShaders();
+  void retireShaderModules(const PipelineStateKey& key);
+
+  SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device,
+                                                VkSurfaceKHR surface);
+  VkSurfaceFormatKHR chooseSwapSurfaceFormat(
+    const std::vector<VkSurfaceFormatKHR>& availableFormats);
+  VkPresentModeKHR chooseSwapPresentMode(
+    const std::vector<VkPresentModeKHR>& availablePresentModes);
+  VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+  VkFormat findDepthFormat();
+  VkShaderModule createShaderModule(const std::vector<char>& code);
+  void checkVertexInputLayout(
+    const ShaderReflection& vertShaderReflection,
+    const VkPipelineVertexInputStateCreateInfo& vertInputCreateInfo);
+
+  SessionOptions m_options;
+  // Shared with the other sessions.
+  VkInstance m_vkInstance = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  VkDevice m_device = VK_NULL_HANDLE;
+  QueueFamilyIndices m_queueFamilies;
+  SubmitQueue* m_graphicsQueue = nullptr;
+  // Null for an offscreen session.
+  SubmitQueue* m_presentQueue = nullptr;
+  SubmitQueue* m_computeQueue = nullptr;
+  LayoutCache* m_layoutCache = nullptr;
+  PipelineCache* m_pipelineCache = nullptr;
+
+  bool m_isOffscreen = false;
+  // Layout the views' images are left in by the render pass.
+  VkImageLayout m_viewLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  JobSystem m_jobSystem;
+  // Fence for the jobs of the current frame, which must finish before it
+  // is submitted.
+  JobCounter m_frameJobs;
+  // The batches of the scene update and of the CPU culling, which are
+  // followed by a frame job each.
+  JobCounter m_sceneJobs;
+  JobCounter m_cullJobs;
+  std::vector<FrameTraceRecord> m_replayFrames;
+  // Registered by createMetrics() and owned by the registry.
+  struct MetricHandles
+  {
+    Counter* frames;
+    Histogram* frameIntervals;
+    Histogram* frameCpuTimes;
+    Counter* graphicsSubmissions;
+    Counter* computeSubmissions;
+    Counter* presents;
+    Counter* droppedCaptureFrames;
+    Histogram* frameGpuTimes;
+    Gauge* resolutionScale;
+    Gauge* textureResidentSize;
+  } m_metricHandles;
+  // Start of the previous frame, for the frame interval metric.
+  std::chrono::steady_clock::time_point m_lastFrameStartTime;
+  // Owning members are destroyed in reverse order of declaration, so each
+  // one must be declared after the objects it depends on.
+  DeletionQueue m_deletionQueue;
+  // Shared by all views, since they use the same render pass.
+  VkFormat m_swapChainImageFormat;
+  VkFormat m_depthFormat;
+  // Renders the scene into the upscaler's image.
+  UniqueRenderPass m_sceneRenderPass;
+  // Upscales the scene into a view's image.
+  UniqueRenderPass m_renderPass;
+  // The first view is the one captured.
+  std::vector<View> m_views;
+  ClusteredLighting m_lighting;
+  ShaderWatcher m_shaderWatcher;
+  PipelineStateKey m_graphicsPipelineKey;
+  VkPipelineLayout m_pipelineLayout;
+  // Looked up in the shared pipeline cache, and taken out of it again when
+  // the session is destroyed.
+  VkPipeline m_graphicsPipeline;
+  // Depth prepass with the vertex shader of the graphics pipeline, built
+  // from its key.
+  VkPipeline m_depthPipeline;
+  PipelineStateKey m_pendingPipelineKey;
+  bool m_isPipelinePending = false;
+  UniqueCommandPool m_commandPool;
+  AsyncCompute m_asyncCompute;
+  ParticleSystem m_particleSystem;
+  // Input time of the previous frame, in seconds.
+  double m_lastFrameTime = 0.0;
+  UniqueDeviceMemory m_vertexBufferMemory;
+  UniqueBuffer m_vertexBuffer;
+  UniqueDeviceMemory m_indexBufferMemory;
+  UniqueBuffer m_indexBuffer;
+  uint32_t m_indexCount;
+  // Bounding sphere of the mesh, centre and radius.
+  float m_meshBounds[4];
+  Scene m_scene;
+  // One per frame in flight, persistently mapped, so that the transforms
+  // of a frame are written while earlier frames still read theirs.
+  std::vector<UniqueDeviceMemory> m_instanceBufferMemories;
+  std::vector<UniqueBuffer> m_instanceBuffers;
+  std::vector<Mat4*> m_instanceData;
+  // Whether the objects are culled on the CPU, if selected or if the GPU
+  // culling is unavailable. If so, the bounds of the objects, updated each
+  // frame, and the visible ones, per batch and in total.
+  bool m_isCpuCulled = false;
+  SphereBounds m_cullBounds;
+  Frustum m_clipFrustum;
+  std::vector<DrawList> m_batchDrawLists;
+  DrawList m_drawList;
+  std::vector<VkCommandBuffer> m_commandBuffers;
+  std::vector<UniqueFence> m_inFlightFences;
+  FrameCapture m_frameCapture;
+  FrameTraceWriter m_traceWriter;
+  Upscaler m_upscaler;
+  GpuTimer m_gpuTimer;
+  ResolutionController m_resolutionController;
+  OcclusionCulling m_occlusionCulling;
+  TextureStreamer m_textureStreamer;
+  // Part of the upscaler's image the scene is rendered to this frame.
+  VkExtent2D m_renderExtent;
+  size_t m_currentFrameIndex = 0;
+  uint64_t m_frameNumber = 0;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cmath>
+
+#include "resolution_controller.hpp"
+
+void ResolutionController::init(double frameBudget, float minScale)
+{
+  m_frameBudget = frameBudget;
+  m_minScale = minScale;
+  m_scale = 1.f;
+  m_hasAverage = false;
+  m_framesOver = 0;
+  m_framesUnder = 0;
+}
+
+float ResolutionController::update(double gpuTime)
+{
+  if (m_hasAverage) {
+    m_averageTime += SMOOTHING * (gpuTime - m_averageTime);
+  } else {
+    m_averageTime = gpuTime;
+    m_hasAverage = true;
+  }
+
+  m_framesOver = m_averageTime > UPPER_THRESHOLD * m_frameBudget
+                 ? m_framesOver + 1 : 0;
+  m_framesUnder = m_averageTime < LOWER_THRESHOLD * m_frameBudget
+                  ? m_framesUnder + 1 : 0;
+
+  // The scale that would bring the average to the target.
+  float targetScale = m_scale * static_cast<float>(
+    std::sqrt(TARGET * m_frameBudget / std::max(m_averageTime, 1e-6)));
+
+  if (m_framesOver >= DECREASE_DELAY) {
+    setScale(targetScale);
+  } else if (m_framesUnder >= INCREASE_DELAY && m_scale < 1.f) {
+    setScale(std::min(targetScale, m_scale + MAX_INCREASE));
+  }
+
+  return m_scale;
+}
+
+float ResolutionController::getScale() const
+{
+  return m_scale;
+}
+
+void ResolutionController::setScale(float scale)
+{
+  scale = std::floor(scale / SCALE_STEP) * SCALE_STEP;
+  scale = std::clamp(scale, m_minScale, 1.f);
+  if (scale == m_scale) {
+    return;
+  }
+
+  // Frames in flight were rendered at the old scale, so the average is
+  // moved to what it would be at the new one, and the delays start over.
+  double ratio = static_cast<double>(scale) / m_scale;
+  m_averageTime *= ratio * ratio;
+  m_scale = scale;
+  m_framesOver = 0;
+  m_framesUnder = 0;
+}
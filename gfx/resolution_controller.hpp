@@ -0,0 +1,51 @@
+#ifndef RESOLUTION_CONTROLLER_HPP
+#define RESOLUTION_CONTROLLER_HPP
+
+#include <cstdint>
+
+// Picks the scale of the render resolution from measured GPU frame times,
+// so that frames stay within a time budget. GPU time is assumed to grow
+// with the pixel count, i.e. the square of the scale.
+//
+// The scale only changes when the smoothed time has been outside a band
+// around the budget for a number of frames, so that noise and the latency
+// of the measurements do not make it oscillate. It drops quickly when over
+// budget, since that costs frames, and rises slowly.
+class ResolutionController
+{
+public:
+  void init(double frameBudget, float minScale);
+
+  // Feeds the GPU time of a finished frame, in seconds, and returns the
+  // scale for the next frame.
+  float update(double gpuTime);
+
+  float getScale() const;
+
+private:
+  // Weight of a new frame time in the moving average.
+  static constexpr double SMOOTHING = 0.1;
+  // The band of the budget within which the scale is kept.
+  static constexpr double UPPER_THRESHOLD = 0.95;
+  static constexpr double LOWER_THRESHOLD = 0.75;
+  // Fraction of the budget a change of scale aims for.
+  static constexpr double TARGET = 0.85;
+  // Frames outside the band before the scale goes down or up.
+  static constexpr uint32_t DECREASE_DELAY = 3;
+  static constexpr uint32_t INCREASE_DELAY = 30;
+  static constexpr float MAX_INCREASE = 0.1f;
+  // Scales are multiples of this, so that small changes are ignored.
+  static constexpr float SCALE_STEP = 1.f / 32.f;
+
+  void setScale(float scale);
+
+  double m_frameBudget = 0.0;
+  float m_minScale = 1.f;
+  float m_scale = 1.f;
+  double m_averageTime = 0.0;
+  bool m_hasAverage = false;
+  uint32_t m_framesOver = 0;
+  uint32_t m_framesUnder = 0;
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "shader_watcher.hpp"
+
+static const char* const SHADER_EXTENSIONS[] = {
+  ".vert", ".frag", ".comp", ".geom", ".tesc", ".tese"
+};
+static constexpr const char* INCLUDE_EXTENSION = ".glsl";
+
+// A source passes extra flags to glslc on lines starting with this, which
+// compile_shaders.sh reads too.
+static constexpr const char* FLAGS_PREFIX = "// glslc: ";
+static constexpr const char* INCLUDE_PREFIX = "#include \"";
+
+// How long the watch thread sleeps between checks for shutdown.
+static constexpr int POLL_TIMEOUT_MS = 100;
+
+// Editors often save a file in several steps (truncate, write, rename), so
+// events are gathered until none arrive for this long before compiling.
+static constexpr int DEBOUNCE_TIMEOUT_MS = 50;
+
+static bool hasExtension(const std::string& fileName, const char* extension)
+{
+  size_t length = std::strlen(extension);
+
+  return fileName.size() > length
+         && fileName.compare(fileName.size() - length, length, extension)
+            == 0;
+}
+
+static bool isShaderSource(const std::string& fileName)
+{
+  for (const char* extension : SHADER_EXTENSIONS) {
+    if (hasExtension(fileName, extension)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool isShaderInclude(const std::string& fileName)
+{
+  return hasExtension(fileName, INCLUDE_EXTENSION);
+}
+
+static bool startsWith(const std::string& line, const char* prefix)
+{
+  return line.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+// Returns the files named by the #include directives of a shader file, or
+// none if it can't be read.
+static std::vector<std::string> readIncludes(const std::string& path)
+{
+  std::vector<std::string> includes;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    line.erase(0, line.find_first_not_of(" \t"));
+    if (startsWith(line, INCLUDE_PREFIX)) {
+      size_t start = std::strlen(INCLUDE_PREFIX);
+      size_t end = line.find('"', start);
+      if (end != std::string::npos) {
+        includes.push_back(line.substr(start, end - start));
+      }
+    }
+  }
+
+  return includes;
+}
+
+// Returns the glslc flags given by a shader source, separated by spaces.
+static std::string readFlags(const std::string& path)
+{
+  std::string flags;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (startsWith(line, FLAGS_PREFIX)) {
+      flags += " " + line.substr(std::strlen(FLAGS_PREFIX));
+    }
+  }
+
+  return flags;
+}
+
+void ShaderWatcher::init(const std::string& shaderDir)
+{
+  m_shaderDir = shaderDir;
+
+  m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_inotifyFd < 0) {
+    throw std::runtime_error("Failed to initialise inotify!");
+  }
+
+  // The directory is watched rather than the files themselves, since
+  // editors that save by renaming would otherwise leave a stale watch.
+  if (inotify_add_watch(m_inotifyFd, shaderDir.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(m_inotifyFd);
+    throw std::runtime_error("Failed to watch the shader directory!");
+  }
+
+  m_isShuttingDown = false;
+  m_watchThread = std::thread(&ShaderWatcher::runWatchThread, this);
+}
+
+void ShaderWatcher::destroy()
+{
+  m_isShuttingDown = true;
+  if (m_watchThread.joinable()) {
+    m_watchThread.join();
+  }
+
+  if (m_inotifyFd >= 0) {
+    close(m_inotifyFd);
+    m_inotifyFd = -1;
+  }
+}
+
+std::vector<std::string> ShaderWatcher::takeCompiledShaders()
+{
+  std::lock_guard<std::mutex> lock(m_compiledMutex);
+  std::vector<std::string> compiledShaders;
+  compiledShaders.swap(m_compiledShaders);
+
+  return compiledShaders;
+}
+
+void ShaderWatcher::runWatchThread()
+{
+  alignas(inotify_event) char buffer[4096];
+  std::set<std::string> changedFiles;
+
+  pollfd pollFd{};
+  pollFd.fd = m_inotifyFd;
+  pollFd.events = POLLIN;
+
+  while (!m_isShuttingDown) {
+    int timeout = changedFiles.empty()
+                  ? POLL_TIMEOUT_MS : DEBOUNCE_TIMEOUT_MS;
+    int result = poll(&pollFd, 1, timeout);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      std::cerr << "Shader watcher stopped: " << std::strerror(errno)
+                << "\n";
+      return;
+    }
+
+    if (result == 0) {
+      if (!changedFiles.empty()) {
+        compileShaders(getAffectedSources(changedFiles));
+        changedFiles.clear();
+      }
+      continue;
+    }
+
+    ssize_t length;
+    while ((length = read(m_inotifyFd, buffer, sizeof(buffer))) > 0) {
+      char* ptr = buffer;
+      while (ptr < buffer + length) {
+        const inotify_event* event = reinterpret_cast<inotify_event*>(ptr);
+        if (event->len > 0
+            && (isShaderSource(event->name)
+                || isShaderInclude(event->name))) {
+          changedFiles.insert(event->name);
+        }
+        ptr += sizeof(inotify_event) + event->len;
+      }
+    }
+  }
+}
+
+std::set<std::string> ShaderWatcher::getAffectedSources(
+  const std::set<std::string>& changedFiles)
+{
+  std::set<std::string> sourceNames;
+  std::set<std::string> includeNames;
+  for (const std::string& fileName : changedFiles) {
+    if (isShaderSource(fileName)) {
+      sourceNames.insert(fileName);
+    } else {
+      includeNames.insert(fileName);
+    }
+  }
+
+  if (includeNames.empty()) {
+    return sourceNames;
+  }
+
+  DIR* dir = opendir(m_shaderDir.c_str());
+  if (dir == nullptr) {
+    std::cerr << "Failed to list " << m_shaderDir << "\n";
+    return sourceNames;
+  }
+
+  while (const dirent* entry = readdir(dir)) {
+    std::set<std::string> visitedIncludes;
+    if (isShaderSource(entry->d_name)
+        && includesAny(entry->d_name, includeNames, visitedIncludes)) {
+      sourceNames.insert(entry->d_name);
+    }
+  }
+  closedir(dir);
+
+  return sourceNames;
+}
+
+bool ShaderWatcher::includesAny(const std::string& fileName,
+                                const std::set<std::string>& includeNames,
+                                std::set<std::string>& visitedIncludes)
+{
+  for (const std::string& include :
+       readIncludes(m_shaderDir + "/" + fileName)) {
+    if (includeNames.count(include) > 0) {
+      return true;
+    }
+
+    // Include guards allow cycles, which are followed once.
+    if (visitedIncludes.insert(include).second
+        && includesAny(include, includeNames, visitedIncludes)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ShaderWatcher::compileShaders(const std::set<std::string>& sourceNames)
+{
+  for (const std::string& sourceName : sourceNames) {
+    std::string sourcePath = m_shaderDir + "/" + sourceName;
+    std::string spirvPath = sourcePath + ".spv";
+
+    // glslc writes to a temporary file first, so that the app never reads
+    // a partially written or failed module.
+    std::string tempPath = spirvPath + ".tmp";
+    std::string command = "glslc" + readFlags(sourcePath) + " \""
+                          + sourcePath + "\" -o \"" + tempPath + "\"";
+    if (std::system(command.c_str()) != 0) {
+      std::cerr << "Failed to compile " << sourcePath << "\n";
+      unlink(tempPath.c_str());
+      continue;
+    }
+
+    if (rename(tempPath.c_str(), spirvPath.c_str()) != 0) {
+      std::cerr << "Failed to replace " << spirvPath << "\n";
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lock(m_compiledMutex);
+    m_compiledShaders.push_back(spirvPath);
+  }
+}
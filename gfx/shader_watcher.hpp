@@ -0,0 +1,44 @@
+#ifndef SHADER_WATCHER_HPP
+#define SHADER_WATCHER_HPP
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches a directory of GLSL sources with inotify and recompiles changed
+// shaders to SPIR-V with glslc on a background thread. A source such as
+// "vertex.vert" is compiled to "vertex.vert.spv" next to it, with the flags
+// it gives on "// glslc: " lines, as in compile_shaders.sh. A change to an
+// included ".glsl" file recompiles the sources that include it.
+class ShaderWatcher
+{
+public:
+  void init(const std::string& shaderDir);
+  void destroy();
+
+  // Returns the paths of the SPIR-V files rewritten since the last call.
+  // Shaders that failed to compile are reported on stderr and left out.
+  std::vector<std::string> takeCompiledShaders();
+
+private:
+  void runWatchThread();
+  std::set<std::string> getAffectedSources(
+    const std::set<std::string>& changedFiles);
+  bool includesAny(const std::string& fileName,
+                   const std::set<std::string>& includeNames,
+                   std::set<std::string>& visitedIncludes);
+  void compileShaders(const std::set<std::string>& sourceNames);
+
+  std::string m_shaderDir;
+  int m_inotifyFd = -1;
+  std::thread m_watchThread;
+  std::atomic<bool> m_isShuttingDown{ false };
+
+  std::mutex m_compiledMutex;
+  std::vector<std::string> m_compiledShaders;
+};
+
+#endif
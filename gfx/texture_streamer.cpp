@@ -0,0 +1,913 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../constants.hpp"
+#include "../utils/specialization.hpp"
+#include "../utils/vk.hpp"
+#include "texture_streamer.hpp"
+
+namespace
+{
+// Matches the local sizes of shaders/texture_feedback.comp and
+// shaders/mip_generate.comp.
+constexpr uint32_t FEEDBACK_GROUP_SIZE = 64;
+constexpr uint32_t MIP_GROUP_SIZE = 8;
+
+// Levels up to this size stay resident, so that a texture coming into view
+// has something to show while its larger levels load.
+constexpr uint32_t TAIL_SIZE = 64;
+// Textures gaining levels in a frame, which bounds the uploads recorded
+// into it. Dropping levels only copies, and is not limited.
+constexpr uint32_t MAX_UPLOADS_PER_FRAME = 4;
+// Alignment of levels in staging buffers, a multiple of every block size.
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+// Matches the push constant block of shaders/texture_feedback.comp.
+struct FeedbackPushConstants
+{
+  float diameter;
+  float viewSize;
+  uint32_t textureCount;
+};
+
+VkDeviceSize alignToStaging(VkDeviceSize offset)
+{
+  return (offset + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+}
+
+VkExtent3D getLevelExtent(VkExtent2D extent, uint32_t level)
+{
+  return { getMipLevelSize(extent.width, level),
+           getMipLevelSize(extent.height, level), 1 };
+}
+}
+
+void TextureStreamer::init(VkDevice device,
+                           VkPhysicalDevice physicalDevice,
+                           LayoutCache& layoutCache,
+                           PipelineCache& pipelineCache,
+                           DeletionQueue& deletionQueue,
+                           VkCommandPool commandPool,
+                           SubmitQueue& queue,
+                           const std::vector<std::string>& fileNames,
+                           VkDeviceSize budget,
+                           uint32_t frameCount,
+                           const OcclusionCulling& culling,
+                           uint32_t instanceCapacity,
+                           float boundsRadius)
+{
+  if (fileNames.size() > MAX_TEXTURES) {
+    throw std::runtime_error("Too many textures!");
+  }
+
+  m_device = device;
+  m_physicalDevice = physicalDevice;
+  m_layoutCache = &layoutCache;
+  m_pipelineCache = &pipelineCache;
+  m_deletionQueue = &deletionQueue;
+  m_commandPool = commandPool;
+  m_queue = &queue;
+  m_budget = budget;
+  m_instanceCapacity = instanceCapacity;
+  m_boundsRadius = boundsRadius;
+  m_frames.resize(frameCount);
+
+  // Declared the same way as the reflected set of the fragment shader, so
+  // that the layout cache returns the same layout for both.
+  VkDescriptorSetLayoutBinding binding{};
+  binding.binding = 0;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  binding.descriptorCount = MAX_TEXTURES;
+  binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  binding.pImmutableSamplers = nullptr;
+  m_setLayout = m_layoutCache->getDescriptorSetLayout({ binding });
+
+  // Only mapped here. Levels are read as they are uploaded, except those
+  // that are generated.
+  m_textures.reserve(fileNames.size());
+  for (const std::string& fileName : fileNames) {
+    try {
+      m_textures.emplace_back(fileName);
+    } catch (const std::exception& e) {
+      throw std::runtime_error("Failed to load texture " + fileName + ": "
+                               + e.what());
+    }
+
+    Texture& texture = m_textures.back();
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice,
+                                        texture.file.getFormat(),
+                                        &properties);
+    if (!(properties.optimalTilingFeatures
+          & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+      throw std::runtime_error("Texture format of " + fileName
+                               + " is not supported by the device!");
+    }
+
+    VkExtent2D extent = texture.file.getExtent();
+    texture.levelCount = getMipLevelCount(extent.width, extent.height);
+    texture.firstResidentLevel = texture.levelCount;
+    if (texture.file.getLevelCount() < texture.levelCount) {
+      generateLevels(texture);
+    }
+  }
+
+  createSampler();
+  createPlaceholder();
+  createDescriptorPool();
+  if (!m_textures.empty()) {
+    createFeedbackPipeline();
+  }
+  createFrames(culling);
+}
+
+void TextureStreamer::destroy()
+{
+  // The layouts belong to the layout cache. Descriptor sets are freed with
+  // the pool.
+  m_feedbackPipeline.reset();
+  m_descriptorPool.reset();
+  m_frames.clear();
+  m_textures.clear();
+  m_placeholderView.reset();
+  m_placeholderImage.reset();
+  m_placeholderMemory.reset();
+  m_sampler.reset();
+}
+
+VkDescriptorSetLayout TextureStreamer::getSetLayout() const
+{
+  return m_setLayout;
+}
+
+uint32_t TextureStreamer::getTextureCount() const
+{
+  return static_cast<uint32_t>(m_textures.size());
+}
+
+VkDeviceSize TextureStreamer::getResidentSize() const
+{
+  VkDeviceSize size = 0;
+  for (const Texture& texture : m_textures) {
+    size += getLevelsSize(texture, texture.firstResidentLevel);
+  }
+
+  return size;
+}
+
+void TextureStreamer::recordUpdates(VkCommandBuffer commandBuffer,
+                                    size_t frameIndex,
+                                    uint64_t frameNumber)
+{
+  Frame& frame = m_frames[frameIndex];
+
+  if (!m_textures.empty()) {
+    // Levels are dropped first, which makes room for those loaded.
+    std::vector<uint32_t> levels = selectLevels(frame);
+    for (size_t i = 0; i < m_textures.size(); i++) {
+      if (levels[i] > m_textures[i].firstResidentLevel) {
+        recordLevelChange(commandBuffer, m_textures[i], levels[i],
+                          frameNumber);
+      }
+    }
+
+    uint32_t uploadCount = 0;
+    for (size_t i = 0; i < m_textures.size(); i++) {
+      if (levels[i] < m_textures[i].firstResidentLevel
+          && uploadCount < MAX_UPLOADS_PER_FRAME) {
+        recordLevelChange(commandBuffer, m_textures[i], levels[i],
+                          frameNumber);
+        uploadCount++;
+      }
+    }
+  }
+
+  // The slot's previous frame has finished, so its set can be rewritten.
+  writeTextureSet(frame);
+}
+
+void TextureStreamer::recordFeedback(VkCommandBuffer commandBuffer,
+                                     size_t frameIndex,
+                                     VkExtent2D renderExtent) const
+{
+  if (m_textures.empty()) {
+    return;
+  }
+
+  const Frame& frame = m_frames[frameIndex];
+  vkCmdFillBuffer(commandBuffer, frame.feedbackBuffer, 0, VK_WHOLE_SIZE, 0);
+
+  // The feedback was just zeroed, and the cull wrote the visible
+  // instances.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT
+                          | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+                          | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT
+                       | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  FeedbackPushConstants pushConstants{};
+  pushConstants.diameter = 2.f * m_boundsRadius;
+  pushConstants.viewSize = static_cast<float>(
+    std::max(renderExtent.width, renderExtent.height));
+  pushConstants.textureCount = getTextureCount();
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_feedbackPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_feedbackPipelineLayout, 0, 1,
+                          &frame.feedbackSet, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, m_feedbackPipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants),
+                     &pushConstants);
+  vkCmdDispatch(commandBuffer,
+                (m_instanceCapacity + FEEDBACK_GROUP_SIZE - 1)
+                / FEEDBACK_GROUP_SIZE, 1, 1);
+
+  // Read by recordUpdates() once the frame has finished.
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+}
+
+void TextureStreamer::bind(VkCommandBuffer commandBuffer,
+                           VkPipelineLayout pipelineLayout,
+                           size_t frameIndex) const
+{
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout, 1, 1,
+                          &m_frames[frameIndex].textureSet, 0, nullptr);
+}
+
+void TextureStreamer::createSampler()
+{
+  // Trilinear, over however many levels are resident.
+  VkSamplerCreateInfo samplerCreateInfo{};
+  samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  VkSampler sampler;
+  if (vkCreateSampler(m_device, &samplerCreateInfo, nullptr, &sampler)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture sampler!");
+  }
+  m_sampler = UniqueSampler(m_device, sampler);
+}
+
+void TextureStreamer::createPlaceholder()
+{
+  VkImage image;
+  VkDeviceMemory memory;
+  createImage(m_device, m_physicalDevice, { 1, 1 },
+              VK_FORMAT_R8G8B8A8_UNORM,
+              VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+  m_placeholderMemory = UniqueDeviceMemory(m_device, memory);
+  m_placeholderImage = UniqueImage(m_device, image);
+  m_placeholderView = createImageView(m_placeholderImage,
+                                      VK_FORMAT_R8G8B8A8_UNORM, 0, 1);
+
+  // White, so that it leaves the colours it is multiplied with unchanged.
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(m_device,
+                                                          m_commandPool);
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = m_placeholderImage;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  VkClearColorValue white = { { 1.f, 1.f, 1.f, 1.f } };
+  vkCmdClearColorImage(commandBuffer, m_placeholderImage,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1,
+                       &barrier.subresourceRange);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                       0, nullptr, 1, &barrier);
+
+  endSingleTimeCommands(m_device, m_commandPool, *m_queue, commandBuffer);
+}
+
+void TextureStreamer::createDescriptorPool()
+{
+  // A texture set and a feedback set per frame, with the visible
+  // instances, the visible objects, the draw command and the feedback.
+  uint32_t frameCount = static_cast<uint32_t>(m_frames.size());
+
+  VkDescriptorPoolSize poolSizes[2] = {};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = MAX_TEXTURES * frameCount;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[1].descriptorCount = 4 * frameCount;
+
+  VkDescriptorPoolCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  createInfo.maxSets = 2 * frameCount;
+  createInfo.poolSizeCount = 2;
+  createInfo.pPoolSizes = poolSizes;
+
+  VkDescriptorPool descriptorPool;
+  if (vkCreateDescriptorPool(m_device, &createInfo, nullptr, &descriptorPool)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture descriptor pool!");
+  }
+  m_descriptorPool = UniqueDescriptorPool(m_device, descriptorPool);
+}
+
+void TextureStreamer::createFeedbackPipeline()
+{
+  ComputePipelineInfo info = m_pipelineCache->createComputePipeline(
+    *m_layoutCache, TEXTURE_FEEDBACK_SHADER_FILE_NAME);
+  m_feedbackPipeline = UniquePipeline(m_device, info.pipeline);
+  m_feedbackPipelineLayout = info.layoutInfo->layout;
+  m_feedbackSetLayout = info.layoutInfo->setLayouts[0];
+}
+
+void TextureStreamer::createFrames(const OcclusionCulling& culling)
+{
+  VkDeviceSize feedbackSize = MAX_TEXTURES * sizeof(uint32_t);
+  for (size_t i = 0; i < m_frames.size(); i++) {
+    Frame& frame = m_frames[i];
+
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    createBuffer(m_device, m_physicalDevice, feedbackSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                 | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                 | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffer, memory);
+    frame.feedbackMemory = UniqueDeviceMemory(m_device, memory);
+    frame.feedbackBuffer = UniqueBuffer(m_device, buffer);
+
+    // Stays mapped until the memory is freed. Zero until the slot's first
+    // frame measures the textures, which keeps them at their smallest.
+    void* data;
+    vkMapMemory(m_device, memory, 0, feedbackSize, 0, &data);
+    std::memset(data, 0, feedbackSize);
+    frame.feedback = static_cast<const uint32_t*>(data);
+
+    frame.textureSet = allocateDescriptorSet(m_device, m_descriptorPool,
+                                            m_setLayout);
+    frame.views.assign(MAX_TEXTURES, VK_NULL_HANDLE);
+    writeTextureSet(frame);
+
+    if (m_textures.empty()) {
+      continue;
+    }
+
+    frame.feedbackSet = allocateDescriptorSet(m_device, m_descriptorPool,
+                                             m_feedbackSetLayout);
+
+    VkDescriptorBufferInfo bufferInfos[4] = {
+      { culling.getVisibleInstanceBuffer(i), 0, VK_WHOLE_SIZE },
+      { culling.getVisibleObjectBuffer(i), 0, VK_WHOLE_SIZE },
+      { culling.getDrawCommandBuffer(i), 0, VK_WHOLE_SIZE },
+      { frame.feedbackBuffer, 0, VK_WHOLE_SIZE }
+    };
+
+    VkWriteDescriptorSet writes[4] = {};
+    for (uint32_t j = 0; j < 4; j++) {
+      writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[j].dstSet = frame.feedbackSet;
+      writes[j].dstBinding = j;
+      writes[j].descriptorCount = 1;
+      writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      writes[j].pBufferInfo = &bufferInfos[j];
+    }
+
+    vkUpdateDescriptorSets(m_device, 4, writes, 0, nullptr);
+  }
+}
+
+void TextureStreamer::generateLevels(Texture& texture)
+{
+  // The levels past those stored are box filtered from the last stored
+  // one, by a dispatch per level reading the level above, and then read
+  // back, so that they stream like stored levels afterwards. sRGB levels
+  // are filtered in an 8-bit UNORM image, which can be written as a
+  // storage image, and converted by the shader.
+  VkFormat format = texture.file.getFormat();
+  uint32_t sourceLevel = texture.file.getLevelCount() - 1;
+  uint32_t levelCount = texture.levelCount - sourceLevel;
+  VkExtent2D extent = texture.file.getExtent();
+  VkExtent2D sourceExtent = { getMipLevelSize(extent.width, sourceLevel),
+                              getMipLevelSize(extent.height, sourceLevel) };
+
+  VkImage image;
+  VkDeviceMemory memory;
+  createImage(m_device, m_physicalDevice, sourceExtent,
+              VK_FORMAT_R8G8B8A8_UNORM,
+              VK_IMAGE_USAGE_STORAGE_BIT
+              | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+              | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory,
+              levelCount);
+  UniqueDeviceMemory imageMemory(m_device, memory);
+  UniqueImage levelImage(m_device, image);
+
+  std::vector<UniqueImageView> views;
+  for (uint32_t i = 0; i < levelCount; i++) {
+    views.push_back(createImageView(levelImage, VK_FORMAT_R8G8B8A8_UNORM,
+                                    i, 1));
+  }
+
+  // Uploads the source level, and then holds the generated ones.
+  std::vector<VkDeviceSize> offsets(levelCount, 0);
+  VkDeviceSize generatedSize = 0;
+  for (uint32_t i = 1; i < levelCount; i++) {
+    offsets[i] = generatedSize;
+    VkExtent3D levelExtent = getLevelExtent(sourceExtent, i);
+    generatedSize = alignToStaging(
+      generatedSize + getTextureLevelByteCount(format, levelExtent.width,
+                                               levelExtent.height));
+  }
+  VkDeviceSize sourceSize = texture.file.getLevelByteCount(sourceLevel);
+
+  VkBuffer buffer;
+  createBuffer(m_device, m_physicalDevice,
+               std::max(sourceSize, generatedSize),
+               VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+               | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+               | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               buffer, memory);
+  UniqueDeviceMemory stagingMemory(m_device, memory);
+  UniqueBuffer stagingBuffer(m_device, buffer);
+
+  void* data;
+  vkMapMemory(m_device, stagingMemory, 0, VK_WHOLE_SIZE, 0, &data);
+  std::memcpy(data, texture.file.getLevelData(sourceLevel), sourceSize);
+
+  // The pipeline and its sets are only needed here.
+  SpecializationConstants specialization;
+  specialization.set(IS_SRGB, format == VK_FORMAT_R8G8B8A8_SRGB);
+  ComputePipelineInfo mipPipelineInfo =
+    m_pipelineCache->createComputePipeline(
+      *m_layoutCache, MIP_GENERATE_SHADER_FILE_NAME, specialization);
+  UniquePipeline mipPipeline(m_device, mipPipelineInfo.pipeline);
+  const PipelineLayoutInfo& layoutInfo = *mipPipelineInfo.layoutInfo;
+
+  VkDescriptorPoolSize poolSize{};
+  poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSize.descriptorCount = 2 * (levelCount - 1);
+
+  VkDescriptorPoolCreateInfo poolCreateInfo{};
+  poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolCreateInfo.maxSets = levelCount - 1;
+  poolCreateInfo.poolSizeCount = 1;
+  poolCreateInfo.pPoolSizes = &poolSize;
+
+  VkDescriptorPool descriptorPool;
+  if (vkCreateDescriptorPool(m_device, &poolCreateInfo, nullptr,
+                             &descriptorPool) != VK_SUCCESS) {
+    throw std::runtime_error(
+      "Failed to create mip generation descriptor pool!");
+  }
+  UniqueDescriptorPool mipDescriptorPool(m_device, descriptorPool);
+
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(m_device,
+                                                          m_commandPool);
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = levelImage;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  VkBufferImageCopy upload{};
+  upload.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+  upload.imageExtent = getLevelExtent(sourceExtent, 0);
+  vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, levelImage,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &upload);
+
+  // Every level is read and written in the general layout.
+  VkImageMemoryBarrier levelBarriers[2] = { barrier, barrier };
+  levelBarriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  levelBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  levelBarriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  levelBarriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  levelBarriers[1].srcAccessMask = 0;
+  levelBarriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  levelBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  levelBarriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  levelBarriers[1].subresourceRange.baseMipLevel = 1;
+  levelBarriers[1].subresourceRange.levelCount = levelCount - 1;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                       0, nullptr, 2, levelBarriers);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    mipPipeline);
+  for (uint32_t i = 1; i < levelCount; i++) {
+    VkDescriptorSet descriptorSet = allocateDescriptorSet(
+      m_device, mipDescriptorPool, layoutInfo.setLayouts[0]);
+
+    VkDescriptorImageInfo imageInfos[2] = {
+      { VK_NULL_HANDLE, views[i - 1], VK_IMAGE_LAYOUT_GENERAL },
+      { VK_NULL_HANDLE, views[i], VK_IMAGE_LAYOUT_GENERAL }
+    };
+
+    VkWriteDescriptorSet writes[2] = {};
+    for (uint32_t j = 0; j < 2; j++) {
+      writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[j].dstSet = descriptorSet;
+      writes[j].dstBinding = j;
+      writes[j].descriptorCount = 1;
+      writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      writes[j].pImageInfo = &imageInfos[j];
+    }
+    vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            layoutInfo.layout, 0, 1, &descriptorSet, 0,
+                            nullptr);
+    VkExtent3D levelExtent = getLevelExtent(sourceExtent, i);
+    vkCmdDispatch(commandBuffer,
+                  (levelExtent.width + MIP_GROUP_SIZE - 1) / MIP_GROUP_SIZE,
+                  (levelExtent.height + MIP_GROUP_SIZE - 1) / MIP_GROUP_SIZE,
+                  1);
+
+    // The level is the source of the next one.
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &memoryBarrier, 0, nullptr, 0, nullptr);
+  }
+
+  levelBarriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  levelBarriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  levelBarriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  levelBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &levelBarriers[1]);
+
+  std::vector<VkBufferImageCopy> readbacks(levelCount - 1);
+  for (uint32_t i = 1; i < levelCount; i++) {
+    VkBufferImageCopy& readback = readbacks[i - 1];
+    readback.bufferOffset = offsets[i];
+    readback.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+    readback.imageExtent = getLevelExtent(sourceExtent, i);
+  }
+  vkCmdCopyImageToBuffer(commandBuffer, levelImage,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer,
+                         static_cast<uint32_t>(readbacks.size()),
+                         readbacks.data());
+
+  VkMemoryBarrier hostBarrier{};
+  hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0,
+                       nullptr, 0, nullptr);
+
+  endSingleTimeCommands(m_device, m_commandPool, *m_queue, commandBuffer);
+
+  const uint8_t* generated = static_cast<const uint8_t*>(data);
+  texture.generatedLevels.resize(levelCount - 1);
+  for (uint32_t i = 1; i < levelCount; i++) {
+    VkExtent3D levelExtent = getLevelExtent(sourceExtent, i);
+    std::vector<uint8_t>& level = texture.generatedLevels[i - 1];
+    level.resize(getTextureLevelByteCount(format, levelExtent.width,
+                                          levelExtent.height));
+    std::memcpy(level.data(), generated + offsets[i], level.size());
+  }
+  vkUnmapMemory(m_device, stagingMemory);
+}
+
+std::vector<uint32_t> TextureStreamer::selectLevels(const Frame& frame) const
+{
+  // Every texture starts at its smallest levels. Visible ones then gain a
+  // level at a time, the largest on screen first, towards the level that
+  // matches their size on screen. Textures out of view keep what they
+  // have while it fits the budget.
+  size_t textureCount = m_textures.size();
+  std::vector<uint32_t> levels(textureCount);
+  std::vector<uint32_t> neededLevels(textureCount);
+  std::vector<float> footprints(textureCount);
+  VkDeviceSize size = 0;
+  for (size_t i = 0; i < textureCount; i++) {
+    const Texture& texture = m_textures[i];
+    VkExtent2D extent = texture.file.getExtent();
+    uint32_t textureSize = std::max(extent.width, extent.height);
+
+    uint32_t tailLevel = 0;
+    while (getMipLevelSize(textureSize, tailLevel) > TAIL_SIZE) {
+      tailLevel++;
+    }
+    levels[i] = tailLevel;
+    size += getLevelsSize(texture, tailLevel);
+
+    std::memcpy(&footprints[i], &frame.feedback[i], sizeof(float));
+    if (footprints[i] > 0.f) {
+      float level = std::floor(std::log2(textureSize / footprints[i]));
+      neededLevels[i] = static_cast<uint32_t>(
+        std::clamp(level, 0.f, float(tailLevel)));
+    } else {
+      neededLevels[i] = std::min(texture.firstResidentLevel, tailLevel);
+    }
+  }
+
+  std::vector<size_t> order(textureCount);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return footprints[a] > footprints[b];
+  });
+
+  for (bool isVisiblePass : { true, false }) {
+    bool isRefined = true;
+    while (isRefined) {
+      isRefined = false;
+      for (size_t i : order) {
+        if ((footprints[i] > 0.f) != isVisiblePass
+            || levels[i] <= neededLevels[i]) {
+          continue;
+        }
+
+        VkExtent3D extent = getLevelExtent(m_textures[i].file.getExtent(),
+                                           levels[i] - 1);
+        VkDeviceSize levelSize = getTextureLevelByteCount(
+          m_textures[i].file.getFormat(), extent.width, extent.height);
+        if (size + levelSize <= m_budget) {
+          levels[i]--;
+          size += levelSize;
+          isRefined = true;
+        }
+      }
+    }
+  }
+
+  return levels;
+}
+
+void TextureStreamer::recordLevelChange(VkCommandBuffer commandBuffer,
+                                        Texture& texture,
+                                        uint32_t firstLevel,
+                                        uint64_t frameNumber)
+{
+  VkFormat format = texture.file.getFormat();
+  VkExtent2D extent = texture.file.getExtent();
+  uint32_t levelCount = texture.levelCount - firstLevel;
+  VkExtent3D firstExtent = getLevelExtent(extent, firstLevel);
+
+  VkImage image;
+  VkDeviceMemory memory;
+  createImage(m_device, m_physicalDevice,
+              { firstExtent.width, firstExtent.height }, format,
+              VK_IMAGE_USAGE_SAMPLED_BIT
+              | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+              | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory,
+              levelCount);
+  UniqueDeviceMemory newMemory(m_device, memory);
+  UniqueImage newImage(m_device, image);
+
+  // The old image may still be sampled by the previous frame.
+  bool hasOldImage = texture.firstResidentLevel < texture.levelCount;
+  VkImageMemoryBarrier barriers[2] = {};
+  for (VkImageMemoryBarrier& barrier : barriers) {
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  }
+  barriers[0].srcAccessMask = 0;
+  barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[0].image = newImage;
+  barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount,
+                                   0, 1 };
+  if (hasOldImage) {
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[1].image = texture.image;
+    barriers[1].subresourceRange = {
+      VK_IMAGE_ASPECT_COLOR_BIT, 0,
+      texture.levelCount - texture.firstResidentLevel, 0, 1
+    };
+  }
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, hasOldImage ? 2 : 1, barriers);
+
+  // Levels resident in both images are copied.
+  std::vector<VkImageCopy> copies;
+  uint32_t firstCopiedLevel = std::max(firstLevel, texture.firstResidentLevel);
+  for (uint32_t i = firstCopiedLevel; i < texture.levelCount; i++) {
+    VkImageCopy copy{};
+    copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT,
+                            i - texture.firstResidentLevel, 0, 1 };
+    copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - firstLevel, 0,
+                            1 };
+    copy.extent = getLevelExtent(extent, i);
+    copies.push_back(copy);
+  }
+  if (!copies.empty()) {
+    vkCmdCopyImage(commandBuffer, texture.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   static_cast<uint32_t>(copies.size()), copies.data());
+  }
+
+  // The others are uploaded, through a staging buffer retired with the
+  // frame.
+  if (firstLevel < texture.firstResidentLevel) {
+    std::vector<VkBufferImageCopy> uploads;
+    VkDeviceSize stagingSize = 0;
+    for (uint32_t i = firstLevel; i < texture.firstResidentLevel; i++) {
+      VkBufferImageCopy upload{};
+      upload.bufferOffset = stagingSize;
+      upload.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - firstLevel,
+                                  0, 1 };
+      upload.imageExtent = getLevelExtent(extent, i);
+      uploads.push_back(upload);
+      stagingSize = alignToStaging(
+        stagingSize + getTextureLevelByteCount(
+          format, upload.imageExtent.width, upload.imageExtent.height));
+    }
+
+    VkBuffer buffer;
+    createBuffer(m_device, m_physicalDevice, stagingSize,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                 | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffer, memory);
+    UniqueDeviceMemory stagingMemory(m_device, memory);
+    UniqueBuffer stagingBuffer(m_device, buffer);
+
+    void* data;
+    vkMapMemory(m_device, stagingMemory, 0, stagingSize, 0, &data);
+    for (uint32_t i = firstLevel; i < texture.firstResidentLevel; i++) {
+      const VkBufferImageCopy& upload = uploads[i - firstLevel];
+      std::memcpy(static_cast<uint8_t*>(data) + upload.bufferOffset,
+                  getLevelData(texture, i),
+                  getTextureLevelByteCount(format, upload.imageExtent.width,
+                                           upload.imageExtent.height));
+    }
+    vkUnmapMemory(m_device, stagingMemory);
+
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, newImage,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(uploads.size()),
+                           uploads.data());
+
+    m_deletionQueue->retire(std::move(stagingBuffer), frameNumber + 1);
+    m_deletionQueue->retire(std::move(stagingMemory), frameNumber + 1);
+  }
+
+  barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                       0, nullptr, 1, barriers);
+
+  // This frame still copies from the old image, and the previous one may
+  // sample it.
+  if (hasOldImage) {
+    m_deletionQueue->retire(std::move(texture.view), frameNumber + 1);
+    m_deletionQueue->retire(std::move(texture.image), frameNumber + 1);
+    m_deletionQueue->retire(std::move(texture.memory), frameNumber + 1);
+  }
+
+  texture.view = createImageView(newImage, format, 0, levelCount);
+  texture.image = std::move(newImage);
+  texture.memory = std::move(newMemory);
+  texture.firstResidentLevel = firstLevel;
+}
+
+void TextureStreamer::writeTextureSet(Frame& frame)
+{
+  // Only the views that changed since the set was last written.
+  std::vector<VkDescriptorImageInfo> imageInfos;
+  std::vector<VkWriteDescriptorSet> writes;
+  imageInfos.reserve(MAX_TEXTURES);
+  for (uint32_t i = 0; i < MAX_TEXTURES; i++) {
+    VkImageView view = m_placeholderView;
+    if (i < m_textures.size() && m_textures[i].view != VK_NULL_HANDLE) {
+      view = m_textures[i].view;
+    }
+    if (frame.views[i] == view) {
+      continue;
+    }
+    frame.views[i] = view;
+
+    imageInfos.push_back(
+      { m_sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = frame.textureSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = i;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfos.back();
+    writes.push_back(write);
+  }
+
+  if (!writes.empty()) {
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()),
+                           writes.data(), 0, nullptr);
+  }
+}
+
+const uint8_t* TextureStreamer::getLevelData(const Texture& texture,
+                                             uint32_t level) const
+{
+  uint32_t storedLevelCount = texture.file.getLevelCount();
+  if (level < storedLevelCount) {
+    return texture.file.getLevelData(level);
+  }
+
+  return texture.generatedLevels[level - storedLevelCount].data();
+}
+
+VkDeviceSize TextureStreamer::getLevelsSize(const Texture& texture,
+                                            uint32_t firstLevel) const
+{
+  VkDeviceSize size = 0;
+  for (uint32_t i = firstLevel; i < texture.levelCount; i++) {
+    VkExtent3D extent = getLevelExtent(texture.file.getExtent(), i);
+    size += getTextureLevelByteCount(texture.file.getFormat(), extent.width,
+                                     extent.height);
+  }
+
+  return size;
+}
+
+UniqueImageView TextureStreamer::createImageView(VkImage image,
+                                                 VkFormat format,
+                                                 uint32_t baseLevel,
+                                                 uint32_t levelCount) const
+{
+  VkImageViewCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  createInfo.image = image;
+  createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  createInfo.format = format;
+  createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  createInfo.subresourceRange.baseMipLevel = baseLevel;
+  createInfo.subresourceRange.levelCount = levelCount;
+  createInfo.subresourceRange.baseArrayLayer = 0;
+  createInfo.subresourceRange.layerCount = 1;
+
+  VkImageView imageView;
+  if (vkCreateImageView(m_device, &createInfo, nullptr, &imageView)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create texture image view!");
+  }
+
+  return UniqueImageView(m_device, imageView);
+}
@@ -0,0 +1,158 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../utils/submit_queue.hpp"
+#include "../utils/texture.hpp"
+#include "deletion_queue.hpp"
+#include "handles.hpp"
+#include "layout_cache.hpp"
+#include "occlusion_culling.hpp"
+#include "pipeline_cache.hpp"
+
+// Textures of the scene, streamed from mapped texture files (see
+// utils/texture.hpp). Each texture keeps only the mip levels needed at the
+// size it was last seen at resident, within a memory budget, and the
+// smallest levels always.
+//
+// The sizes come from a compute pass over the instances that passed the
+// occlusion culling, which records the largest screen size of each
+// texture. They are read back once the frame finishes, and textures whose
+// needed levels changed are reallocated with the new levels. Levels kept
+// are copied from the old image, and the others uploaded from the file.
+//
+// Textures that do not store their mips get them generated on the GPU when
+// loaded, and are streamed the same way afterwards.
+class TextureStreamer
+{
+public:
+  // Matches shaders/fragment.frag.
+  static constexpr uint32_t MAX_TEXTURES = 16;
+
+  // Loads the texture files, of which there are at most MAX_TEXTURES. The
+  // command pool and queue are used to generate missing mips. Feedback is
+  // taken from the visible instances of the culling, which culls up to
+  // instanceCapacity instances of a mesh with the given bounding sphere
+  // radius.
+  void init(VkDevice device,
+            VkPhysicalDevice physicalDevice,
+            LayoutCache& layoutCache,
+            PipelineCache& pipelineCache,
+            DeletionQueue& deletionQueue,
+            VkCommandPool commandPool,
+            SubmitQueue& queue,
+            const std::vector<std::string>& fileNames,
+            VkDeviceSize budget,
+            uint32_t frameCount,
+            const OcclusionCulling& culling,
+            uint32_t instanceCapacity,
+            float boundsRadius);
+  void destroy();
+
+  // Layout of set 1 of the scene's fragment shader, which the sets bound
+  // by bind() are allocated with. Slots past the texture count hold a
+  // white texture.
+  VkDescriptorSetLayout getSetLayout() const;
+  uint32_t getTextureCount() const;
+  // Bytes of texel data resident.
+  VkDeviceSize getResidentSize() const;
+
+  // Reads the feedback of the slot's previous frame, which must have
+  // finished, and records the copies and uploads of the textures whose
+  // resident levels change. Must be outside of a render pass, before the
+  // draws.
+  void recordUpdates(VkCommandBuffer commandBuffer,
+                     size_t frameIndex,
+                     uint64_t frameNumber);
+
+  // Records the screen size of the textures of the instances that passed
+  // the slot's cull. Must be after the cull.
+  void recordFeedback(VkCommandBuffer commandBuffer,
+                      size_t frameIndex,
+                      VkExtent2D renderExtent) const;
+
+  // Binds the textures as set 1 of a pipeline with the set layout.
+  void bind(VkCommandBuffer commandBuffer,
+            VkPipelineLayout pipelineLayout,
+            size_t frameIndex) const;
+
+private:
+  struct Texture
+  {
+    explicit Texture(const std::string& fileName) : file(fileName) {}
+
+    TextureFile file;
+    // Levels the file does not store, generated on load, from level 1.
+    std::vector<std::vector<uint8_t>> generatedLevels;
+    uint32_t levelCount = 0;
+    // Most detailed level resident, levelCount while nothing is.
+    uint32_t firstResidentLevel = 0;
+    UniqueDeviceMemory memory;
+    UniqueImage image;
+    UniqueImageView view;
+  };
+
+  struct Frame
+  {
+    UniqueDeviceMemory feedbackMemory;
+    UniqueBuffer feedbackBuffer;
+    // Largest screen size of each texture in pixels, as float bits.
+    const uint32_t* feedback = nullptr;
+    VkDescriptorSet feedbackSet = VK_NULL_HANDLE;
+    VkDescriptorSet textureSet = VK_NULL_HANDLE;
+    // Views the texture set was last written with.
+    std::vector<VkImageView> views;
+  };
+
+  void createSampler();
+  void createPlaceholder();
+  void createDescriptorPool();
+  void createFeedbackPipeline();
+  void createFrames(const OcclusionCulling& culling);
+  void generateLevels(Texture& texture);
+  std::vector<uint32_t> selectLevels(const Frame& frame) const;
+  void recordLevelChange(VkCommandBuffer commandBuffer,
+                         Texture& texture,
+                         uint32_t firstLevel,
+                         uint64_t frameNumber);
+  void writeTextureSet(Frame& frame);
+  const uint8_t* getLevelData(const Texture& texture, uint32_t level) const;
+  VkDeviceSize getLevelsSize(const Texture& texture,
+                             uint32_t firstLevel) const;
+  UniqueImageView createImageView(VkImage image,
+                                  VkFormat format,
+                                  uint32_t baseLevel,
+                                  uint32_t levelCount) const;
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  LayoutCache* m_layoutCache = nullptr;
+  PipelineCache* m_pipelineCache = nullptr;
+  DeletionQueue* m_deletionQueue = nullptr;
+  VkCommandPool m_commandPool = VK_NULL_HANDLE;
+  SubmitQueue* m_queue = nullptr;
+  VkDeviceSize m_budget = 0;
+  uint32_t m_instanceCapacity = 0;
+  float m_boundsRadius = 0.f;
+
+  std::vector<Texture> m_textures;
+  std::vector<Frame> m_frames;
+  UniqueSampler m_sampler;
+  UniqueDeviceMemory m_placeholderMemory;
+  UniqueImage m_placeholderImage;
+  UniqueImageView m_placeholderView;
+  UniqueDescriptorPool m_descriptorPool;
+
+  // The layouts are owned by the layout cache.
+  VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+  VkPipelineLayout m_feedbackPipelineLayout = VK_NULL_HANDLE;
+  VkDescriptorSetLayout m_feedbackSetLayout = VK_NULL_HANDLE;
+  UniquePipeline m_feedbackPipeline;
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../constants.hpp"
+#include "../utils/io.hpp"
+#include "../utils/spirv.hpp"
+#include "../utils/vk.hpp"
+#include "upscaler.hpp"
+
+void Upscaler::init(VkDevice device,
+                    VkPhysicalDevice physicalDevice,
+                    LayoutCache& layoutCache,
+                    PipelineCache& pipelineCache,
+                    VkRenderPass sceneRenderPass,
+                    VkRenderPass outputRenderPass,
+                    VkFormat format,
+                    VkFormat depthFormat,
+                    VkExtent2D extent)
+{
+  m_device = device;
+  m_physicalDevice = physicalDevice;
+  m_layoutCache = &layoutCache;
+  m_pipelineCache = &pipelineCache;
+  m_sceneExtent = extent;
+
+  createSceneTarget(sceneRenderPass, format, depthFormat);
+  createPipeline(outputRenderPass);
+}
+
+void Upscaler::destroy()
+{
+  // The layouts belong to their cache. The pipeline's key holds this
+  // class's modules, so no one else uses it, and it is taken out of its
+  // cache, which may be shared and outlive this class. The descriptor set
+  // is freed with the pool.
+  vkDestroyPipeline(m_device, m_pipelineCache->evict(m_pipelineKey),
+                    nullptr);
+  m_vertexShaderModule.reset();
+  m_fragmentShaderModule.reset();
+  m_descriptorPool.reset();
+  m_sampler.reset();
+  m_sceneFramebuffer.reset();
+  m_sceneDepthImageView.reset();
+  m_sceneDepthImage.reset();
+  m_sceneDepthImageMemory.reset();
+  m_sceneImageView.reset();
+  m_sceneImage.reset();
+  m_sceneImageMemory.reset();
+}
+
+VkFramebuffer Upscaler::getSceneFramebuffer() const
+{
+  return m_sceneFramebuffer;
+}
+
+VkExtent2D Upscaler::getSceneExtent() const
+{
+  return m_sceneExtent;
+}
+
+VkImageView Upscaler::getSceneDepthView() const
+{
+  return m_sceneDepthImageView;
+}
+
+void Upscaler::recordDraw(VkCommandBuffer commandBuffer,
+                          VkExtent2D renderExtent) const
+{
+  float width = static_cast<float>(m_sceneExtent.width);
+  float height = static_cast<float>(m_sceneExtent.height);
+
+  PushConstants pushConstants;
+  pushConstants.uvScale[0] = renderExtent.width / width;
+  pushConstants.uvScale[1] = renderExtent.height / height;
+  pushConstants.uvMax[0] = (renderExtent.width - 0.5f) / width;
+  pushConstants.uvMax[1] = (renderExtent.height - 0.5f) / height;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    m_pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          m_pipelineLayout, 0, 1, &m_descriptorSet, 0,
+                          nullptr);
+  vkCmdPushConstants(commandBuffer, m_pipelineLayout, m_pushConstantStages,
+                     0, sizeof(pushConstants), &pushConstants);
+  vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void Upscaler::createSceneTarget(VkRenderPass sceneRenderPass,
+                                 VkFormat format,
+                                 VkFormat depthFormat)
+{
+  VkImage image;
+  VkDeviceMemory memory;
+  createImage(m_device, m_physicalDevice, m_sceneExtent, format,
+              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+              | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+  m_sceneImageMemory = UniqueDeviceMemory(m_device, memory);
+  m_sceneImage = UniqueImage(m_device, image);
+  m_sceneImageView = createImageView(m_sceneImage, format,
+                                     VK_IMAGE_ASPECT_COLOR_BIT);
+
+  createImage(m_device, m_physicalDevice, m_sceneExtent, depthFormat,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+              | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+  m_sceneDepthImageMemory = UniqueDeviceMemory(m_device, memory);
+  m_sceneDepthImage = UniqueImage(m_device, image);
+  m_sceneDepthImageView = createImageView(m_sceneDepthImage, depthFormat,
+                                          VK_IMAGE_ASPECT_DEPTH_BIT);
+
+  VkImageView attachments[] = { m_sceneImageView, m_sceneDepthImageView };
+
+  VkFramebufferCreateInfo framebufferCreateInfo{};
+  framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferCreateInfo.renderPass = sceneRenderPass;
+  framebufferCreateInfo.attachmentCount = 2;
+  framebufferCreateInfo.pAttachments = attachments;
+  framebufferCreateInfo.width = m_sceneExtent.width;
+  framebufferCreateInfo.height = m_sceneExtent.height;
+  framebufferCreateInfo.layers = 1;
+
+  VkFramebuffer framebuffer;
+  if (vkCreateFramebuffer(m_device, &framebufferCreateInfo, nullptr,
+                          &framebuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create scene framebuffer!");
+  }
+  m_sceneFramebuffer = UniqueFramebuffer(m_device, framebuffer);
+
+  // Clamped, so that the edges do not wrap around to the other side.
+  VkSamplerCreateInfo samplerCreateInfo{};
+  samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+  VkSampler sampler;
+  if (vkCreateSampler(m_device, &samplerCreateInfo, nullptr, &sampler)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create scene sampler!");
+  }
+  m_sampler = UniqueSampler(m_device, sampler);
+}
+
+UniqueImageView Upscaler::createImageView(VkImage image,
+                                          VkFormat format,
+                                          VkImageAspectFlags aspectMask)
+{
+  VkImageViewCreateInfo viewCreateInfo{};
+  viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewCreateInfo.image = image;
+  viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewCreateInfo.format = format;
+  viewCreateInfo.subresourceRange.aspectMask = aspectMask;
+  viewCreateInfo.subresourceRange.levelCount = 1;
+  viewCreateInfo.subresourceRange.layerCount = 1;
+
+  VkImageView imageView;
+  if (vkCreateImageView(m_device, &viewCreateInfo, nullptr, &imageView)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create scene image view!");
+  }
+
+  return UniqueImageView(m_device, imageView);
+}
+
+void Upscaler::createDescriptorSet(VkDescriptorSetLayout setLayout)
+{
+  VkDescriptorPoolSize poolSize{};
+  poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSize.descriptorCount = 1;
+
+  VkDescriptorPoolCreateInfo poolCreateInfo{};
+  poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolCreateInfo.maxSets = 1;
+  poolCreateInfo.poolSizeCount = 1;
+  poolCreateInfo.pPoolSizes = &poolSize;
+
+  VkDescriptorPool descriptorPool;
+  if (vkCreateDescriptorPool(m_device, &poolCreateInfo, nullptr,
+                             &descriptorPool) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create upscale descriptor pool!");
+  }
+  m_descriptorPool = UniqueDescriptorPool(m_device, descriptorPool);
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = m_descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &setLayout;
+  if (vkAllocateDescriptorSets(m_device, &allocInfo, &m_descriptorSet)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate upscale descriptor set!");
+  }
+
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = m_sampler;
+  imageInfo.imageView = m_sceneImageView;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = m_descriptorSet;
+  write.dstBinding = 0;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+void Upscaler::createPipeline(VkRenderPass outputRenderPass)
+{
+  std::vector<char> vertShaderCode =
+    readFile(UPSCALE_VERTEX_SHADER_FILE_NAME);
+  std::vector<char> fragShaderCode =
+    readFile(UPSCALE_FRAGMENT_SHADER_FILE_NAME);
+
+  const PipelineLayoutInfo& layoutInfo = m_layoutCache->getPipelineLayout(
+    { reflectShader(vertShaderCode), reflectShader(fragShaderCode) });
+  if (layoutInfo.setLayouts.size() != 1) {
+    throw std::runtime_error("Upscale shaders must only use set 0!");
+  }
+  m_pipelineLayout = layoutInfo.layout;
+  for (const VkPushConstantRange& range : layoutInfo.pushConstantRanges) {
+    m_pushConstantStages |= range.stageFlags;
+  }
+  createDescriptorSet(layoutInfo.setLayouts[0]);
+
+  VkPipelineColorBlendAttachmentState colourBlendAttachment{};
+  colourBlendAttachment.colorWriteMask =
+    VK_COLOR_COMPONENT_R_BIT
+    | VK_COLOR_COMPONENT_G_BIT
+    | VK_COLOR_COMPONENT_B_BIT
+    | VK_COLOR_COMPONENT_A_BIT;
+  colourBlendAttachment.blendEnable = VK_FALSE;
+
+  m_vertexShaderModule = UniqueShaderModule(
+    m_device, createShaderModule(m_device, vertShaderCode));
+  m_fragmentShaderModule = UniqueShaderModule(
+    m_device, createShaderModule(m_device, fragShaderCode));
+
+  // No vertex input, the vertex shader generates a fullscreen triangle.
+  PipelineStateKey& key = m_pipelineKey;
+  key.cullMode = VK_CULL_MODE_NONE;
+  key.colourBlendAttachments = { colourBlendAttachment };
+  key.renderPass = outputRenderPass;
+  key.layout = m_pipelineLayout;
+  key.stages = {
+    { VK_SHADER_STAGE_VERTEX_BIT, m_vertexShaderModule, "main", {} },
+    { VK_SHADER_STAGE_FRAGMENT_BIT, m_fragmentShaderModule, "main", {} }
+  };
+
+  // Owned by the pipeline cache.
+  m_pipeline = m_pipelineCache->get(key);
+}
@@ -0,0 +1,86 @@
+#ifndef UPSCALER_HPP
+#define UPSCALER_HPP
+
+#include <vulkan/vulkan.h>
+
+#include "handles.hpp"
+#include "layout_cache.hpp"
+#include "pipeline_cache.hpp"
+
+// Owns the offscreen colour and depth images the scene is rendered into,
+// at a resolution that may be lower than their size, and the pass that
+// stretches the rendered part over an output image with bilinear
+// filtering.
+class Upscaler
+{
+public:
+  // The scene render pass must have a colour and a depth attachment, and
+  // leave both in SHADER_READ_ONLY_OPTIMAL layout. The extent is the
+  // largest resolution the scene is rendered at.
+  void init(VkDevice device,
+            VkPhysicalDevice physicalDevice,
+            LayoutCache& layoutCache,
+            PipelineCache& pipelineCache,
+            VkRenderPass sceneRenderPass,
+            VkRenderPass outputRenderPass,
+            VkFormat format,
+            VkFormat depthFormat,
+            VkExtent2D extent);
+  void destroy();
+
+  VkFramebuffer getSceneFramebuffer() const;
+  VkExtent2D getSceneExtent() const;
+  // Depth of the last rendered scene, e.g. for the depth pyramid.
+  VkImageView getSceneDepthView() const;
+
+  // Records the upscale of the top left renderExtent of the scene image.
+  // Must be inside the output render pass, with the viewport and scissor
+  // set to the output image.
+  void recordDraw(VkCommandBuffer commandBuffer,
+                  VkExtent2D renderExtent) const;
+
+private:
+  // Matches the push constant block of shaders/upscale_vertex.vert.
+  struct PushConstants
+  {
+    float uvScale[2];
+    float uvMax[2];
+  };
+
+  void createSceneTarget(VkRenderPass sceneRenderPass,
+                         VkFormat format,
+                         VkFormat depthFormat);
+  UniqueImageView createImageView(VkImage image,
+                                  VkFormat format,
+                                  VkImageAspectFlags aspectMask);
+  void createDescriptorSet(VkDescriptorSetLayout setLayout);
+  void createPipeline(VkRenderPass outputRenderPass);
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  LayoutCache* m_layoutCache = nullptr;
+  PipelineCache* m_pipelineCache = nullptr;
+  VkExtent2D m_sceneExtent = { 0, 0 };
+
+  UniqueDeviceMemory m_sceneImageMemory;
+  UniqueImage m_sceneImage;
+  UniqueImageView m_sceneImageView;
+  UniqueDeviceMemory m_sceneDepthImageMemory;
+  UniqueImage m_sceneDepthImage;
+  UniqueImageView m_sceneDepthImageView;
+  UniqueFramebuffer m_sceneFramebuffer;
+  UniqueSampler m_sampler;
+  UniqueDescriptorPool m_descriptorPool;
+  VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+  // The pipeline and its layout are owned by their caches, and the modules
+  // referenced by its key by this class.
+  VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+  VkShaderStageFlags m_pushConstantStages = 0;
+  UniqueShaderModule m_vertexShaderModule;
+  UniqueShaderModule m_fragmentShaderModule;
+  PipelineStateKey m_pipelineKey;
+  VkPipeline m_pipeline = VK_NULL_HANDLE;
+};
+
+#endif
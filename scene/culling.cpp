@@ -0,0 +1,240 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "culling.hpp"
+
+// Batches may run past the last object into the padding of the arrays,
+// which must therefore hold a whole batch.
+static_assert(FloatN::WIDTH * sizeof(float) <= 32,
+              "Bounds arrays are not padded to a whole SIMD register.");
+
+void SphereBounds::resize(size_t count)
+{
+  this->count = count;
+  for (AlignedArray<float>* component : { &x, &y, &z, &radius }) {
+    component->resize(count);
+  }
+}
+
+void AabbBounds::resize(size_t count)
+{
+  this->count = count;
+  for (AlignedArray<float>* component :
+       { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+    component->resize(count);
+  }
+}
+
+Frustum extractFrustum(const Mat4& viewProjection)
+{
+  // Each plane is a sum or difference of rows of the matrix (Gribb and
+  // Hartmann), e.g. the left plane is where x = -w.
+  const float* m = viewProjection.m;
+  auto row = [m](int i, float* result) {
+    for (int column = 0; column < 4; column++) {
+      result[column] = m[column * 4 + i];
+    }
+  };
+
+  float x[4];
+  float y[4];
+  float z[4];
+  float w[4];
+  row(0, x);
+  row(1, y);
+  row(2, z);
+  row(3, w);
+
+  Frustum frustum;
+  for (int i = 0; i < 4; i++) {
+    frustum.planes[0][i] = w[i] + x[i];
+    frustum.planes[1][i] = w[i] - x[i];
+    frustum.planes[2][i] = w[i] + y[i];
+    frustum.planes[3][i] = w[i] - y[i];
+    frustum.planes[4][i] = z[i];
+    frustum.planes[5][i] = w[i] - z[i];
+  }
+
+  for (float* plane : frustum.planes) {
+    float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1]
+                             + plane[2] * plane[2]);
+    for (int i = 0; i < 4; i++) {
+      plane[i] /= length;
+    }
+  }
+
+  return frustum;
+}
+
+static void clearDrawList(DrawList& drawList)
+{
+  for (std::vector<uint32_t>& objects : drawList.objects) {
+    objects.clear();
+  }
+}
+
+// The lanes of a batch starting at first that hold objects.
+template<typename Float>
+static uint32_t getValidLanes(size_t first, size_t count)
+{
+  size_t validCount = count - first;
+
+  return validCount >= Float::WIDTH ? (1u << Float::WIDTH) - 1
+                                    : (1u << validCount) - 1;
+}
+
+// Appends the visible lanes of a batch to the draw list. Sizes are compared
+// squared, i.e. r * scale / d < t as (r * scale)^2 < (t * d)^2, to avoid
+// square roots and divisions.
+template<typename Float>
+static void appendVisible(Float x,
+                          Float y,
+                          Float z,
+                          Float radiusSquared,
+                          size_t first,
+                          uint32_t visibleLanes,
+                          const LodSelection& lodSelection,
+                          DrawList& drawList)
+{
+  Float dx = x - Float::set(lodSelection.cameraPosition[0]);
+  Float dy = y - Float::set(lodSelection.cameraPosition[1]);
+  Float dz = z - Float::set(lodSelection.cameraPosition[2]);
+  Float distanceSquared = dx * dx + dy * dy + dz * dz;
+  Float sizeSquared = radiusSquared * Float::set(
+    lodSelection.projectionScale * lodSelection.projectionScale);
+
+  uint32_t lods[Float::WIDTH] = {};
+  for (uint32_t i = 0; i + 1 < lodSelection.lodCount; i++) {
+    float threshold = lodSelection.thresholds[i];
+    uint32_t smallerLanes = lessMask(
+      sizeSquared, Float::set(threshold * threshold) * distanceSquared);
+    for (size_t lane = 0; lane < Float::WIDTH; lane++) {
+      lods[lane] += (smallerLanes >> lane) & 1;
+    }
+  }
+
+  while (visibleLanes != 0) {
+    uint32_t lane = static_cast<uint32_t>(__builtin_ctz(visibleLanes));
+    drawList.objects[lods[lane]].push_back(
+      static_cast<uint32_t>(first + lane));
+    visibleLanes &= visibleLanes - 1;
+  }
+}
+
+template<typename Float>
+void cullSpheres(const SphereBounds& bounds,
+                 const Frustum& frustum,
+                 const LodSelection& lodSelection,
+                 DrawList& drawList)
+{
+  cullSpheres<Float>(bounds, 0, bounds.count, frustum, lodSelection,
+                     drawList);
+}
+
+template<typename Float>
+void cullSpheres(const SphereBounds& bounds,
+                 size_t begin,
+                 size_t end,
+                 const Frustum& frustum,
+                 const LodSelection& lodSelection,
+                 DrawList& drawList)
+{
+  clearDrawList(drawList);
+
+  Float planes[6][4];
+  for (int p = 0; p < 6; p++) {
+    for (int i = 0; i < 4; i++) {
+      planes[p][i] = Float::set(frustum.planes[p][i]);
+    }
+  }
+  const Float zero = Float::set(0.f);
+
+  for (size_t i = begin; i < end; i += Float::WIDTH) {
+    Float x = Float::load(bounds.x.data() + i);
+    Float y = Float::load(bounds.y.data() + i);
+    Float z = Float::load(bounds.z.data() + i);
+    Float radius = Float::load(bounds.radius.data() + i);
+    Float negativeRadius = zero - radius;
+
+    // A sphere is outside if it lies entirely behind any plane.
+    uint32_t visibleLanes = getValidLanes<Float>(i, end);
+    for (const Float* plane : planes) {
+      Float distance = plane[0] * x + plane[1] * y + plane[2] * z + plane[3];
+      visibleLanes &= ~lessMask(distance, negativeRadius);
+    }
+
+    if (visibleLanes != 0) {
+      appendVisible(x, y, z, radius * radius, i, visibleLanes, lodSelection,
+                    drawList);
+    }
+  }
+}
+
+template<typename Float>
+void cullAabbs(const AabbBounds& bounds,
+               const Frustum& frustum,
+               const LodSelection& lodSelection,
+               DrawList& drawList)
+{
+  clearDrawList(drawList);
+
+  // The box corner furthest along a plane's normal is centre + extent
+  // * sign(normal), so its distance is that of the centre plus extent
+  // * abs(normal).
+  Float planes[6][4];
+  Float absNormals[6][3];
+  for (int p = 0; p < 6; p++) {
+    for (int i = 0; i < 4; i++) {
+      planes[p][i] = Float::set(frustum.planes[p][i]);
+    }
+    for (int i = 0; i < 3; i++) {
+      absNormals[p][i] = Float::set(std::fabs(frustum.planes[p][i]));
+    }
+  }
+  const Float zero = Float::set(0.f);
+
+  for (size_t i = 0; i < bounds.count; i += Float::WIDTH) {
+    Float x = Float::load(bounds.centerX.data() + i);
+    Float y = Float::load(bounds.centerY.data() + i);
+    Float z = Float::load(bounds.centerZ.data() + i);
+    Float extentX = Float::load(bounds.extentX.data() + i);
+    Float extentY = Float::load(bounds.extentY.data() + i);
+    Float extentZ = Float::load(bounds.extentZ.data() + i);
+
+    uint32_t visibleLanes = getValidLanes<Float>(i, bounds.count);
+    for (int p = 0; p < 6; p++) {
+      const Float* plane = planes[p];
+      const Float* absNormal = absNormals[p];
+      Float distance = plane[0] * x + plane[1] * y + plane[2] * z + plane[3]
+                       + absNormal[0] * extentX + absNormal[1] * extentY
+                       + absNormal[2] * extentZ;
+      visibleLanes &= ~lessMask(distance, zero);
+    }
+
+    if (visibleLanes != 0) {
+      Float radiusSquared = extentX * extentX + extentY * extentY
+                            + extentZ * extentZ;
+      appendVisible(x, y, z, radiusSquared, i, visibleLanes, lodSelection,
+                    drawList);
+    }
+  }
+}
+
+template void cullSpheres<Float1>(const SphereBounds&, const Frustum&,
+                                  const LodSelection&, DrawList&);
+template void cullSpheres<Float1>(const SphereBounds&, size_t, size_t,
+                                  const Frustum&, const LodSelection&,
+                                  DrawList&);
+template void cullAabbs<Float1>(const AabbBounds&, const Frustum&,
+                                const LodSelection&, DrawList&);
+
+#if defined(__SSE2__)
+template void cullSpheres<FloatN>(const SphereBounds&, const Frustum&,
+                                  const LodSelection&, DrawList&);
+template void cullSpheres<FloatN>(const SphereBounds&, size_t, size_t,
+                                  const Frustum&, const LodSelection&,
+                                  DrawList&);
+template void cullAabbs<FloatN>(const AabbBounds&, const Frustum&,
+                                const LodSelection&, DrawList&);
+#endif
@@ -0,0 +1,85 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../ds/DrawList.hpp"
+#include "../ds/Frustum.hpp"
+#include "../ds/Mat4.hpp"
+#include "../utils/aligned_array.hpp"
+#include "../utils/simd.hpp"
+
+// CPU visibility for when GPU-driven culling is unavailable, or other
+// systems need to know what is visible. Bounds are stored as
+// structure-of-arrays and tested FloatN::WIDTH objects at a time; culling
+// with Float1 gives the scalar reference.
+
+// World-space bounding spheres.
+struct SphereBounds
+{
+  void resize(size_t count);
+
+  size_t count = 0;
+  AlignedArray<float> x;
+  AlignedArray<float> y;
+  AlignedArray<float> z;
+  AlignedArray<float> radius;
+};
+
+// World-space axis-aligned bounding boxes, as centres and half extents.
+struct AabbBounds
+{
+  void resize(size_t count);
+
+  size_t count = 0;
+  AlignedArray<float> centerX;
+  AlignedArray<float> centerY;
+  AlignedArray<float> centerZ;
+  AlignedArray<float> extentX;
+  AlignedArray<float> extentY;
+  AlignedArray<float> extentZ;
+};
+
+// Picks the LOD of a visible object from the radius it projects to on
+// screen, measured from the camera position.
+struct LodSelection
+{
+  float cameraPosition[3];
+  // Projected radius in pixels of a unit radius at unit distance, i.e.
+  // viewportHeight / (2 * tan(fovY / 2)).
+  float projectionScale;
+  // Projected radii in pixels, descending. Objects smaller than
+  // thresholds[i] use LOD i + 1 or coarser.
+  float thresholds[MAX_LOD_COUNT - 1];
+  uint32_t lodCount;
+};
+
+// For a Vulkan clip space, i.e. depth in [0, 1].
+Frustum extractFrustum(const Mat4& viewProjection);
+
+// Replaces the draw list with the objects whose bounds intersect the
+// frustum.
+template<typename Float = FloatN>
+void cullSpheres(const SphereBounds& bounds,
+                 const Frustum& frustum,
+                 const LodSelection& lodSelection,
+                 DrawList& drawList);
+// Culls the objects in [begin, end) only, e.g. a batch of a parallel cull.
+// begin must be a multiple of Float::WIDTH.
+template<typename Float = FloatN>
+void cullSpheres(const SphereBounds& bounds,
+                 size_t begin,
+                 size_t end,
+                 const Frustum& frustum,
+                 const LodSelection& lodSelection,
+                 DrawList& drawList);
+
+// The LOD is picked from the box's bounding sphere.
+template<typename Float = FloatN>
+void cullAabbs(const AabbBounds& bounds,
+               const Frustum& frustum,
+               const LodSelection& lodSelection,
+               DrawList& drawList);
+
+#endif
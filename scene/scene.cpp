@@ -0,0 +1,179 @@
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "../ds/Mat4.hpp"
+#include "../utils/simd.hpp"
+#include "scene.hpp"
+
+void Scene::reserve(size_t count)
+{
+  for (AlignedArray<float>* component :
+       { &m_positions.x, &m_positions.y, &m_positions.z, &m_rotations.x,
+         &m_rotations.y, &m_rotations.z, &m_rotations.w, &m_scales.x,
+         &m_scales.y, &m_scales.z }) {
+    component->reserve(count);
+  }
+  m_parents.reserve(count);
+  m_worldMatrices.reserve(count);
+}
+
+uint32_t Scene::createObject(uint32_t parent)
+{
+  if (parent != NO_PARENT && parent >= m_objectCount) {
+    throw std::runtime_error("Parent object does not exist!");
+  }
+
+  uint32_t object = static_cast<uint32_t>(m_objectCount);
+  m_objectCount++;
+
+  for (AlignedArray<float>* component :
+       { &m_positions.x, &m_positions.y, &m_positions.z, &m_rotations.x,
+         &m_rotations.y, &m_rotations.z, &m_rotations.w, &m_scales.x,
+         &m_scales.y, &m_scales.z }) {
+    component->resize(m_objectCount);
+  }
+  m_parents.resize(m_objectCount);
+  m_worldMatrices.resize(m_objectCount);
+
+  m_rotations.w[object] = 1.f;
+  m_scales.x[object] = 1.f;
+  m_scales.y[object] = 1.f;
+  m_scales.z[object] = 1.f;
+  m_parents[object] = parent;
+
+  return object;
+}
+
+void Scene::setPosition(uint32_t object, float x, float y, float z)
+{
+  m_positions.x[object] = x;
+  m_positions.y[object] = y;
+  m_positions.z[object] = z;
+}
+
+void Scene::setRotation(uint32_t object, float x, float y, float z, float w)
+{
+  m_rotations.x[object] = x;
+  m_rotations.y[object] = y;
+  m_rotations.z[object] = z;
+  m_rotations.w[object] = w;
+}
+
+void Scene::setScale(uint32_t object, float x, float y, float z)
+{
+  m_scales.x[object] = x;
+  m_scales.y[object] = y;
+  m_scales.z[object] = z;
+}
+
+static_assert(Scene::OBJECT_BATCH_ALIGNMENT % FloatN::WIDTH == 0,
+              "Object batches must start at a multiple of the SIMD width.");
+
+void Scene::updateLocalMatrices(size_t begin, size_t end)
+{
+  // Local matrices are computed FloatN::WIDTH objects at a time, straight
+  // into the world matrices, and the objects left over are done one by one.
+  size_t simdEnd = end - (end - begin) % FloatN::WIDTH;
+  computeLocalMatrices<FloatN>(begin, simdEnd);
+  computeLocalMatrices<Float1>(simdEnd, end);
+}
+
+void Scene::resolveWorldMatrices(Mat4* instanceData)
+{
+  // Parents come first, so their world matrices are final by the time
+  // their children are reached.
+  for (size_t object = 0; object < m_objectCount; object++) {
+    Mat4& world = m_worldMatrices[object];
+    uint32_t parent = m_parents[object];
+    if (parent != NO_PARENT) {
+      multiply(m_worldMatrices[parent], world, world);
+    }
+
+    if (instanceData != nullptr) {
+      streamMatrix(world, instanceData[object]);
+    }
+  }
+
+  if (instanceData != nullptr) {
+    streamFence();
+  }
+}
+
+size_t Scene::getObjectCount() const
+{
+  return m_objectCount;
+}
+
+const Scene::Vec3Soa& Scene::getPositions() const
+{
+  return m_positions;
+}
+
+const Scene::QuatSoa& Scene::getRotations() const
+{
+  return m_rotations;
+}
+
+const Scene::Vec3Soa& Scene::getScales() const
+{
+  return m_scales;
+}
+
+const Mat4& Scene::getWorldMatrix(uint32_t object) const
+{
+  return m_worldMatrices[object];
+}
+
+template<typename Float>
+void Scene::computeLocalMatrices(size_t begin, size_t end)
+{
+  const Float zero = Float::set(0.f);
+  const Float one = Float::set(1.f);
+  const Float two = Float::set(2.f);
+
+  for (size_t i = begin; i < end; i += Float::WIDTH) {
+    Float qx = Float::load(&m_rotations.x[i]);
+    Float qy = Float::load(&m_rotations.y[i]);
+    Float qz = Float::load(&m_rotations.z[i]);
+    Float qw = Float::load(&m_rotations.w[i]);
+    Float sx = Float::load(&m_scales.x[i]);
+    Float sy = Float::load(&m_scales.y[i]);
+    Float sz = Float::load(&m_scales.z[i]);
+
+    Float xx = qx * qx;
+    Float yy = qy * qy;
+    Float zz = qz * qz;
+    Float xy = qx * qy;
+    Float xz = qx * qz;
+    Float yz = qy * qz;
+    Float wx = qw * qx;
+    Float wy = qw * qy;
+    Float wz = qw * qz;
+
+    // Rotation scaled per axis, column-major, followed by the translation.
+    Float elements[16] = {
+      (one - two * (yy + zz)) * sx,
+      two * (xy + wz) * sx,
+      two * (xz - wy) * sx,
+      zero,
+
+      two * (xy - wz) * sy,
+      (one - two * (xx + zz)) * sy,
+      two * (yz + wx) * sy,
+      zero,
+
+      two * (xz + wy) * sz,
+      two * (yz - wx) * sz,
+      (one - two * (xx + yy)) * sz,
+      zero,
+
+      Float::load(&m_positions.x[i]),
+      Float::load(&m_positions.y[i]),
+      Float::load(&m_positions.z[i]),
+      one,
+    };
+
+    storeMatrices(elements, &m_worldMatrices[i]);
+  }
+}
@@ -0,0 +1,78 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../ds/Mat4.hpp"
+#include "../utils/aligned_array.hpp"
+
+// Object transforms stored as structure-of-arrays, one aligned array per
+// component, so that updates run over many objects per SIMD instruction.
+// Objects are ordered so that each parent comes before its children, which
+// lets world matrices be resolved in one pass.
+class Scene
+{
+public:
+  static constexpr uint32_t NO_PARENT = UINT32_MAX;
+  // Batches of objects updated in parallel must start at a multiple of
+  // this, the widest SIMD width, so that their loads stay aligned.
+  static constexpr size_t OBJECT_BATCH_ALIGNMENT = 8;
+
+  struct Vec3Soa
+  {
+    AlignedArray<float> x;
+    AlignedArray<float> y;
+    AlignedArray<float> z;
+  };
+
+  struct QuatSoa
+  {
+    AlignedArray<float> x;
+    AlignedArray<float> y;
+    AlignedArray<float> z;
+    AlignedArray<float> w;
+  };
+
+  // Makes room for count objects in total, so that creating them does not
+  // reallocate.
+  void reserve(size_t count);
+
+  // Returns the index of the new object, which has the identity transform.
+  // The parent must already exist.
+  uint32_t createObject(uint32_t parent = NO_PARENT);
+
+  void setPosition(uint32_t object, float x, float y, float z);
+  // Takes a unit quaternion.
+  void setRotation(uint32_t object, float x, float y, float z, float w);
+  void setScale(uint32_t object, float x, float y, float z);
+
+  // Computes the local matrices of the objects in [begin, end). Disjoint
+  // batches can be computed in parallel, and all of them must be before
+  // resolveWorldMatrices().
+  void updateLocalMatrices(size_t begin, size_t end);
+  // Turns the local matrices into world matrices and, if instanceData is
+  // not null, writes them to it in object order. instanceData is written
+  // with streaming stores, since it is typically a mapped buffer the CPU
+  // does not read back.
+  void resolveWorldMatrices(Mat4* instanceData);
+
+  size_t getObjectCount() const;
+  const Vec3Soa& getPositions() const;
+  const QuatSoa& getRotations() const;
+  const Vec3Soa& getScales() const;
+  const Mat4& getWorldMatrix(uint32_t object) const;
+
+private:
+  template<typename Float>
+  void computeLocalMatrices(size_t begin, size_t end);
+
+  size_t m_objectCount = 0;
+  Vec3Soa m_positions;
+  QuatSoa m_rotations;
+  Vec3Soa m_scales;
+  AlignedArray<uint32_t> m_parents;
+  AlignedArray<Mat4> m_worldMatrices;
+};
+
+#endif
@@ -1,11 +1,86 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#define LIGHTING_BUFFER_ACCESS readonly
+#include "lighting_common.glsl"
 
 layout(location = 0) in vec3 fragColour;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec2 fragUv;
+layout(location = 3) in vec3 fragPosition;
+layout(location = 4) flat in uint fragObject;
 
 layout(location = 0) out vec4 outColour;
 
+// Set through SpecializationConstants (see constants.hpp), so the unused
+// branches are compiled out of each pipeline.
+layout(constant_id = 0) const bool IS_NORMAL_VIEW_ENABLED = false;
+layout(constant_id = 1) const bool IS_LIGHTING_ENABLED = false;
+// Textures loaded, zero for untextured objects.
+layout(constant_id = 2) const uint TEXTURE_COUNT = 0;
+
+// Matches gfx/texture_streamer.hpp. Slots past the texture count hold a
+// white texture.
+const uint MAX_TEXTURES = 16;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[MAX_TEXTURES];
+
+const float AMBIENT = 0.1;
+
+// Sums the point lights binned into the pixel's cluster.
+vec3 shadeClustered(vec3 normal)
+{
+  vec3 lighting = vec3(AMBIENT);
+
+  uint cluster = getClusterIndex(fragPosition);
+  uint count = clusterLightCounts[cluster];
+  for (uint i = 0; i < count; i++) {
+    Light light = lights[clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER
+                                             + i]];
+    vec3 toLight = light.position - fragPosition;
+    float lightDistance = length(toLight);
+    float falloff = clamp(1.0 - lightDistance / light.radius, 0.0, 1.0);
+    float diffuse = max(dot(normal, toLight / max(lightDistance, 1e-4)), 0.0);
+    lighting += light.colour * (light.intensity * diffuse * falloff
+                                * falloff);
+  }
+
+  return lighting;
+}
+
+// Each object samples one of the textures. Objects of a draw may differ,
+// so the index is compared against each texture's instead of indexing the
+// array with it, and the gradients are taken outside of the branches.
+vec3 sampleTexture()
+{
+  uint index = fragObject % TEXTURE_COUNT;
+  vec2 uvDx = dFdx(fragUv);
+  vec2 uvDy = dFdy(fragUv);
+
+  vec3 colour = vec3(1.0);
+  for (uint i = 0; i < TEXTURE_COUNT; i++) {
+    if (i == index) {
+      colour = textureGrad(textures[i], fragUv, uvDx, uvDy).rgb;
+    }
+  }
+
+  return colour;
+}
+
 void main()
 {
-  outColour = vec4(fragColour, 1.0);
+  vec3 normal = normalize(fragNormal);
+  vec3 albedo = fragColour;
+  if (TEXTURE_COUNT > 0) {
+    albedo *= sampleTexture();
+  }
+
+  if (IS_NORMAL_VIEW_ENABLED) {
+    outColour = vec4(normal * 0.5 + 0.5, 1.0);
+  } else if (IS_LIGHTING_ENABLED) {
+    outColour = vec4(albedo * shadeClustered(normal), 1.0);
+  } else {
+    outColour = vec4(albedo, 1.0);
+  }
 }
@@ -0,0 +1,183 @@
+// Builds the depth pyramid in a single dispatch, in the manner of AMD's
+// single pass downsampler. Each group reduces a 64x64 tile of the depth,
+// writing levels 0 to 5 of it on the way down to one texel. The last group
+// to finish then reduces level 5, which has a texel per group, to levels 6
+// to 11 the same way, instead of a dispatch per level.
+//
+// Included by hiz_build.comp, which combines 2x2 blocks of texels with
+// subgroup quad operations, and by hiz_build_shared.comp, which goes
+// through shared memory for devices without them.
+
+#include "hiz_common.glsl"
+
+const uint GROUP_SIZE = 256;
+// Width and height of the part of the input a group reduces.
+const uint TILE_SIZE = 64;
+// Levels written by each reduction of a tile.
+const uint TILE_LEVEL_COUNT = 6;
+// Neutral value of min and max, for texels past the edge of the input.
+const vec2 EMPTY = vec2(1.0, 0.0);
+
+layout(local_size_x = GROUP_SIZE) in;
+
+PYRAMID_BUFFER_ACCESS layout(std430, set = 0, binding = 1) buffer Counter
+{
+  // Zeroed before the dispatch.
+  uint finishedGroupCount;
+};
+
+layout(set = 0, binding = 2) uniform sampler2D depth;
+
+layout(push_constant) uniform PushConstants
+{
+  uvec2 depthSize;
+  uvec2 capacity;
+} pushConstants;
+
+// Texels of the level being reduced, passed between steps.
+shared vec2 texels[GROUP_SIZE / 4];
+#ifndef IS_SUBGROUP_QUAD_ENABLED
+shared vec2 quads[GROUP_SIZE];
+#endif
+shared bool isLastGroup;
+
+// Index of the invocation, such that each four consecutive ones form a
+// quad. Ordered by subgroup when using quad operations.
+uint getInvocationIndex()
+{
+#ifdef IS_SUBGROUP_QUAD_ENABLED
+  return gl_SubgroupID * gl_SubgroupSize + gl_SubgroupInvocationID;
+#else
+  return gl_LocalInvocationIndex;
+#endif
+}
+
+// Position in a square of the item with the given index in Morton order,
+// so that each four consecutive items form a 2x2 block.
+uvec2 decodeMorton(uint index)
+{
+  uvec2 position = uvec2(index, index >> 1) & 0x55u;
+  position = (position | (position >> 1)) & 0x33u;
+  position = (position | (position >> 2)) & 0x0fu;
+
+  return position;
+}
+
+vec2 combine(vec2 a, vec2 b)
+{
+  return vec2(min(a.x, b.x), max(a.y, b.y));
+}
+
+// Combines the values of each quad, which every invocation of it returns.
+vec2 reduceQuad(vec2 value, uint index)
+{
+#ifdef IS_SUBGROUP_QUAD_ENABLED
+  value = combine(value, subgroupQuadSwapHorizontal(value));
+  return combine(value, subgroupQuadSwapVertical(value));
+#else
+  quads[index] = value;
+  barrier();
+  uint first = index & ~3u;
+  value = combine(combine(quads[first], quads[first + 1]),
+                  combine(quads[first + 2], quads[first + 3]));
+  barrier();
+
+  return value;
+#endif
+}
+
+// Texel of the input of a reduction starting at firstLevel, i.e. of the
+// depth for level 0, else of the level above.
+vec2 loadInput(uint firstLevel, uvec2 texel)
+{
+  if (firstLevel == 0) {
+    if (any(greaterThanEqual(texel, pushConstants.depthSize))) {
+      return EMPTY;
+    }
+    return vec2(texelFetch(depth, ivec2(texel), 0).r);
+  }
+
+  uint level = firstLevel - 1;
+  if (any(greaterThanEqual(
+        texel, getLevelSize(pushConstants.depthSize, level)))) {
+    return EMPTY;
+  }
+  return pyramid[getTexelIndex(pushConstants.capacity, level, texel)];
+}
+
+void storeTexel(uint level, uvec2 texel, vec2 value)
+{
+  if (all(lessThan(texel, getLevelSize(pushConstants.depthSize, level)))) {
+    pyramid[getTexelIndex(pushConstants.capacity, level, texel)] = value;
+  }
+}
+
+// Reduces a tile of the input into levels firstLevel to firstLevel + 5.
+// Must be called by the whole group, in uniform control flow.
+void reduceTile(uvec2 tile, uint firstLevel)
+{
+  uint index = getInvocationIndex();
+
+  // Each invocation reduces 4x4 input texels to 2x2 texels of the first
+  // level, and those to a texel of the second.
+  uvec2 texel = tile * (TILE_SIZE / 4) + decodeMorton(index);
+  vec2 value = EMPTY;
+  for (uint y = 0; y < 2; y++) {
+    for (uint x = 0; x < 2; x++) {
+      uvec2 firstTexel = texel * 2 + uvec2(x, y);
+      uvec2 source = firstTexel * 2;
+      vec2 firstValue = combine(
+        combine(loadInput(firstLevel, source),
+                loadInput(firstLevel, source + uvec2(1, 0))),
+        combine(loadInput(firstLevel, source + uvec2(0, 1)),
+                loadInput(firstLevel, source + uvec2(1, 1))));
+      storeTexel(firstLevel, firstTexel, firstValue);
+      value = combine(value, firstValue);
+    }
+  }
+  storeTexel(firstLevel + 1, texel, value);
+
+  // Each further level has a quarter of the texels. The first invocation
+  // of each quad writes the quad's texel, and the texels are spread back
+  // over the first invocations for the next level.
+  uint texelCount = GROUP_SIZE;
+  for (uint i = 2; i < TILE_LEVEL_COUNT; i++) {
+    value = reduceQuad(value, index);
+    texelCount /= 4;
+
+    uint texelIndex = index / 4;
+    if (index % 4 == 0 && texelIndex < texelCount) {
+      uvec2 levelTile = tile * (TILE_SIZE >> (i + 1));
+      storeTexel(firstLevel + i, levelTile + decodeMorton(texelIndex),
+                 value);
+      texels[texelIndex] = value;
+    }
+    barrier();
+    value = texels[index % texelCount];
+    barrier();
+  }
+}
+
+void main()
+{
+  reduceTile(gl_WorkGroupID.xy, 0);
+
+  // Makes the group's texels visible to the last group, before counting
+  // the group as finished.
+  memoryBarrierBuffer();
+  barrier();
+  if (gl_LocalInvocationIndex == 0) {
+    uint groupCount = gl_NumWorkGroups.x * gl_NumWorkGroups.y;
+    isLastGroup = atomicAdd(finishedGroupCount, 1) == groupCount - 1;
+  }
+  barrier();
+
+  if (!isLastGroup) {
+    return;
+  }
+
+  // Level 5 has at most MAX_DEPTH_SIZE / TILE_SIZE texels across, so it
+  // fits in one tile.
+  memoryBarrierBuffer();
+  reduceTile(uvec2(0), TILE_LEVEL_COUNT);
+}
@@ -0,0 +1,42 @@
+// Shared by the depth pyramid shaders (see gfx/occlusion_culling.hpp).
+// Each texel of the pyramid holds the min and max depth of the pixels it
+// covers. Level 0 is half the depth resolution, rounded up, and each level
+// halves the previous one down to a single texel.
+//
+// The levels are packed one after another in a buffer, each laid out for
+// the largest depth the pyramid is built from (its capacity). Smaller
+// depths use the top left part of each level.
+
+const uint PYRAMID_LEVEL_COUNT = 12;
+// Largest width and height of the depth, which the levels reduce to a
+// single texel.
+const uint MAX_DEPTH_SIZE = 4096;
+
+// Only the build writes the pyramid, the cull defines this as readonly.
+#ifndef PYRAMID_BUFFER_ACCESS
+#define PYRAMID_BUFFER_ACCESS
+#endif
+
+PYRAMID_BUFFER_ACCESS layout(std430, set = 0, binding = 0) buffer Pyramid
+{
+  // Min depth in x, max depth in y.
+  vec2 pyramid[];
+};
+
+// Size of a level of the pyramid of a depth of the given size.
+uvec2 getLevelSize(uvec2 depthSize, uint level)
+{
+  uint divisor = 2u << level;
+  return (depthSize + divisor - 1u) / divisor;
+}
+
+uint getTexelIndex(uvec2 capacity, uint level, uvec2 texel)
+{
+  uint offset = 0;
+  for (uint i = 0; i < level; i++) {
+    uvec2 size = getLevelSize(capacity, i);
+    offset += size.x * size.y;
+  }
+
+  return offset + texel.y * getLevelSize(capacity, level).x + texel.x;
+}
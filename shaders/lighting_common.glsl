@@ -0,0 +1,60 @@
+// Shared by the clustered lighting shaders (see gfx/clustered_lighting.hpp).
+// The scene has no camera, so view space is the clip space the vertex
+// shader outputs, and the clusters split the box below uniformly.
+
+const uvec3 CLUSTER_COUNTS = uvec3(16, 16, 16);
+const uint CLUSTER_COUNT = CLUSTER_COUNTS.x * CLUSTER_COUNTS.y
+                           * CLUSTER_COUNTS.z;
+const vec3 CLUSTER_MIN = vec3(-1.0, -1.0, -1.0);
+const vec3 CLUSTER_MAX = vec3(1.0, 1.0, 1.0);
+// Lights past this many in a cluster are dropped.
+const uint MAX_LIGHTS_PER_CLUSTER = 128;
+
+// Only the binning pass writes the cluster lists, fragment shaders define
+// this as readonly.
+#ifndef LIGHTING_BUFFER_ACCESS
+#define LIGHTING_BUFFER_ACCESS
+#endif
+
+struct Light
+{
+  vec3 position;
+  float radius;
+  vec3 colour;
+  float intensity;
+};
+
+readonly layout(std430, set = 0, binding = 0) buffer Lights
+{
+  Light lights[];
+};
+
+// Number of lights in each cluster.
+LIGHTING_BUFFER_ACCESS layout(std430, set = 0, binding = 1)
+  buffer ClusterLightCounts
+{
+  uint clusterLightCounts[];
+};
+
+// MAX_LIGHTS_PER_CLUSTER light indices per cluster, of which the first
+// clusterLightCounts are used.
+LIGHTING_BUFFER_ACCESS layout(std430, set = 0, binding = 2)
+  buffer ClusterLightIndices
+{
+  uint clusterLightIndices[];
+};
+
+uint getClusterIndex(uvec3 cluster)
+{
+  return cluster.x + CLUSTER_COUNTS.x * (cluster.y + CLUSTER_COUNTS.y
+                                                     * cluster.z);
+}
+
+uint getClusterIndex(vec3 position)
+{
+  vec3 t = (position - CLUSTER_MIN) / (CLUSTER_MAX - CLUSTER_MIN);
+  uvec3 cluster = uvec3(clamp(t * vec3(CLUSTER_COUNTS), vec3(0.0),
+                              vec3(CLUSTER_COUNTS - 1)));
+
+  return getClusterIndex(cluster);
+}
@@ -0,0 +1,74 @@
+// Shared by the particle shaders (see gfx/particle_system.hpp). Particle
+// state is stored as structure-of-arrays, twice, since each frame reads one
+// half and writes the other. Indices into the arrays are particle ids.
+
+const uint PARTICLE_GROUP_SIZE = 64;
+
+// Vertex shaders may not write storage buffers unless the device enables
+// vertexPipelineStoresAndAtomics, so they define this as readonly.
+#ifndef PARTICLE_BUFFER_ACCESS
+#define PARTICLE_BUFFER_ACCESS
+#endif
+
+struct DrawIndirectCommand
+{
+  uint vertexCount;
+  uint instanceCount;
+  uint firstVertex;
+  uint firstInstance;
+};
+
+PARTICLE_BUFFER_ACCESS layout(std430, set = 0, binding = 0) buffer Counters
+{
+  int freeCount;
+  uint pad0;
+  uint pad1;
+  uint pad2;
+  uvec4 simulateDispatch;
+  // The instance count of each half is its number of live particles.
+  DrawIndirectCommand draws[2];
+} counters;
+
+// xyz is the position, w the age in seconds.
+PARTICLE_BUFFER_ACCESS layout(std430, set = 0, binding = 1) buffer Positions
+{
+  vec4 positions[];
+};
+
+// xyz is the velocity, w the lifetime in seconds.
+PARTICLE_BUFFER_ACCESS layout(std430, set = 0, binding = 2) buffer Velocities
+{
+  vec4 velocities[];
+};
+
+// Ids of the live particles of each half, packed at the front.
+PARTICLE_BUFFER_ACCESS layout(std430, set = 0, binding = 3) buffer AliveIds
+{
+  uint aliveIds[];
+};
+
+// Stack of the ids of dead particles, counters.freeCount long.
+PARTICLE_BUFFER_ACCESS layout(std430, set = 0, binding = 4) buffer FreeIds
+{
+  uint freeIds[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+  uint capacity;
+  // The half read this frame. The other half is written, and drawn.
+  uint readHalf;
+  uint emitCount;
+  uint seed;
+  float deltaTime;
+} pushConstants;
+
+uint readOffset()
+{
+  return pushConstants.readHalf * pushConstants.capacity;
+}
+
+uint writeOffset()
+{
+  return (1 - pushConstants.readHalf) * pushConstants.capacity;
+}
@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec4 fragColour;
+layout(location = 1) in vec2 fragOffset;
+
+layout(location = 0) out vec4 outColour;
+
+void main()
+{
+  // Round, soft-edged particles, blended additively.
+  float falloff = max(1.0 - dot(fragOffset, fragOffset), 0.0);
+  outColour = vec4(fragColour.rgb * fragColour.a * falloff, 1.0);
+}
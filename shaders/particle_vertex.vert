@@ -0,0 +1,31 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define PARTICLE_BUFFER_ACCESS readonly
+#include "particle_common.glsl"
+
+layout(location = 0) out vec4 fragColour;
+layout(location = 1) out vec2 fragOffset;
+
+const float PARTICLE_SIZE = 0.004;
+
+const vec2 CORNERS[6] = vec2[](
+  vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+  vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+
+// Draws one quad per live particle of the written half. There are no
+// vertex buffers, the instance index picks the particle.
+void main()
+{
+  uint id = aliveIds[writeOffset() + gl_InstanceIndex];
+  vec4 position = positions[writeOffset() + id];
+  float lifetime = velocities[writeOffset() + id].w;
+  float t = clamp(position.w / lifetime, 0.0, 1.0);
+
+  vec2 corner = CORNERS[gl_VertexIndex];
+  gl_Position = vec4(position.xy + corner * PARTICLE_SIZE, position.z, 1.0);
+  fragColour = vec4(mix(vec3(1.0, 0.8, 0.3), vec3(0.8, 0.1, 0.05), t),
+                    1.0 - t);
+  fragOffset = corner;
+}
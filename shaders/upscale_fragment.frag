@@ -0,0 +1,19 @@
+#version 450
+
+layout(push_constant) uniform PushConstants
+{
+  vec2 uvScale;
+  vec2 uvMax;
+};
+
+layout(set = 0, binding = 0) uniform sampler2D sceneImage;
+
+layout(location = 0) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColour;
+
+void main()
+{
+  // Bilinear upscale of the rendered part of the scene image.
+  outColour = texture(sceneImage, min(fragUv, uvMax));
+}
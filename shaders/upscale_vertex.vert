@@ -0,0 +1,20 @@
+#version 450
+
+// Shared with upscale_fragment.frag.
+layout(push_constant) uniform PushConstants
+{
+  // Part of the scene image covered by this frame's render resolution.
+  vec2 uvScale;
+  // Centre of its last texel, so that filtering stays inside it.
+  vec2 uvMax;
+};
+
+layout(location = 0) out vec2 fragUv;
+
+void main()
+{
+  // A triangle covering the whole viewport, without vertex input.
+  vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+  fragUv = position * uvScale;
+  gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -1,20 +1,40 @@
 #version 450
 
-vec2 positions[3] = {
-  vec2( 0.0, -0.5),
-  vec2( 0.5,  0.5),
-  vec2(-0.5,  0.5)
-};
-vec3 colours[3] = {
-  vec3(1.0, 0.0, 0.0),
-  vec3(0.0, 1.0, 0.0),
-  vec3(0.0, 0.0, 1.0)
-};
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inUv;
+layout(location = 3) in vec4 inColour;
+// Per instance, from the scene (see scene/scene.hpp).
+layout(location = 4) in mat4 inModel;
+// Per instance, from the occlusion culling (see ds/Instance.hpp).
+layout(location = 8) in uint inObject;
 
 layout(location = 0) out vec3 fragColour;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragUv;
+// View space position, for lighting.
+layout(location = 3) out vec3 fragPosition;
+layout(location = 4) flat out uint fragObject;
+
+// The depth prepass and the colour subpass must compute the same depth.
+invariant gl_Position;
+
+// Decodes a normal stored in octahedral encoding (see utils/quantize.hpp).
+vec3 decodeOctahedral(vec2 e)
+{
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+
+  return normalize(n);
+}
 
 void main()
 {
-  gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-  fragColour = colours[gl_VertexIndex];
+  gl_Position = inModel * vec4(inPosition.xyz, 1.0);
+  fragColour = inColour.rgb;
+  fragNormal = decodeOctahedral(inNormal);
+  fragUv = inUv;
+  fragPosition = gl_Position.xyz;
+  fragObject = inObject;
 }
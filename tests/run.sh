@@ -0,0 +1,235 @@
+#!/bin/sh
+# Renders each test case headless on a software Vulkan driver, compares the
+# captured frame against its golden image and the startup and frame times
+# against the stored baseline. With --bless, the outputs become the new
+# golden images and baselines instead.
+#
+# Baselines are only comparable on the machine they were recorded on, so
+# bless them on the build machine after changes that are expected to move
+# them. A case without a golden image or baseline fails, since it checks
+# nothing.
+
+set -u
+
+cd "$(dirname "$0")/.."
+
+OUTPUT_DIR=tests/output
+GOLDEN_DIR=tests/golden
+BASELINE_DIR=tests/baseline
+
+# The image run is short; the captured frame is its last one.
+IMAGE_FRAME_COUNT=10
+CAPTURED_FRAME=000009
+PERF_FRAME_COUNT=300
+
+PERF_THRESHOLD=${PERF_THRESHOLD:-0.25}
+IMAGE_TOLERANCE=${IMAGE_TOLERANCE:-2}
+
+IS_BLESSING=0
+if [ "${1:-}" = "--bless" ]; then
+  IS_BLESSING=1
+fi
+
+# Prefer lavapipe, then SwiftShader, unless a driver was picked already.
+if [ -z "${VK_ICD_FILENAMES:-}" ]; then
+  for icd in /usr/share/vulkan/icd.d/lvp_icd*.json \
+             /usr/share/vulkan/icd.d/vk_swiftshader_icd.json \
+             /usr/local/share/vulkan/icd.d/vk_swiftshader_icd.json; do
+    if [ -f "$icd" ]; then
+      VK_ICD_FILENAMES=$icd
+      break
+    fi
+  done
+fi
+if [ -z "${VK_ICD_FILENAMES:-}" ]; then
+  echo "No software Vulkan driver found; install lavapipe" \
+       "(mesa-vulkan-drivers) or SwiftShader."
+  exit 1
+fi
+export VK_ICD_FILENAMES
+echo "Using $VK_ICD_FILENAMES"
+
+# GLFW needs a display for the window surface.
+run_app() {
+  if [ -n "${DISPLAY:-}" ]; then
+    ./bin/vk-app > "$1" 2>&1
+  else
+    xvfb-run -a -s "-screen 0 1280x1024x24" ./bin/vk-app > "$1" 2>&1
+  fi
+}
+
+# The app of the current case, given its log file.
+run_case_app() {
+  if [ -n "$replay_trace" ]; then
+    ./bin/replay "$replay_trace" > "$1" 2>&1
+  else
+    run_app "$1"
+  fi
+}
+
+failure_count=0
+
+fail() {
+  echo "FAIL: $1"
+  failure_count=$((failure_count + 1))
+}
+
+# Usage: run_case [--no-image] [--replay <trace>] <name> [VAR=value...]
+# With --no-image, the captured frame is not compared, for cases whose
+# frames depend on the frame times. With --replay, the trace is drawn by
+# bin/replay, which is headless, instead of bin/vk-app.
+run_case() {
+  is_image_checked=1
+  replay_trace=
+  while true; do
+    case $1 in
+      --no-image) is_image_checked=0; shift ;;
+      --replay) replay_trace=$2; shift 2 ;;
+      *) break ;;
+    esac
+  done
+  name=$1
+  shift
+  case_dir=$OUTPUT_DIR/$name
+
+  # Several headless sessions write their files with the session index
+  # before the extension. Those of the first session are checked.
+  session_suffix=
+  for setting in "$@"; do
+    case $setting in
+      VK_APP_SESSIONS=0|VK_APP_SESSIONS=1) ;;
+      VK_APP_SESSIONS=*) session_suffix=_0 ;;
+    esac
+  done
+
+  rm -rf "$case_dir"
+  mkdir -p "$case_dir"
+
+  echo "== $name"
+
+  if ! (export "$@" VK_APP_FRAME_LIMIT=$IMAGE_FRAME_COUNT \
+                VK_APP_CAPTURE="$case_dir/frame.png";
+        run_case_app "$case_dir/image.log"); then
+    fail "$name crashed, see $case_dir/image.log"
+    return
+  fi
+
+  if ! (export "$@" VK_APP_FRAME_LIMIT=$PERF_FRAME_COUNT \
+                VK_APP_STATS="$case_dir/stats.txt";
+        run_case_app "$case_dir/perf.log"); then
+    fail "$name crashed, see $case_dir/perf.log"
+    return
+  fi
+
+  frame=$case_dir/frame${session_suffix}_$CAPTURED_FRAME.png
+  stats=$case_dir/stats$session_suffix.txt
+  golden=$GOLDEN_DIR/$name.png
+  baseline=$BASELINE_DIR/$name.txt
+
+  if [ "$IS_BLESSING" = 1 ]; then
+    if [ "$is_image_checked" = 1 ]; then
+      cp "$frame" "$golden"
+      echo "Blessed $golden"
+    fi
+    cp "$stats" "$baseline"
+    echo "Blessed $baseline"
+    return
+  fi
+
+  if [ "$is_image_checked" = 1 ]; then
+    if [ -f "$golden" ]; then
+      ./bin/regress image --tolerance "$IMAGE_TOLERANCE" "$frame" \
+                    "$golden" \
+        || fail "$name image differs from $golden"
+    else
+      fail "$name has no golden image; run make test-bless"
+    fi
+  fi
+
+  if [ -f "$baseline" ]; then
+    ./bin/regress metrics --threshold "$PERF_THRESHOLD" \
+                  "$stats" "$baseline" \
+      || fail "$name regressed against $baseline"
+  else
+    fail "$name has no baseline; run make test-bless"
+  fi
+}
+
+run_case default
+run_case normal-view VK_APP_NORMAL_VIEW=1
+# Particles are simulated up to the time of each frame.
+run_case --no-image particles VK_APP_PARTICLES=100000
+run_case objects VK_APP_OBJECTS=100
+run_case lights VK_APP_LIGHTS=256 VK_APP_OBJECTS=100
+# The resolution is picked from the GPU times.
+run_case --no-image dynamic-resolution VK_APP_TARGET_FPS=1000
+# Half of the objects circle behind the triangle, which hides them.
+run_case occlusion-culling VK_APP_OBJECTS=10000
+run_case cpu-culling VK_APP_OBJECTS=10000 VK_APP_CPU_CULLING=1
+
+# The textures are packed from the frame of the default case, as RGBA8,
+# with mips generated on load, and as BC1 with its full mip chain.
+run_texture_case() {
+  name=$1
+  shift
+  texture=$OUTPUT_DIR/$name.tex
+  if ./bin/texpack "$@" "$OUTPUT_DIR/default/frame_$CAPTURED_FRAME.png" \
+                   "$texture" > "$OUTPUT_DIR/$name.log" 2>&1; then
+    run_case "$name" VK_APP_OBJECTS=100 VK_APP_TEXTURES="$texture"
+  else
+    fail "$name could not pack its texture, see $OUTPUT_DIR/$name.log"
+  fi
+}
+
+run_texture_case textures
+run_texture_case textures-bc1 --bc1
+
+# A cube, optimized by meshopt, drawn in place of the triangle.
+mesh=$OUTPUT_DIR/cube.mesh
+cat > "$OUTPUT_DIR/cube.obj" <<EOF
+v -1 -1 -1
+v 1 -1 -1
+v 1 1 -1
+v -1 1 -1
+v -1 -1 1
+v 1 -1 1
+v 1 1 1
+v -1 1 1
+vn 0 0 1
+vn 0 0 -1
+vn 1 0 0
+vn -1 0 0
+vn 0 1 0
+vn 0 -1 0
+f 5//1 6//1 7//1 8//1
+f 2//2 1//2 4//2 3//2
+f 6//3 2//3 3//3 7//3
+f 1//4 5//4 8//4 4//4
+f 8//5 7//5 3//5 4//5
+f 1//6 2//6 6//6 5//6
+EOF
+if ./bin/meshopt "$OUTPUT_DIR/cube.obj" "$mesh" \
+     > "$OUTPUT_DIR/mesh.log" 2>&1; then
+  run_case mesh VK_APP_MESH="$mesh" VK_APP_OBJECTS=100
+else
+  fail "mesh could not be optimized, see $OUTPUT_DIR/mesh.log"
+fi
+
+run_case sessions VK_APP_SESSIONS=2
+
+# The replayed trace is recorded by a run as long as the performance one,
+# with the same settings.
+trace=$OUTPUT_DIR/trace.vkft
+if (export VK_APP_OBJECTS=100 VK_APP_FRAME_LIMIT=$PERF_FRAME_COUNT \
+           VK_APP_TRACE="$trace";
+    run_app "$OUTPUT_DIR/trace.log"); then
+  run_case --replay "$trace" replay
+else
+  fail "replay could not record its trace, see $OUTPUT_DIR/trace.log"
+fi
+
+if [ "$failure_count" -gt 0 ]; then
+  echo "$failure_count check(s) failed."
+  exit 1
+fi
+echo "All checks passed."
@@ -0,0 +1,161 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "../../ds/DrawList.hpp"
+#include "../../ds/Frustum.hpp"
+#include "../../ds/Mat4.hpp"
+#include "../../scene/culling.hpp"
+#include "../../utils/simd.hpp"
+
+static constexpr size_t DEFAULT_OBJECT_COUNT = 100000;
+static constexpr int DEFAULT_ITERATION_COUNT = 100;
+
+static constexpr float FOV_Y = 1.0471976f;
+static constexpr float NEAR_PLANE = 0.1f;
+static constexpr float FAR_PLANE = 500.f;
+static constexpr float VIEWPORT_HEIGHT = 1080.f;
+
+// Objects are spread around the camera, which looks down -z, so that about
+// a tenth of them are visible.
+static constexpr float SCENE_EXTENT = 400.f;
+
+static Mat4 createProjection(float aspectRatio)
+{
+  float f = 1.f / std::tan(FOV_Y / 2.f);
+
+  Mat4 projection{};
+  projection.m[0] = f / aspectRatio;
+  projection.m[5] = -f;
+  projection.m[10] = FAR_PLANE / (NEAR_PLANE - FAR_PLANE);
+  projection.m[11] = -1.f;
+  projection.m[14] = NEAR_PLANE * FAR_PLANE / (NEAR_PLANE - FAR_PLANE);
+
+  return projection;
+}
+
+static size_t countObjects(const DrawList& drawList)
+{
+  size_t count = 0;
+  for (const std::vector<uint32_t>& objects : drawList.objects) {
+    count += objects.size();
+  }
+
+  return count;
+}
+
+static bool isSameDrawList(const DrawList& a, const DrawList& b)
+{
+  for (uint32_t i = 0; i < MAX_LOD_COUNT; i++) {
+    if (a.objects[i] != b.objects[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Returns the fastest of the runs in nanoseconds per object, which is the
+// least disturbed by the rest of the system.
+template<typename Cull>
+static double measure(Cull cull, size_t objectCount, int iterationCount)
+{
+  double best = INFINITY;
+  for (int i = 0; i < iterationCount; i++) {
+    auto start = std::chrono::steady_clock::now();
+    cull();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::nano>(
+                            end - start).count());
+  }
+
+  return best / objectCount;
+}
+
+static void printResult(const char* name,
+                        double scalarTime,
+                        double simdTime,
+                        const DrawList& drawList,
+                        bool isMatching)
+{
+  std::cout << std::left << std::setw(8) << name << std::right
+            << std::fixed << std::setprecision(2)
+            << std::setw(10) << scalarTime << " ns"
+            << std::setw(10) << simdTime << " ns"
+            << std::setw(8) << scalarTime / simdTime << "x"
+            << std::setw(10) << countObjects(drawList)
+            << (isMatching ? "" : "  MISMATCH") << '\n';
+}
+
+int main(int argc, char** argv)
+{
+  size_t objectCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+                                : DEFAULT_OBJECT_COUNT;
+  int iterationCount = argc > 2 ? std::atoi(argv[2])
+                                : DEFAULT_ITERATION_COUNT;
+  if (objectCount == 0 || iterationCount <= 0) {
+    std::cerr << "Usage: cullbench [object count] [iteration count]\n";
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(-SCENE_EXTENT / 2.f,
+                                                 SCENE_EXTENT / 2.f);
+  std::uniform_real_distribution<float> size(0.1f, 4.f);
+
+  SphereBounds spheres;
+  AabbBounds aabbs;
+  spheres.resize(objectCount);
+  aabbs.resize(objectCount);
+  for (size_t i = 0; i < objectCount; i++) {
+    aabbs.centerX[i] = spheres.x[i] = position(random);
+    aabbs.centerY[i] = spheres.y[i] = position(random);
+    aabbs.centerZ[i] = spheres.z[i] = position(random);
+    aabbs.extentX[i] = size(random);
+    aabbs.extentY[i] = size(random);
+    aabbs.extentZ[i] = size(random);
+    spheres.radius[i] = size(random);
+  }
+
+  Frustum frustum = extractFrustum(createProjection(16.f / 9.f));
+
+  LodSelection lodSelection{};
+  lodSelection.projectionScale = VIEWPORT_HEIGHT
+                                 / (2.f * std::tan(FOV_Y / 2.f));
+  lodSelection.thresholds[0] = 64.f;
+  lodSelection.thresholds[1] = 16.f;
+  lodSelection.thresholds[2] = 4.f;
+  lodSelection.lodCount = MAX_LOD_COUNT;
+
+  DrawList scalarDrawList;
+  DrawList simdDrawList;
+
+  std::cout << objectCount << " objects, " << FloatN::WIDTH
+            << "-wide SIMD, best of " << iterationCount << " runs\n"
+            << "bounds      scalar      SIMD speedup   visible\n";
+
+  double scalarTime = measure([&]() {
+    cullSpheres<Float1>(spheres, frustum, lodSelection, scalarDrawList);
+  }, objectCount, iterationCount);
+  double simdTime = measure([&]() {
+    cullSpheres<FloatN>(spheres, frustum, lodSelection, simdDrawList);
+  }, objectCount, iterationCount);
+  bool isSphereMatching = isSameDrawList(scalarDrawList, simdDrawList);
+  printResult("sphere", scalarTime, simdTime, simdDrawList,
+              isSphereMatching);
+
+  scalarTime = measure([&]() {
+    cullAabbs<Float1>(aabbs, frustum, lodSelection, scalarDrawList);
+  }, objectCount, iterationCount);
+  simdTime = measure([&]() {
+    cullAabbs<FloatN>(aabbs, frustum, lodSelection, simdDrawList);
+  }, objectCount, iterationCount);
+  bool isAabbMatching = isSameDrawList(scalarDrawList, simdDrawList);
+  printResult("aabb", scalarTime, simdTime, simdDrawList, isAabbMatching);
+
+  return isSphereMatching && isAabbMatching ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "../../ds/MeshData.hpp"
+#include "../../utils/mesh.hpp"
+#include "obj.hpp"
+#include "optimizer.hpp"
+
+static constexpr float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+// Cache size used to report the ACMR. Most current hardware behaves roughly
+// like a FIFO cache of this size.
+static constexpr size_t REPORT_CACHE_SIZE = 16;
+
+static void printUsage()
+{
+  std::cerr << "Usage: meshopt [--overdraw-threshold <value>] [--no-overdraw] "
+            << "<input.obj> <output.mesh>\n";
+}
+
+int main(int argc, char** argv)
+{
+  float overdrawThreshold = DEFAULT_OVERDRAW_THRESHOLD;
+  bool isOverdrawOptimizationEnabled = true;
+  std::string inputFileName;
+  std::string outputFileName;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--overdraw-threshold") == 0 && i + 1 < argc) {
+      overdrawThreshold = std::strtof(argv[++i], nullptr);
+    } else if (std::strcmp(argv[i], "--no-overdraw") == 0) {
+      isOverdrawOptimizationEnabled = false;
+    } else if (inputFileName.empty()) {
+      inputFileName = argv[i];
+    } else if (outputFileName.empty()) {
+      outputFileName = argv[i];
+    } else {
+      printUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (inputFileName.empty() || outputFileName.empty()) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  try {
+    MeshData mesh = loadObj(inputFileName);
+    float initialAcmr = analyzeVertexCache(mesh.indices, mesh.vertices.size(),
+                                           REPORT_CACHE_SIZE);
+
+    mesh.indices = optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    if (isOverdrawOptimizationEnabled) {
+      mesh.indices = optimizeOverdraw(mesh.indices, mesh.vertices,
+                                      overdrawThreshold);
+    }
+    optimizeVertexFetch(mesh.vertices, mesh.indices);
+    buildMeshlets(mesh);
+
+    float finalAcmr = analyzeVertexCache(mesh.indices, mesh.vertices.size(),
+                                         REPORT_CACHE_SIZE);
+
+    writeMesh(outputFileName, mesh);
+
+    std::cout << "Vertices: " << mesh.vertices.size() << "\n"
+              << "Triangles: " << mesh.indices.size() / 3 << "\n"
+              << "Meshlets: " << mesh.meshlets.size() << "\n"
+              << "ACMR: " << initialAcmr << " -> " << finalAcmr << "\n";
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
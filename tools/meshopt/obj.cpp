@@ -0,0 +1,110 @@
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "obj.hpp"
+
+// Resolves a 1-based (or negative, relative) OBJ index into a 0-based one,
+// or -1 for 0, which marks a missing index.
+static int resolveObjIndex(int index, size_t count)
+{
+  if (index > 0) {
+    return index - 1;
+  } else if (index < 0) {
+    return static_cast<int>(count) + index;
+  }
+
+  return -1;
+}
+
+MeshData loadObj(const std::string& fileName)
+{
+  std::ifstream file(fileName);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file.");
+  }
+
+  std::vector<std::array<float, 3>> positions;
+  std::vector<std::array<float, 3>> normals;
+  std::vector<std::array<float, 2>> uvs;
+
+  MeshData mesh;
+  std::map<std::array<int, 3>, uint32_t> uniqueVertices;
+
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream stream(line);
+    std::string keyword;
+    stream >> keyword;
+
+    if (keyword == "v") {
+      std::array<float, 3> p{};
+      stream >> p[0] >> p[1] >> p[2];
+      positions.push_back(p);
+    } else if (keyword == "vn") {
+      std::array<float, 3> n{};
+      stream >> n[0] >> n[1] >> n[2];
+      normals.push_back(n);
+    } else if (keyword == "vt") {
+      std::array<float, 2> uv{};
+      stream >> uv[0] >> uv[1];
+      uvs.push_back(uv);
+    } else if (keyword == "f") {
+      std::vector<uint32_t> face;
+      std::string corner;
+      while (stream >> corner) {
+        // Corners are "v", "v/vt", "v//vn" or "v/vt/vn". Missing ones stay
+        // 0, which is not a valid OBJ index, and resolve to -1.
+        std::array<int, 3> key = { 0, 0, 0 };
+        std::istringstream cornerStream(corner);
+        std::string part;
+        for (size_t i = 0; i < 3 && std::getline(cornerStream, part, '/');
+             i++) {
+          if (!part.empty()) {
+            key[i] = std::stoi(part);
+          }
+        }
+
+        key[0] = resolveObjIndex(key[0], positions.size());
+        key[1] = resolveObjIndex(key[1], uvs.size());
+        key[2] = resolveObjIndex(key[2], normals.size());
+        if (key[0] < 0 || key[0] >= static_cast<int>(positions.size())) {
+          throw std::runtime_error("OBJ face references a missing vertex.");
+        }
+
+        auto it = uniqueVertices.find(key);
+        if (it == uniqueVertices.end()) {
+          MeshVertex vertex{};
+          std::copy(positions[key[0]].begin(), positions[key[0]].end(),
+                    vertex.position);
+          if (key[1] >= 0 && key[1] < static_cast<int>(uvs.size())) {
+            std::copy(uvs[key[1]].begin(), uvs[key[1]].end(), vertex.uv);
+          }
+          if (key[2] >= 0 && key[2] < static_cast<int>(normals.size())) {
+            std::copy(normals[key[2]].begin(), normals[key[2]].end(),
+                      vertex.normal);
+          }
+
+          uint32_t index = static_cast<uint32_t>(mesh.vertices.size());
+          mesh.vertices.push_back(vertex);
+          it = uniqueVertices.emplace(key, index).first;
+        }
+
+        face.push_back(it->second);
+      }
+
+      for (size_t i = 2; i < face.size(); i++) {
+        mesh.indices.push_back(face[0]);
+        mesh.indices.push_back(face[i - 1]);
+        mesh.indices.push_back(face[i]);
+      }
+    }
+  }
+
+  return mesh;
+}
@@ -0,0 +1,12 @@
+#ifndef OBJ_HPP
+#define OBJ_HPP
+
+#include <string>
+
+#include "../../ds/MeshData.hpp"
+
+// Loads the positions, normals and texture coordinates of a Wavefront OBJ
+// file into an indexed triangle mesh. Polygons are triangulated as fans.
+MeshData loadObj(const std::string& fileName);
+
+#endif
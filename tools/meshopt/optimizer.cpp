@@ -0,0 +1,561 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "optimizer.hpp"
+
+static constexpr size_t FORSYTH_CACHE_SIZE = 32;
+static constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static constexpr float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.f;
+static constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+// Cache size used to find cluster boundaries for overdraw optimization. This
+// is smaller than the Forsyth cache to approximate real hardware.
+static constexpr size_t OVERDRAW_CACHE_SIZE = 16;
+
+static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+static float computeVertexScore(int cachePosition, uint32_t numRemainingTris)
+{
+  if (numRemainingTris == 0) {
+    return -1.f;
+  }
+
+  float score = 0.f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // The vertices of the last triangle get a fixed score so that the
+      // next triangle does not simply reuse the same edge over and over.
+      score = FORSYTH_LAST_TRIANGLE_SCORE;
+    } else {
+      float scale = 1.f / (FORSYTH_CACHE_SIZE - 3);
+      score = 1.f - (cachePosition - 3) * scale;
+      score = std::pow(score, FORSYTH_CACHE_DECAY_POWER);
+    }
+  }
+
+  // Boost vertices with few remaining triangles so that they are finished
+  // off instead of being left as isolated triangles.
+  float valenceBoost = std::pow(static_cast<float>(numRemainingTris),
+                                -FORSYTH_VALENCE_BOOST_POWER);
+  score += FORSYTH_VALENCE_BOOST_SCALE * valenceBoost;
+
+  return score;
+}
+
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices,
+                                          size_t vertexCount)
+{
+  size_t triCount = indices.size() / 3;
+
+  // Build the vertex-to-triangle adjacency.
+  std::vector<uint32_t> triOffsets(vertexCount + 1, 0);
+  for (uint32_t index : indices) {
+    triOffsets[index + 1]++;
+  }
+  std::partial_sum(triOffsets.begin(), triOffsets.end(), triOffsets.begin());
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> cursors(triOffsets.begin(), triOffsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++) {
+    adjacency[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  std::vector<uint32_t> numRemainingTris(vertexCount);
+  std::vector<int> cachePositions(vertexCount, -1);
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    numRemainingTris[v] = triOffsets[v + 1] - triOffsets[v];
+    vertexScores[v] = computeVertexScore(-1, numRemainingTris[v]);
+  }
+
+  std::vector<float> triScores(triCount);
+  std::vector<bool> isTriEmitted(triCount, false);
+  for (size_t t = 0; t < triCount; t++) {
+    triScores[t] = vertexScores[indices[t * 3]]
+                   + vertexScores[indices[t * 3 + 1]]
+                   + vertexScores[indices[t * 3 + 2]];
+  }
+
+  uint32_t bestTri = INVALID_INDEX;
+  if (triCount > 0) {
+    bestTri = static_cast<uint32_t>(
+      std::max_element(triScores.begin(), triScores.end())
+      - triScores.begin());
+  }
+
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> newCache;
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+
+  size_t fallbackCursor = 0;
+  while (output.size() < indices.size()) {
+    if (bestTri == INVALID_INDEX) {
+      // No triangle touches the cache anymore, so continue with the next
+      // triangle that has not been emitted yet.
+      while (isTriEmitted[fallbackCursor]) {
+        fallbackCursor++;
+      }
+      bestTri = static_cast<uint32_t>(fallbackCursor);
+    }
+
+    isTriEmitted[bestTri] = true;
+
+    newCache.clear();
+    for (size_t k = 0; k < 3; k++) {
+      uint32_t v = indices[bestTri * 3 + k];
+      output.push_back(v);
+      numRemainingTris[v]--;
+      newCache.push_back(v);
+    }
+
+    for (uint32_t v : cache) {
+      if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+        newCache.push_back(v);
+      }
+    }
+
+    // Vertices pushed out of the cache lose their cache score.
+    for (size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); i++) {
+      uint32_t v = newCache[i];
+      cachePositions[v] = -1;
+      vertexScores[v] = computeVertexScore(-1, numRemainingTris[v]);
+    }
+    if (newCache.size() > FORSYTH_CACHE_SIZE) {
+      newCache.resize(FORSYTH_CACHE_SIZE);
+    }
+
+    for (size_t i = 0; i < newCache.size(); i++) {
+      uint32_t v = newCache[i];
+      cachePositions[v] = static_cast<int>(i);
+      vertexScores[v] = computeVertexScore(cachePositions[v],
+                                           numRemainingTris[v]);
+    }
+
+    std::swap(cache, newCache);
+
+    // Only triangles touching the cache can have changed score, so the next
+    // triangle is picked from those.
+    bestTri = INVALID_INDEX;
+    float bestScore = -1.f;
+    for (uint32_t v : cache) {
+      for (uint32_t i = triOffsets[v]; i < triOffsets[v + 1]; i++) {
+        uint32_t t = adjacency[i];
+        if (isTriEmitted[t]) {
+          continue;
+        }
+
+        triScores[t] = vertexScores[indices[t * 3]]
+                       + vertexScores[indices[t * 3 + 1]]
+                       + vertexScores[indices[t * 3 + 2]];
+        if (triScores[t] > bestScore) {
+          bestScore = triScores[t];
+          bestTri = t;
+        }
+      }
+    }
+  }
+
+  return output;
+}
+
+// FIFO post-transform cache simulation. Entries are timestamped on insertion,
+// so a vertex is cached if fewer than `size` misses happened since.
+class FifoCache
+{
+public:
+  FifoCache(size_t vertexCount, size_t size)
+    : m_timestamps(vertexCount, 0)
+    , m_time(static_cast<uint32_t>(size) + 1)
+    , m_size(size) {}
+
+  void reset()
+  {
+    m_time += static_cast<uint32_t>(m_size) + 1;
+  }
+
+  uint32_t accessTriangle(const uint32_t* tri)
+  {
+    uint32_t misses = 0;
+    for (size_t k = 0; k < 3; k++) {
+      if (m_time - m_timestamps[tri[k]] > m_size) {
+        m_timestamps[tri[k]] = m_time++;
+        misses++;
+      }
+    }
+
+    return misses;
+  }
+
+private:
+  std::vector<uint32_t> m_timestamps;
+  uint32_t m_time;
+  size_t m_size;
+};
+
+struct TriangleCluster
+{
+  size_t triBegin;
+  size_t triEnd;
+  float sortKey;
+};
+
+std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t>& indices,
+                                       const std::vector<MeshVertex>& vertices,
+                                       float threshold)
+{
+  size_t triCount = indices.size() / 3;
+  if (triCount == 0) {
+    return indices;
+  }
+
+  FifoCache cache(vertices.size(), OVERDRAW_CACHE_SIZE);
+
+  // Hard boundaries are where the cache optimizer had to start over, i.e.
+  // where a triangle misses on all of its vertices.
+  std::vector<size_t> hardBoundaries;
+  for (size_t t = 0; t < triCount; t++) {
+    if (cache.accessTriangle(&indices[t * 3]) == 3 || t == 0) {
+      hardBoundaries.push_back(t);
+    }
+  }
+  hardBoundaries.push_back(triCount);
+
+  // Soft boundaries split hard clusters further, wherever restarting the
+  // cache keeps the cluster's ACMR within the threshold.
+  std::vector<TriangleCluster> clusters;
+  for (size_t i = 0; i + 1 < hardBoundaries.size(); i++) {
+    size_t begin = hardBoundaries[i];
+    size_t end = hardBoundaries[i + 1];
+
+    cache.reset();
+    uint32_t totalMisses = 0;
+    for (size_t t = begin; t < end; t++) {
+      totalMisses += cache.accessTriangle(&indices[t * 3]);
+    }
+    float targetAcmr = threshold * totalMisses / (end - begin);
+
+    cache.reset();
+    size_t start = begin;
+    uint32_t accumulatedMisses = 0;
+    for (size_t t = begin; t < end; t++) {
+      accumulatedMisses += cache.accessTriangle(&indices[t * 3]);
+
+      float acmr = static_cast<float>(accumulatedMisses) / (t - start + 1);
+      if (t + 1 < end && acmr <= targetAcmr) {
+        clusters.push_back({ start, t + 1, 0.f });
+        start = t + 1;
+        accumulatedMisses = 0;
+        cache.reset();
+      }
+    }
+    clusters.push_back({ start, end, 0.f });
+  }
+
+  float meshCentroid[3] = { 0.f, 0.f, 0.f };
+  for (uint32_t index : indices) {
+    for (size_t k = 0; k < 3; k++) {
+      meshCentroid[k] += vertices[index].position[k];
+    }
+  }
+  for (size_t k = 0; k < 3; k++) {
+    meshCentroid[k] /= indices.size();
+  }
+
+  // Clusters facing away from the mesh centre are drawn first, since they
+  // are the most likely to occlude the rest of the mesh.
+  for (TriangleCluster& cluster : clusters) {
+    float centroid[3] = { 0.f, 0.f, 0.f };
+    float normal[3] = { 0.f, 0.f, 0.f };
+    float totalArea = 0.f;
+
+    for (size_t t = cluster.triBegin; t < cluster.triEnd; t++) {
+      const float* a = vertices[indices[t * 3]].position;
+      const float* b = vertices[indices[t * 3 + 1]].position;
+      const float* c = vertices[indices[t * 3 + 2]].position;
+
+      float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+      float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+      float n[3] = {
+        ab[1] * ac[2] - ab[2] * ac[1],
+        ab[2] * ac[0] - ab[0] * ac[2],
+        ab[0] * ac[1] - ab[1] * ac[0]
+      };
+      float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+      for (size_t k = 0; k < 3; k++) {
+        centroid[k] += (a[k] + b[k] + c[k]) / 3.f * area;
+        normal[k] += n[k];
+      }
+      totalArea += area;
+    }
+
+    if (totalArea > 0.f) {
+      for (size_t k = 0; k < 3; k++) {
+        centroid[k] /= totalArea;
+      }
+    }
+
+    float normalLength = std::sqrt(normal[0] * normal[0]
+                                   + normal[1] * normal[1]
+                                   + normal[2] * normal[2]);
+    if (normalLength > 0.f) {
+      for (size_t k = 0; k < 3; k++) {
+        normal[k] /= normalLength;
+      }
+    }
+
+    cluster.sortKey = (centroid[0] - meshCentroid[0]) * normal[0]
+                      + (centroid[1] - meshCentroid[1]) * normal[1]
+                      + (centroid[2] - meshCentroid[2]) * normal[2];
+  }
+
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const TriangleCluster& a, const TriangleCluster& b) {
+                     return a.sortKey > b.sortKey;
+                   });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (const TriangleCluster& cluster : clusters) {
+    output.insert(output.end(),
+                  indices.begin() + cluster.triBegin * 3,
+                  indices.begin() + cluster.triEnd * 3);
+  }
+
+  return output;
+}
+
+size_t optimizeVertexFetch(std::vector<MeshVertex>& vertices,
+                           std::vector<uint32_t>& indices)
+{
+  std::vector<uint32_t> remap(vertices.size(), INVALID_INDEX);
+  std::vector<MeshVertex> reordered;
+  reordered.reserve(vertices.size());
+
+  for (uint32_t& index : indices) {
+    if (remap[index] == INVALID_INDEX) {
+      remap[index] = static_cast<uint32_t>(reordered.size());
+      reordered.push_back(vertices[index]);
+    }
+
+    index = remap[index];
+  }
+
+  vertices = std::move(reordered);
+
+  return vertices.size();
+}
+
+static void computeMeshletBounds(Meshlet& meshlet, const MeshData& mesh)
+{
+  auto position = [&](uint32_t localIndex) {
+    uint32_t v = mesh.meshletVertices[meshlet.vertexOffset + localIndex];
+    return mesh.vertices[v].position;
+  };
+  auto distanceSquared = [](const float* a, const float* b) {
+    float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+    return d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+  };
+
+  // Ritter's bounding sphere: start from the two most distant points found
+  // in two passes and grow the sphere to include any point outside it.
+  uint32_t farthest = 0;
+  for (uint32_t i = 1; i < meshlet.vertexCount; i++) {
+    if (distanceSquared(position(0), position(i))
+        > distanceSquared(position(0), position(farthest))) {
+      farthest = i;
+    }
+  }
+  uint32_t opposite = farthest;
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    if (distanceSquared(position(farthest), position(i))
+        > distanceSquared(position(farthest), position(opposite))) {
+      opposite = i;
+    }
+  }
+
+  const float* a = position(farthest);
+  const float* b = position(opposite);
+  float center[3] = {
+    (a[0] + b[0]) * 0.5f, (a[1] + b[1]) * 0.5f, (a[2] + b[2]) * 0.5f
+  };
+  float radius = std::sqrt(distanceSquared(a, b)) * 0.5f;
+
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    const float* p = position(i);
+    float distance = std::sqrt(distanceSquared(center, p));
+    if (distance > radius) {
+      float newRadius = (radius + distance) * 0.5f;
+      float shift = (newRadius - radius) / distance;
+      for (size_t k = 0; k < 3; k++) {
+        center[k] += (p[k] - center[k]) * shift;
+      }
+      radius = newRadius;
+    }
+  }
+
+  std::copy(center, center + 3, meshlet.center);
+  meshlet.radius = radius;
+
+  // The cone axis is the average triangle normal, and the cutoff is derived
+  // from the normal that deviates the most from it.
+  struct TrianglePlane
+  {
+    float normal[3];
+    float point[3];
+  };
+  std::vector<TrianglePlane> planes;
+  float axis[3] = { 0.f, 0.f, 0.f };
+  for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+    const uint8_t* tri = &mesh.meshletTriangles[meshlet.triangleOffset + t * 3];
+    const float* p0 = position(tri[0]);
+    const float* p1 = position(tri[1]);
+    const float* p2 = position(tri[2]);
+
+    float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    TrianglePlane plane = {
+      {
+        e1[1] * e2[2] - e1[2] * e2[1],
+        e1[2] * e2[0] - e1[0] * e2[2],
+        e1[0] * e2[1] - e1[1] * e2[0]
+      },
+      { p0[0], p0[1], p0[2] }
+    };
+    float* n = plane.normal;
+    float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length == 0.f) {
+      continue;
+    }
+
+    for (size_t k = 0; k < 3; k++) {
+      n[k] /= length;
+      axis[k] += n[k];
+    }
+    planes.push_back(plane);
+  }
+
+  float axisLength = std::sqrt(axis[0] * axis[0]
+                               + axis[1] * axis[1]
+                               + axis[2] * axis[2]);
+  float minDot = 1.f;
+  if (axisLength > 0.f) {
+    for (size_t k = 0; k < 3; k++) {
+      axis[k] /= axisLength;
+    }
+    for (const TrianglePlane& plane : planes) {
+      const float* n = plane.normal;
+      minDot = std::min(minDot,
+                        n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
+    }
+  }
+
+  std::copy(axis, axis + 3, meshlet.coneAxis);
+  if (axisLength == 0.f || minDot <= 0.f) {
+    // The triangles face in every direction, so the cluster can never be
+    // backface culled.
+    std::copy(center, center + 3, meshlet.coneApex);
+    meshlet.coneCutoff = 1.f;
+    return;
+  }
+
+  // Move the apex back along the axis until it lies in front of every
+  // triangle's plane.
+  float maxT = 0.f;
+  for (const TrianglePlane& plane : planes) {
+    const float* n = plane.normal;
+    const float* p = plane.point;
+    float centerDistance = (center[0] - p[0]) * n[0]
+                           + (center[1] - p[1]) * n[1]
+                           + (center[2] - p[2]) * n[2];
+    float axisDot = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+    maxT = std::max(maxT, centerDistance / axisDot);
+  }
+
+  for (size_t k = 0; k < 3; k++) {
+    meshlet.coneApex[k] = center[k] - axis[k] * maxT;
+  }
+  meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+}
+
+void buildMeshlets(MeshData& mesh)
+{
+  mesh.meshlets.clear();
+  mesh.meshletVertices.clear();
+  mesh.meshletTriangles.clear();
+
+  std::vector<uint8_t> localIndices(mesh.vertices.size(), UINT8_MAX);
+
+  Meshlet meshlet{};
+  auto flush = [&]() {
+    if (meshlet.triangleCount == 0) {
+      return;
+    }
+
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+      localIndices[mesh.meshletVertices[meshlet.vertexOffset + i]] = UINT8_MAX;
+    }
+
+    computeMeshletBounds(meshlet, mesh);
+    mesh.meshlets.push_back(meshlet);
+
+    meshlet = {};
+    meshlet.vertexOffset = static_cast<uint32_t>(mesh.meshletVertices.size());
+    meshlet.triangleOffset = static_cast<uint32_t>(
+      mesh.meshletTriangles.size());
+  };
+
+  for (size_t t = 0; t < mesh.indices.size() / 3; t++) {
+    const uint32_t* tri = &mesh.indices[t * 3];
+
+    uint32_t numNewVertices = 0;
+    for (size_t k = 0; k < 3; k++) {
+      if (localIndices[tri[k]] == UINT8_MAX) {
+        numNewVertices++;
+      }
+    }
+
+    if (meshlet.vertexCount + numNewVertices > MAX_MESHLET_VERTICES
+        || meshlet.triangleCount + 1 > MAX_MESHLET_TRIANGLES) {
+      flush();
+    }
+
+    for (size_t k = 0; k < 3; k++) {
+      uint8_t& localIndex = localIndices[tri[k]];
+      if (localIndex == UINT8_MAX) {
+        localIndex = static_cast<uint8_t>(meshlet.vertexCount++);
+        mesh.meshletVertices.push_back(tri[k]);
+      }
+
+      mesh.meshletTriangles.push_back(localIndex);
+    }
+
+    meshlet.triangleCount++;
+  }
+
+  flush();
+}
+
+float analyzeVertexCache(const std::vector<uint32_t>& indices,
+                         size_t vertexCount,
+                         size_t cacheSize)
+{
+  size_t triCount = indices.size() / 3;
+  if (triCount == 0) {
+    return 0.f;
+  }
+
+  FifoCache cache(vertexCount, cacheSize);
+  uint32_t misses = 0;
+  for (size_t t = 0; t < triCount; t++) {
+    misses += cache.accessTriangle(&indices[t * 3]);
+  }
+
+  return static_cast<float>(misses) / triCount;
+}
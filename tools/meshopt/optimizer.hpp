@@ -0,0 +1,43 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../../ds/MeshData.hpp"
+#include "../../ds/MeshVertex.hpp"
+
+static constexpr size_t MAX_MESHLET_VERTICES = 64;
+static constexpr size_t MAX_MESHLET_TRIANGLES = 124;
+
+// Reorders triangles so that consecutive triangles share vertices, using Tom
+// Forsyth's "Linear-Speed Vertex Cache Optimisation".
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices,
+                                          size_t vertexCount);
+
+// Reorders clusters of an already cache-optimized index buffer so that
+// outward-facing clusters are drawn first, as in Sander et al., "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw". A threshold
+// of 1.05 allows the ACMR to get up to 5% worse in exchange for smaller,
+// more freely sortable clusters.
+std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t>& indices,
+                                       const std::vector<MeshVertex>& vertices,
+                                       float threshold);
+
+// Reorders vertices in the order they are first referenced by the index
+// buffer and drops unreferenced ones. Returns the new vertex count.
+size_t optimizeVertexFetch(std::vector<MeshVertex>& vertices,
+                           std::vector<uint32_t>& indices);
+
+// Splits the mesh's index buffer into meshlets and computes their bounding
+// spheres and backface cones.
+void buildMeshlets(MeshData& mesh);
+
+// Average number of vertex shader invocations per triangle with a FIFO
+// post-transform cache of the given size.
+float analyzeVertexCache(const std::vector<uint32_t>& indices,
+                         size_t vertexCount,
+                         size_t cacheSize);
+
+#endif
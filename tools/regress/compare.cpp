@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "compare.hpp"
+
+ImageComparison compareImages(const ImageData& actual,
+                              const ImageData& expected,
+                              int tolerance)
+{
+  if (actual.width != expected.width || actual.height != expected.height) {
+    throw std::runtime_error("Images differ in size!");
+  }
+
+  ImageComparison comparison;
+  comparison.pixelCount = uint64_t(actual.width) * actual.height;
+  for (uint64_t i = 0; i < comparison.pixelCount; i++) {
+    int pixelDifference = 0;
+    for (int c = 0; c < 3; c++) {
+      int difference = std::abs(int(actual.pixels[i * 3 + c])
+                                - int(expected.pixels[i * 3 + c]));
+      pixelDifference = std::max(pixelDifference, difference);
+    }
+
+    comparison.maxDifference = std::max(comparison.maxDifference,
+                                        pixelDifference);
+    if (pixelDifference > tolerance) {
+      comparison.differingPixelCount++;
+    }
+  }
+
+  return comparison;
+}
+
+std::map<std::string, double> readMetrics(const std::string& fileName)
+{
+  std::ifstream file(fileName);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open " + fileName + "!");
+  }
+
+  std::map<std::string, double> metrics;
+  std::string name;
+  double value;
+  while (file >> name >> value) {
+    metrics[name] = value;
+  }
+
+  return metrics;
+}
@@ -0,0 +1,29 @@
+#ifndef COMPARE_HPP
+#define COMPARE_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "../../ds/ImageData.hpp"
+
+struct ImageComparison
+{
+  // Largest difference of any channel, 0-255.
+  int maxDifference = 0;
+  // Pixels with a channel differing by more than the tolerance.
+  uint64_t differingPixelCount = 0;
+  uint64_t pixelCount = 0;
+};
+
+// Compares two images of the same size. Software rasterizers are
+// deterministic, but may round differently between versions, hence the
+// per-channel tolerance.
+ImageComparison compareImages(const ImageData& actual,
+                              const ImageData& expected,
+                              int tolerance);
+
+// Reads the "name value" lines written by FrameStats.
+std::map<std::string, double> readMetrics(const std::string& fileName);
+
+#endif
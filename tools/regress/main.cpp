@@ -0,0 +1,149 @@
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "../../ds/ImageData.hpp"
+#include "../../utils/png.hpp"
+#include "compare.hpp"
+
+static constexpr int DEFAULT_TOLERANCE = 2;
+static constexpr double DEFAULT_MAX_DIFFERING_RATIO = 0.001;
+static constexpr double DEFAULT_THRESHOLD = 0.25;
+
+// Frame times of a few milliseconds are dominated by scheduling noise, so
+// regressions smaller than this are ignored regardless of the threshold.
+static constexpr double MIN_REGRESSION_MS = 0.5;
+
+static void printUsage()
+{
+  std::cerr << "Usage:\n"
+            << "  regress image [--tolerance <0-255>] [--max-ratio <value>] "
+            << "<actual.png> <golden.png>\n"
+            << "  regress metrics [--threshold <value>] "
+            << "<actual.txt> <baseline.txt>\n";
+}
+
+static int runImageComparison(int argc, char** argv)
+{
+  int tolerance = DEFAULT_TOLERANCE;
+  double maxDifferingRatio = DEFAULT_MAX_DIFFERING_RATIO;
+  std::string actualFileName;
+  std::string goldenFileName;
+
+  for (int i = 2; i < argc; i++) {
+    if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      tolerance = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--max-ratio") == 0 && i + 1 < argc) {
+      maxDifferingRatio = std::strtod(argv[++i], nullptr);
+    } else if (actualFileName.empty()) {
+      actualFileName = argv[i];
+    } else if (goldenFileName.empty()) {
+      goldenFileName = argv[i];
+    } else {
+      printUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (actualFileName.empty() || goldenFileName.empty()) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  ImageComparison comparison = compareImages(readPng(actualFileName),
+                                             readPng(goldenFileName),
+                                             tolerance);
+  double differingRatio = double(comparison.differingPixelCount)
+                          / comparison.pixelCount;
+  bool hasPassed = differingRatio <= maxDifferingRatio;
+
+  std::cout << (hasPassed ? "ok" : "FAIL") << ": "
+            << comparison.differingPixelCount << " of "
+            << comparison.pixelCount << " pixels differ by more than "
+            << tolerance << " (max difference "
+            << comparison.maxDifference << ")\n";
+
+  return hasPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int runMetricsComparison(int argc, char** argv)
+{
+  double threshold = DEFAULT_THRESHOLD;
+  std::string actualFileName;
+  std::string baselineFileName;
+
+  for (int i = 2; i < argc; i++) {
+    if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+      threshold = std::strtod(argv[++i], nullptr);
+    } else if (actualFileName.empty()) {
+      actualFileName = argv[i];
+    } else if (baselineFileName.empty()) {
+      baselineFileName = argv[i];
+    } else {
+      printUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (actualFileName.empty() || baselineFileName.empty()) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  std::map<std::string, double> actual = readMetrics(actualFileName);
+  std::map<std::string, double> baseline = readMetrics(baselineFileName);
+
+  // All metrics are times, so only increases count as regressions.
+  bool hasPassed = true;
+  for (const auto& expected : baseline) {
+    auto it = actual.find(expected.first);
+    if (it == actual.end()) {
+      std::cout << "FAIL: " << expected.first << " is missing\n";
+      hasPassed = false;
+      continue;
+    }
+
+    double change = it->second - expected.second;
+    double relativeChange = expected.second > 0.0
+                            ? change / expected.second : 0.0;
+    bool hasRegressed = relativeChange > threshold
+                        && change > MIN_REGRESSION_MS;
+    hasPassed = hasPassed && !hasRegressed;
+
+    std::cout << (hasRegressed ? "FAIL" : "ok") << ": " << expected.first
+              << " " << std::fixed << std::setprecision(3) << it->second
+              << " (baseline " << expected.second << ", "
+              << std::showpos << relativeChange * 100.0 << std::noshowpos
+              << "%)\n";
+  }
+
+  return hasPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  try {
+    if (std::strcmp(argv[1], "image") == 0) {
+      return runImageComparison(argc, argv);
+    }
+    if (std::strcmp(argv[1], "metrics") == 0) {
+      return runMetricsComparison(argc, argv);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+  printUsage();
+  return EXIT_FAILURE;
+}
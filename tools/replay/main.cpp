@@ -0,0 +1,94 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "../../app.hpp"
+#include "../../constants.hpp"
+#include "../../utils/frame_trace.hpp"
+
+static void printUsage()
+{
+  std::cerr << "Usage: replay [--stats <stats.txt>] <trace.vkft>\n";
+}
+
+static bool isTracedSetting(const std::string& name)
+{
+  for (const char* tracedName : TRACED_SETTINGS) {
+    if (name == tracedName) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Draws the frames of a trace recorded with VK_APP_TRACE, with the
+// settings they were recorded with, in a headless render session and one
+// after the other as fast as they are drawn. The frame times are written as
+// by VK_APP_STATS, for tools/regress to compare.
+int main(int argc, char** argv)
+{
+  std::string statsFileName;
+  std::string traceFileName;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+      statsFileName = argv[++i];
+    } else if (traceFileName.empty()) {
+      traceFileName = argv[i];
+    } else {
+      printUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (traceFileName.empty()) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  try {
+    FrameTrace trace = readFrameTrace(traceFileName);
+    std::cout << "Replaying " << trace.frames.size() << " frames of "
+              << traceFileName << "\n";
+
+    // The app reads its settings from the environment, which must not
+    // add to those of the trace.
+    for (const char* name : TRACED_SETTINGS) {
+      unsetenv(name);
+    }
+    for (const std::string& setting : trace.settings) {
+      size_t separator = setting.find('=');
+      if (separator == std::string::npos) {
+        throw std::runtime_error("Invalid setting in frame trace.");
+      }
+
+      std::string name = setting.substr(0, separator);
+      std::string value = setting.substr(separator + 1);
+      if (!isTracedSetting(name)) {
+        throw std::runtime_error("Unknown setting " + name
+                                 + " in frame trace.");
+      }
+      setenv(name.c_str(), value.c_str(), 1);
+      std::cout << "  " << setting << "\n";
+    }
+
+    // Offscreen, so that no display is needed and nothing waits for one.
+    setenv("VK_APP_SESSIONS", "1", 1);
+    setenv("VK_APP_REPLAY", traceFileName.c_str(), 1);
+    if (!statsFileName.empty()) {
+      setenv("VK_APP_STATS", statsFileName.c_str(), 1);
+    }
+
+    App app;
+    app.run();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "encoder.hpp"
+
+static float srgbToLinear(uint8_t value)
+{
+  float c = value / 255.f;
+  return c <= 0.04045f ? c / 12.92f
+                       : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linearToSrgb(float c)
+{
+  c = c <= 0.0031308f ? c * 12.92f
+                      : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+  return static_cast<uint8_t>(std::lround(std::clamp(c, 0.f, 1.f) * 255.f));
+}
+
+std::vector<uint8_t> downsampleLevel(const std::vector<uint8_t>& texels,
+                                     uint32_t width,
+                                     uint32_t height,
+                                     bool isSrgb)
+{
+  uint32_t levelWidth = std::max(width / 2, 1u);
+  uint32_t levelHeight = std::max(height / 2, 1u);
+  std::vector<uint8_t> level(size_t(levelWidth) * levelHeight * 4);
+
+  for (uint32_t y = 0; y < levelHeight; y++) {
+    for (uint32_t x = 0; x < levelWidth; x++) {
+      // A dimension of 1 has a single texel to average.
+      uint32_t xs[2] = { 2 * x, std::min(2 * x + 1, width - 1) };
+      uint32_t ys[2] = { 2 * y, std::min(2 * y + 1, height - 1) };
+      for (uint32_t channel = 0; channel < 4; channel++) {
+        // Alpha is linear either way.
+        bool isLinearized = isSrgb && channel < 3;
+        float sum = 0.f;
+        for (uint32_t sy : ys) {
+          for (uint32_t sx : xs) {
+            uint8_t value = texels[(size_t(sy) * width + sx) * 4 + channel];
+            sum += isLinearized ? srgbToLinear(value) : value / 255.f;
+          }
+        }
+
+        float average = sum / 4.f;
+        level[(size_t(y) * levelWidth + x) * 4 + channel] =
+          isLinearized ? linearToSrgb(average)
+                       : static_cast<uint8_t>(std::lround(average * 255.f));
+      }
+    }
+  }
+
+  return level;
+}
+
+static uint16_t packRgb565(const int colour[3])
+{
+  int r = (colour[0] * 31 + 127) / 255;
+  int g = (colour[1] * 63 + 127) / 255;
+  int b = (colour[2] * 31 + 127) / 255;
+
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpackRgb565(uint16_t packed, int colour[3])
+{
+  int r = (packed >> 11) & 31;
+  int g = (packed >> 5) & 63;
+  int b = packed & 31;
+  colour[0] = (r << 3) | (r >> 2);
+  colour[1] = (g << 2) | (g >> 4);
+  colour[2] = (b << 3) | (b >> 2);
+}
+
+static void encodeBlock(const uint8_t block[16][4], uint8_t* output)
+{
+  int minColour[3] = { 255, 255, 255 };
+  int maxColour[3] = { 0, 0, 0 };
+  for (uint32_t i = 0; i < 16; i++) {
+    for (uint32_t channel = 0; channel < 3; channel++) {
+      minColour[channel] = std::min<int>(minColour[channel],
+                                         block[i][channel]);
+      maxColour[channel] = std::max<int>(maxColour[channel],
+                                         block[i][channel]);
+    }
+  }
+
+  // Moving the endpoints in by a sixteenth of the range lowers the error
+  // of the colours in between.
+  for (uint32_t channel = 0; channel < 3; channel++) {
+    int inset = (maxColour[channel] - minColour[channel]) / 16;
+    minColour[channel] += inset;
+    maxColour[channel] -= inset;
+  }
+
+  // The endpoints are opposite corners of the box, on the diagonal the
+  // colours vary along. A channel that falls as the channel of the largest
+  // range rises runs the other way along it.
+  uint32_t mainChannel = 0;
+  for (uint32_t channel = 1; channel < 3; channel++) {
+    if (maxColour[channel] - minColour[channel]
+        > maxColour[mainChannel] - minColour[mainChannel]) {
+      mainChannel = channel;
+    }
+  }
+  int mean[3] = {};
+  for (uint32_t i = 0; i < 16; i++) {
+    for (uint32_t channel = 0; channel < 3; channel++) {
+      mean[channel] += block[i][channel];
+    }
+  }
+  for (uint32_t channel = 0; channel < 3; channel++) {
+    int covariance = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+      covariance += (16 * block[i][channel] - mean[channel])
+                    * (16 * block[i][mainChannel] - mean[mainChannel]) / 256;
+    }
+    if (covariance < 0) {
+      std::swap(minColour[channel], maxColour[channel]);
+    }
+  }
+
+  // The first endpoint must be the greater for the 4 colour mode. Equal
+  // endpoints select the 3 colour mode, which still decodes to index 0.
+  uint16_t endpoints[2] = { packRgb565(maxColour), packRgb565(minColour) };
+  if (endpoints[0] < endpoints[1]) {
+    std::swap(endpoints[0], endpoints[1]);
+  }
+
+  int palette[4][3];
+  unpackRgb565(endpoints[0], palette[0]);
+  unpackRgb565(endpoints[1], palette[1]);
+  for (uint32_t channel = 0; channel < 3; channel++) {
+    palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+    palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+  }
+
+  uint32_t indices = 0;
+  if (endpoints[0] != endpoints[1]) {
+    for (uint32_t i = 0; i < 16; i++) {
+      uint32_t bestIndex = 0;
+      int bestError = INT32_MAX;
+      for (uint32_t index = 0; index < 4; index++) {
+        int error = 0;
+        for (uint32_t channel = 0; channel < 3; channel++) {
+          int difference = block[i][channel] - palette[index][channel];
+          error += difference * difference;
+        }
+        if (error < bestError) {
+          bestIndex = index;
+          bestError = error;
+        }
+      }
+      indices |= bestIndex << (2 * i);
+    }
+  }
+
+  // Little-endian.
+  output[0] = static_cast<uint8_t>(endpoints[0]);
+  output[1] = static_cast<uint8_t>(endpoints[0] >> 8);
+  output[2] = static_cast<uint8_t>(endpoints[1]);
+  output[3] = static_cast<uint8_t>(endpoints[1] >> 8);
+  for (uint32_t i = 0; i < 4; i++) {
+    output[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+  }
+}
+
+std::vector<uint8_t> encodeBc1(const std::vector<uint8_t>& texels,
+                               uint32_t width,
+                               uint32_t height)
+{
+  uint32_t blockCountX = (width + 3) / 4;
+  uint32_t blockCountY = (height + 3) / 4;
+  std::vector<uint8_t> blocks(size_t(blockCountX) * blockCountY * 8);
+
+  for (uint32_t blockY = 0; blockY < blockCountY; blockY++) {
+    for (uint32_t blockX = 0; blockX < blockCountX; blockX++) {
+      uint8_t block[16][4];
+      for (uint32_t i = 0; i < 16; i++) {
+        uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+        uint32_t y = std::min(blockY * 4 + i / 4, height - 1);
+        const uint8_t* texel = &texels[(size_t(y) * width + x) * 4];
+        std::copy(texel, texel + 4, block[i]);
+      }
+
+      encodeBlock(block,
+                  &blocks[(size_t(blockY) * blockCountX + blockX) * 8]);
+    }
+  }
+
+  return blocks;
+}
@@ -0,0 +1,26 @@
+#ifndef ENCODER_HPP
+#define ENCODER_HPP
+
+#include <cstdint>
+#include <vector>
+
+// Levels are tightly packed 8-bit RGBA texels, in rows.
+
+// Returns the next mip level, half the size rounded down but at least 1,
+// with each texel the average of up to 2x2 texels. With isSrgb, colours
+// are averaged in linear space, as by the app's mip generation.
+std::vector<uint8_t> downsampleLevel(const std::vector<uint8_t>& texels,
+                                     uint32_t width,
+                                     uint32_t height,
+                                     bool isSrgb);
+
+// Encodes a level as BC1 blocks without alpha, in rows of 4x4 blocks.
+// Edge blocks of sizes that are not a multiple of 4 repeat the last row
+// and column. Each block's endpoints are the corners of the bounding box
+// of its colours, inset slightly, which is fast and close to optimal for
+// the smooth gradients of most textures.
+std::vector<uint8_t> encodeBc1(const std::vector<uint8_t>& texels,
+                               uint32_t width,
+                               uint32_t height);
+
+#endif
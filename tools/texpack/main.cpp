@@ -0,0 +1,96 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../ds/ImageData.hpp"
+#include "../../utils/png.hpp"
+#include "../../utils/texture.hpp"
+#include "encoder.hpp"
+
+static void printUsage()
+{
+  std::cerr << "Usage: texpack [--unorm] [--bc1] <input.png> <output.tex>\n";
+}
+
+// Packs a PNG into a texture file, sRGB unless --unorm is given. As 8-bit
+// RGBA, only the first level is stored, and the app generates the rest.
+// With --bc1, the full mip chain is generated here and stored as BC1, as
+// block-compressed textures must be.
+int main(int argc, char** argv)
+{
+  bool isUnorm = false;
+  bool isBc1 = false;
+  std::string inputFileName;
+  std::string outputFileName;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--unorm") == 0) {
+      isUnorm = true;
+    } else if (std::strcmp(argv[i], "--bc1") == 0) {
+      isBc1 = true;
+    } else if (inputFileName.empty()) {
+      inputFileName = argv[i];
+    } else if (outputFileName.empty()) {
+      outputFileName = argv[i];
+    } else {
+      printUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (inputFileName.empty() || outputFileName.empty()) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  try {
+    ImageData image = readPng(inputFileName);
+
+    std::vector<uint8_t> texels(size_t(image.width) * image.height * 4);
+    for (size_t i = 0; i < size_t(image.width) * image.height; i++) {
+      std::memcpy(&texels[i * 4], &image.pixels[i * 3], 3);
+      texels[i * 4 + 3] = 255;
+    }
+
+    uint32_t levelCount = getMipLevelCount(image.width, image.height);
+    if (isBc1) {
+      std::vector<std::vector<uint8_t>> levels;
+      uint32_t width = image.width;
+      uint32_t height = image.height;
+      for (uint32_t level = 0; level < levelCount; level++) {
+        if (level > 0) {
+          texels = downsampleLevel(texels, width, height, !isUnorm);
+          width = getMipLevelSize(image.width, level);
+          height = getMipLevelSize(image.height, level);
+        }
+        levels.push_back(encodeBc1(texels, width, height));
+      }
+
+      writeTexture(outputFileName,
+                   isUnorm ? VK_FORMAT_BC1_RGB_UNORM_BLOCK
+                           : VK_FORMAT_BC1_RGB_SRGB_BLOCK,
+                   image.width, image.height, levels);
+    } else {
+      writeTexture(outputFileName,
+                   isUnorm ? VK_FORMAT_R8G8B8A8_UNORM
+                           : VK_FORMAT_R8G8B8A8_SRGB,
+                   image.width, image.height, { texels });
+    }
+
+    std::cout << "Size: " << image.width << "x" << image.height << "\n"
+              << "Levels: " << levelCount << " ("
+              << (isBc1 ? levelCount : 1) << " stored)\n";
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
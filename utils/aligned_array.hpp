@@ -0,0 +1,79 @@
+#ifndef ALIGNED_ARRAY_HPP
+#define ALIGNED_ARRAY_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+// Heap array of plain values aligned for SIMD loads, e.g. one component of
+// structure-of-arrays data. The capacity is rounded up to whole SIMD
+// registers, so that kernels can process the tail without a scalar loop.
+template<typename T, size_t Alignment = 32>
+class AlignedArray
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "AlignedArray only holds plain values.");
+
+public:
+  AlignedArray() = default;
+  ~AlignedArray() { std::free(m_data); }
+
+  AlignedArray(const AlignedArray&) = delete;
+  AlignedArray& operator=(const AlignedArray&) = delete;
+
+  // Makes room for at least count elements without changing the size.
+  void reserve(size_t count)
+  {
+    size_t capacity = (count * sizeof(T) + Alignment - 1) / Alignment
+                      * Alignment;
+    if (capacity <= m_capacity) {
+      return;
+    }
+
+    T* data = static_cast<T*>(std::aligned_alloc(Alignment, capacity));
+    if (data == nullptr) {
+      throw std::bad_alloc();
+    }
+
+    // Zeroed including the padding, which kernels may read.
+    std::memset(data, 0, capacity);
+    if (m_data != nullptr) {
+      std::memcpy(data, m_data, m_size * sizeof(T));
+      std::free(m_data);
+    }
+    m_data = data;
+    m_capacity = capacity;
+  }
+
+  // New elements are zeroed. The capacity at least doubles when it grows,
+  // so that growing by one element at a time takes amortised constant
+  // time.
+  void resize(size_t size)
+  {
+    if (size * sizeof(T) > m_capacity) {
+      reserve(std::max(size, 2 * m_capacity / sizeof(T)));
+    }
+
+    if (size > m_size) {
+      std::memset(m_data + m_size, 0, (size - m_size) * sizeof(T));
+    }
+    m_size = size;
+  }
+
+  size_t size() const { return m_size; }
+  T* data() { return m_data; }
+  const T* data() const { return m_data; }
+  T& operator[](size_t i) { return m_data[i]; }
+  const T& operator[](size_t i) const { return m_data[i]; }
+
+private:
+  T* m_data = nullptr;
+  size_t m_size = 0;
+  // In bytes.
+  size_t m_capacity = 0;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "env.hpp"
+
+bool hasEnv(const char* name)
+{
+  return std::getenv(name) != nullptr;
+}
+
+std::string getEnv(const char* name, const std::string& defaultValue)
+{
+  const char* value = std::getenv(name);
+
+  return value != nullptr ? value : defaultValue;
+}
+
+uint64_t getEnvUint(const char* name, uint64_t defaultValue)
+{
+  const char* value = std::getenv(name);
+  if (value == nullptr || *value == '\0') {
+    return defaultValue;
+  }
+
+  char* end;
+  uint64_t result = std::strtoull(value, &end, 10);
+  if (*end != '\0') {
+    throw std::runtime_error(std::string(name) + " is not a number!");
+  }
+
+  return result;
+}
+
+std::vector<std::string> getEnvList(const char* name)
+{
+  std::vector<std::string> list;
+  std::string value = getEnv(name);
+  size_t start = 0;
+  while (start <= value.size()) {
+    size_t end = value.find(':', start);
+    if (end == std::string::npos) {
+      end = value.size();
+    }
+    if (end > start) {
+      list.push_back(value.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+
+  return list;
+}
@@ -0,0 +1,16 @@
+#ifndef ENV_HPP
+#define ENV_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runtime options are read from VK_APP_* environment variables, so that
+// tests and tools can configure the app without a command line.
+bool hasEnv(const char* name);
+std::string getEnv(const char* name, const std::string& defaultValue = "");
+uint64_t getEnvUint(const char* name, uint64_t defaultValue = 0);
+// Colon-separated, like PATH. Empty entries are skipped.
+std::vector<std::string> getEnvList(const char* name);
+
+#endif
@@ -0,0 +1,112 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "frame_trace.hpp"
+#include "io.hpp"
+
+// Byte count of a record, without the padding of FrameTraceRecord.
+static constexpr size_t RECORD_SIZE = sizeof(double) + 2 * sizeof(int32_t)
+                                      + sizeof(float);
+
+template<typename T>
+static void readValue(const std::vector<char>& buffer, size_t& offset,
+                      T& value)
+{
+  if (offset + sizeof(T) > buffer.size()) {
+    throw std::runtime_error("Frame trace is truncated.");
+  }
+
+  std::memcpy(&value, buffer.data() + offset, sizeof(T));
+  offset += sizeof(T);
+}
+
+template<typename T>
+static void writeValue(std::ofstream& file, const T& value)
+{
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+FrameTrace readFrameTrace(const std::string& fileName)
+{
+  std::vector<char> buffer = readFile(fileName);
+
+  FrameTraceHeader header;
+  size_t offset = 0;
+  readValue(buffer, offset, header);
+
+  if (std::memcmp(header.magic, FRAME_TRACE_MAGIC,
+                  sizeof(header.magic)) != 0) {
+    throw std::runtime_error("File is not a frame trace.");
+  }
+  if (header.version != FRAME_TRACE_VERSION) {
+    throw std::runtime_error("Unsupported frame trace version.");
+  }
+
+  FrameTrace trace;
+  for (uint32_t i = 0; i < header.settingCount; i++) {
+    uint32_t size;
+    readValue(buffer, offset, size);
+    if (offset + size > buffer.size()) {
+      throw std::runtime_error("Frame trace is truncated.");
+    }
+
+    trace.settings.emplace_back(buffer.data() + offset, size);
+    offset += size;
+  }
+
+  // A partly written last record is dropped.
+  while (buffer.size() - offset >= RECORD_SIZE) {
+    FrameTraceRecord record;
+    int32_t framebufferWidth;
+    int32_t framebufferHeight;
+    readValue(buffer, offset, record.input.time);
+    readValue(buffer, offset, framebufferWidth);
+    readValue(buffer, offset, framebufferHeight);
+    readValue(buffer, offset, record.resolutionScale);
+    record.input.framebufferWidth = framebufferWidth;
+    record.input.framebufferHeight = framebufferHeight;
+    trace.frames.push_back(record);
+  }
+
+  return trace;
+}
+
+void FrameTraceWriter::init(const std::string& fileName,
+                            const std::vector<std::string>& settings)
+{
+  m_file.open(fileName, std::ios::binary | std::ios::trunc);
+  if (!m_file.is_open()) {
+    throw std::runtime_error("Failed to open file.");
+  }
+
+  FrameTraceHeader header{};
+  std::memcpy(header.magic, FRAME_TRACE_MAGIC, sizeof(header.magic));
+  header.version = FRAME_TRACE_VERSION;
+  header.settingCount = static_cast<uint32_t>(settings.size());
+  writeValue(m_file, header);
+
+  for (const std::string& setting : settings) {
+    writeValue(m_file, static_cast<uint32_t>(setting.size()));
+    m_file.write(setting.data(), setting.size());
+  }
+}
+
+void FrameTraceWriter::destroy()
+{
+  m_file.close();
+  if (!m_file) {
+    throw std::runtime_error("Failed to write frame trace.");
+  }
+}
+
+void FrameTraceWriter::write(const FrameTraceRecord& record)
+{
+  writeValue(m_file, record.input.time);
+  writeValue(m_file, static_cast<int32_t>(record.input.framebufferWidth));
+  writeValue(m_file, static_cast<int32_t>(record.input.framebufferHeight));
+  writeValue(m_file, record.resolutionScale);
+}
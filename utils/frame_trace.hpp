@@ -0,0 +1,59 @@
+#ifndef FRAME_TRACE_HPP
+#define FRAME_TRACE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../ds/FrameInput.hpp"
+
+// On-disk layout of a frame trace (see tools/replay). All values are
+// little-endian. The header is followed by the settings, each a uint32
+// byte count and that many bytes of "NAME=value", and then by a record per
+// frame until the end of the file, so that a trace cut short by a crash
+// still holds the frames before it.
+static constexpr char FRAME_TRACE_MAGIC[4] = { 'V', 'K', 'F', 'T' };
+static constexpr uint32_t FRAME_TRACE_VERSION = 1;
+
+struct FrameTraceHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t settingCount;
+};
+
+// What a frame's work depends on besides the settings. Stored field by
+// field: the time, the framebuffer width and height as int32, and the
+// scale.
+struct FrameTraceRecord
+{
+  FrameInput input;
+  // Picked from GPU times, which differ between runs.
+  float resolutionScale;
+};
+
+struct FrameTrace
+{
+  // Environment variables the trace was recorded with, as "NAME=value".
+  std::vector<std::string> settings;
+  std::vector<FrameTraceRecord> frames;
+};
+
+FrameTrace readFrameTrace(const std::string& fileName);
+
+// Appends a record per frame as it is drawn.
+class FrameTraceWriter
+{
+public:
+  void init(const std::string& fileName,
+            const std::vector<std::string>& settings);
+  void destroy();
+
+  void write(const FrameTraceRecord& record);
+
+private:
+  std::ofstream m_file;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef GLFW_HPP
+#define GLFW_HPP
+
+#include <memory>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// Keeps GLFW initialised from init() until it is destroyed. Declared before
+// any window or surface, so that it is torn down after them.
+class GlfwLibrary
+{
+public:
+  GlfwLibrary() = default;
+  ~GlfwLibrary()
+  {
+    if (m_isInitialised) {
+      glfwTerminate();
+    }
+  }
+
+  GlfwLibrary(const GlfwLibrary&) = delete;
+  GlfwLibrary& operator=(const GlfwLibrary&) = delete;
+
+  void init()
+  {
+    m_isInitialised = glfwInit() == GLFW_TRUE;
+  }
+
+private:
+  bool m_isInitialised = false;
+};
+
+struct GlfwWindowDeleter
+{
+  void operator()(GLFWwindow* window) const
+  {
+    glfwDestroyWindow(window);
+  }
+};
+
+using UniqueWindow = std::unique_ptr<GLFWwindow, GlfwWindowDeleter>;
+
+#endif
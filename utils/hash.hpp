@@ -0,0 +1,33 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Boost's hash_combine, widened to 64 bits.
+inline void hashCombine(size_t& seed, size_t value)
+{
+  seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+template<typename T>
+inline void hashCombine(size_t& seed, const T& value)
+{
+  hashCombine(seed, std::hash<T>{}(value));
+}
+
+// FNV-1a over raw bytes, for plain structs and blobs such as SPIR-V code.
+inline size_t hashBytes(const void* data, size_t size)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+
+  return static_cast<size_t>(hash);
+}
+
+#endif
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "job_system.hpp"
+
+struct Job
+{
+  std::function<void()> function;
+  JobCounter* counter;
+};
+
+namespace
+{
+// Set on the threads of a job system, including the one that called init(),
+// so that jobs they start go to their own deque.
+thread_local JobSystem* t_jobSystem = nullptr;
+thread_local uint32_t t_workerIndex = 0;
+
+// Spins this many times looking for work before going to sleep, since a
+// frame usually starts its next jobs within microseconds.
+constexpr uint32_t IDLE_SPIN_COUNT = 64;
+}
+
+void JobSystem::init(uint32_t workerThreadCount)
+{
+  m_isShuttingDown = false;
+
+  // Worker 0 is the calling thread.
+  for (uint32_t i = 0; i <= workerThreadCount; i++) {
+    m_workers.push_back(std::make_unique<Worker>());
+  }
+
+  t_jobSystem = this;
+  t_workerIndex = 0;
+
+  for (uint32_t i = 1; i <= workerThreadCount; i++) {
+    m_workers[i]->thread = std::thread(&JobSystem::runWorkerThread, this, i);
+  }
+}
+
+void JobSystem::destroy()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_isShuttingDown = true;
+  }
+  m_sleepCondition.notify_all();
+
+  for (auto& worker : m_workers) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+  m_workers.clear();
+
+  if (t_jobSystem == this) {
+    t_jobSystem = nullptr;
+  }
+}
+
+void JobSystem::run(std::function<void()> function, JobCounter* counter)
+{
+  if (counter != nullptr) {
+    counter->m_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  schedule(new Job{ std::move(function), counter });
+}
+
+void JobSystem::runAfter(JobCounter& dependency,
+                         std::function<void()> function,
+                         JobCounter* counter)
+{
+  if (counter != nullptr) {
+    counter->m_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Job* job = new Job{ std::move(function), counter };
+  {
+    std::lock_guard<std::mutex> lock(dependency.m_mutex);
+    if (dependency.m_count.load(std::memory_order_acquire) > 0) {
+      dependency.m_continuations.push_back(job);
+      return;
+    }
+  }
+
+  schedule(job);
+}
+
+void JobSystem::parallelFor(size_t count,
+                            size_t batchSize,
+                            std::function<void(size_t, size_t)> function,
+                            JobCounter& counter)
+{
+  if (batchSize == 0) {
+    batchSize = 1;
+  }
+
+  // Shared by the batches, rather than copied into each.
+  auto sharedFunction =
+    std::make_shared<std::function<void(size_t, size_t)>>(
+      std::move(function));
+  for (size_t begin = 0; begin < count; begin += batchSize) {
+    size_t end = std::min(begin + batchSize, count);
+    run([sharedFunction, begin, end]() { (*sharedFunction)(begin, end); },
+        &counter);
+  }
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+  uint32_t spinCount = 0;
+  while (counter.m_count.load(std::memory_order_acquire) > 0) {
+    Job* job = t_jobSystem == this ? findJob(t_workerIndex) : nullptr;
+    if (job != nullptr) {
+      execute(job);
+      spinCount = 0;
+    } else if (++spinCount > IDLE_SPIN_COUNT) {
+      std::this_thread::yield();
+    }
+  }
+
+  // The job that finished last may still hold the lock, e.g. while it
+  // starts the continuations. Taking it ensures the counter is no longer
+  // in use once this returns.
+  std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+uint32_t JobSystem::getWorkerCount() const
+{
+  return static_cast<uint32_t>(m_workers.size());
+}
+
+void JobSystem::schedule(Job* job)
+{
+  // Counted before the job is visible, so that the count never drops below
+  // zero when a thief takes it straight away.
+  m_queuedJobCount.fetch_add(1, std::memory_order_seq_cst);
+
+  if (t_jobSystem == this) {
+    m_workers[t_workerIndex]->deque.push(job);
+  } else {
+    std::lock_guard<std::mutex> lock(m_injectedMutex);
+    m_injectedJobs.push_back(job);
+  }
+
+  // A worker going to sleep registers itself before checking the queued
+  // count, so either it sees this job, or this sees it sleeping. Taking the
+  // lock keeps the notification from arriving between its check and its
+  // wait.
+  if (m_sleepingWorkerCount.load(std::memory_order_seq_cst) > 0) {
+    {
+      std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_sleepCondition.notify_one();
+  }
+}
+
+Job* JobSystem::findJob(uint32_t workerIndex)
+{
+  Job* job = m_workers[workerIndex]->deque.pop();
+
+  if (job == nullptr) {
+    std::lock_guard<std::mutex> lock(m_injectedMutex);
+    if (!m_injectedJobs.empty()) {
+      job = m_injectedJobs.front();
+      m_injectedJobs.pop_front();
+    }
+  }
+
+  // Victims are visited starting after this worker, so that thieves spread
+  // out over the deques.
+  size_t workerCount = m_workers.size();
+  for (size_t i = 1; job == nullptr && i < workerCount; i++) {
+    job = m_workers[(workerIndex + i) % workerCount]->deque.steal();
+  }
+
+  if (job != nullptr) {
+    m_queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  return job;
+}
+
+void JobSystem::execute(Job* job)
+{
+  job->function();
+
+  JobCounter* counter = job->counter;
+  delete job;
+  if (counter == nullptr) {
+    return;
+  }
+
+  std::vector<Job*> continuations;
+  {
+    std::lock_guard<std::mutex> lock(counter->m_mutex);
+    if (counter->m_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      continuations.swap(counter->m_continuations);
+    }
+  }
+
+  for (Job* continuation : continuations) {
+    schedule(continuation);
+  }
+}
+
+void JobSystem::runWorkerThread(uint32_t workerIndex)
+{
+  t_jobSystem = this;
+  t_workerIndex = workerIndex;
+
+  uint32_t spinCount = 0;
+  while (true) {
+    Job* job = findJob(workerIndex);
+    if (job != nullptr) {
+      execute(job);
+      spinCount = 0;
+      continue;
+    }
+
+    if (++spinCount < IDLE_SPIN_COUNT) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_sleepingWorkerCount.fetch_add(1, std::memory_order_seq_cst);
+    m_sleepCondition.wait(lock, [this]() {
+      return m_isShuttingDown
+             || m_queuedJobCount.load(std::memory_order_seq_cst) > 0;
+    });
+    m_sleepingWorkerCount.fetch_sub(1, std::memory_order_relaxed);
+    spinCount = 0;
+
+    if (m_isShuttingDown) {
+      return;
+    }
+  }
+}
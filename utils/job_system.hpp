@@ -0,0 +1,102 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "work_stealing_deque.hpp"
+
+class JobSystem;
+struct Job;
+
+// Counts the unfinished jobs that were started with it. Waiting on a
+// counter, e.g. one per frame, acts as a fence for all of them, and jobs
+// can be made to start only once a counter reaches zero.
+class JobCounter
+{
+public:
+  JobCounter() = default;
+  JobCounter(const JobCounter&) = delete;
+  JobCounter& operator=(const JobCounter&) = delete;
+
+private:
+  friend class JobSystem;
+
+  // Protects the continuations, and the count reaching zero, so that
+  // dependent jobs are not missed or started twice.
+  std::mutex m_mutex;
+  std::atomic<uint32_t> m_count{ 0 };
+  std::vector<Job*> m_continuations;
+};
+
+// Runs jobs on a fixed set of worker threads, so that parallel frame work
+// shares one pool sized to the machine instead of each system starting its
+// own threads. Each worker has a work-stealing deque: jobs started by a
+// worker go to its own deque, and idle workers steal from the others. The
+// thread calling init() is worker 0 and runs jobs while it waits.
+//
+// Jobs must not throw.
+class JobSystem
+{
+public:
+  // A worker count of zero runs every job on the thread calling wait().
+  void init(uint32_t workerThreadCount);
+  // All jobs must be finished.
+  void destroy();
+
+  // Starts a job. The counter, if any, must be waited on with wait()
+  // before it is destroyed or reused for a dependency.
+  void run(std::function<void()> function, JobCounter* counter = nullptr);
+
+  // Starts a job once the dependency's jobs have finished.
+  void runAfter(JobCounter& dependency,
+                std::function<void()> function,
+                JobCounter* counter = nullptr);
+
+  // Calls function(begin, end) for batches of [0, count) in parallel.
+  void parallelFor(size_t count,
+                   size_t batchSize,
+                   std::function<void(size_t, size_t)> function,
+                   JobCounter& counter);
+
+  // Runs jobs until all of the counter's jobs have finished.
+  void wait(JobCounter& counter);
+
+  uint32_t getWorkerCount() const;
+
+private:
+  struct Worker
+  {
+    WorkStealingDeque<Job> deque;
+    std::thread thread;
+  };
+
+  void schedule(Job* job);
+  Job* findJob(uint32_t workerIndex);
+  void execute(Job* job);
+  void runWorkerThread(uint32_t workerIndex);
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+
+  // Jobs started from threads that are not workers, which may not push to
+  // a worker's deque.
+  std::mutex m_injectedMutex;
+  std::deque<Job*> m_injectedJobs;
+
+  // Idle workers sleep until a job is queued.
+  std::atomic<uint64_t> m_queuedJobCount{ 0 };
+  std::atomic<uint32_t> m_sleepingWorkerCount{ 0 };
+  std::mutex m_sleepMutex;
+  std::condition_variable m_sleepCondition;
+  bool m_isShuttingDown = false;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MAILBOX_HPP
+#define MAILBOX_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer passing the latest value from one writer thread
+// to one reader thread. Neither side ever waits: the writer can publish
+// faster than the reader consumes, older values are then skipped, and the
+// reader keeps the last value until a newer one arrives.
+template<typename T>
+class Mailbox
+{
+public:
+  // Writer thread only.
+  void write(const T& value)
+  {
+    m_slots[m_writeIndex].value = value;
+    // Hands the written slot over and takes back the one the reader has
+    // not claimed.
+    m_writeIndex = m_sharedIndex.exchange(m_writeIndex | NEW_VALUE_BIT,
+                                          std::memory_order_acq_rel)
+                   & INDEX_MASK;
+  }
+
+  // Reader thread only. Returns the latest value written, or a
+  // value-initialised T before the first write.
+  const T& read()
+  {
+    if (m_sharedIndex.load(std::memory_order_relaxed) & NEW_VALUE_BIT) {
+      m_readIndex = m_sharedIndex.exchange(m_readIndex,
+                                           std::memory_order_acq_rel)
+                    & INDEX_MASK;
+    }
+
+    return m_slots[m_readIndex].value;
+  }
+
+private:
+  static constexpr uint32_t INDEX_MASK = 3;
+  static constexpr uint32_t NEW_VALUE_BIT = 4;
+
+  // On separate cache lines, so the threads do not contend for them.
+  struct alignas(64) Slot
+  {
+    T value{};
+  };
+
+  Slot m_slots[3];
+  // The slot each thread owns, and the one in between.
+  uint32_t m_writeIndex = 0;
+  alignas(64) uint32_t m_readIndex = 1;
+  alignas(64) std::atomic<uint32_t> m_sharedIndex{ 2 };
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A file mapped read-only into memory. Pages are only read from disk when
+// first touched, so large files cost nothing for the parts never read.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string& fileName);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  const uint8_t* getData() const { return m_data; }
+  size_t getSize() const { return m_size; }
+
+private:
+  void unmap();
+
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+};
+
+#endif
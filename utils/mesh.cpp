@@ -0,0 +1,99 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "io.hpp"
+#include "mesh.hpp"
+
+template<typename T>
+static void readArray(const std::vector<char>& buffer, size_t& offset,
+                      std::vector<T>& out, size_t count)
+{
+  size_t size = count * sizeof(T);
+  if (offset + size > buffer.size()) {
+    throw std::runtime_error("Mesh file is truncated.");
+  }
+
+  out.resize(count);
+  std::memcpy(out.data(), buffer.data() + offset, size);
+  offset += size;
+}
+
+template<typename T>
+static void writeArray(std::ofstream& file, const std::vector<T>& data)
+{
+  file.write(reinterpret_cast<const char*>(data.data()),
+             data.size() * sizeof(T));
+}
+
+static size_t alignToFour(size_t size)
+{
+  return (size + 3) & ~size_t(3);
+}
+
+MeshData readMesh(const std::string& fileName)
+{
+  std::vector<char> buffer = readFile(fileName);
+
+  MeshFileHeader header;
+  if (buffer.size() < sizeof(header)) {
+    throw std::runtime_error("Mesh file is truncated.");
+  }
+  std::memcpy(&header, buffer.data(), sizeof(header));
+
+  if (std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0) {
+    throw std::runtime_error("File is not a mesh file.");
+  }
+  if (header.version != MESH_FILE_VERSION) {
+    throw std::runtime_error("Unsupported mesh file version.");
+  }
+
+  MeshData mesh;
+  size_t offset = sizeof(header);
+  readArray(buffer, offset, mesh.vertices, header.vertexCount);
+  readArray(buffer, offset, mesh.indices, header.indexCount);
+  readArray(buffer, offset, mesh.meshlets, header.meshletCount);
+  readArray(buffer, offset, mesh.meshletVertices, header.meshletVertexCount);
+  readArray(buffer, offset, mesh.meshletTriangles,
+            header.meshletTriangleByteCount);
+
+  return mesh;
+}
+
+void writeMesh(const std::string& fileName, const MeshData& mesh)
+{
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file.");
+  }
+
+  MeshFileHeader header{};
+  std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+  header.version = MESH_FILE_VERSION;
+  header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+  header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+  header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+  header.meshletVertexCount = static_cast<uint32_t>(
+    mesh.meshletVertices.size());
+  header.meshletTriangleByteCount = static_cast<uint32_t>(
+    mesh.meshletTriangles.size());
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  writeArray(file, mesh.vertices);
+  writeArray(file, mesh.indices);
+  writeArray(file, mesh.meshlets);
+  writeArray(file, mesh.meshletVertices);
+  writeArray(file, mesh.meshletTriangles);
+
+  size_t padding = alignToFour(mesh.meshletTriangles.size())
+                   - mesh.meshletTriangles.size();
+  const char zeroes[4] = {};
+  file.write(zeroes, padding);
+
+  if (!file) {
+    throw std::runtime_error("Failed to write mesh file.");
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "../ds/MeshData.hpp"
+
+// On-disk layout of a preprocessed mesh (see tools/meshopt). All values are
+// little-endian. The header is followed, in order, by the vertices, the
+// indices, the meshlets, the meshlet vertices and the meshlet triangles. The
+// meshlet triangle bytes are padded to a multiple of four.
+static constexpr char MESH_FILE_MAGIC[4] = { 'V', 'K', 'M', 'S' };
+static constexpr uint32_t MESH_FILE_VERSION = 1;
+
+struct MeshFileHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t meshletCount;
+  uint32_t meshletVertexCount;
+  uint32_t meshletTriangleByteCount;
+};
+
+MeshData readMesh(const std::string& fileName);
+void writeMesh(const std::string& fileName, const MeshData& mesh);
+
+#endif
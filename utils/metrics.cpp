@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "metrics.hpp"
+
+static void addToDouble(std::atomic<double>& target, double value)
+{
+  double expected = target.load(std::memory_order_relaxed);
+  while (!target.compare_exchange_weak(expected, expected + value,
+                                       std::memory_order_relaxed)) {}
+}
+
+// Doubles are written with the fewest digits that read back exactly.
+static std::string formatNumber(double value)
+{
+  if (std::isnan(value)) {
+    return "NaN";
+  }
+  if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+
+  std::ostringstream stream;
+  stream << std::setprecision(15) << value;
+  if (std::strtod(stream.str().c_str(), nullptr) != value) {
+    stream.str("");
+    stream << std::setprecision(17) << value;
+  }
+
+  return stream.str();
+}
+
+// Prometheus help texts escape backslashes and line feeds, label values
+// also quotes, and JSON strings also other control characters.
+enum class Escaping
+{
+  Help,
+  LabelValue,
+  Json
+};
+
+static std::string escape(const std::string& text, Escaping escaping)
+{
+  bool isJson = escaping == Escaping::Json;
+  std::string result;
+  for (char c : text) {
+    if (c == '\\' || (c == '"' && escaping != Escaping::Help)) {
+      result += '\\';
+      result += c;
+    } else if (c == '\n') {
+      result += "\\n";
+    } else if (isJson && static_cast<unsigned char>(c) < 0x20) {
+      std::ostringstream stream;
+      stream << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+             << static_cast<int>(c);
+      result += stream.str();
+    } else {
+      result += c;
+    }
+  }
+
+  return result;
+}
+
+// Formats labels as {name="value",...}, with an extra label appended, e.g.
+// the bucket bound "le" of a histogram.
+static std::string formatPrometheusLabels(const MetricLabels& labels,
+                                          const std::string& extraName = "",
+                                          const std::string& extraValue = "")
+{
+  if (labels.empty() && extraName.empty()) {
+    return "";
+  }
+
+  std::string result = "{";
+  bool isFirst = true;
+  auto append = [&](const std::string& name, const std::string& value) {
+    if (!isFirst) {
+      result += ",";
+    }
+    result += name + "=\"" + escape(value, Escaping::LabelValue) + "\"";
+    isFirst = false;
+  };
+  for (const auto& [name, value] : labels) {
+    append(name, value);
+  }
+  if (!extraName.empty()) {
+    append(extraName, extraValue);
+  }
+
+  return result + "}";
+}
+
+static std::string formatJsonNumber(double value)
+{
+  // JSON has no representation for these.
+  return std::isfinite(value) ? formatNumber(value) : "null";
+}
+
+void Counter::add(uint64_t value)
+{
+  m_value.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Counter::update(uint64_t total)
+{
+  m_value.store(total, std::memory_order_relaxed);
+}
+
+uint64_t Counter::get() const
+{
+  return m_value.load(std::memory_order_relaxed);
+}
+
+void Gauge::set(double value)
+{
+  m_value.store(value, std::memory_order_relaxed);
+}
+
+double Gauge::get() const
+{
+  return m_value.load(std::memory_order_relaxed);
+}
+
+Histogram::Histogram(std::vector<double> upperBounds)
+  : m_upperBounds(std::move(upperBounds))
+  , m_bucketCounts(new std::atomic<uint64_t>[m_upperBounds.size() + 1])
+{
+  if (!std::is_sorted(m_upperBounds.begin(), m_upperBounds.end())) {
+    throw std::runtime_error("Histogram bounds are not ascending!");
+  }
+
+  for (size_t i = 0; i <= m_upperBounds.size(); i++) {
+    m_bucketCounts[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::observe(double value)
+{
+  size_t bucket = std::lower_bound(m_upperBounds.begin(),
+                                   m_upperBounds.end(), value)
+                  - m_upperBounds.begin();
+  m_bucketCounts[bucket].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  addToDouble(m_sum, value);
+}
+
+const std::vector<double>& Histogram::getUpperBounds() const
+{
+  return m_upperBounds;
+}
+
+std::vector<uint64_t> Histogram::getBucketCounts() const
+{
+  std::vector<uint64_t> counts(m_upperBounds.size() + 1);
+  for (size_t i = 0; i < counts.size(); i++) {
+    counts[i] = m_bucketCounts[i].load(std::memory_order_relaxed);
+  }
+
+  return counts;
+}
+
+uint64_t Histogram::getCount() const
+{
+  return m_count.load(std::memory_order_relaxed);
+}
+
+double Histogram::getSum() const
+{
+  return m_sum.load(std::memory_order_relaxed);
+}
+
+Counter& MetricsRegistry::addCounter(const std::string& name,
+                                     const std::string& help,
+                                     const MetricLabels& labels)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Series& series = addSeries(name, help, Type::Counter, labels);
+  if (!series.counter) {
+    series.counter = std::make_unique<Counter>();
+  }
+
+  return *series.counter;
+}
+
+Gauge& MetricsRegistry::addGauge(const std::string& name,
+                                 const std::string& help,
+                                 const MetricLabels& labels)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Series& series = addSeries(name, help, Type::Gauge, labels);
+  if (!series.gauge) {
+    series.gauge = std::make_unique<Gauge>();
+  }
+
+  return *series.gauge;
+}
+
+Histogram& MetricsRegistry::addHistogram(const std::string& name,
+                                         const std::string& help,
+                                         const std::vector<double>& upperBounds,
+                                         const MetricLabels& labels)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Series& series = addSeries(name, help, Type::Histogram, labels);
+  if (!series.histogram) {
+    series.histogram = std::make_unique<Histogram>(upperBounds);
+  }
+
+  return *series.histogram;
+}
+
+std::string MetricsRegistry::formatPrometheus() const
+{
+  static const char* TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::ostringstream stream;
+  for (const auto& [name, family] : m_families) {
+    stream << "# HELP " << name << ' '
+           << escape(family.help, Escaping::Help) << '\n'
+           << "# TYPE " << name << ' '
+           << TYPE_NAMES[static_cast<int>(family.type)] << '\n';
+
+    for (const auto& series : family.series) {
+      std::string labels = formatPrometheusLabels(series->labels);
+      switch (family.type) {
+        case Type::Counter:
+          stream << name << labels << ' ' << series->counter->get() << '\n';
+          break;
+        case Type::Gauge:
+          stream << name << labels << ' '
+                 << formatNumber(series->gauge->get()) << '\n';
+          break;
+        case Type::Histogram: {
+          const Histogram& histogram = *series->histogram;
+          const std::vector<double>& bounds = histogram.getUpperBounds();
+          std::vector<uint64_t> counts = histogram.getBucketCounts();
+
+          // Buckets are cumulative in the exposition format.
+          uint64_t cumulativeCount = 0;
+          for (size_t i = 0; i < counts.size(); i++) {
+            cumulativeCount += counts[i];
+            std::string bound = i < bounds.size() ? formatNumber(bounds[i])
+                                                  : "+Inf";
+            stream << name << "_bucket"
+                   << formatPrometheusLabels(series->labels, "le", bound)
+                   << ' ' << cumulativeCount << '\n';
+          }
+          // Counted from the buckets, so that the total matches them even if
+          // an observation lands while they are read.
+          stream << name << "_sum" << labels << ' '
+                 << formatNumber(histogram.getSum()) << '\n'
+                 << name << "_count" << labels << ' ' << cumulativeCount
+                 << '\n';
+          break;
+        }
+      }
+    }
+  }
+
+  return stream.str();
+}
+
+std::string MetricsRegistry::formatJson() const
+{
+  static const char* TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::ostringstream stream;
+  stream << "{\n  \"metrics\": [";
+  bool isFirstFamily = true;
+  for (const auto& [name, family] : m_families) {
+    stream << (isFirstFamily ? "\n" : ",\n")
+           << "    {\n"
+           << "      \"name\": \"" << escape(name, Escaping::Json)
+           << "\",\n"
+           << "      \"type\": \""
+           << TYPE_NAMES[static_cast<int>(family.type)] << "\",\n"
+           << "      \"help\": \""
+           << escape(family.help, Escaping::Json) << "\",\n"
+           << "      \"series\": [";
+    isFirstFamily = false;
+
+    bool isFirstSeries = true;
+    for (const auto& series : family.series) {
+      stream << (isFirstSeries ? "\n" : ",\n")
+             << "        { \"labels\": {";
+      isFirstSeries = false;
+
+      bool isFirstLabel = true;
+      for (const auto& [labelName, labelValue] : series->labels) {
+        stream << (isFirstLabel ? " " : ", ") << '"'
+               << escape(labelName, Escaping::Json) << "\": \""
+               << escape(labelValue, Escaping::Json) << '"';
+        isFirstLabel = false;
+      }
+      stream << (isFirstLabel ? "}, " : " }, ");
+
+      switch (family.type) {
+        case Type::Counter:
+          stream << "\"value\": " << series->counter->get() << " }";
+          break;
+        case Type::Gauge:
+          stream << "\"value\": " << formatJsonNumber(series->gauge->get())
+                 << " }";
+          break;
+        case Type::Histogram: {
+          const Histogram& histogram = *series->histogram;
+          const std::vector<double>& bounds = histogram.getUpperBounds();
+          std::vector<uint64_t> counts = histogram.getBucketCounts();
+
+          uint64_t count = 0;
+          stream << "\"buckets\": [";
+          for (size_t i = 0; i < counts.size(); i++) {
+            count += counts[i];
+            stream << (i == 0 ? "" : ", ") << "{ \"le\": "
+                   << (i < bounds.size() ? formatJsonNumber(bounds[i])
+                                         : "null")
+                   << ", \"count\": " << counts[i] << " }";
+          }
+          stream << "], \"sum\": " << formatJsonNumber(histogram.getSum())
+                 << ", \"count\": " << count << " }";
+          break;
+        }
+      }
+    }
+
+    stream << "\n      ]\n    }";
+  }
+  stream << "\n  ]\n}\n";
+
+  return stream.str();
+}
+
+MetricsRegistry::Series& MetricsRegistry::addSeries(
+  const std::string& name,
+  const std::string& help,
+  Type type,
+  const MetricLabels& labels)
+{
+  auto it = m_families.find(name);
+  if (it == m_families.end()) {
+    it = m_families.emplace(name, Family{ type, help, {} }).first;
+  } else if (it->second.type != type) {
+    throw std::runtime_error("Metric " + name
+                             + " is registered with another type!");
+  }
+
+  Family& family = it->second;
+  for (const auto& series : family.series) {
+    if (series->labels == labels) {
+      return *series;
+    }
+  }
+
+  family.series.push_back(std::make_unique<Series>());
+  family.series.back()->labels = labels;
+
+  return *family.series.back();
+}
@@ -0,0 +1,119 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Label names and values of one time series, e.g. { { "heap", "0" } }.
+using MetricLabels = std::map<std::string, std::string>;
+
+// A total that only increases, e.g. the number of frames rendered.
+class Counter
+{
+public:
+  void add(uint64_t value = 1);
+  // For totals kept elsewhere, e.g. by a subsystem. Must not decrease.
+  void update(uint64_t total);
+  uint64_t get() const;
+
+private:
+  std::atomic<uint64_t> m_value{ 0 };
+};
+
+// A value that goes up and down, e.g. memory usage.
+class Gauge
+{
+public:
+  void set(double value);
+  double get() const;
+
+private:
+  std::atomic<double> m_value{ 0.0 };
+};
+
+// Counts observations, e.g. frame times, in buckets with fixed upper
+// bounds, so that percentiles can be estimated when scraped.
+class Histogram
+{
+public:
+  explicit Histogram(std::vector<double> upperBounds);
+
+  void observe(double value);
+
+  const std::vector<double>& getUpperBounds() const;
+  // Per bucket, i.e. not cumulative, with the overflow bucket last.
+  std::vector<uint64_t> getBucketCounts() const;
+  uint64_t getCount() const;
+  double getSum() const;
+
+private:
+  const std::vector<double> m_upperBounds;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_bucketCounts;
+  std::atomic<uint64_t> m_count{ 0 };
+  std::atomic<double> m_sum{ 0.0 };
+};
+
+// Named metrics, updated lock-free from any thread once registered, and
+// formatted for export. Returned references stay valid for the lifetime
+// of the registry, and registering the same name and labels again returns
+// the existing metric.
+class MetricsRegistry
+{
+public:
+  Counter& addCounter(const std::string& name,
+                      const std::string& help,
+                      const MetricLabels& labels = {});
+  Gauge& addGauge(const std::string& name,
+                  const std::string& help,
+                  const MetricLabels& labels = {});
+  // The upper bounds must be ascending.
+  Histogram& addHistogram(const std::string& name,
+                          const std::string& help,
+                          const std::vector<double>& upperBounds,
+                          const MetricLabels& labels = {});
+
+  // Prometheus text exposition format, version 0.0.4.
+  std::string formatPrometheus() const;
+  // One object per metric, with a "series" array of labels and values.
+  std::string formatJson() const;
+
+private:
+  enum class Type
+  {
+    Counter,
+    Gauge,
+    Histogram
+  };
+
+  struct Series
+  {
+    MetricLabels labels;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+  };
+
+  struct Family
+  {
+    Type type;
+    std::string help;
+    std::vector<std::unique_ptr<Series>> series;
+  };
+
+  Series& addSeries(const std::string& name,
+                    const std::string& help,
+                    Type type,
+                    const MetricLabels& labels);
+
+  // Only protects registration and formatting; the values are atomic.
+  mutable std::mutex m_mutex;
+  // Ordered by name, so that the output is stable.
+  std::map<std::string, Family> m_families;
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "metrics_exporter.hpp"
+
+// A client that has not sent its request by then gets the response anyway,
+// e.g. a plain socket reader like socat.
+static constexpr int REQUEST_TIMEOUT_MS = 100;
+static constexpr size_t MAX_REQUEST_SIZE = 4096;
+// A client that makes no room for the response for that long is dropped.
+static constexpr int SEND_TIMEOUT_MS = 1000;
+
+void MetricsExporter::init(const MetricsRegistry& registry,
+                           const std::string& socketPath,
+                           const std::string& jsonFileName,
+                           std::chrono::milliseconds jsonInterval)
+{
+  m_registry = &registry;
+  m_socketPath = socketPath;
+  m_jsonFileName = jsonFileName;
+  m_jsonInterval = jsonInterval;
+
+  if (pipe(m_wakeFds) != 0) {
+    throw std::runtime_error("Failed to create metrics exporter pipe!");
+  }
+
+  try {
+    listenOnSocket();
+    m_thread = std::thread(&MetricsExporter::runThread, this);
+  } catch (...) {
+    closeFds();
+    throw;
+  }
+}
+
+void MetricsExporter::listenOnSocket()
+{
+  if (!m_socketPath.empty()) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (m_socketPath.size() >= sizeof(address.sun_path)) {
+      throw std::runtime_error("Metrics socket path " + m_socketPath
+                               + " is too long!");
+    }
+    std::strcpy(address.sun_path, m_socketPath.c_str());
+
+    // A socket left behind by an earlier run would fail the bind.
+    unlink(m_socketPath.c_str());
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0
+        || bind(m_listenFd, reinterpret_cast<const sockaddr*>(&address),
+                sizeof(address)) != 0
+        || listen(m_listenFd, SOMAXCONN) != 0) {
+      throw std::runtime_error("Failed to listen on metrics socket "
+                               + m_socketPath + "!");
+    }
+  }
+}
+
+void MetricsExporter::destroy()
+{
+  if (m_thread.joinable()) {
+    char wake = 0;
+    if (write(m_wakeFds[1], &wake, 1) != 1) {
+      std::cerr << "Failed to stop the metrics exporter.\n";
+    }
+    m_thread.join();
+  }
+
+  if (!m_jsonFileName.empty()) {
+    writeJson();
+  }
+
+  closeFds();
+}
+
+void MetricsExporter::closeFds()
+{
+  if (m_listenFd >= 0) {
+    close(m_listenFd);
+    unlink(m_socketPath.c_str());
+    m_listenFd = -1;
+  }
+  for (int& fd : m_wakeFds) {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+}
+
+void MetricsExporter::runThread()
+{
+  using Clock = std::chrono::steady_clock;
+
+  Clock::time_point nextJsonTime = Clock::now() + m_jsonInterval;
+
+  while (true) {
+    int timeoutMs = -1;
+    if (!m_jsonFileName.empty()) {
+      auto untilJson = std::chrono::duration_cast<std::chrono::milliseconds>(
+        nextJsonTime - Clock::now());
+      timeoutMs = static_cast<int>(std::max<int64_t>(untilJson.count(), 0));
+    }
+
+    pollfd fds[2] = {
+      { m_wakeFds[0], POLLIN, 0 },
+      { m_listenFd, POLLIN, 0 }
+    };
+    nfds_t fdCount = m_listenFd >= 0 ? 2 : 1;
+    if (poll(fds, fdCount, timeoutMs) < 0) {
+      continue;
+    }
+
+    if (fds[0].revents != 0) {
+      return;
+    }
+
+    if (fdCount > 1 && (fds[1].revents & POLLIN)) {
+      int clientFd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (clientFd >= 0) {
+        serveClient(clientFd);
+        close(clientFd);
+      }
+    }
+
+    if (!m_jsonFileName.empty() && Clock::now() >= nextJsonTime) {
+      writeJson();
+      nextJsonTime += m_jsonInterval;
+      if (nextJsonTime < Clock::now()) {
+        nextJsonTime = Clock::now() + m_jsonInterval;
+      }
+    }
+  }
+}
+
+void MetricsExporter::serveClient(int clientFd)
+{
+  // The request is read and ignored: every path returns the metrics.
+  std::string request;
+  char buffer[512];
+  while (request.find("\r\n\r\n") == std::string::npos
+         && request.size() < MAX_REQUEST_SIZE) {
+    pollfd fd = { clientFd, POLLIN, 0 };
+    if (poll(&fd, 1, REQUEST_TIMEOUT_MS) <= 0) {
+      break;
+    }
+
+    ssize_t size = read(clientFd, buffer, sizeof(buffer));
+    if (size <= 0) {
+      break;
+    }
+    request.append(buffer, size);
+  }
+
+  std::string body = m_registry->formatPrometheus();
+  std::string response =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/plain; version=0.0.4\r\n"
+    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+    "\r\n" + body;
+
+  // Sent without blocking, so that a client that stopped reading holds up
+  // neither the thread nor destroy(), which wakes it up.
+  size_t offset = 0;
+  while (offset < response.size()) {
+    pollfd fds[2] = {
+      { clientFd, POLLOUT, 0 },
+      { m_wakeFds[0], POLLIN, 0 }
+    };
+    if (poll(fds, 2, SEND_TIMEOUT_MS) <= 0 || fds[1].revents != 0) {
+      return;
+    }
+
+    ssize_t size = send(clientFd, response.data() + offset,
+                        response.size() - offset,
+                        MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      continue;
+    }
+    if (size <= 0) {
+      return;
+    }
+    offset += size;
+  }
+}
+
+void MetricsExporter::writeJson()
+{
+  // Written next to the file and renamed over it, so that readers never
+  // see a partial dump.
+  std::string tempFileName = m_jsonFileName + ".tmp";
+  {
+    std::ofstream file(tempFileName, std::ios::trunc);
+    if (!file.is_open()) {
+      std::cerr << "Failed to open " << tempFileName << ".\n";
+      return;
+    }
+    file << m_registry->formatJson();
+  }
+
+  if (std::rename(tempFileName.c_str(), m_jsonFileName.c_str()) != 0) {
+    std::cerr << "Failed to write " << m_jsonFileName << ".\n";
+  }
+}
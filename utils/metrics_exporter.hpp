@@ -0,0 +1,45 @@
+#ifndef METRICS_EXPORTER_HPP
+#define METRICS_EXPORTER_HPP
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "metrics.hpp"
+
+// Publishes a metrics registry from a background thread: in Prometheus text
+// format to each client connecting to a local Unix socket, answered as an
+// HTTP response so that e.g.
+//   curl --unix-socket <path> http://localhost/metrics
+// works, and as a JSON file rewritten periodically.
+class MetricsExporter
+{
+public:
+  // An empty socket path or JSON file name disables that output. The
+  // registry must outlive the exporter.
+  void init(const MetricsRegistry& registry,
+            const std::string& socketPath,
+            const std::string& jsonFileName,
+            std::chrono::milliseconds jsonInterval);
+  // Writes a last JSON file, so that it has the final values.
+  void destroy();
+
+private:
+  void listenOnSocket();
+  // Closes the socket and the pipe, whichever are open.
+  void closeFds();
+  void runThread();
+  void serveClient(int clientFd);
+  void writeJson();
+
+  const MetricsRegistry* m_registry = nullptr;
+  std::string m_socketPath;
+  std::string m_jsonFileName;
+  std::chrono::milliseconds m_jsonInterval{ 0 };
+  int m_listenFd = -1;
+  // Written to by destroy() to wake the thread up.
+  int m_wakeFds[2] = { -1, -1 };
+  std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,517 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "io.hpp"
+#include "png.hpp"
+
+static constexpr uint8_t PNG_SIGNATURE[8] = {
+  0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+};
+
+// Largest payload of a deflate stored block.
+static constexpr size_t MAX_STORED_BLOCK_SIZE = 65535;
+
+static const std::array<uint32_t, 256>& getCrcTable()
+{
+  static const std::array<uint32_t, 256> table = []() {
+    std::array<uint32_t, 256> result{};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      result[i] = c;
+    }
+
+    return result;
+  }();
+
+  return table;
+}
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size)
+{
+  const auto& table = getCrcTable();
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+
+  return crc;
+}
+
+static uint32_t computeAdler32(const std::vector<uint8_t>& data)
+{
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (uint8_t byte : data) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+
+  return (b << 16) | a;
+}
+
+static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+  out.push_back(static_cast<uint8_t>(value >> 24));
+  out.push_back(static_cast<uint8_t>(value >> 16));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint32_t readBigEndian(const uint8_t* data)
+{
+  return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16)
+         | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+}
+
+static void writeChunk(std::ofstream& file, const char type[4],
+                       const std::vector<uint8_t>& data)
+{
+  std::vector<uint8_t> header;
+  appendBigEndian(header, static_cast<uint32_t>(data.size()));
+  header.insert(header.end(), type, type + 4);
+
+  uint32_t crc = updateCrc(0xffffffffu, header.data() + 4, 4);
+  crc = updateCrc(crc, data.data(), data.size()) ^ 0xffffffffu;
+
+  std::vector<uint8_t> footer;
+  appendBigEndian(footer, crc);
+
+  file.write(reinterpret_cast<const char*>(header.data()), header.size());
+  file.write(reinterpret_cast<const char*>(data.data()), data.size());
+  file.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+}
+
+void writePng(const std::string& fileName, const ImageData& image)
+{
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open " + fileName + "!");
+  }
+
+  file.write(reinterpret_cast<const char*>(PNG_SIGNATURE),
+             sizeof(PNG_SIGNATURE));
+
+  std::vector<uint8_t> header;
+  appendBigEndian(header, image.width);
+  appendBigEndian(header, image.height);
+  header.push_back(8); // Bit depth
+  header.push_back(2); // Colour type: RGB
+  header.push_back(0); // Compression method: deflate
+  header.push_back(0); // Filter method: adaptive
+  header.push_back(0); // Interlace method: none
+  writeChunk(file, "IHDR", header);
+
+  // Each row is preceded by its filter type, which is always "none".
+  size_t rowSize = size_t(image.width) * 3;
+  std::vector<uint8_t> scanlines;
+  scanlines.reserve((rowSize + 1) * image.height);
+  for (uint32_t y = 0; y < image.height; y++) {
+    scanlines.push_back(0);
+    const uint8_t* row = image.pixels.data() + y * rowSize;
+    scanlines.insert(scanlines.end(), row, row + rowSize);
+  }
+
+  std::vector<uint8_t> zlib = { 0x78, 0x01 };
+  size_t offset = 0;
+  do {
+    size_t blockSize = std::min(MAX_STORED_BLOCK_SIZE,
+                                scanlines.size() - offset);
+    bool isFinal = offset + blockSize == scanlines.size();
+
+    zlib.push_back(isFinal ? 1 : 0);
+    zlib.push_back(static_cast<uint8_t>(blockSize));
+    zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+    zlib.push_back(static_cast<uint8_t>(~blockSize));
+    zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+    zlib.insert(zlib.end(), scanlines.begin() + offset,
+                scanlines.begin() + offset + blockSize);
+
+    offset += blockSize;
+  } while (offset < scanlines.size());
+  appendBigEndian(zlib, computeAdler32(scanlines));
+  writeChunk(file, "IDAT", zlib);
+
+  writeChunk(file, "IEND", {});
+}
+
+// Canonical Huffman code of a deflate block: the number of codes of each
+// length, and the symbols ordered by code.
+struct Huffman
+{
+  uint16_t counts[16];
+  uint16_t symbols[288];
+};
+
+struct InflateState
+{
+  const std::vector<uint8_t>& input;
+  size_t offset;
+  uint32_t bitBuffer;
+  int bitCount;
+  const std::string& fileName;
+};
+
+// Base and extra bits of the length symbols 257 to 285, and of the distance
+// symbols.
+static constexpr uint16_t LENGTH_BASES[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+  67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static constexpr uint8_t LENGTH_EXTRA_BITS[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5,
+  5, 5, 5, 0
+};
+static constexpr uint16_t DISTANCE_BASES[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+  769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static constexpr uint8_t DISTANCE_EXTRA_BITS[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+  11, 11, 12, 12, 13, 13
+};
+// Order in which a dynamic block gives the code lengths of its code length
+// code.
+static constexpr uint8_t CODE_LENGTH_ORDER[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static uint32_t readBits(InflateState& state, int count)
+{
+  while (state.bitCount < count) {
+    if (state.offset >= state.input.size()) {
+      throw std::runtime_error(state.fileName + " is truncated!");
+    }
+    state.bitBuffer |= uint32_t(state.input[state.offset++])
+                       << state.bitCount;
+    state.bitCount += 8;
+  }
+
+  uint32_t bits = state.bitBuffer & ((uint32_t(1) << count) - 1);
+  state.bitBuffer >>= count;
+  state.bitCount -= count;
+
+  return bits;
+}
+
+static void buildHuffman(Huffman& huffman, const uint8_t* lengths,
+                         size_t symbolCount, const std::string& fileName)
+{
+  std::fill(std::begin(huffman.counts), std::end(huffman.counts), 0);
+  for (size_t i = 0; i < symbolCount; i++) {
+    huffman.counts[lengths[i]]++;
+  }
+
+  // Codes of each length start after those of the shorter lengths, which
+  // must leave room for them.
+  uint16_t offsets[16];
+  offsets[1] = 0;
+  int left = 1;
+  for (int length = 1; length < 16; length++) {
+    left = 2 * left - huffman.counts[length];
+    if (left < 0) {
+      throw std::runtime_error(fileName + " has an invalid Huffman code!");
+    }
+    if (length < 15) {
+      offsets[length + 1] = offsets[length] + huffman.counts[length];
+    }
+  }
+
+  for (size_t i = 0; i < symbolCount; i++) {
+    if (lengths[i] != 0) {
+      huffman.symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+    }
+  }
+}
+
+// Reads the code bit by bit, most significant first, until it falls within
+// the codes of its length.
+static uint16_t decodeSymbol(InflateState& state, const Huffman& huffman)
+{
+  int code = 0;
+  int first = 0;
+  int index = 0;
+  for (int length = 1; length < 16; length++) {
+    code |= static_cast<int>(readBits(state, 1));
+    int count = huffman.counts[length];
+    if (code - first < count) {
+      return huffman.symbols[index + code - first];
+    }
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+
+  throw std::runtime_error(state.fileName + " has an invalid Huffman code!");
+}
+
+static void inflateBlock(InflateState& state, const Huffman& lengthCode,
+                         const Huffman& distanceCode,
+                         std::vector<uint8_t>& output)
+{
+  while (true) {
+    uint16_t symbol = decodeSymbol(state, lengthCode);
+    if (symbol < 256) {
+      output.push_back(static_cast<uint8_t>(symbol));
+      continue;
+    }
+    if (symbol == 256) {
+      return;
+    }
+
+    symbol -= 257;
+    if (symbol >= 29) {
+      throw std::runtime_error(state.fileName + " has an invalid length!");
+    }
+    size_t length = LENGTH_BASES[symbol]
+                    + readBits(state, LENGTH_EXTRA_BITS[symbol]);
+
+    symbol = decodeSymbol(state, distanceCode);
+    if (symbol >= 30) {
+      throw std::runtime_error(state.fileName + " has an invalid distance!");
+    }
+    size_t distance = DISTANCE_BASES[symbol]
+                      + readBits(state, DISTANCE_EXTRA_BITS[symbol]);
+    if (distance > output.size()) {
+      throw std::runtime_error(state.fileName + " has an invalid distance!");
+    }
+
+    // The copy may overlap what it appends, byte by byte.
+    size_t start = output.size() - distance;
+    for (size_t i = 0; i < length; i++) {
+      output.push_back(output[start + i]);
+    }
+  }
+}
+
+static void readDynamicCodes(InflateState& state, Huffman& lengthCode,
+                             Huffman& distanceCode)
+{
+  size_t lengthCount = readBits(state, 5) + 257;
+  size_t distanceCount = readBits(state, 5) + 1;
+  size_t codeLengthCount = readBits(state, 4) + 4;
+  if (lengthCount > 286 || distanceCount > 30) {
+    throw std::runtime_error(state.fileName + " has an invalid block!");
+  }
+
+  uint8_t lengths[286 + 30] = {};
+  for (size_t i = 0; i < codeLengthCount; i++) {
+    lengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(readBits(state, 3));
+  }
+  Huffman codeLengthCode;
+  buildHuffman(codeLengthCode, lengths, 19, state.fileName);
+
+  // The lengths of both codes are given as one sequence, run-length coded.
+  size_t count = lengthCount + distanceCount;
+  for (size_t i = 0; i < count;) {
+    uint16_t symbol = decodeSymbol(state, codeLengthCode);
+    if (symbol < 16) {
+      lengths[i++] = static_cast<uint8_t>(symbol);
+      continue;
+    }
+
+    uint8_t value = 0;
+    size_t repeatCount;
+    if (symbol == 16) {
+      if (i == 0) {
+        throw std::runtime_error(state.fileName + " has an invalid block!");
+      }
+      value = lengths[i - 1];
+      repeatCount = 3 + readBits(state, 2);
+    } else if (symbol == 17) {
+      repeatCount = 3 + readBits(state, 3);
+    } else {
+      repeatCount = 11 + readBits(state, 7);
+    }
+    if (i + repeatCount > count) {
+      throw std::runtime_error(state.fileName + " has an invalid block!");
+    }
+    std::fill(lengths + i, lengths + i + repeatCount, value);
+    i += repeatCount;
+  }
+
+  buildHuffman(lengthCode, lengths, lengthCount, state.fileName);
+  buildHuffman(distanceCode, lengths + lengthCount, distanceCount,
+               state.fileName);
+}
+
+// Decompresses a zlib stream (RFC 1950 and 1951). The checksum is not
+// verified, since the PNG chunks have their own.
+static std::vector<uint8_t> inflateZlib(const std::vector<uint8_t>& zlib,
+                                        const std::string& fileName)
+{
+  if (zlib.size() < 2 || (zlib[0] & 0xf) != 8
+      || ((zlib[0] << 8) | zlib[1]) % 31 != 0 || (zlib[1] & 0x20) != 0) {
+    throw std::runtime_error(fileName + " has an invalid zlib header!");
+  }
+
+  InflateState state{ zlib, 2, 0, 0, fileName };
+  std::vector<uint8_t> output;
+  bool isFinal = false;
+  while (!isFinal) {
+    isFinal = readBits(state, 1) != 0;
+    uint32_t type = readBits(state, 2);
+    if (type == 0) {
+      // Stored blocks start at a byte boundary.
+      state.bitBuffer = 0;
+      state.bitCount = 0;
+      if (state.offset + 4 > zlib.size()) {
+        throw std::runtime_error(fileName + " is truncated!");
+      }
+      size_t blockSize = zlib[state.offset] | (zlib[state.offset + 1] << 8);
+      state.offset += 4;
+      if (state.offset + blockSize > zlib.size()) {
+        throw std::runtime_error(fileName + " is truncated!");
+      }
+      output.insert(output.end(), zlib.begin() + state.offset,
+                    zlib.begin() + state.offset + blockSize);
+      state.offset += blockSize;
+    } else if (type == 1) {
+      static const std::array<Huffman, 2> fixedCodes = []() {
+        uint8_t lengths[288];
+        std::fill(lengths, lengths + 144, 8);
+        std::fill(lengths + 144, lengths + 256, 9);
+        std::fill(lengths + 256, lengths + 280, 7);
+        std::fill(lengths + 280, lengths + 288, 8);
+        std::array<Huffman, 2> codes;
+        buildHuffman(codes[0], lengths, 288, "");
+        std::fill(lengths, lengths + 30, 5);
+        buildHuffman(codes[1], lengths, 30, "");
+
+        return codes;
+      }();
+      inflateBlock(state, fixedCodes[0], fixedCodes[1], output);
+    } else if (type == 2) {
+      Huffman lengthCode;
+      Huffman distanceCode;
+      readDynamicCodes(state, lengthCode, distanceCode);
+      inflateBlock(state, lengthCode, distanceCode, output);
+    } else {
+      throw std::runtime_error(fileName + " has an invalid block!");
+    }
+  }
+
+  return output;
+}
+
+static uint8_t predictPaeth(uint8_t left, uint8_t up, uint8_t upLeft)
+{
+  int prediction = int(left) + int(up) - int(upLeft);
+  int leftDistance = std::abs(prediction - int(left));
+  int upDistance = std::abs(prediction - int(up));
+  int upLeftDistance = std::abs(prediction - int(upLeft));
+  if (leftDistance <= upDistance && leftDistance <= upLeftDistance) {
+    return left;
+  }
+
+  return upDistance <= upLeftDistance ? up : upLeft;
+}
+
+// Reverses the filter of each scanline in place, against the previous
+// unfiltered one.
+static void unfilterScanlines(std::vector<uint8_t>& scanlines,
+                              size_t rowSize, uint32_t height,
+                              size_t pixelSize, const std::string& fileName)
+{
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t filter = scanlines[y * (rowSize + 1)];
+    uint8_t* row = scanlines.data() + y * (rowSize + 1) + 1;
+    const uint8_t* previous = y > 0 ? row - (rowSize + 1) : nullptr;
+
+    for (size_t x = 0; x < rowSize; x++) {
+      uint8_t left = x >= pixelSize ? row[x - pixelSize] : 0;
+      uint8_t up = previous ? previous[x] : 0;
+      uint8_t upLeft = previous && x >= pixelSize
+                       ? previous[x - pixelSize] : 0;
+      switch (filter) {
+        case 0:
+          break;
+        case 1:
+          row[x] += left;
+          break;
+        case 2:
+          row[x] += up;
+          break;
+        case 3:
+          row[x] += static_cast<uint8_t>((int(left) + int(up)) / 2);
+          break;
+        case 4:
+          row[x] += predictPaeth(left, up, upLeft);
+          break;
+        default:
+          throw std::runtime_error(fileName + " has an invalid row filter!");
+      }
+    }
+  }
+}
+
+ImageData readPng(const std::string& fileName)
+{
+  std::vector<char> buffer = readFile(fileName);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.data());
+  size_t size = buffer.size();
+
+  if (size < sizeof(PNG_SIGNATURE)
+      || std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0) {
+    throw std::runtime_error(fileName + " is not a PNG file!");
+  }
+
+  ImageData image;
+  size_t pixelSize = 3;
+  std::vector<uint8_t> zlib;
+  size_t offset = sizeof(PNG_SIGNATURE);
+  while (offset + 12 <= size) {
+    uint32_t length = readBigEndian(data + offset);
+    const char* type = reinterpret_cast<const char*>(data + offset + 4);
+    const uint8_t* chunk = data + offset + 8;
+    if (offset + 12 + length > size) {
+      throw std::runtime_error(fileName + " is truncated!");
+    }
+
+    if (std::memcmp(type, "IHDR", 4) == 0) {
+      image.width = readBigEndian(chunk);
+      image.height = readBigEndian(chunk + 4);
+      if (chunk[8] != 8 || (chunk[9] != 2 && chunk[9] != 6)) {
+        throw std::runtime_error(fileName + " is not 8-bit RGB or RGBA!");
+      }
+      if (chunk[12] != 0) {
+        throw std::runtime_error(fileName + " is interlaced!");
+      }
+      pixelSize = chunk[9] == 6 ? 4 : 3;
+    } else if (std::memcmp(type, "IDAT", 4) == 0) {
+      zlib.insert(zlib.end(), chunk, chunk + length);
+    } else if (std::memcmp(type, "IEND", 4) == 0) {
+      break;
+    }
+
+    offset += 12 + length;
+  }
+
+  size_t rowSize = size_t(image.width) * pixelSize;
+  std::vector<uint8_t> scanlines = inflateZlib(zlib, fileName);
+  if (scanlines.size() != (rowSize + 1) * image.height) {
+    throw std::runtime_error(fileName + " has the wrong image size!");
+  }
+  unfilterScanlines(scanlines, rowSize, image.height, pixelSize, fileName);
+
+  // Alpha is dropped.
+  image.pixels.resize(size_t(image.width) * image.height * 3);
+  for (uint32_t y = 0; y < image.height; y++) {
+    const uint8_t* row = scanlines.data() + y * (rowSize + 1) + 1;
+    uint8_t* pixels = image.pixels.data() + y * size_t(image.width) * 3;
+    for (uint32_t x = 0; x < image.width; x++) {
+      std::memcpy(pixels + x * 3, row + x * pixelSize, 3);
+    }
+  }
+
+  return image;
+}
@@ -0,0 +1,17 @@
+#ifndef PNG_HPP
+#define PNG_HPP
+
+#include <string>
+
+#include "../ds/ImageData.hpp"
+
+// Writes an 8-bit RGB PNG. The image data is stored uncompressed (deflate
+// "stored" blocks), which keeps the writer dependency-free and fast enough
+// to run per frame.
+void writePng(const std::string& fileName, const ImageData& image);
+
+// Reads 8-bit RGB or RGBA PNGs that are not interlaced, such as those
+// written by writePng() or by image editors. Alpha is dropped.
+ImageData readPng(const std::string& fileName);
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef QUANTIZE_HPP
+#define QUANTIZE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Quantized vertex attribute types. See utils/vertex_layout.hpp for the
+// formats they map to.
+
+// Half-float position. Three-component 16-bit formats are rarely supported
+// for vertex input, so w is stored too (and set to 1).
+struct Half4
+{
+  uint16_t x, y, z, w;
+};
+
+// Unit normal in octahedral encoding, as two SNORM16 values.
+struct OctNormal
+{
+  int16_t x, y;
+};
+
+struct Unorm16x2
+{
+  uint16_t x, y;
+};
+
+struct Unorm8x4
+{
+  uint8_t x, y, z, w;
+};
+
+inline uint16_t floatToHalf(float value)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  uint32_t sign = (bits >> 16) & 0x8000;
+  int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if (exponent >= 31) {
+    // Overflow, infinity and NaN.
+    bool isNan = ((bits >> 23) & 0xff) == 0xff && mantissa != 0;
+    return static_cast<uint16_t>(sign | 0x7c00 | (isNan ? 0x200 : 0));
+  } else if (exponent <= 0) {
+    // Denormals and underflow to zero.
+    if (exponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+
+    mantissa |= 0x800000;
+    uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    uint32_t halfMantissa = mantissa >> shift;
+    uint32_t roundBit = 1u << (shift - 1);
+    if ((mantissa & roundBit) && (mantissa & (3 * roundBit - 1))) {
+      halfMantissa++;
+    }
+
+    return static_cast<uint16_t>(sign | halfMantissa);
+  }
+
+  uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10)
+                  | (mantissa >> 13);
+  // Round to nearest even. A carry into the exponent is still correct.
+  if ((mantissa & 0x1000) && (mantissa & 0x2fff)) {
+    half++;
+  }
+
+  return static_cast<uint16_t>(half);
+}
+
+inline Half4 packHalf4(float x, float y, float z, float w = 1.f)
+{
+  return { floatToHalf(x), floatToHalf(y), floatToHalf(z), floatToHalf(w) };
+}
+
+inline int16_t packSnorm16(float value)
+{
+  value = std::clamp(value, -1.f, 1.f);
+
+  return static_cast<int16_t>(std::lround(value * 32767.f));
+}
+
+inline uint16_t packUnorm16(float value)
+{
+  value = std::clamp(value, 0.f, 1.f);
+
+  return static_cast<uint16_t>(std::lround(value * 65535.f));
+}
+
+inline uint8_t packUnorm8(float value)
+{
+  value = std::clamp(value, 0.f, 1.f);
+
+  return static_cast<uint8_t>(std::lround(value * 255.f));
+}
+
+// Projects the normal onto the octahedron |x| + |y| + |z| = 1 and unfolds
+// the lower hemisphere onto the outer triangles of the unit square. Decoded
+// in shaders with:
+//   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//   float t = max(-n.z, 0.0);
+//   n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+//   n = normalize(n);
+inline OctNormal encodeOctahedral(float x, float y, float z)
+{
+  float l1Norm = std::abs(x) + std::abs(y) + std::abs(z);
+  float u = x / l1Norm;
+  float v = y / l1Norm;
+
+  if (z < 0.f) {
+    float foldedU = (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+    float foldedV = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+    u = foldedU;
+    v = foldedV;
+  }
+
+  return { packSnorm16(u), packSnorm16(v) };
+}
+
+inline Unorm16x2 packUnorm16x2(float x, float y)
+{
+  return { packUnorm16(x), packUnorm16(y) };
+}
+
+inline Unorm8x4 packUnorm8x4(float x, float y, float z, float w)
+{
+  return { packUnorm8(x), packUnorm8(y), packUnorm8(z), packUnorm8(w) };
+}
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../ds/Mat4.hpp"
+
+// Thin wrappers over SIMD registers of floats, so that kernels are written
+// once and compiled for the widest instruction set enabled at build time
+// (e.g. -mavx). FloatN is that width, and Float1 the scalar fallback.
+// Loads and stores require FloatN::WIDTH-aligned pointers. Comparisons
+// return one bit per lane, lane 0 in the lowest bit.
+
+struct Float1
+{
+  static constexpr size_t WIDTH = 1;
+
+  float v;
+
+  static Float1 load(const float* p) { return { *p }; }
+  static Float1 set(float x) { return { x }; }
+  void store(float* p) const { *p = v; }
+
+  friend Float1 operator+(Float1 a, Float1 b) { return { a.v + b.v }; }
+  friend Float1 operator-(Float1 a, Float1 b) { return { a.v - b.v }; }
+  friend Float1 operator*(Float1 a, Float1 b) { return { a.v * b.v }; }
+
+  friend uint32_t lessMask(Float1 a, Float1 b) { return a.v < b.v ? 1 : 0; }
+};
+
+#if defined(__SSE2__)
+struct Float4
+{
+  static constexpr size_t WIDTH = 4;
+
+  __m128 v;
+
+  static Float4 load(const float* p) { return { _mm_load_ps(p) }; }
+  static Float4 set(float x) { return { _mm_set1_ps(x) }; }
+  void store(float* p) const { _mm_store_ps(p, v); }
+
+  friend Float4 operator+(Float4 a, Float4 b)
+  {
+    return { _mm_add_ps(a.v, b.v) };
+  }
+  friend Float4 operator-(Float4 a, Float4 b)
+  {
+    return { _mm_sub_ps(a.v, b.v) };
+  }
+  friend Float4 operator*(Float4 a, Float4 b)
+  {
+    return { _mm_mul_ps(a.v, b.v) };
+  }
+
+  friend uint32_t lessMask(Float4 a, Float4 b)
+  {
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)));
+  }
+};
+#endif
+
+#if defined(__AVX__)
+struct Float8
+{
+  static constexpr size_t WIDTH = 8;
+
+  __m256 v;
+
+  static Float8 load(const float* p) { return { _mm256_load_ps(p) }; }
+  static Float8 set(float x) { return { _mm256_set1_ps(x) }; }
+  void store(float* p) const { _mm256_store_ps(p, v); }
+
+  friend Float8 operator+(Float8 a, Float8 b)
+  {
+    return { _mm256_add_ps(a.v, b.v) };
+  }
+  friend Float8 operator-(Float8 a, Float8 b)
+  {
+    return { _mm256_sub_ps(a.v, b.v) };
+  }
+  friend Float8 operator*(Float8 a, Float8 b)
+  {
+    return { _mm256_mul_ps(a.v, b.v) };
+  }
+
+  friend uint32_t lessMask(Float8 a, Float8 b)
+  {
+    return static_cast<uint32_t>(
+      _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)));
+  }
+};
+
+using FloatN = Float8;
+#elif defined(__SSE2__)
+using FloatN = Float4;
+#else
+using FloatN = Float1;
+#endif
+
+// Writes the matrices whose elements are spread over SIMD lanes, i.e. lane
+// j of elements[e] is element e of matrix j, to consecutive matrices.
+inline void storeMatrices(const Float1 elements[16], Mat4* matrices)
+{
+  for (size_t e = 0; e < 16; e++) {
+    matrices[0].m[e] = elements[e].v;
+  }
+}
+
+#if defined(__SSE2__)
+inline void storeMatrices(const Float4 elements[16], Mat4* matrices)
+{
+  // Each 4x4 transpose turns four elements of four matrices into one
+  // column of each.
+  for (size_t column = 0; column < 4; column++) {
+    __m128 row0 = elements[column * 4].v;
+    __m128 row1 = elements[column * 4 + 1].v;
+    __m128 row2 = elements[column * 4 + 2].v;
+    __m128 row3 = elements[column * 4 + 3].v;
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    _mm_store_ps(&matrices[0].m[column * 4], row0);
+    _mm_store_ps(&matrices[1].m[column * 4], row1);
+    _mm_store_ps(&matrices[2].m[column * 4], row2);
+    _mm_store_ps(&matrices[3].m[column * 4], row3);
+  }
+}
+#endif
+
+#if defined(__AVX__)
+inline void storeMatrices(const Float8 elements[16], Mat4* matrices)
+{
+  Float4 low[16];
+  Float4 high[16];
+  for (size_t e = 0; e < 16; e++) {
+    low[e].v = _mm256_castps256_ps128(elements[e].v);
+    high[e].v = _mm256_extractf128_ps(elements[e].v, 1);
+  }
+
+  storeMatrices(low, matrices);
+  storeMatrices(high, matrices + 4);
+}
+#endif
+
+// Sets result to a * b. result may be the same matrix as b.
+inline void multiply(const Mat4& a, const Mat4& b, Mat4& result)
+{
+#if defined(__SSE2__)
+  __m128 a0 = _mm_load_ps(&a.m[0]);
+  __m128 a1 = _mm_load_ps(&a.m[4]);
+  __m128 a2 = _mm_load_ps(&a.m[8]);
+  __m128 a3 = _mm_load_ps(&a.m[12]);
+  for (size_t column = 0; column < 4; column++) {
+    const float* b0 = &b.m[column * 4];
+    __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(b0[0]));
+    sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(b0[1])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(b0[2])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(b0[3])));
+    _mm_store_ps(&result.m[column * 4], sum);
+  }
+#else
+  Mat4 product;
+  for (size_t column = 0; column < 4; column++) {
+    for (size_t row = 0; row < 4; row++) {
+      float sum = 0.f;
+      for (size_t k = 0; k < 4; k++) {
+        sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+      }
+      product.m[column * 4 + row] = sum;
+    }
+  }
+  result = product;
+#endif
+}
+
+// Copies a matrix to memory that is written but not read by the CPU, e.g.
+// a mapped buffer, bypassing the cache.
+inline void streamMatrix(const Mat4& matrix, Mat4& destination)
+{
+#if defined(__SSE2__)
+  for (size_t column = 0; column < 4; column++) {
+    _mm_stream_ps(&destination.m[column * 4],
+                  _mm_load_ps(&matrix.m[column * 4]));
+  }
+#else
+  destination = matrix;
+#endif
+}
+
+// Orders streaming stores before later writes, e.g. before the buffer is
+// handed to the GPU.
+inline void streamFence()
+{
+#if defined(__SSE2__)
+  _mm_sfence();
+#endif
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "hash.hpp"
+#include "specialization.hpp"
+#include "spirv.hpp"
+
+bool SpecializationConstants::isEmpty() const
+{
+  return m_values.empty();
+}
+
+std::vector<VkSpecializationMapEntry>
+SpecializationConstants::getMapEntries() const
+{
+  std::vector<VkSpecializationMapEntry> entries;
+  entries.reserve(m_values.size());
+
+  uint32_t offset = 0;
+  for (const auto& value : m_values) {
+    entries.push_back({ value.first, offset, sizeof(uint32_t) });
+    offset += sizeof(uint32_t);
+  }
+
+  return entries;
+}
+
+std::vector<uint32_t> SpecializationConstants::getData() const
+{
+  std::vector<uint32_t> data;
+  data.reserve(m_values.size());
+  for (const auto& value : m_values) {
+    data.push_back(value.second);
+  }
+
+  return data;
+}
+
+void SpecializationConstants::validate(
+  const ShaderReflection& reflection) const
+{
+  for (const auto& value : m_values) {
+    auto it = std::find_if(
+      reflection.specializationConstants.begin(),
+      reflection.specializationConstants.end(),
+      [&](const ReflectedSpecializationConstant& constant) {
+        return constant.constantId == value.first;
+      });
+    if (it == reflection.specializationConstants.end()) {
+      throw std::runtime_error("Shader has no specialization constant "
+                               + std::to_string(value.first) + "!");
+    }
+
+    if (it->size != sizeof(uint32_t)) {
+      throw std::runtime_error("Specialization constant " + it->name
+                               + " is not 32 bits wide!");
+    }
+  }
+}
+
+size_t SpecializationConstants::hash() const
+{
+  size_t seed = 0;
+  for (const auto& value : m_values) {
+    hashCombine(seed, value.first);
+    hashCombine(seed, value.second);
+  }
+
+  return seed;
+}
+
+bool SpecializationConstants::operator==(
+  const SpecializationConstants& other) const
+{
+  return m_values == other.m_values;
+}
+
+bool SpecializationConstants::operator!=(
+  const SpecializationConstants& other) const
+{
+  return !(*this == other);
+}
@@ -0,0 +1,72 @@
+#ifndef SPECIALIZATION_HPP
+#define SPECIALIZATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+struct ShaderReflection;
+
+// Typed handle to a specialization constant, matching a shader declaration
+// such as
+//   layout(constant_id = 0) const bool IS_FOG_ENABLED = false;
+// Workgroup sizes declared with local_size_x_id are set the same way, as
+// uint32_t constants.
+template<typename T>
+struct SpecConstant
+{
+  static_assert(std::is_same_v<T, bool>
+                || std::is_same_v<T, int32_t>
+                || std::is_same_v<T, uint32_t>
+                || std::is_same_v<T, float>,
+                "Specialization constants must be bool, int, uint or float.");
+
+  uint32_t constantId;
+};
+
+// Values of the specialization constants of one shader stage. Constants
+// that are not set keep the default from the shader. Values are kept
+// ordered by constant ID, so the order they are set in does not matter
+// when comparing variants.
+class SpecializationConstants
+{
+public:
+  template<typename T>
+  SpecializationConstants& set(SpecConstant<T> constant, T value)
+  {
+    uint32_t bits;
+    if constexpr (std::is_same_v<T, bool>) {
+      bits = value ? VK_TRUE : VK_FALSE;
+    } else {
+      std::memcpy(&bits, &value, sizeof(bits));
+    }
+    m_values[constant.constantId] = bits;
+
+    return *this;
+  }
+
+  bool isEmpty() const;
+
+  // The map entries and data for a VkSpecializationInfo. All supported
+  // types are 32 bits wide, so each constant takes one word of the data.
+  std::vector<VkSpecializationMapEntry> getMapEntries() const;
+  std::vector<uint32_t> getData() const;
+
+  // Throws if a constant is not declared by the shader, since it would
+  // silently have no effect.
+  void validate(const ShaderReflection& reflection) const;
+
+  size_t hash() const;
+  bool operator==(const SpecializationConstants& other) const;
+  bool operator!=(const SpecializationConstants& other) const;
+
+private:
+  std::map<uint32_t, uint32_t> m_values;
+};
+
+#endif
@@ -0,0 +1,521 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "spirv.hpp"
+
+// Subset of the SPIR-V specification needed for reflection.
+static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+static constexpr size_t SPIRV_HEADER_WORD_COUNT = 5;
+
+enum SpirvOp : uint32_t
+{
+  OP_NAME = 5,
+  OP_ENTRY_POINT = 15,
+  OP_EXECUTION_MODE = 16,
+  OP_TYPE_BOOL = 20,
+  OP_TYPE_INT = 21,
+  OP_TYPE_FLOAT = 22,
+  OP_TYPE_VECTOR = 23,
+  OP_TYPE_MATRIX = 24,
+  OP_TYPE_IMAGE = 25,
+  OP_TYPE_SAMPLER = 26,
+  OP_TYPE_SAMPLED_IMAGE = 27,
+  OP_TYPE_ARRAY = 28,
+  OP_TYPE_RUNTIME_ARRAY = 29,
+  OP_TYPE_STRUCT = 30,
+  OP_TYPE_POINTER = 32,
+  OP_CONSTANT = 43,
+  OP_SPEC_CONSTANT_TRUE = 48,
+  OP_SPEC_CONSTANT_FALSE = 49,
+  OP_SPEC_CONSTANT = 50,
+  OP_VARIABLE = 59,
+  OP_DECORATE = 71,
+  OP_MEMBER_DECORATE = 72
+};
+
+enum SpirvDecoration : uint32_t
+{
+  DECORATION_SPEC_ID = 1,
+  DECORATION_BLOCK = 2,
+  DECORATION_BUFFER_BLOCK = 3,
+  DECORATION_ARRAY_STRIDE = 6,
+  DECORATION_MATRIX_STRIDE = 7,
+  DECORATION_BUILT_IN = 11,
+  DECORATION_LOCATION = 30,
+  DECORATION_BINDING = 33,
+  DECORATION_DESCRIPTOR_SET = 34,
+  DECORATION_OFFSET = 35
+};
+
+enum SpirvStorageClass : uint32_t
+{
+  STORAGE_CLASS_UNIFORM_CONSTANT = 0,
+  STORAGE_CLASS_INPUT = 1,
+  STORAGE_CLASS_UNIFORM = 2,
+  STORAGE_CLASS_PUSH_CONSTANT = 9,
+  STORAGE_CLASS_STORAGE_BUFFER = 12
+};
+
+enum SpirvExecutionModel : uint32_t
+{
+  EXECUTION_MODEL_VERTEX = 0,
+  EXECUTION_MODEL_TESSELLATION_CONTROL = 1,
+  EXECUTION_MODEL_TESSELLATION_EVALUATION = 2,
+  EXECUTION_MODEL_GEOMETRY = 3,
+  EXECUTION_MODEL_FRAGMENT = 4,
+  EXECUTION_MODEL_GL_COMPUTE = 5
+};
+
+static constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE = 17;
+static constexpr uint32_t IMAGE_DIM_BUFFER = 5;
+static constexpr uint32_t IMAGE_DIM_SUBPASS_DATA = 6;
+
+struct SpirvId
+{
+  uint32_t opcode = 0;
+  std::vector<uint32_t> operands;
+  std::string name;
+
+  bool hasSet = false;
+  bool hasBinding = false;
+  bool hasLocation = false;
+  bool hasSpecId = false;
+  bool isBuiltIn = false;
+  bool isBlock = false;
+  bool isBufferBlock = false;
+  uint32_t set = 0;
+  uint32_t binding = 0;
+  uint32_t location = 0;
+  uint32_t specId = 0;
+  uint32_t arrayStride = 0;
+
+  std::vector<uint32_t> memberOffsets;
+  std::vector<uint32_t> memberMatrixStrides;
+};
+
+static std::string readLiteralString(const uint32_t* words, size_t wordCount)
+{
+  const char* chars = reinterpret_cast<const char*>(words);
+  return std::string(chars, strnlen(chars, wordCount * sizeof(uint32_t)));
+}
+
+static VkShaderStageFlagBits toShaderStage(uint32_t executionModel)
+{
+  switch (executionModel) {
+    case EXECUTION_MODEL_VERTEX:
+      return VK_SHADER_STAGE_VERTEX_BIT;
+    case EXECUTION_MODEL_TESSELLATION_CONTROL:
+      return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case EXECUTION_MODEL_TESSELLATION_EVALUATION:
+      return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case EXECUTION_MODEL_GEOMETRY:
+      return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case EXECUTION_MODEL_FRAGMENT:
+      return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case EXECUTION_MODEL_GL_COMPUTE:
+      return VK_SHADER_STAGE_COMPUTE_BIT;
+    default:
+      throw std::runtime_error("Unsupported shader execution model.");
+  }
+}
+
+// Length of an OpTypeArray. Lengths from specialization constants, or from
+// OpSpecConstantOp, are rejected, since they are only known once the
+// pipeline is created.
+static uint32_t getArrayLength(
+  const std::unordered_map<uint32_t, SpirvId>& ids,
+  const SpirvId& arrayType)
+{
+  auto length = ids.find(arrayType.operands[1]);
+  if (length == ids.end() || length->second.opcode != OP_CONSTANT
+      || length->second.operands.size() < 2) {
+    throw std::runtime_error("SPIR-V array length is not a constant.");
+  }
+
+  return length->second.operands[1];
+}
+
+// Size in bytes of a type as laid out in a block, given explicit layout
+// decorations.
+static uint32_t computeTypeSize(
+  const std::unordered_map<uint32_t, SpirvId>& ids,
+  uint32_t typeId,
+  uint32_t matrixStride = 0)
+{
+  const SpirvId& type = ids.at(typeId);
+  switch (type.opcode) {
+    case OP_TYPE_BOOL:
+      return 4;
+    case OP_TYPE_INT:
+    case OP_TYPE_FLOAT:
+      return type.operands[0] / 8;
+    case OP_TYPE_VECTOR:
+      return computeTypeSize(ids, type.operands[0]) * type.operands[1];
+    case OP_TYPE_MATRIX:
+      if (matrixStride != 0) {
+        return matrixStride * type.operands[1];
+      }
+      return computeTypeSize(ids, type.operands[0]) * type.operands[1];
+    case OP_TYPE_ARRAY: {
+      uint32_t length = getArrayLength(ids, type);
+      uint32_t stride = type.arrayStride != 0
+                        ? type.arrayStride
+                        : computeTypeSize(ids, type.operands[0]);
+      return stride * length;
+    }
+    case OP_TYPE_RUNTIME_ARRAY:
+      return 0;
+    case OP_TYPE_STRUCT: {
+      uint32_t size = 0;
+      for (size_t i = 0; i < type.operands.size(); i++) {
+        uint32_t offset = i < type.memberOffsets.size()
+                          ? type.memberOffsets[i] : 0;
+        uint32_t memberMatrixStride = i < type.memberMatrixStrides.size()
+                                      ? type.memberMatrixStrides[i] : 0;
+        size = std::max(size,
+                        offset + computeTypeSize(ids, type.operands[i],
+                                                 memberMatrixStride));
+      }
+      return size;
+    }
+    default:
+      throw std::runtime_error("Cannot compute the size of a SPIR-V type.");
+  }
+}
+
+static VkDescriptorType toDescriptorType(const SpirvId& type,
+                                        uint32_t storageClass)
+{
+  switch (type.opcode) {
+    case OP_TYPE_SAMPLER:
+      return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case OP_TYPE_SAMPLED_IMAGE:
+      return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    case OP_TYPE_IMAGE: {
+      uint32_t dim = type.operands[1];
+      uint32_t sampled = type.operands[5];
+      if (dim == IMAGE_DIM_SUBPASS_DATA) {
+        return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      } else if (dim == IMAGE_DIM_BUFFER) {
+        return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                            : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+      }
+
+      return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                          : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+    case OP_TYPE_STRUCT:
+      if (storageClass == STORAGE_CLASS_STORAGE_BUFFER || type.isBufferBlock) {
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      }
+      return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    default:
+      throw std::runtime_error("Unsupported SPIR-V descriptor type.");
+  }
+}
+
+static VkFormat toVertexInputFormat(
+  const std::unordered_map<uint32_t, SpirvId>& ids,
+  const SpirvId& type)
+{
+  uint32_t componentCount = 1;
+  const SpirvId* componentType = &type;
+  if (type.opcode == OP_TYPE_VECTOR) {
+    componentType = &ids.at(type.operands[0]);
+    componentCount = type.operands[1];
+  }
+
+  static const VkFormat floatFormats[] = {
+    VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+    VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT
+  };
+  static const VkFormat intFormats[] = {
+    VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+    VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT
+  };
+  static const VkFormat uintFormats[] = {
+    VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+    VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT
+  };
+
+  if (componentCount < 1 || componentCount > 4) {
+    return VK_FORMAT_UNDEFINED;
+  }
+
+  if (componentType->opcode == OP_TYPE_FLOAT) {
+    return floatFormats[componentCount - 1];
+  } else if (componentType->opcode == OP_TYPE_INT) {
+    bool isSigned = componentType->operands[1] != 0;
+    return isSigned ? intFormats[componentCount - 1]
+                    : uintFormats[componentCount - 1];
+  }
+
+  return VK_FORMAT_UNDEFINED;
+}
+
+ShaderReflection reflectShader(const std::vector<char>& code)
+{
+  if (code.size() % sizeof(uint32_t) != 0
+      || code.size() < SPIRV_HEADER_WORD_COUNT * sizeof(uint32_t)) {
+    throw std::runtime_error("Shader code is not valid SPIR-V.");
+  }
+
+  std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+  std::memcpy(words.data(), code.data(), code.size());
+  if (words[0] != SPIRV_MAGIC) {
+    throw std::runtime_error("Shader code is not valid SPIR-V.");
+  }
+
+  ShaderReflection reflection{};
+  reflection.localSize[0] = 1;
+  reflection.localSize[1] = 1;
+  reflection.localSize[2] = 1;
+
+  std::unordered_map<uint32_t, SpirvId> ids;
+  std::vector<uint32_t> variables;
+  std::vector<uint32_t> specConstants;
+  bool hasEntryPoint = false;
+  uint32_t entryPointId = 0;
+
+  size_t offset = SPIRV_HEADER_WORD_COUNT;
+  while (offset < words.size()) {
+    uint32_t opcode = words[offset] & 0xffff;
+    uint32_t wordCount = words[offset] >> 16;
+    if (wordCount == 0 || offset + wordCount > words.size()) {
+      throw std::runtime_error("Shader code is not valid SPIR-V.");
+    }
+
+    const uint32_t* operands = &words[offset + 1];
+    uint32_t operandCount = wordCount - 1;
+
+    switch (opcode) {
+      case OP_NAME:
+        ids[operands[0]].name = readLiteralString(operands + 1,
+                                                  operandCount - 1);
+        break;
+      case OP_ENTRY_POINT:
+        // Only the first entry point is reflected.
+        if (!hasEntryPoint) {
+          hasEntryPoint = true;
+          reflection.stage = toShaderStage(operands[0]);
+          entryPointId = operands[1];
+          reflection.entryPoint = readLiteralString(operands + 2,
+                                                    operandCount - 2);
+        }
+        break;
+      case OP_EXECUTION_MODE:
+        if (hasEntryPoint && operands[0] == entryPointId
+            && operands[1] == EXECUTION_MODE_LOCAL_SIZE) {
+          reflection.localSize[0] = operands[2];
+          reflection.localSize[1] = operands[3];
+          reflection.localSize[2] = operands[4];
+        }
+        break;
+      case OP_TYPE_BOOL:
+      case OP_TYPE_INT:
+      case OP_TYPE_FLOAT:
+      case OP_TYPE_VECTOR:
+      case OP_TYPE_MATRIX:
+      case OP_TYPE_IMAGE:
+      case OP_TYPE_SAMPLER:
+      case OP_TYPE_SAMPLED_IMAGE:
+      case OP_TYPE_ARRAY:
+      case OP_TYPE_RUNTIME_ARRAY:
+      case OP_TYPE_STRUCT:
+      case OP_TYPE_POINTER: {
+        SpirvId& id = ids[operands[0]];
+        id.opcode = opcode;
+        id.operands.assign(operands + 1, operands + operandCount);
+        break;
+      }
+      case OP_CONSTANT:
+      case OP_SPEC_CONSTANT:
+      case OP_SPEC_CONSTANT_TRUE:
+      case OP_SPEC_CONSTANT_FALSE: {
+        // Operands are the result type, then the literal value.
+        SpirvId& id = ids[operands[1]];
+        id.opcode = opcode;
+        id.operands.assign(operands, operands + operandCount);
+        id.operands.erase(id.operands.begin() + 1);
+        if (opcode != OP_CONSTANT) {
+          specConstants.push_back(operands[1]);
+        }
+        break;
+      }
+      case OP_VARIABLE: {
+        SpirvId& id = ids[operands[1]];
+        id.opcode = opcode;
+        id.operands = { operands[0], operands[2] };
+        variables.push_back(operands[1]);
+        break;
+      }
+      case OP_DECORATE: {
+        SpirvId& id = ids[operands[0]];
+        uint32_t value = operandCount > 2 ? operands[2] : 0;
+        switch (operands[1]) {
+          case DECORATION_SPEC_ID:
+            id.hasSpecId = true;
+            id.specId = value;
+            break;
+          case DECORATION_BLOCK:
+            id.isBlock = true;
+            break;
+          case DECORATION_BUFFER_BLOCK:
+            id.isBufferBlock = true;
+            break;
+          case DECORATION_ARRAY_STRIDE:
+            id.arrayStride = value;
+            break;
+          case DECORATION_BUILT_IN:
+            id.isBuiltIn = true;
+            break;
+          case DECORATION_LOCATION:
+            id.hasLocation = true;
+            id.location = value;
+            break;
+          case DECORATION_BINDING:
+            id.hasBinding = true;
+            id.binding = value;
+            break;
+          case DECORATION_DESCRIPTOR_SET:
+            id.hasSet = true;
+            id.set = value;
+            break;
+        }
+        break;
+      }
+      case OP_MEMBER_DECORATE: {
+        SpirvId& id = ids[operands[0]];
+        uint32_t member = operands[1];
+        uint32_t value = operandCount > 3 ? operands[3] : 0;
+        if (operands[2] == DECORATION_OFFSET) {
+          if (id.memberOffsets.size() <= member) {
+            id.memberOffsets.resize(member + 1, 0);
+          }
+          id.memberOffsets[member] = value;
+        } else if (operands[2] == DECORATION_MATRIX_STRIDE) {
+          if (id.memberMatrixStrides.size() <= member) {
+            id.memberMatrixStrides.resize(member + 1, 0);
+          }
+          id.memberMatrixStrides[member] = value;
+        } else if (operands[2] == DECORATION_BUILT_IN) {
+          // Members of gl_PerVertex; the whole block is a built-in.
+          id.isBuiltIn = true;
+        }
+        break;
+      }
+    }
+
+    offset += wordCount;
+  }
+
+  if (!hasEntryPoint) {
+    throw std::runtime_error("Shader has no entry point.");
+  }
+
+  for (uint32_t variableId : variables) {
+    const SpirvId& variable = ids[variableId];
+    uint32_t storageClass = variable.operands[1];
+    const SpirvId& pointer = ids[variable.operands[0]];
+    uint32_t typeId = pointer.operands[1];
+    const SpirvId* type = &ids[typeId];
+
+    switch (storageClass) {
+      case STORAGE_CLASS_UNIFORM_CONSTANT:
+      case STORAGE_CLASS_UNIFORM:
+      case STORAGE_CLASS_STORAGE_BUFFER: {
+        if (!variable.hasBinding) {
+          break;
+        }
+
+        // Arrays of descriptors.
+        uint32_t descriptorCount = 1;
+        while (type->opcode == OP_TYPE_ARRAY
+               || type->opcode == OP_TYPE_RUNTIME_ARRAY) {
+          if (type->opcode == OP_TYPE_ARRAY) {
+            descriptorCount *= getArrayLength(ids, *type);
+          }
+          type = &ids[type->operands[0]];
+        }
+
+        ReflectedDescriptorBinding binding{};
+        binding.set = variable.set;
+        binding.binding = variable.binding;
+        binding.descriptorType = toDescriptorType(*type, storageClass);
+        binding.descriptorCount = descriptorCount;
+        binding.stageFlags = reflection.stage;
+        binding.name = !variable.name.empty() ? variable.name : type->name;
+        reflection.descriptorBindings.push_back(binding);
+        break;
+      }
+      case STORAGE_CLASS_PUSH_CONSTANT: {
+        // Ranges start at the first member's offset, so that blocks split
+        // between stages by explicit offsets do not overlap.
+        uint32_t firstOffset = type->memberOffsets.empty()
+                               ? 0
+                               : *std::min_element(type->memberOffsets.begin(),
+                                                   type->memberOffsets.end());
+
+        ReflectedPushConstantRange range{};
+        range.offset = firstOffset;
+        range.size = computeTypeSize(ids, typeId) - firstOffset;
+        range.stageFlags = reflection.stage;
+        reflection.pushConstantRanges.push_back(range);
+        break;
+      }
+      case STORAGE_CLASS_INPUT: {
+        if (reflection.stage != VK_SHADER_STAGE_VERTEX_BIT
+            || variable.isBuiltIn || type->isBuiltIn
+            || !variable.hasLocation) {
+          break;
+        }
+
+        ReflectedVertexInput input{};
+        input.location = variable.location;
+        input.format = toVertexInputFormat(ids, *type);
+        input.name = variable.name;
+        reflection.vertexInputs.push_back(input);
+        break;
+      }
+    }
+  }
+
+  for (uint32_t specConstantId : specConstants) {
+    const SpirvId& specConstant = ids[specConstantId];
+    if (!specConstant.hasSpecId) {
+      continue;
+    }
+
+    ReflectedSpecializationConstant constant{};
+    constant.constantId = specConstant.specId;
+    constant.name = specConstant.name;
+    if (specConstant.opcode == OP_SPEC_CONSTANT) {
+      constant.size = computeTypeSize(ids, specConstant.operands[0]);
+      constant.defaultValue = specConstant.operands[1];
+      if (specConstant.operands.size() > 2) {
+        constant.defaultValue |=
+          static_cast<uint64_t>(specConstant.operands[2]) << 32;
+      }
+    } else {
+      constant.size = sizeof(VkBool32);
+      constant.defaultValue = specConstant.opcode == OP_SPEC_CONSTANT_TRUE;
+    }
+    reflection.specializationConstants.push_back(constant);
+  }
+
+  auto byLocation = [](const ReflectedVertexInput& a,
+                       const ReflectedVertexInput& b) {
+    return a.location < b.location;
+  };
+  std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(),
+            byLocation);
+
+  return reflection;
+}
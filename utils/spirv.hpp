@@ -0,0 +1,60 @@
+#ifndef SPIRV_HPP
+#define SPIRV_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+struct ReflectedDescriptorBinding
+{
+  uint32_t set;
+  uint32_t binding;
+  VkDescriptorType descriptorType;
+  uint32_t descriptorCount;
+  VkShaderStageFlags stageFlags;
+  std::string name;
+};
+
+struct ReflectedPushConstantRange
+{
+  uint32_t offset;
+  uint32_t size;
+  VkShaderStageFlags stageFlags;
+};
+
+// Vertex shader input. The format is the one the shader reads (e.g. a vec4
+// is R32G32B32A32_SFLOAT), which may differ from the format of the vertex
+// attribute feeding it.
+struct ReflectedVertexInput
+{
+  uint32_t location;
+  VkFormat format;
+  std::string name;
+};
+
+struct ReflectedSpecializationConstant
+{
+  uint32_t constantId;
+  uint32_t size;
+  uint64_t defaultValue;
+  std::string name;
+};
+
+struct ShaderReflection
+{
+  VkShaderStageFlagBits stage;
+  std::string entryPoint;
+  std::vector<ReflectedDescriptorBinding> descriptorBindings;
+  std::vector<ReflectedPushConstantRange> pushConstantRanges;
+  std::vector<ReflectedVertexInput> vertexInputs;
+  std::vector<ReflectedSpecializationConstant> specializationConstants;
+  uint32_t localSize[3];
+};
+
+// Extracts the interface of the first entry point in a SPIR-V module, as
+// loaded by readFile().
+ShaderReflection reflectShader(const std::vector<char>& code);
+
+#endif
@@ -0,0 +1,57 @@
+#include <cstdint>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "submit_queue.hpp"
+
+SubmitQueue::Turn::Turn(SubmitQueue& queue) : m_queue(queue)
+{
+  std::unique_lock<std::mutex> lock(m_queue.m_mutex);
+  uint64_t ticket = m_queue.m_nextTicket++;
+  m_queue.m_turnChanged.wait(lock, [this, ticket]() {
+    return m_queue.m_servedTicket == ticket;
+  });
+}
+
+SubmitQueue::Turn::~Turn()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_queue.m_mutex);
+    m_queue.m_servedTicket++;
+  }
+  m_queue.m_turnChanged.notify_all();
+}
+
+void SubmitQueue::init(VkDevice device, uint32_t familyIndex)
+{
+  m_familyIndex = familyIndex;
+  vkGetDeviceQueue(device, familyIndex, 0, &m_queue);
+}
+
+uint32_t SubmitQueue::getFamilyIndex() const
+{
+  return m_familyIndex;
+}
+
+VkResult SubmitQueue::submit(uint32_t submitCount,
+                             const VkSubmitInfo* pSubmits,
+                             VkFence fence)
+{
+  Turn turn(*this);
+
+  return vkQueueSubmit(m_queue, submitCount, pSubmits, fence);
+}
+
+VkResult SubmitQueue::present(const VkPresentInfoKHR& presentInfo)
+{
+  Turn turn(*this);
+
+  return vkQueuePresentKHR(m_queue, &presentInfo);
+}
+
+void SubmitQueue::waitIdle()
+{
+  Turn turn(*this);
+  vkQueueWaitIdle(m_queue);
+}
@@ -0,0 +1,53 @@
+#ifndef SUBMIT_QUEUE_HPP
+#define SUBMIT_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+// A device queue shared by threads. Vulkan requires calls on a queue to be
+// externally synchronised, so every submission, present and wait goes
+// through here. Threads get the queue in the order they asked for it, so
+// one that submits in a tight loop cannot starve the others.
+class SubmitQueue
+{
+public:
+  void init(VkDevice device, uint32_t familyIndex);
+
+  uint32_t getFamilyIndex() const;
+
+  VkResult submit(uint32_t submitCount,
+                  const VkSubmitInfo* pSubmits,
+                  VkFence fence);
+  VkResult present(const VkPresentInfoKHR& presentInfo);
+  // Waits for all work submitted by any thread. Waiting on a fence is
+  // preferred, since it does not hold the queue meanwhile.
+  void waitIdle();
+
+private:
+  // Ticket lock: each caller takes the next ticket and waits until it is
+  // served.
+  class Turn
+  {
+  public:
+    explicit Turn(SubmitQueue& queue);
+    ~Turn();
+
+    Turn(const Turn&) = delete;
+    Turn& operator=(const Turn&) = delete;
+
+  private:
+    SubmitQueue& m_queue;
+  };
+
+  VkQueue m_queue = VK_NULL_HANDLE;
+  uint32_t m_familyIndex = 0;
+  std::mutex m_mutex;
+  std::condition_variable m_turnChanged;
+  uint64_t m_nextTicket = 0;
+  uint64_t m_servedTicket = 0;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "texture.hpp"
+
+static uint64_t alignToTextureFile(uint64_t offset)
+{
+  return (offset + TEXTURE_FILE_ALIGNMENT - 1)
+         & ~uint64_t(TEXTURE_FILE_ALIGNMENT - 1);
+}
+
+// Bytes per 4x4 block, or per texel for uncompressed formats.
+static uint32_t getBlockByteCount(VkFormat format)
+{
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+      return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return 16;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+bool isTextureFormatSupported(VkFormat format)
+{
+  return getBlockByteCount(format) != 0;
+}
+
+bool isBlockCompressed(VkFormat format)
+{
+  return format != VK_FORMAT_R8G8B8A8_UNORM
+         && format != VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+{
+  uint32_t levelCount = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+    levelCount++;
+  }
+
+  return levelCount;
+}
+
+uint32_t getMipLevelSize(uint32_t size, uint32_t level)
+{
+  return std::max(size >> level, 1u);
+}
+
+uint64_t getTextureLevelByteCount(VkFormat format,
+                                  uint32_t width,
+                                  uint32_t height)
+{
+  uint64_t blockByteCount = getBlockByteCount(format);
+  if (!isBlockCompressed(format)) {
+    return blockByteCount * width * height;
+  }
+
+  return blockByteCount * ((width + 3) / 4) * ((height + 3) / 4);
+}
+
+TextureFile::TextureFile(const std::string& fileName)
+  : m_file(fileName)
+{
+  if (m_file.getSize() < sizeof(m_header)) {
+    throw std::runtime_error("Texture file is truncated.");
+  }
+  std::memcpy(&m_header, m_file.getData(), sizeof(m_header));
+
+  if (std::memcmp(m_header.magic, TEXTURE_FILE_MAGIC,
+                  sizeof(m_header.magic)) != 0) {
+    throw std::runtime_error("File is not a texture file.");
+  }
+  if (m_header.version != TEXTURE_FILE_VERSION) {
+    throw std::runtime_error("Unsupported texture file version.");
+  }
+
+  VkFormat format = getFormat();
+  if (!isTextureFormatSupported(format)) {
+    throw std::runtime_error("Unsupported texture format.");
+  }
+  if (m_header.width == 0 || m_header.height == 0) {
+    throw std::runtime_error("Texture is empty.");
+  }
+  // Compressed levels cannot be generated, so they must all be stored.
+  uint32_t fullLevelCount = getMipLevelCount(m_header.width,
+                                             m_header.height);
+  if (m_header.levelCount == 0 || m_header.levelCount > fullLevelCount
+      || (isBlockCompressed(format)
+          && m_header.levelCount != fullLevelCount)) {
+    throw std::runtime_error("Invalid texture level count.");
+  }
+
+  uint64_t tableSize = m_header.levelCount * sizeof(TextureFileLevel);
+  if (m_file.getSize() < sizeof(m_header) + tableSize) {
+    throw std::runtime_error("Texture file is truncated.");
+  }
+  m_levels.resize(m_header.levelCount);
+  std::memcpy(m_levels.data(), m_file.getData() + sizeof(m_header),
+              tableSize);
+
+  for (uint32_t i = 0; i < m_header.levelCount; i++) {
+    const TextureFileLevel& level = m_levels[i];
+    uint64_t byteCount = getTextureLevelByteCount(
+      format, getMipLevelSize(m_header.width, i),
+      getMipLevelSize(m_header.height, i));
+    if (level.size != byteCount) {
+      throw std::runtime_error("Invalid texture level size.");
+    }
+    if (level.offset > m_file.getSize()
+        || level.size > m_file.getSize() - level.offset) {
+      throw std::runtime_error("Texture file is truncated.");
+    }
+  }
+}
+
+VkFormat TextureFile::getFormat() const
+{
+  return static_cast<VkFormat>(m_header.format);
+}
+
+VkExtent2D TextureFile::getExtent() const
+{
+  return { m_header.width, m_header.height };
+}
+
+uint32_t TextureFile::getLevelCount() const
+{
+  return m_header.levelCount;
+}
+
+const uint8_t* TextureFile::getLevelData(uint32_t level) const
+{
+  return m_file.getData() + m_levels[level].offset;
+}
+
+uint64_t TextureFile::getLevelByteCount(uint32_t level) const
+{
+  return m_levels[level].size;
+}
+
+void writeTexture(const std::string& fileName,
+                  VkFormat format,
+                  uint32_t width,
+                  uint32_t height,
+                  const std::vector<std::vector<uint8_t>>& levels)
+{
+  std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file.");
+  }
+
+  TextureFileHeader header{};
+  std::memcpy(header.magic, TEXTURE_FILE_MAGIC, sizeof(header.magic));
+  header.version = TEXTURE_FILE_VERSION;
+  header.format = static_cast<uint32_t>(format);
+  header.width = width;
+  header.height = height;
+  header.levelCount = static_cast<uint32_t>(levels.size());
+
+  std::vector<TextureFileLevel> table(levels.size());
+  uint64_t offset = sizeof(header) + table.size() * sizeof(table[0]);
+  for (size_t i = 0; i < levels.size(); i++) {
+    offset = alignToTextureFile(offset);
+    table[i].offset = offset;
+    table[i].size = levels[i].size();
+    offset += levels[i].size();
+  }
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(table.data()),
+             table.size() * sizeof(table[0]));
+
+  uint64_t position = sizeof(header) + table.size() * sizeof(table[0]);
+  const char zeroes[TEXTURE_FILE_ALIGNMENT] = {};
+  for (size_t i = 0; i < levels.size(); i++) {
+    file.write(zeroes, table[i].offset - position);
+    file.write(reinterpret_cast<const char*>(levels[i].data()),
+               levels[i].size());
+    position = table[i].offset + levels[i].size();
+  }
+
+  if (!file) {
+    throw std::runtime_error("Failed to write texture file.");
+  }
+}
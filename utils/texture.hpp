@@ -0,0 +1,80 @@
+#ifndef TEXTURE_HPP
+#define TEXTURE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "mapped_file.hpp"
+
+// On-disk layout of a texture (see tools/texpack). All values are
+// little-endian. The header is followed by a TextureFileLevel per mip
+// level, largest first, and then by the levels' data, each tightly packed
+// in rows of blocks (or of texels, for uncompressed formats) and starting
+// at a multiple of TEXTURE_FILE_ALIGNMENT.
+//
+// Block-compressed textures store their full mip chain. Uncompressed ones
+// may store only the first level, and get the others generated on load.
+static constexpr char TEXTURE_FILE_MAGIC[4] = { 'V', 'K', 'T', 'X' };
+static constexpr uint32_t TEXTURE_FILE_VERSION = 1;
+static constexpr uint32_t TEXTURE_FILE_ALIGNMENT = 16;
+
+struct TextureFileHeader
+{
+  char magic[4];
+  uint32_t version;
+  // A VkFormat, one of those isTextureFormatSupported() accepts.
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelCount;
+};
+
+struct TextureFileLevel
+{
+  // From the start of the file.
+  uint64_t offset;
+  uint64_t size;
+};
+
+// BC1, BC3, BC4, BC5 and BC7, and 8-bit RGBA.
+bool isTextureFormatSupported(VkFormat format);
+bool isBlockCompressed(VkFormat format);
+// Levels of a full mip chain, down to 1x1.
+uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+uint32_t getMipLevelSize(uint32_t size, uint32_t level);
+// Bytes of a tightly packed level of the given size.
+uint64_t getTextureLevelByteCount(VkFormat format,
+                                  uint32_t width,
+                                  uint32_t height);
+
+// A texture file, mapped rather than read, so that only the levels that
+// are used get loaded.
+class TextureFile
+{
+public:
+  // Checks the header and the level table, not the texel data.
+  explicit TextureFile(const std::string& fileName);
+
+  VkFormat getFormat() const;
+  VkExtent2D getExtent() const;
+  uint32_t getLevelCount() const;
+  const uint8_t* getLevelData(uint32_t level) const;
+  uint64_t getLevelByteCount(uint32_t level) const;
+
+private:
+  MappedFile m_file;
+  TextureFileHeader m_header;
+  std::vector<TextureFileLevel> m_levels;
+};
+
+// Writes levels, largest first, of the given format and first level size.
+void writeTexture(const std::string& fileName,
+                  VkFormat format,
+                  uint32_t width,
+                  uint32_t height,
+                  const std::vector<std::vector<uint8_t>>& levels);
+
+#endif
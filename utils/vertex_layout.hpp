@@ -0,0 +1,158 @@
+#ifndef VERTEX_LAYOUT_HPP
+#define VERTEX_LAYOUT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "../ds/Mat4.hpp"
+#include "quantize.hpp"
+
+// Maps the C++ type of a vertex struct member to the format of its vertex
+// attribute. Types spanning several locations (e.g. matrices) also set
+// locationCount and locationStride.
+template<typename T>
+struct VertexFormat;
+
+#define DEFINE_VERTEX_FORMAT(Type, Format)                \
+  template<>                                              \
+  struct VertexFormat<Type>                               \
+  {                                                       \
+    static constexpr VkFormat value = Format;             \
+    static constexpr uint32_t locationCount = 1;          \
+    static constexpr uint32_t locationStride = 0;         \
+  }
+
+DEFINE_VERTEX_FORMAT(float, VK_FORMAT_R32_SFLOAT);
+DEFINE_VERTEX_FORMAT(float[2], VK_FORMAT_R32G32_SFLOAT);
+DEFINE_VERTEX_FORMAT(float[3], VK_FORMAT_R32G32B32_SFLOAT);
+DEFINE_VERTEX_FORMAT(float[4], VK_FORMAT_R32G32B32A32_SFLOAT);
+DEFINE_VERTEX_FORMAT(uint32_t, VK_FORMAT_R32_UINT);
+DEFINE_VERTEX_FORMAT(int32_t, VK_FORMAT_R32_SINT);
+DEFINE_VERTEX_FORMAT(Half4, VK_FORMAT_R16G16B16A16_SFLOAT);
+DEFINE_VERTEX_FORMAT(OctNormal, VK_FORMAT_R16G16_SNORM);
+DEFINE_VERTEX_FORMAT(Unorm16x2, VK_FORMAT_R16G16_UNORM);
+DEFINE_VERTEX_FORMAT(Unorm8x4, VK_FORMAT_R8G8B8A8_UNORM);
+
+#undef DEFINE_VERTEX_FORMAT
+
+// A matrix takes one location per column.
+template<>
+struct VertexFormat<Mat4>
+{
+  static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT;
+  static constexpr uint32_t locationCount = 4;
+  static constexpr uint32_t locationStride = 4 * sizeof(float);
+};
+
+template<typename T, uint32_t Offset>
+struct VertexAttribute
+{
+  static constexpr VkFormat format = VertexFormat<T>::value;
+  static constexpr uint32_t offset = Offset;
+  static constexpr uint32_t size = sizeof(T);
+  static constexpr uint32_t locationCount = VertexFormat<T>::locationCount;
+  static constexpr uint32_t locationStride = VertexFormat<T>::locationStride;
+};
+
+// Describes the attribute for a member of a vertex struct, e.g.
+//   VERTEX_ATTRIBUTE(Vertex, position)
+#define VERTEX_ATTRIBUTE(Vertex, member)                  \
+  VertexAttribute<decltype(Vertex::member), offsetof(Vertex, member)>
+
+// Vertex input binding whose descriptions are generated at compile time from
+// the listed attributes. Attributes get consecutive shader locations, starting
+// from FirstLocation, in the order they are listed.
+template<typename Vertex,
+         uint32_t Binding,
+         VkVertexInputRate InputRate,
+         uint32_t FirstLocation,
+         typename... Attributes>
+struct VertexBindingLayout
+{
+  static_assert(sizeof...(Attributes) > 0,
+                "A vertex binding needs at least one attribute.");
+  static_assert(((Attributes::offset + Attributes::size <= sizeof(Vertex))
+                 && ...),
+                "Vertex attribute lies outside of the vertex.");
+  static_assert((Attributes::size + ...) == sizeof(Vertex),
+                "Vertex has padding or members without an attribute.");
+
+  static constexpr uint32_t attributeCount =
+    (Attributes::locationCount + ...);
+
+  static constexpr VkVertexInputBindingDescription binding = {
+    Binding, static_cast<uint32_t>(sizeof(Vertex)), InputRate
+  };
+
+  static constexpr std::array<VkVertexInputAttributeDescription,
+                              attributeCount> attributes = []() {
+    std::array<VkVertexInputAttributeDescription, attributeCount> result{};
+
+    constexpr VkFormat formats[] = { Attributes::format... };
+    constexpr uint32_t offsets[] = { Attributes::offset... };
+    constexpr uint32_t locationCounts[] = { Attributes::locationCount... };
+    constexpr uint32_t locationStrides[] = { Attributes::locationStride... };
+
+    uint32_t location = FirstLocation;
+    size_t i = 0;
+    for (size_t a = 0; a < sizeof...(Attributes); a++) {
+      for (uint32_t l = 0; l < locationCounts[a]; l++) {
+        result[i].location = location++;
+        result[i].binding = Binding;
+        result[i].format = formats[a];
+        result[i].offset = offsets[a] + l * locationStrides[a];
+        i++;
+      }
+    }
+
+    return result;
+  }();
+};
+
+// Vertex input state made of one or more binding layouts. The descriptions
+// live in static storage, so the returned create info can be used directly.
+template<typename... Layouts>
+struct VertexInputLayout
+{
+  static constexpr std::array<VkVertexInputBindingDescription,
+                              sizeof...(Layouts)> bindings = {
+    Layouts::binding...
+  };
+
+  static constexpr uint32_t attributeCount = (Layouts::attributeCount + ...);
+
+  static constexpr std::array<VkVertexInputAttributeDescription,
+                              attributeCount> attributes = []() {
+    std::array<VkVertexInputAttributeDescription, attributeCount> result{};
+
+    size_t i = 0;
+    auto append = [&](const auto& layoutAttributes) {
+      for (const auto& attribute : layoutAttributes) {
+        result[i++] = attribute;
+      }
+    };
+    (append(Layouts::attributes), ...);
+
+    return result;
+  }();
+
+  static VkPipelineVertexInputStateCreateInfo createInfo()
+  {
+    VkPipelineVertexInputStateCreateInfo createInfo{};
+    createInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    createInfo.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(bindings.size());
+    createInfo.pVertexBindingDescriptions = bindings.data();
+    createInfo.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(attributes.size());
+    createInfo.pVertexAttributeDescriptions = attributes.data();
+
+    return createInfo;
+  }
+};
+
+#endif
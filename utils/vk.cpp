@@ -1,3 +1,8 @@
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
 #include <vulkan/vulkan.h>
 
 #include "vk.hpp"
@@ -27,4 +32,258 @@ void DestroyDebugUtilsMessengerEXT(
   if (func != nullptr) {
     func(instance, debugMessenger, pAllocator);
   }
-}
\ No newline at end of file
+}
+
+static std::atomic<uint64_t> s_memoryAllocationCount{ 0 };
+static std::atomic<uint64_t> s_memoryFreeCount{ 0 };
+
+VkResult allocateMemory(VkDevice device,
+                        const VkMemoryAllocateInfo* pAllocateInfo,
+                        const VkAllocationCallbacks* pAllocator,
+                        VkDeviceMemory* pMemory)
+{
+  VkResult result = vkAllocateMemory(device, pAllocateInfo, pAllocator,
+                                     pMemory);
+  if (result == VK_SUCCESS) {
+    s_memoryAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  return result;
+}
+
+void freeMemory(VkDevice device,
+                VkDeviceMemory memory,
+                const VkAllocationCallbacks* pAllocator)
+{
+  if (memory != VK_NULL_HANDLE) {
+    s_memoryFreeCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  vkFreeMemory(device, memory, pAllocator);
+}
+
+uint64_t getMemoryAllocationCount()
+{
+  return s_memoryAllocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t getMemoryFreeCount()
+{
+  return s_memoryFreeCount.load(std::memory_order_relaxed);
+}
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice,
+                        uint32_t typeFilter,
+                        VkMemoryPropertyFlags properties)
+{
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i))
+        && (memoryProperties.memoryTypes[i].propertyFlags & properties)
+           == properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("Failed to find a suitable memory type!");
+}
+
+void createBuffer(VkDevice device,
+                  VkPhysicalDevice physicalDevice,
+                  VkDeviceSize size,
+                  VkBufferUsageFlags usage,
+                  VkMemoryPropertyFlags properties,
+                  VkBuffer& buffer,
+                  VkDeviceMemory& bufferMemory,
+                  const std::vector<uint32_t>& queueFamilies)
+{
+  VkBufferCreateInfo bufferCreateInfo{};
+  bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferCreateInfo.size = size;
+  bufferCreateInfo.usage = usage;
+  if (queueFamilies.size() > 1) {
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(
+      queueFamilies.size());
+    bufferCreateInfo.pQueueFamilyIndices = queueFamilies.data();
+  } else {
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  }
+  if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create buffer!");
+  }
+
+  VkMemoryRequirements memoryRequirements;
+  vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memoryRequirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(physicalDevice,
+                                             memoryRequirements.memoryTypeBits,
+                                             properties);
+  if (allocateMemory(device, &allocInfo, nullptr, &bufferMemory)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate buffer memory!");
+  }
+
+  vkBindBufferMemory(device, buffer, bufferMemory, 0);
+}
+
+void createImage(VkDevice device,
+                 VkPhysicalDevice physicalDevice,
+                 VkExtent2D extent,
+                 VkFormat format,
+                 VkImageUsageFlags usage,
+                 VkMemoryPropertyFlags properties,
+                 VkImage& image,
+                 VkDeviceMemory& imageMemory,
+                 uint32_t mipLevelCount)
+{
+  VkImageCreateInfo imageCreateInfo{};
+  imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageCreateInfo.format = format;
+  imageCreateInfo.extent = { extent.width, extent.height, 1 };
+  imageCreateInfo.mipLevels = mipLevelCount;
+  imageCreateInfo.arrayLayers = 1;
+  imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageCreateInfo.usage = usage;
+  imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if (vkCreateImage(device, &imageCreateInfo, nullptr, &image)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create image!");
+  }
+
+  VkMemoryRequirements memoryRequirements;
+  vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memoryRequirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(physicalDevice,
+                                             memoryRequirements.memoryTypeBits,
+                                             properties);
+  if (allocateMemory(device, &allocInfo, nullptr, &imageMemory)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate image memory!");
+  }
+
+  vkBindImageMemory(device, image, imageMemory, 0);
+}
+
+VkShaderModule createShaderModule(VkDevice device,
+                                  const std::vector<char>& code)
+{
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = code.size();
+  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create shader module!");
+  }
+
+  return shaderModule;
+}
+
+VkDescriptorSet allocateDescriptorSet(VkDevice device,
+                                      VkDescriptorPool descriptorPool,
+                                      VkDescriptorSetLayout setLayout)
+{
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &setLayout;
+
+  VkDescriptorSet descriptorSet;
+  if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate descriptor set!");
+  }
+
+  return descriptorSet;
+}
+
+VkCommandBuffer beginSingleTimeCommands(VkDevice device,
+                                        VkCommandPool commandPool)
+{
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = commandPool;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+  if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate command buffer!");
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+  return commandBuffer;
+}
+
+void endSingleTimeCommands(VkDevice device,
+                           VkCommandPool commandPool,
+                           SubmitQueue& queue,
+                           VkCommandBuffer commandBuffer)
+{
+  vkEndCommandBuffer(commandBuffer);
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+
+  VkFenceCreateInfo fenceCreateInfo{};
+  fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence;
+  if (vkCreateFence(device, &fenceCreateInfo, nullptr, &fence)
+      != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create fence!");
+  }
+
+  // Only used while loading, so waiting for the work is acceptable here.
+  // Waiting for the whole queue would also wait for other threads' frames.
+  VkResult result = queue.submit(1, &submitInfo, fence);
+  if (result == VK_SUCCESS) {
+    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+  }
+  vkDestroyFence(device, fence, nullptr);
+  vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("Failed to submit command buffer!");
+  }
+}
+
+void copyBuffer(VkDevice device,
+                VkCommandPool commandPool,
+                SubmitQueue& queue,
+                VkBuffer srcBuffer,
+                VkBuffer dstBuffer,
+                VkDeviceSize size)
+{
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(device,
+                                                          commandPool);
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = 0;
+  copyRegion.dstOffset = 0;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+  endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+}
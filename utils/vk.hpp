@@ -1,8 +1,13 @@
 #ifndef VK_HPP
 #define VK_HPP
 
+#include <cstdint>
+#include <vector>
+
 #include <vulkan/vulkan.h>
 
+#include "submit_queue.hpp"
+
 VkResult CreateDebugUtilsMessengerEXT(
   VkInstance instance,
   const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
@@ -14,4 +19,67 @@ void DestroyDebugUtilsMessengerEXT(
   VkDebugUtilsMessengerEXT debugMessenger,
   const VkAllocationCallbacks* pAllocator);
 
-#endif
\ No newline at end of file
+// Wrap vkAllocateMemory() and vkFreeMemory(), counting the calls, since
+// the number of allocations a device allows is limited.
+VkResult allocateMemory(VkDevice device,
+                        const VkMemoryAllocateInfo* pAllocateInfo,
+                        const VkAllocationCallbacks* pAllocator,
+                        VkDeviceMemory* pMemory);
+void freeMemory(VkDevice device,
+                VkDeviceMemory memory,
+                const VkAllocationCallbacks* pAllocator);
+// Totals since startup, over all devices.
+uint64_t getMemoryAllocationCount();
+uint64_t getMemoryFreeCount();
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice,
+                        uint32_t typeFilter,
+                        VkMemoryPropertyFlags properties);
+
+// Buffers used by several queue families without ownership transfers list
+// them in queueFamilies, and are shared concurrently.
+void createBuffer(VkDevice device,
+                  VkPhysicalDevice physicalDevice,
+                  VkDeviceSize size,
+                  VkBufferUsageFlags usage,
+                  VkMemoryPropertyFlags properties,
+                  VkBuffer& buffer,
+                  VkDeviceMemory& bufferMemory,
+                  const std::vector<uint32_t>& queueFamilies = {});
+
+// A 2D image with one layer, in optimal tiling.
+void createImage(VkDevice device,
+                 VkPhysicalDevice physicalDevice,
+                 VkExtent2D extent,
+                 VkFormat format,
+                 VkImageUsageFlags usage,
+                 VkMemoryPropertyFlags properties,
+                 VkImage& image,
+                 VkDeviceMemory& imageMemory,
+                 uint32_t mipLevelCount = 1);
+
+VkShaderModule createShaderModule(VkDevice device,
+                                  const std::vector<char>& code);
+
+VkDescriptorSet allocateDescriptorSet(VkDevice device,
+                                      VkDescriptorPool descriptorPool,
+                                      VkDescriptorSetLayout setLayout);
+
+VkCommandBuffer beginSingleTimeCommands(VkDevice device,
+                                        VkCommandPool commandPool);
+
+// Submits the command buffer and waits for it alone, so other threads
+// can keep submitting to the queue meanwhile.
+void endSingleTimeCommands(VkDevice device,
+                           VkCommandPool commandPool,
+                           SubmitQueue& queue,
+                           VkCommandBuffer commandBuffer);
+
+void copyBuffer(VkDevice device,
+                VkCommandPool commandPool,
+                SubmitQueue& queue,
+                VkBuffer srcBuffer,
+                VkBuffer dstBuffer,
+                VkDeviceSize size);
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef WORK_STEALING_DEQUE_HPP
+#define WORK_STEALING_DEQUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Chase-Lev work-stealing deque of pointers, with the memory orderings from
+// Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models".
+// The owning thread pushes and pops at the bottom, and other threads steal
+// from the top, so the owner only contends with thieves over the last item.
+template<typename T>
+class WorkStealingDeque
+{
+public:
+  // The capacity must be a power of two. The deque grows when full.
+  explicit WorkStealingDeque(int64_t capacity = 1024)
+  {
+    m_buffers.push_back(std::make_unique<Buffer>(capacity));
+    m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  // Owner only.
+  void push(T* item)
+  {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+    if (bottom - top > buffer->capacity - 1) {
+      buffer = grow(buffer, bottom, top);
+    }
+
+    buffer->put(bottom, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only. Returns nullptr if empty.
+  T* pop()
+  {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    T* item = buffer->get(bottom);
+    if (top == bottom) {
+      // The last item, which a thief may be taking at the same time.
+      if (!m_top.compare_exchange_strong(top, top + 1,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return item;
+  }
+
+  // Any thread. Returns nullptr if empty, or if another thread took the
+  // item first.
+  T* steal()
+  {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return nullptr;
+    }
+
+    Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+    T* item = buffer->get(top);
+    if (!m_top.compare_exchange_strong(top, top + 1,
+                                       std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+      return nullptr;
+    }
+
+    return item;
+  }
+
+private:
+  struct Buffer
+  {
+    explicit Buffer(int64_t capacity)
+      : capacity(capacity)
+      , items(std::make_unique<std::atomic<T*>[]>(capacity)) {}
+
+    T* get(int64_t i) const
+    {
+      return items[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+
+    void put(int64_t i, T* item)
+    {
+      items[i & (capacity - 1)].store(item, std::memory_order_relaxed);
+    }
+
+    const int64_t capacity;
+    std::unique_ptr<std::atomic<T*>[]> items;
+  };
+
+  Buffer* grow(Buffer* buffer, int64_t bottom, int64_t top)
+  {
+    auto grown = std::make_unique<Buffer>(buffer->capacity * 2);
+    for (int64_t i = top; i < bottom; i++) {
+      grown->put(i, buffer->get(i));
+    }
+
+    // Thieves may still be reading the old buffer, so it is only freed
+    // with the deque.
+    m_buffers.push_back(std::move(grown));
+    m_buffer.store(m_buffers.back().get(), std::memory_order_release);
+
+    return m_buffers.back().get();
+  }
+
+  // On separate cache lines, since the owner writes the bottom and thieves
+  // the top.
+  alignas(64) std::atomic<int64_t> m_top{ 0 };
+  alignas(64) std::atomic<int64_t> m_bottom{ 0 };
+  std::atomic<Buffer*> m_buffer;
+  // Owner only.
+  std::vector<std::unique_ptr<Buffer>> m_buffers;
+};
+
+#endif